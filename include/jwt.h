@@ -399,6 +399,106 @@ typedef enum {
         JWT_CLAIM_JTI           = 0x0040, /**< @rfc_t{7519,4.1.7} ``"jti"`` */
 } jwt_claims_t;
 
+/**
+ * @brief Why a verify failed
+ *
+ * The machine-readable reason for a rejected token: see
+ * jwt_checker_error_code(). Failing claims get one of ::JWT_ERR_EXPIRED,
+ * ::JWT_ERR_NOT_BEFORE, ::JWT_ERR_CLAIMS or ::JWT_ERR_REPLAY, in that order,
+ * and jwt_checker_error_claims() says which claims they were. Anything
+ * without a reason of its own (a bad argument, an unsupported "crit" header,
+ * a key too short for its alg, ...) is ::JWT_ERR_OTHER, and the error
+ * message tells it apart.
+ *
+ * @since 3.7.0
+ */
+typedef enum {
+	JWT_ERR_NONE = 0,	/**< No error					*/
+	JWT_ERR_OTHER,		/**< See the error message			*/
+	JWT_ERR_MALFORMED,	/**< Not a well-formed token			*/
+	JWT_ERR_ALG_DENIED,	/**< Its "alg" (or "typ") is not allowed	*/
+	JWT_ERR_KID_UNKNOWN,	/**< No key to verify it with			*/
+	JWT_ERR_BAD_SIG,	/**< The signature did not verify		*/
+	JWT_ERR_EXPIRED,	/**< "exp" has passed				*/
+	JWT_ERR_NOT_BEFORE,	/**< "nbf" is still to come			*/
+	JWT_ERR_CLAIMS,		/**< Another claim failed or is missing		*/
+	JWT_ERR_REPLAY,		/**< "jti" is missing or was turned down	*/
+	JWT_ERR_LIMIT,		/**< Over a limit of jwt_checker_setlimits()	*/
+} jwt_error_t;
+
+/**
+ * @brief Limits on the size and shape of an untrusted token
+ *
+ * A token is hostile input, and every octet of it costs something to
+ * decode. These bound what a checker will look at, so one oversized token
+ * costs no more to turn down than a good one costs to accept. Each is
+ * checked before the part it bounds is allocated or parsed. A field of 0
+ * means no limit.
+ *
+ * The JSON limits apply to every JSON document of the token: the header
+ * and claims, and for a JSON Serialization, the serialization itself (for
+ * which @ref max_string_len is not checked, as it holds the encoded
+ * payload and signatures; @ref max_payload_len bounds those).
+ *
+ * @since 3.7.0
+ */
+typedef struct {
+	size_t max_token_len;	/**< Octets in the whole token			*/
+	size_t max_header_len;	/**< Decoded octets of a (protected) header	*/
+	size_t max_payload_len;	/**< Decoded octets of the payload or JWE
+				 *   ciphertext					*/
+	unsigned int max_depth;	/**< Nesting of JSON objects and arrays		*/
+	size_t max_members;	/**< JSON object members and array elements,
+				 *   in all, in one document			*/
+	size_t max_string_len;	/**< Octets in one JSON string, as encoded	*/
+} jwt_limits_t;
+
+/**
+ * @brief Stages of a token operation counted by the statistics API
+ *
+ * Stages nest: parsing a token includes the base64 and JSON decoding it
+ * does, and checking a signature includes decoding it. See jwt_stats_t.
+ *
+ * @since 3.7.0
+ */
+typedef enum {
+	JWT_STAGE_PARSE = 0,	/**< Splitting and decoding a token		*/
+	JWT_STAGE_BASE64,	/**< base64url encoding and decoding		*/
+	JWT_STAGE_JSON,		/**< JSON parsing and serialization		*/
+	JWT_STAGE_CLAIMS,	/**< Claim checks, including "jti"		*/
+	JWT_STAGE_KEY,		/**< Finding and binding the key		*/
+	JWT_STAGE_SIGNATURE,	/**< Signing and signature checks		*/
+	JWT_STAGE_JWE,		/**< JWE key management and content crypto	*/
+	JWT_STAGE_COUNT,	/**< Number of stages (not a stage)		*/
+} jwt_stage_t;
+
+/**
+ * @brief Counters for one stage of a token operation
+ * @since 3.7.0
+ */
+typedef struct {
+	unsigned long long count;	/**< Times the stage ran		*/
+	unsigned long long failures;	/**< Times it failed			*/
+	unsigned long long ns;		/**< Total time in it, in nanoseconds	*/
+} jwt_stage_stats_t;
+
+/**
+ * @brief Per-stage statistics of a checker or builder
+ *
+ * Filled by jwt_checker_stats(), jwt_builder_stats(), jwe_checker_stats()
+ * and jwe_builder_stats(). Each verify, generate or decrypt is a call; one
+ * that fails is also counted against the stage it failed in. A failure
+ * outside every stage (e.g. an algorithm allowlist or the callback) only
+ * counts in @ref failures.
+ *
+ * @since 3.7.0
+ */
+typedef struct {
+	unsigned long long calls;	/**< Operations started			*/
+	unsigned long long failures;	/**< Operations that failed		*/
+	jwt_stage_stats_t stage[JWT_STAGE_COUNT]; /**< By ::jwt_stage_t	*/
+} jwt_stats_t;
+
 /**
  * @defgroup jwt_grp JSON Web Token
  *
@@ -759,6 +859,60 @@ int jwt_builder_setcb(jwt_builder_t *builder, jwt_callback_t cb, void *ctx);
 JWT_EXPORT
 int jwt_builder_setjti(jwt_builder_t *builder, jwt_jti_gen_cb_t cb, void *ctx);
 
+/**
+ * @brief Build tokens in a per-thread arena
+ *
+ * As jwt_checker_setarena(), for jwt_builder_generate(): the JWT object and
+ * the copies of the header and claims it is built from come from the calling
+ * thread's arena, which is reset when the call returns. The generated token
+ * is always allocated normally.
+ *
+ * @param builder Pointer to a builder object
+ * @param size Size of the first arena block in octets, or 0 to disable
+ * @return 0 on success, non-zero otherwise
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwt_builder_setarena(jwt_builder_t *builder, size_t size);
+
+/**
+ * @brief Sign the signatures of a JWS JSON Serialization in parallel
+ *
+ * By default each signature of a JSON-serialized JWS (jwt_builder_set_format())
+ * is made in turn on the calling thread. With @p threads set, they are signed
+ * on up to that many threads, the calling one included, started for each
+ * jwt_builder_generate() and joined before it returns. Headers are still built
+ * and the output still assembled on the calling thread, in signature order.
+ * Signing stops at the first signature that fails, which is the one reported.
+ *
+ * This pays off for slow algorithms (RSA, ML-DSA) and several signatures; a
+ * Compact token, or a single signature, is not affected.
+ *
+ * @param builder Pointer to a builder object
+ * @param threads Threads to sign with, or 0 to sign on the calling thread
+ * @return 0 on success, non-zero otherwise
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwt_builder_setthreads(jwt_builder_t *builder, unsigned int threads);
+
+/**
+ * @brief Get the per-stage statistics of a builder
+ *
+ * Counters are only kept when LibJWT is built with ``WITH_STATS``
+ * (``LIBJWT_HAVE_STATS`` is then defined); otherwise the instrumentation is
+ * compiled out and this always fails. They are updated atomically, so they
+ * may be read while other threads use the builder, but the fields are read
+ * one at a time, not as a single snapshot.
+ *
+ * @param builder Pointer to a builder object
+ * @param stats Filled with the counters since the builder was created
+ * @return 0 on success, non-zero if the statistics are not available
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwt_builder_stats(const jwt_builder_t *builder, jwt_stats_t *stats);
+
 /**
  * @brief Retrieve the callback context that was previously set
  *
@@ -961,6 +1115,33 @@ int jwt_checker_error(const jwt_checker_t *checker);
 JWT_EXPORT
 const char *jwt_checker_error_msg(const jwt_checker_t *checker);
 
+/**
+ * @brief Get the reason for the error in a checker object
+ *
+ * Unlike the message, the reason of a rejected token costs nothing to
+ * record, so a service turning down a flood of bad tokens can count them by
+ * reason without ever formatting a message. The message is only looked up
+ * when jwt_checker_error_msg() asks for it.
+ *
+ * @param checker Pointer to a checker object
+ * @return ::JWT_ERR_NONE if there is no error, else the reason
+ * @since 3.7.0
+ */
+JWT_EXPORT
+jwt_error_t jwt_checker_error_code(const jwt_checker_t *checker);
+
+/**
+ * @brief Get the claims that failed the last verify
+ *
+ * @param checker Pointer to a checker object
+ * @return The ORd ``JWT_CLAIM_*`` values of the claims that failed, or 0 if
+ *  the error (if any) was not a claim failing. A missing required claim
+ *  (jwt_checker_require()) is not one of these; its name is in the message.
+ * @since 3.7.0
+ */
+JWT_EXPORT
+jwt_claims_t jwt_checker_error_claims(const jwt_checker_t *checker);
+
 /**
  * @brief Clear error state in a checker object
  *
@@ -1025,6 +1206,32 @@ JWT_EXPORT
 int jwt_checker_setkeyring(jwt_checker_t *checker, const jwk_set_t *keyring,
 			   jwt_verify_policy_t policy);
 
+/**
+ * @brief Verify the signatures of a JWS JSON Serialization in parallel
+ *
+ * By default every signature of a JSON-serialized JWS is verified in turn on
+ * the calling thread, so jwt_checker_sig_verified() reports on each of them.
+ * With @p threads set, the signatures are verified on up to that many
+ * threads, the calling one included, started for each jwt_checker_verify()
+ * and joined before it returns, and verification stops as soon as the
+ * ::jwt_verify_policy_t is decided: at the first signature that verifies
+ * under ::JWT_VERIFY_POLICY_ANY, or the first that does not under
+ * ::JWT_VERIFY_POLICY_ALL. A signature left unchecked reports as not
+ * verified. Even with one thread, this stops early.
+ *
+ * Header checks, key selection and the callback (jwt_checker_setcb()) still
+ * run on the calling thread, in signature order, before any verify. Keys are
+ * shared by the threads, as with jwt_checker_verify_batch().
+ *
+ * @param checker Pointer to a checker object
+ * @param threads Threads to verify with, or 0 to verify every signature on
+ *  the calling thread
+ * @return 0 on success, non-zero otherwise
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwt_checker_setthreads(jwt_checker_t *checker, unsigned int threads);
+
 /**
  * @brief Require a specific token media type ("typ" header)
  *
@@ -1192,6 +1399,53 @@ int jwt_checker_setcb(jwt_checker_t *checker, jwt_callback_t cb, void *ctx);
 JWT_EXPORT
 int jwt_checker_setjti(jwt_checker_t *checker, jwt_jti_check_cb_t cb, void *ctx);
 
+/**
+ * @brief Decode tokens into a per-thread arena
+ *
+ * Each verify allocates a JWT object and JSON trees for its header and
+ * claims, and frees them when it is done. With an arena, those come from a
+ * block of memory owned by the calling thread and are released together by
+ * resetting it at the end of the verify, instead of one allocation at a time.
+ * Keys, caches and anything else that outlives the verify are still
+ * allocated normally.
+ *
+ * @p size is the size of the thread's first block. More is added if a verify
+ * needs it, and the arena keeps one block big enough for the largest verify
+ * so far. The arena stays with the thread until it exits or calls
+ * jwt_arena_release().
+ *
+ * Enabling an arena also points the JSON library's allocator at LibJWT's,
+ * as jwt_set_alloc() does. With json-c, which has no allocator hooks, only
+ * LibJWT's own allocations come from the arena.
+ *
+ * @warning The JWT object passed to a callback (jwt_checker_setcb(),
+ *  jwt_checker_setjti()) and anything borrowed from it are only valid until
+ *  the callback returns, as without an arena.
+ *
+ * @param checker Pointer to a checker object
+ * @param size Size of the first arena block in octets, or 0 to disable
+ * @return 0 on success, non-zero otherwise
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwt_checker_setarena(jwt_checker_t *checker, size_t size);
+
+/**
+ * @brief Limit the size and shape of the tokens a checker accepts
+ *
+ * Every verify checks the token against @p limits (see jwt_limits_t) as
+ * it goes, and turns it down with ::JWT_ERR_LIMIT at the first one it is
+ * over, before decoding any more of it. The limits are copied. By default,
+ * there are none.
+ *
+ * @param checker Pointer to a checker object
+ * @param limits The limits, or NULL for none
+ * @return 0 on success, non-zero otherwise
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwt_checker_setlimits(jwt_checker_t *checker, const jwt_limits_t *limits);
+
 /**
  * @brief Retrieve the callback context that was previously set
  *
@@ -1241,6 +1495,93 @@ int jwt_checker_understands(jwt_checker_t *checker, const char *header);
 JWT_EXPORT
 int jwt_checker_verify(jwt_checker_t *checker, const char *token);
 
+/**
+ * @brief Verify a token given by pointer and length
+ *
+ * Like jwt_checker_verify(), but the token is the @p len octets at @p token,
+ * which need not be nil-terminated. Suited to verifying a bearer token in
+ * place inside a larger buffer (e.g. an HTTP header) without copying it. The
+ * length is carried through parsing and signature verification; the token is
+ * not rescanned for its end.
+ *
+ * @param checker Pointer to a checker object
+ * @param token Start of the token to be verified
+ * @param len Length of the token in octets
+ * @return 0 on success, non-zero otherwise with error set in the checker
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwt_checker_verify_n(jwt_checker_t *checker, const char *token,
+			 size_t len);
+
+/**
+ * @brief Size of a formatted error message, including its terminating nul
+ *
+ * @since 3.7.0
+ */
+#define JWT_ERROR_MSG_LEN	256
+
+/**
+ * @brief The outcome of one token in jwt_checker_verify_batch()
+ *
+ * A fixed message is pointed to, not copied. Only a formatted one is copied,
+ * into @ref error_buf, so @ref error_msg may point into the result itself:
+ * read it where it was written, not from a copy of the struct.
+ *
+ * @since 3.7.0
+ */
+typedef struct {
+	int error;		/**< 0 if the token verified			*/
+	const char *error_msg;	/**< Why it did not, or an empty string	*/
+	jwt_error_t code;	/**< As jwt_checker_error_code()		*/
+	jwt_claims_t claims;	/**< As jwt_checker_error_claims()		*/
+	char error_buf[JWT_ERROR_MSG_LEN]; /**< Storage for a formatted
+					    * @ref error_msg			*/
+} jwt_verify_result_t;
+
+/**
+ * @brief Verify a batch of tokens
+ *
+ * Verifies each of the @p n tokens as jwt_checker_verify_n() would, and
+ * records each outcome in the matching element of @p results. One token
+ * failing does not stop the rest. Each thread reads the checker's
+ * configuration once and reuses it for every token it verifies.
+ *
+ * With @p threads above 1 the tokens are spread over up to that many threads,
+ * counting the calling thread, which returns once every token is done. Any
+ * callbacks set on the checker (jwt_checker_setcb(), jwt_checker_setjti())
+ * may then be called from several threads at once and must be safe for that.
+ *
+ * The checker's own error and signature state (jwt_checker_error(),
+ * jwt_checker_sig_count()) are left as they were, unless the arguments are
+ * invalid.
+ *
+ * @code
+ * jwt_verify_result_t results[64];
+ *
+ * if (jwt_checker_verify_batch(checker, tokens, lens, 64, results, 4)) {
+ *     for (i = 0; i < 64; i++)
+ *         if (results[i].error)
+ *             printf("%zu: %s\n", i, results[i].error_msg);
+ * }
+ * @endcode
+ *
+ * @param checker Pointer to a checker object
+ * @param tokens An array of @p n tokens
+ * @param lens The length of each token in octets, or NULL if every token is
+ *  nil-terminated
+ * @param n The number of tokens
+ * @param results An array of @p n results, filled in
+ * @param threads The number of threads to use; 0 or 1 for the calling thread
+ *  only
+ * @return 0 if every token verified, non-zero otherwise
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwt_checker_verify_batch(jwt_checker_t *checker, const char *const *tokens,
+			     const size_t *lens, size_t n,
+			     jwt_verify_result_t *results, unsigned int threads);
+
 /**
  * @brief Number of signatures in the last verified token
  *
@@ -1305,6 +1646,298 @@ JWT_EXPORT
 int jwt_checker_verify_detached(jwt_checker_t *checker, const char *token,
 				const unsigned char *payload, size_t len);
 
+/**
+ * @brief Cache verified signatures on a checker
+ *
+ * Services that see the same token many times over its lifetime can skip the
+ * signature operation after the first verify. When enabled, a Compact token
+ * whose signature verifies is remembered, keyed by a hash of the token and the
+ * @rfc{7638} thumbprint of the key it verified against. A later verify of the
+ * byte-identical token, with the same key and algorithm, skips the signature
+ * check.
+ *
+ * Only the signature result is cached. The token is still parsed, and the
+ * callback (jwt_checker_setcb()), ``"crit"`` handling, the claim checks --
+ * including ``"exp"`` and ``"nbf"`` against the current time -- and the jti
+ * callback (jwt_checker_setjti()) all run on every verify, hit or not. JSON
+ * Serialization tokens are not cached.
+ *
+ * The least recently used entry is dropped once @p entries are held, and an
+ * entry is dropped @p ttl seconds after it was added (0 for no time limit).
+ * Calling this again replaces the cache, dropping all entries and counters;
+ * passing @p entries as 0 disables it. A cache on a shared checker
+ * (jwt_checker_freeze()) is used by all of its threads.
+ *
+ * @param checker Pointer to a checker object
+ * @param entries Maximum number of cached tokens, or 0 to disable
+ * @param ttl Maximum age of an entry in seconds, or 0 for no limit
+ * @return 0 on success, non-zero otherwise with error set in the checker
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwt_checker_cache(jwt_checker_t *checker, unsigned int entries, time_t ttl);
+
+/**
+ * @brief Get the verified-signature cache counters
+ *
+ * A hit is a verify that skipped the signature check; a miss is one that
+ * looked and did not. Any of the out parameters may be NULL.
+ *
+ * @param checker Pointer to a checker object
+ * @param hits Set to the number of cache hits
+ * @param misses Set to the number of cache misses
+ * @param entries Set to the number of tokens currently cached
+ * @return 0 on success, non-zero if no cache is enabled (see
+ *  jwt_checker_cache())
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwt_checker_cache_stats(const jwt_checker_t *checker, unsigned long *hits,
+			    unsigned long *misses, unsigned int *entries);
+
+/**
+ * @brief Get the per-stage statistics of a checker
+ *
+ * Like jwt_builder_stats(), for verifies. The verifies of a shared checker
+ * (jwt_checker_freeze()), from every thread, count in the checker it was
+ * frozen from.
+ *
+ * @param checker Pointer to a checker object
+ * @param stats Filled with the counters since the checker was created
+ * @return 0 on success, non-zero if the statistics are not available
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwt_checker_stats(const jwt_checker_t *checker, jwt_stats_t *stats);
+
+/**
+ * @brief Opaque frozen checker, shareable between threads
+ *
+ * Made by jwt_checker_freeze(). Its configuration can no longer change, so
+ * any number of threads may verify against it at once, each with its own
+ * @ref jwt_verify_ctx_t.
+ *
+ * @since 3.7.0
+ */
+typedef struct jwt_checker_shared jwt_checker_shared_t;
+
+/**
+ * @brief Opaque per-call verification context
+ *
+ * Holds the result of one jwt_checker_shared_verify(): the error state and
+ * the per-signature results. A context is used by one thread at a time and
+ * may be reused for any number of verifies, against any shared checker.
+ *
+ * @since 3.7.0
+ */
+typedef struct jwt_verify_ctx jwt_verify_ctx_t;
+
+/**
+ * @brief Freeze a configured checker for sharing between threads
+ *
+ * Takes ownership of @p checker and returns a reference-counted handle to
+ * it with a count of one. From here on @p checker must not be used or freed
+ * directly; it is freed when the last reference is dropped with
+ * jwt_checker_shared_unref().
+ *
+ * Verifying with jwt_checker_shared_verify() only reads the frozen
+ * configuration and takes no locks, other than a short one around the
+ * verified-signature cache if one is enabled (jwt_checker_cache()). Keys, keyrings and callback contexts that
+ * the checker borrows must stay valid for the life of the shared checker, and
+ * any callbacks set on it (jwt_checker_setcb(), jwt_checker_setjti()) must be
+ * safe to call from several threads at once.
+ *
+ * @code
+ * jwt_checker_shared_t *shared;
+ *
+ * checker = jwt_checker_new();
+ * jwt_checker_setkey(checker, JWT_ALG_ES256, key);
+ * shared = jwt_checker_freeze(checker); // checker now belongs to shared
+ *
+ * // In each worker thread
+ * jwt_verify_ctx_t *ctx = jwt_verify_ctx_new();
+ * if (jwt_checker_shared_verify(shared, ctx, token, token_len))
+ *     printf("Rejected: %s\n", jwt_verify_ctx_error_msg(ctx));
+ * jwt_verify_ctx_free(ctx);
+ *
+ * jwt_checker_shared_unref(shared);
+ * @endcode
+ *
+ * @param checker Pointer to a checker object
+ * @return A shared checker, or NULL on failure (in which case @p checker is
+ *  still owned by the caller)
+ * @since 3.7.0
+ */
+JWT_EXPORT
+jwt_checker_shared_t *jwt_checker_freeze(jwt_checker_t *checker);
+
+/**
+ * @brief Take another reference to a shared checker
+ *
+ * @param shared Pointer to a shared checker
+ * @return @p shared
+ * @since 3.7.0
+ */
+JWT_EXPORT
+jwt_checker_shared_t *jwt_checker_shared_ref(jwt_checker_shared_t *shared);
+
+/**
+ * @brief Drop a reference to a shared checker
+ *
+ * The frozen checker is freed with the last reference.
+ *
+ * @param shared Pointer to a shared checker
+ * @since 3.7.0
+ */
+JWT_EXPORT
+void jwt_checker_shared_unref(jwt_checker_shared_t *shared);
+
+/**
+ * @brief Create a per-call verification context
+ *
+ * @return Pointer to a context on success, NULL on failure
+ * @since 3.7.0
+ */
+JWT_EXPORT
+jwt_verify_ctx_t *jwt_verify_ctx_new(void);
+
+/**
+ * @brief Free a verification context
+ *
+ * May be done before or after the shared checker it was last used with is
+ * released.
+ *
+ * @param ctx Pointer to a context
+ * @since 3.7.0
+ */
+JWT_EXPORT
+void jwt_verify_ctx_free(jwt_verify_ctx_t *ctx);
+
+#if defined(__GNUC__) || defined(__clang__) || defined(_DOXYGEN)
+/**
+ * @brief Helper function to free a context and set the pointer to NULL
+ *
+ * This is mainly to use with the jwt_verify_ctx_auto_t type.
+ *
+ * @param Pointer to a pointer for a jwt_verify_ctx_t object
+ * @since 3.7.0
+ */
+static inline void jwt_verify_ctx_freep(jwt_verify_ctx_t **ctx) {
+        if (ctx) {
+                jwt_verify_ctx_free(*ctx);
+                *ctx = NULL;
+        }
+}
+/**
+ * @brief A jwt_verify_ctx_t pointer that is freed automatically at scope exit
+ *
+ * @since 3.7.0
+ */
+#define jwt_verify_ctx_auto_t jwt_verify_ctx_t \
+        __attribute__((cleanup(jwt_verify_ctx_freep)))
+#endif
+
+/**
+ * @brief Verify a token against a shared checker
+ *
+ * Behaves as jwt_checker_verify_n() on the frozen checker, except that the
+ * error and signature results go to @p ctx. Safe to call concurrently on the
+ * same @p shared, provided each thread passes its own @p ctx.
+ *
+ * @param shared Pointer to a shared checker
+ * @param ctx Pointer to a context, reset at the start of the call
+ * @param token Start of the token to be verified
+ * @param len Length of the token in octets
+ * @return 0 on success, non-zero otherwise with error set in @p ctx
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwt_checker_shared_verify(const jwt_checker_shared_t *shared,
+			      jwt_verify_ctx_t *ctx, const char *token,
+			      size_t len);
+
+/**
+ * @brief Checks error state of a verification context
+ *
+ * @param ctx Pointer to a context
+ * @return 0 if no errors exist, non-zero otherwise
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwt_verify_ctx_error(const jwt_verify_ctx_t *ctx);
+
+/**
+ * @brief Get the error message from a verification context
+ *
+ * @param ctx Pointer to a context
+ * @return A string message, empty if no error
+ * @since 3.7.0
+ */
+JWT_EXPORT
+const char *jwt_verify_ctx_error_msg(const jwt_verify_ctx_t *ctx);
+
+/**
+ * @brief Get the reason for the error in a verification context
+ *
+ * @param ctx Pointer to a context
+ * @return As jwt_checker_error_code()
+ * @since 3.7.0
+ */
+JWT_EXPORT
+jwt_error_t jwt_verify_ctx_error_code(const jwt_verify_ctx_t *ctx);
+
+/**
+ * @brief Get the claims that failed the last verify with a context
+ *
+ * @param ctx Pointer to a context
+ * @return As jwt_checker_error_claims()
+ * @since 3.7.0
+ */
+JWT_EXPORT
+jwt_claims_t jwt_verify_ctx_error_claims(const jwt_verify_ctx_t *ctx);
+
+/**
+ * @brief Number of signatures in the token last verified with a context
+ *
+ * As jwt_checker_sig_count().
+ *
+ * @param ctx Pointer to a context
+ * @return The signature count of the last token
+ * @since 3.7.0
+ */
+JWT_EXPORT
+unsigned int jwt_verify_ctx_sig_count(const jwt_verify_ctx_t *ctx);
+
+/**
+ * @brief Whether a given signature of the last token verified
+ *
+ * As jwt_checker_sig_verified().
+ *
+ * @param ctx Pointer to a context
+ * @param index A signature index in ``[0, jwt_verify_ctx_sig_count())``
+ * @return 1 if signature @p index verified, 0 otherwise
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwt_verify_ctx_sig_verified(const jwt_verify_ctx_t *ctx,
+				unsigned int index);
+
+/**
+ * @brief The key a given signature of the last token verified against
+ *
+ * As jwt_checker_sig_key(). The key is borrowed from the shared checker (or,
+ * for an embedded JWK, from @p ctx) and is valid until the next verify with
+ * @p ctx or until that is freed.
+ *
+ * @param ctx Pointer to a context
+ * @param index A signature index in ``[0, jwt_verify_ctx_sig_count())``
+ * @return The verifying key, or NULL
+ * @since 3.7.0
+ */
+JWT_EXPORT
+const jwk_item_t *jwt_verify_ctx_sig_key(const jwt_verify_ctx_t *ctx,
+					 unsigned int index);
+
 /**
  * @}
  * @noop jwt_checker_grp
@@ -2377,6 +3010,19 @@ int jwe_builder_set_aad(jwe_builder_t *builder, const unsigned char *aad,
 JWT_EXPORT
 int jwe_builder_setpbes2(jwe_builder_t *builder, unsigned int p2c);
 
+/**
+ * @brief Get the per-stage statistics of a JWE builder
+ *
+ * Like jwt_builder_stats(), for jwe_builder_generate().
+ *
+ * @param builder Pointer to a JWE builder object
+ * @param stats Filled with the counters since the builder was created
+ * @return 0 on success, non-zero if the statistics are not available
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwe_builder_stats(const jwe_builder_t *builder, jwt_stats_t *stats);
+
 /**
  * @brief Encrypt a plaintext into a JWE
  *
@@ -2520,6 +3166,25 @@ JWT_EXPORT
 unsigned char *jwe_checker_decrypt(jwe_checker_t *checker, const char *token,
 				   size_t *plaintext_len);
 
+/**
+ * @brief Decrypt a Compact Serialization JWE given by pointer and length
+ *
+ * Like @ref jwe_checker_decrypt, but the token is the @p len octets at
+ * @p token, which need not be nil-terminated.
+ *
+ * @param checker Pointer to a JWE checker object
+ * @param token Start of the compact JWE
+ * @param len Length of the token in octets
+ * @param plaintext_len If non-NULL, set to the length of the returned
+ *  plaintext on success
+ * @return A newly allocated, nil-terminated buffer of decrypted plaintext the
+ *  caller must free, or NULL on error (with the error set in the checker)
+ * @since 3.7.0
+ */
+JWT_EXPORT
+unsigned char *jwe_checker_decrypt_n(jwe_checker_t *checker, const char *token,
+				     size_t len, size_t *plaintext_len);
+
 /**
  * @brief Decrypt and authenticate a JWE in any serialization
  *
@@ -2560,6 +3225,33 @@ JWT_EXPORT
 const unsigned char *jwe_checker_get_aad(const jwe_checker_t *checker,
 					 size_t *aad_len);
 
+/**
+ * @brief Get the per-stage statistics of a JWE checker
+ *
+ * Like jwt_builder_stats(), for jwe_checker_decrypt() and friends.
+ *
+ * @param checker Pointer to a JWE checker object
+ * @param stats Filled with the counters since the checker was created
+ * @return 0 on success, non-zero if the statistics are not available
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwe_checker_stats(const jwe_checker_t *checker, jwt_stats_t *stats);
+
+/**
+ * @brief Limit the size and shape of the tokens a JWE checker accepts
+ *
+ * As jwt_checker_setlimits(), for jwe_checker_decrypt() and friends: the
+ * payload limit bounds the decoded ciphertext.
+ *
+ * @param checker Pointer to a JWE checker object
+ * @param limits The limits, or NULL for none
+ * @return 0 on success, non-zero otherwise
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwe_checker_setlimits(jwe_checker_t *checker, const jwt_limits_t *limits);
+
 /**
  * @}
  * @noop jwe_checker_grp
@@ -2800,6 +3492,61 @@ jwk_set_t *jwks_load_fromurl_cached(jwk_set_t *jwk_set, const char *url,
 JWT_EXPORT
 jwk_set_t *jwks_refresh_fromurl(jwk_set_t *jwk_set);
 
+/**
+ * @brief Keep a cached JWKS source fresh from a background thread
+ *
+ * Starts a thread, owned by @p jwk_set, that renews the keys fetched by
+ * jwks_load_fromurl_cached() so that no verify has to wait on the network.
+ * The keys are renewed ahead of their expiry, once four fifths of their
+ * lifetime has passed, with the same conditional GET, but never sooner than
+ * the cooldown of @ref jwks_url_config_t after the last fetch. While a fetch is in
+ * flight the current keys keep being used, and they are kept (even past
+ * their expiry) when it fails. A failed fetch is retried with exponential
+ * backoff, from one second up to five minutes, each delay jittered so that
+ * many clients of one origin do not retry in step.
+ *
+ * While the refresher runs, jwks_load_fromurl_cached() with the same URL
+ * returns the keys without fetching, and jwks_refresh_fromurl() only wakes
+ * the thread (still bounded by the cooldown) and returns at once.
+ *
+ * New keys are swapped in between verifies. A checker that has @p jwk_set as
+ * its keyring (jwt_checker_setkeyring()) holds its keys for the length of each
+ * verify, including any callback it calls, so a callback that looks up a
+ * ``"kid"`` in @p jwk_set is safe, but it must not itself verify with a
+ * checker using @p jwk_set, which could wait on a swap that waits on it.
+ * Anything else that reads @p jwk_set while the refresher runs, including
+ * keys borrowed from it after a verify (such as jwt_checker_sig_key()), may
+ * see the keys freed under it.
+ *
+ * The set's error is that of the fetches failing since the last one that did
+ * not. It is written by the refresher's thread, and jwks_error(),
+ * jwks_error_msg() and jwks_error_clear() may be used on it from any thread.
+ *
+ * The refresher must be started before @p jwk_set is shared with other
+ * threads. It is stopped by jwks_refresh_stop() or jwks_free().
+ *
+ * @param jwk_set A keyring populated by jwks_load_fromurl_cached()
+ * @return 0 on success (or if it is already running), or non-zero if
+ *  @p jwk_set has no URL source, the thread could not be started, or when
+ *  built without libcurl
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwks_refresh_start(jwk_set_t *jwk_set);
+
+/**
+ * @brief Stop the background refresher of a cached JWKS source
+ *
+ * Stops the thread started by jwks_refresh_start(), abandoning any fetch in
+ * flight, and waits for it to exit. The keys it last loaded are kept. Does
+ * nothing if no refresher is running.
+ *
+ * @param jwk_set A keyring passed to jwks_refresh_start()
+ * @since 3.7.0
+ */
+JWT_EXPORT
+void jwks_refresh_stop(jwk_set_t *jwk_set);
+
 /**
  * @brief Flags controlling how a native key is imported into a keyring
  *
@@ -2819,6 +3566,10 @@ typedef enum {
 						     as a PEM/DER key, treat the
 						     raw bytes as an "oct" (HMAC)
 						     key */
+	JWK_KEY_USE_ENC		= 0x0004,	/**< Mark each key for JWE
+						     (``"use":"enc"``) instead of
+						     signing: no signing "alg" or
+						     "key_ops" @since 3.7.0 */
 } jwk_key_flags_t;
 
 /**
@@ -2961,6 +3712,9 @@ int jwks_error_any(const jwk_set_t *jwk_set);
  *
  * @note A zero length string is valid even if jwks_error() returns non-zero.
  *
+ * While a background refresher runs (jwks_refresh_start()), the string is a
+ * copy, valid until the calling thread next calls this function.
+ *
  * @param jwk_set An existing jwk_set_t
  * @return A string message. The string may be empty.
  * @since 3.0.0
@@ -3477,6 +4231,20 @@ int jwt_set_alloc(jwt_malloc_t pmalloc, jwt_free_t pfree);
 JWT_EXPORT
 void jwt_get_alloc(jwt_malloc_t *pmalloc, jwt_free_t *pfree);
 
+/**
+ * @brief Free the calling thread's decode arena
+ *
+ * A checker or builder with an arena (jwt_checker_setarena(),
+ * jwt_builder_setarena()) keeps one per thread that uses it, and frees it
+ * when that thread exits. A thread that is done verifying but lives on, such
+ * as one in a long-lived pool, can give the memory back sooner with this.
+ * The arena is made again on the next call that needs one.
+ *
+ * @since 3.7.0
+ */
+JWT_EXPORT
+void jwt_arena_release(void);
+
  /**
   * @}
   * @noop jwt_memory_grp
@@ -3563,6 +4331,31 @@ int jwt_set_crypto_ops_t(jwt_crypto_provider_t opname);
 JWT_EXPORT
 int jwt_crypto_ops_supports_jwk(void);
 
+/**
+ * Run the OpenSSL backend in its own library context
+ *
+ * By default the OpenSSL backend uses OpenSSL's default library context and
+ * no property query. This makes it use @p libctx (an ``OSSL_LIB_CTX *``)
+ * and @p propq (e.g. ``"fips=yes"``) instead, for every key, digest, MAC,
+ * cipher and random byte it creates or fetches. Pass NULL for both to go
+ * back to the defaults.
+ *
+ * The backend fetches each algorithm it uses once and keeps it, rather than
+ * looking it up on every operation; calling this drops those so they are
+ * fetched again from the new context.
+ *
+ * @warning Like jwt_set_crypto_ops(), this is not thread safe and should be
+ *  done once at start up. Keys already loaded stay in the context they were
+ *  created in. @p libctx is not copied: it must outlive its use by LibJWT.
+ *
+ * @param libctx An OpenSSL ``OSSL_LIB_CTX *``, or NULL for the default
+ * @param propq A property query string, or NULL. This is copied.
+ * @return 0 on success, 1 on error or if the OpenSSL backend is not built
+ * @since 3.7.0
+ */
+JWT_EXPORT
+int jwt_set_crypto_openssl_libctx(void *libctx, const char *propq);
+
 /**
  * @}
  * @noop jwt_crypto_grp
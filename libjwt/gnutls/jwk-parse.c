@@ -72,7 +72,7 @@ static gnutls_ecc_curve_t ec_crv_to_curve(const char *crv)
 /* Attach the RSA-OAEP-256 (SHA-256) SPKI to a private key. Done once at parse
  * time so the native RSA-OAEP-256 decrypt op can use the key without mutating
  * it per call (avoiding a data race when one key decrypts concurrently). The
- * SPKI is idempotent and does not affect JWS, which re-imports from item->pem.
+ * SPKI is idempotent and does not affect JWS, which signs with key->sign.
  * Best effort: a failure here just leaves decrypt to surface the error. */
 static void set_rsa_oaep_spki(gnutls_privkey_t priv)
 {
@@ -168,6 +168,10 @@ static int finalize(jwk_item_t *item, gnutls_jwk_t *key, int priv)
 
 	item->bits = key_bits(item, key);
 
+	/* Non-RSA keys sign with the same handle; see gnutls_jwk_t. */
+	if (key->sign == NULL)
+		key->sign = key->priv;
+
 	item->provider = JWT_CRYPTO_OPS_GNUTLS;
 	item->provider_data = key;
 
@@ -245,6 +249,15 @@ int gnutls_process_rsa(jwt_json_t *jwk, jwk_item_t *item)
 			jwt_write_error(item, "Error deriving RSA public key"); // LCOV_EXCL_LINE
 			goto out; // LCOV_EXCL_LINE
 		}
+		/* Separate JWS signing handle, kept free of the OAEP SPKI. */
+		if (gnutls_privkey_init(&key->sign) ||
+		    gnutls_privkey_import_rsa_raw(key->sign, &m, &e, &d, &p, &q,
+						  &u, &e1, &e2)) {
+			// LCOV_EXCL_START
+			jwt_write_error(item, "Error importing RSA private key");
+			goto out;
+			// LCOV_EXCL_STOP
+		}
 		item->is_private_key = 1;
 	} else {
 		if (gnutls_pubkey_import_rsa_raw(key->pub, &m, &e)) {
@@ -265,8 +278,8 @@ int gnutls_process_rsa(jwt_json_t *jwk, jwk_item_t *item)
 	}
 
 	/* Attach the RSA-OAEP-256 SPKI to the private key AFTER finalize() has
-	 * exported the (unrestricted) item->pem, so JWS sign/verify and the
-	 * SHA-1 RSA-OAEP OpenSSL fallback still get a plain RSA PEM. Doing it
+	 * exported the (unrestricted) item->pem, so the SHA-1 RSA-OAEP OpenSSL
+	 * fallback still gets a plain RSA PEM. JWS signs with key->sign. Doing it
 	 * once here keeps the native RSA-OAEP-256 decrypt from mutating the
 	 * shared key per call (race-free concurrent decrypts). */
 	if (priv)
@@ -278,6 +291,8 @@ int gnutls_process_rsa(jwt_json_t *jwk, jwk_item_t *item)
 out:
 	if (key != NULL) {
 		// LCOV_EXCL_START
+		if (key->sign)
+			gnutls_privkey_deinit(key->sign);
 		if (key->priv)
 			gnutls_privkey_deinit(key->priv);
 		if (key->pub)
@@ -721,6 +736,8 @@ void gnutls_process_item_free(jwk_item_t *item)
 
 	key = item->provider_data;
 	if (key != NULL) {
+		if (key->sign && key->sign != key->priv)
+			gnutls_privkey_deinit(key->sign);
 		if (key->priv)
 			gnutls_privkey_deinit(key->priv);
 		if (key->pub)
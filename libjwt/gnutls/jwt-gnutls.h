@@ -14,12 +14,18 @@
 
 /* A parsed JWK held as native GnuTLS key handles. This is what a GnuTLS
  * jwk_item_t.provider_data points to. The pubkey is always present; the privkey
- * only for private keys. The JWE RSA-OAEP and ECDH-ES ops use these directly;
- * JWS sign/verify continue to use item->pem. */
+ * only for private keys. JWS sign/verify and the JWE RSA-OAEP and ECDH-ES ops
+ * all use these directly, so a key is imported once per parse rather than once
+ * per operation; item->pem is only a convenience export.
+ *
+ * sign is the privkey JWS signs with. It aliases priv except for RSA, where
+ * priv carries the RSA-OAEP SPKI for JWE and so a second, unrestricted import
+ * of the same components is kept for RS and PS signatures. */
 typedef struct {
 	jwk_key_type_t kty;
 	gnutls_pubkey_t pub;
 	gnutls_privkey_t priv;	/* NULL for public-only keys */
+	gnutls_privkey_t sign;	/* NULL for public-only keys */
 } gnutls_jwk_t;
 
 /* JWK parsing: build native GnuTLS key handles into provider_data. */
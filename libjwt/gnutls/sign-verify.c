@@ -65,17 +65,15 @@ static int gnutls_sign_sha_hmac(jwt_t *jwt, char **out, unsigned int *len,
 	return 0;
 }
 
-#define SIGN_ERROR(_msg) { jwt_write_error(jwt, "JWT[GnuTLS]: " _msg); goto sign_clean_privkey; }
+#define SIGN_ERROR(_msg) { jwt_write_error(jwt, "JWT[GnuTLS]: " _msg); goto sign_clean; }
 
 static int gnutls_sign_sha_pem(jwt_t *jwt, char **out, unsigned int *len,
 			       const char *str, unsigned int str_len)
 {
-	/* For EC handling. */
-	int r_padding = 0, s_padding = 0, r_out_padding = 0,
-		s_out_padding = 0;
+	gnutls_jwk_t *jk = jwt->key->provider_data;
 	gnutls_privkey_t privkey;
 	size_t out_size;
-	gnutls_datum_t sig_dat, r, s;
+	gnutls_datum_t sig_dat;
 	gnutls_digest_algorithm_t alg;
 	int pk_alg, flags = 0;
 	unsigned int adj = 0;
@@ -83,34 +81,22 @@ static int gnutls_sign_sha_pem(jwt_t *jwt, char **out, unsigned int *len,
 	 * signs via sign_data2() instead of the digest-based sign_data(). */
 	int sign_algo = 0;
 
-	if (gnutls_privkey_init(&privkey))
-		SIGN_ERROR("Error initializing privkey"); // LCOV_EXCL_LINE
-
-	if (jwt->alg == JWT_ALG_ES256K)
-		SIGN_ERROR("ES256K not supported"); // LCOV_EXCL_LINE
-
-	if (jwt->key->pem == NULL)
-		SIGN_ERROR("No PEM to load"); // LCOV_EXCL_LINE
-
-	gnutls_datum_t key_dat = {
-		(unsigned char *)jwt->key->pem,
-		strlen(jwt->key->pem)
-	};
 	gnutls_datum_t body_dat = {
 		(unsigned char *)str,
 		str_len
 	};
 
-	/* Try loading as a private key, and extracting the pubkey */
-	if (gnutls_privkey_import_x509_raw(privkey, &key_dat,
-					   GNUTLS_X509_FMT_PEM,
-					   NULL, 0)) {
-		SIGN_ERROR("Could not import private key"); // LCOV_EXCL_LINE
-	}
-
 	/* Initialize for checking later. */
 	*out = NULL;
 
+	if (jwt->alg == JWT_ALG_ES256K)
+		SIGN_ERROR("ES256K not supported"); // LCOV_EXCL_LINE
+
+	/* Sign with the handle imported when the JWK was parsed. */
+	if (jk == NULL || jk->sign == NULL)
+		SIGN_ERROR("No private key to sign with"); // LCOV_EXCL_LINE
+	privkey = jk->sign;
+
 	switch (jwt->alg) {
 	/* RSA */
 	case JWT_ALG_RS256:
@@ -213,10 +199,6 @@ static int gnutls_sign_sha_pem(jwt_t *jwt, char **out, unsigned int *len,
 	}
 
 	if (pk_alg == GNUTLS_PK_EC) {
-		/* Start EC handling. */
-		if (gnutls_decode_rs_value(&sig_dat, &r, &s))
-			SIGN_ERROR("Error decoding EC key"); // LCOV_EXCL_LINE
-
 		/* Check r and s size */
 		if (jwt->alg == JWT_ALG_ES256 || jwt->alg == JWT_ALG_ES256K)
 			adj = 32;
@@ -227,32 +209,22 @@ static int gnutls_sign_sha_pem(jwt_t *jwt, char **out, unsigned int *len,
 		else
 			SIGN_ERROR("Unknown EC algorithm");
 
-		if (r.size > adj)
-			r_padding = r.size - adj;
-		else if (r.size < adj)
-			r_out_padding = adj - r.size;
-
-		if (s.size > adj)
-			s_padding = s.size - adj;
-		else if (s.size < adj)
-			s_out_padding = adj - s.size;
-
 		out_size = adj << 1;
 
 		*out = jwt_malloc(out_size);
 		if (*out == NULL)
 			SIGN_ERROR("Out of memory"); // LCOV_EXCL_LINE
 
-		memset(*out, 0, out_size);
-
-		memcpy(*out + r_out_padding, r.data + r_padding, r.size - r_padding);
-		memcpy(*out + (r.size - r_padding + r_out_padding) + s_out_padding,
-		       s.data + s_padding, (s.size - s_padding));
+		/* DER straight to R || S, each padded to adj octets. */
+		if (jwt_ecdsa_der2raw(sig_dat.data, sig_dat.size,
+				      (unsigned char *)*out, out_size)) {
+			// LCOV_EXCL_START
+			gnutls_free(sig_dat.data);
+			SIGN_ERROR("Error decoding EC key");
+			// LCOV_EXCL_STOP
+		}
 
-		*len = (r.size - r_padding + r_out_padding) +
-			(s.size - s_padding + s_out_padding);
-		gnutls_free(r.data);
-		gnutls_free(s.data);
+		*len = out_size;
 	} else {
 		/* All others that aren't EC */
 		*out = jwt_malloc(sig_dat.size);
@@ -267,9 +239,7 @@ static int gnutls_sign_sha_pem(jwt_t *jwt, char **out, unsigned int *len,
 	/* Clean and exit */
 	gnutls_free(sig_dat.data);
 
-sign_clean_privkey:
-	gnutls_privkey_deinit(privkey);
-
+sign_clean:
 	if (jwt->error)
 		jwt_freemem(*out); // LCOV_EXCL_LINE
 
@@ -277,57 +247,31 @@ sign_clean_privkey:
 }
 
 #define VERIFY_ERROR(_msg) { jwt_write_error(jwt, "JWT[GnuTLS]: " _msg); goto verify_clean_sig; }
+#define VERIFY_FAILED(_msg) { jwt_set_error(jwt, JWT_ERR_BAD_SIG, "JWT[GnuTLS]: " _msg); goto verify_clean_sig; }
 
 static int gnutls_verify_sha_pem(jwt_t *jwt, const char *head,
 				 unsigned int head_len, unsigned char *sig,
 				 int sig_len)
 {
-	gnutls_datum_t r, s;
+	unsigned char der[JWT_ECDSA_DER_MAX];
 	gnutls_datum_t data = {
 		(unsigned char *)head,
 		head_len
 	};
 	gnutls_datum_t sig_dat = { NULL, 0 };
+	gnutls_jwk_t *jk = jwt->key->provider_data;
 	gnutls_pubkey_t pubkey;
 	int alg, ret = 0;
 
-	if (gnutls_pubkey_init(&pubkey))
-		VERIFY_ERROR("Failed initializing pubkey"); // LCOV_EXCL_LINE
-
-	if (jwt->key->pem == NULL)
-		VERIFY_ERROR("No PEM to load"); // LCOV_EXCL_LINE
-
-	gnutls_datum_t cert_dat = {
-		(unsigned char *)jwt->key->pem,
-		strlen(jwt->key->pem)
-	};
-
 	if (jwt->alg == JWT_ALG_ES256K)
 		VERIFY_ERROR("ES256K not supported"); // LCOV_EXCL_LINE
 
-	ret = gnutls_pubkey_import(pubkey, &cert_dat, GNUTLS_X509_FMT_PEM);
-	if (ret) {
-		gnutls_privkey_t privkey;
-
-		/* Try loading as a private key, and extracting the pubkey.
-		 * This is perfectly legit. A JWK can have a private key with
-		 * key_ops of SIGN and VERIFY. */
-		if (gnutls_privkey_init(&privkey))
-			VERIFY_ERROR("Failed initializing privkey"); // LCOV_EXCL_LINE
-
-		/* Try loading as a private key, and extracting the pubkey */
-		if (gnutls_privkey_import_x509_raw(privkey, &cert_dat,
-						   GNUTLS_X509_FMT_PEM,
-						   NULL, 0)) {
-			VERIFY_ERROR("Failed importing key"); // LCOV_EXCL_LINE
-		}
-
-		ret = gnutls_pubkey_import_privkey(pubkey, privkey, 0, 0);
-		gnutls_privkey_deinit(privkey);
-
-		if (ret)
-			VERIFY_ERROR("Failed to import key"); // LCOV_EXCL_LINE
-	}
+	/* The parsed pubkey is always present, including for private JWKs
+	 * (derived from the privkey at parse time), and is never mutated, so it
+	 * is safe to verify with concurrently. */
+	if (jk == NULL || jk->pub == NULL)
+		VERIFY_ERROR("No key to verify with"); // LCOV_EXCL_LINE
+	pubkey = jk->pub;
 
 	switch (jwt->alg) {
 	/* RSA */
@@ -403,34 +347,17 @@ static int gnutls_verify_sha_pem(jwt_t *jwt, const char *head,
 	case JWT_ALG_ES256K:
 	case JWT_ALG_ES384:
 	case JWT_ALG_ES512:
-		/* XXX Gotta be a better way. */
-		if (sig_len == 64) {
-			r.size = 32;
-			r.data = sig;
-			s.size = 32;
-			s.data = sig + 32;
-		} else if (sig_len == 96) {
-			r.size = 48;
-			r.data = sig;
-			s.size = 48;
-			s.data = sig + 48;
-		} else if (sig_len == 132) {
-			r.size = 66;
-			r.data = sig;
-			s.size = 66;
-			s.data = sig + 66;
-		} else {
+		if (sig_len != 64 && sig_len != 96 && sig_len != 132)
 			VERIFY_ERROR("Irregular sig_len for ECDHA"); // LCOV_EXCL_LINE
-		}
 
-		if (gnutls_encode_rs_value(&sig_dat, &r, &s) ||
-		    gnutls_pubkey_verify_data2(pubkey, alg, 0, &data, &sig_dat))
-			ret = 1; // LCOV_EXCL_LINE
+		ret = jwt_ecdsa_raw2der(sig, sig_len, der, sizeof(der));
+		if (ret < 0)
+			VERIFY_ERROR("Could not encode R/S values for ECDHA"); // LCOV_EXCL_LINE
 
-		if (sig_dat.data != NULL)
-			gnutls_free(sig_dat.data);
+		sig_dat.data = der;
+		sig_dat.size = ret;
 
-		if (ret)
+		if (gnutls_pubkey_verify_data2(pubkey, alg, 0, &data, &sig_dat))
 			VERIFY_ERROR("Could not encode R/S values for ECDHA"); // LCOV_EXCL_LINE
 		break;
 
@@ -440,12 +367,10 @@ static int gnutls_verify_sha_pem(jwt_t *jwt, const char *head,
 		sig_dat.data = sig;
 
 		if (gnutls_pubkey_verify_data2(pubkey, alg, 0, &data, &sig_dat))
-			VERIFY_ERROR("Failed to verify signature"); // LCOV_EXCL_LINE
+			VERIFY_FAILED("Failed to verify signature"); // LCOV_EXCL_LINE
 	}
 
 verify_clean_sig:
-	gnutls_pubkey_deinit(pubkey);
-
 	/* Return the error flag, not ret: the default (RSA/RSA-PSS/EdDSA) branch
 	 * reaches VERIFY_ERROR without setting ret, so returning ret would report
 	 * a failed verification as success (0). jwt_write_error() always sets
@@ -586,9 +586,10 @@ static void set_error(jwt_json_error_t *error, const char *source,
 /*
  * NOTE: json-c does not support JWT_JSON_REJECT_DUPLICATES.
  * Duplicate keys are silently accepted (last value wins).
- * This only affects jwt_set_json() where users manually set
- * JSON claims - it does not affect JWT verification of
- * received tokens.
+ * The header and claims of a received token are checked for
+ * duplicates before they are parsed here (jwt-verify.c), so
+ * this only affects JSON given to the library directly, such
+ * as jwt_set_json().
  */
 
 /**
@@ -48,6 +48,7 @@ void FUNC(free)(jwe_common_t *__cmd)
 	jwt_scrub_and_free(__cmd->c.aad, __cmd->c.aad_len);
 	jwt_freemem(__cmd->c.aad_b64);
 	jwt_scrub_and_free(__cmd->c.recovered_aad, __cmd->c.recovered_aad_len);
+	JWT_STATS_FREE(__cmd->c.stats);
 
 	memset(__cmd, 0, sizeof(*__cmd));
 
@@ -69,7 +70,8 @@ jwe_common_t *FUNC(new)(void)
 	__cmd->c.payload = jwt_json_create();
 	__cmd->c.headers = jwt_json_create();
 
-	if (!__cmd->c.payload || !__cmd->c.headers) {
+	if (!__cmd->c.payload || !__cmd->c.headers ||
+	    JWT_STATS_NEW(__cmd->c.stats)) {
 		// LCOV_EXCL_START
 		jwt_json_release(__cmd->c.payload);
 		jwt_json_release(__cmd->c.headers);
@@ -106,6 +108,14 @@ void FUNC(error_clear)(jwe_common_t *__cmd)
 	__cmd->error_msg[0] = '\0';
 }
 
+int FUNC(stats)(const jwe_common_t *__cmd, jwt_stats_t *stats)
+{
+	if (__cmd == NULL || stats == NULL)
+		return 1;
+
+	return JWT_STATS_READ(__cmd->c.stats, stats);
+}
+
 int FUNC(setkey)(jwe_common_t *__cmd, jwe_key_alg_t alg, jwe_enc_t enc,
 		 const jwk_item_t *key)
 {
@@ -799,8 +809,8 @@ static int FUNC(check_disjoint)(jwe_common_t *__cmd)
 
 /* @rfc{7516,5.1} Encrypt @plaintext into a JWE. The Compact Serialization is
  * produced unless a JSON format was selected with set_format. */
-char *FUNC(generate)(jwe_common_t *__cmd, const unsigned char *plaintext,
-		     size_t plaintext_len)
+static char *__generate(jwe_common_t *__cmd, const unsigned char *plaintext,
+			size_t plaintext_len)
 {
 	struct jwe_recipient *recip, *first;
 	jwt_json_auto_t *hdr = NULL;
@@ -813,9 +823,6 @@ char *FUNC(generate)(jwe_common_t *__cmd, const unsigned char *plaintext,
 	char *out = NULL;
 	int hdr_len, ret;
 
-	if (__cmd == NULL)
-		return NULL;
-
 	/* @rfc{7516,7.2.1} At least one recipient must be configured (via setkey
 	 * or add_recipient). */
 	first = jwe_recipient_first(&__cmd->c);
@@ -913,6 +920,7 @@ char *FUNC(generate)(jwe_common_t *__cmd, const unsigned char *plaintext,
 	 * the shared CEK (or, for a lone direct recipient, derive the CEK). */
 	list_for_each_entry(recip, &__cmd->c.recipients, node) {
 		jwt_json_t *kmhdr;
+		JWT_STAGE_BEGIN(t);
 
 		if (is_json) {
 			if (recip->header == NULL) {
@@ -925,22 +933,28 @@ char *FUNC(generate)(jwe_common_t *__cmd, const unsigned char *plaintext,
 			kmhdr = hdr;
 		}
 
-		if (has_direct) {
-			/* The lone direct recipient produces the CEK. */
-			if (FUNC(wrap_recipient)(__cmd, recip, kmhdr, NULL, 0,
-						 &cek, &cek_len))
-				goto fail;
-		} else {
-			if (FUNC(wrap_recipient)(__cmd, recip, kmhdr, cek,
-						 cek_len, &cek, &cek_len))
-				goto fail;
-		}
+		/* The lone direct recipient produces the CEK. */
+		if (has_direct)
+			ret = FUNC(wrap_recipient)(__cmd, recip, kmhdr, NULL, 0,
+						   &cek, &cek_len);
+		else
+			ret = FUNC(wrap_recipient)(__cmd, recip, kmhdr, cek,
+						   cek_len, &cek, &cek_len);
+		JWT_STAGE_END(JWT_STAGE_JWE, t, ret);
+		if (ret)
+			goto fail;
 	}
 
 	/* @rfc{7516,5.1} Serialize the protected header (after the wrap loop,
 	 * which for the Compact Serialization populated it with alg/epk/apu/apv).
 	 * The JSON serializations leave it as just enc + application params. */
-	hdr_json = jwt_json_serialize(hdr, JWT_JSON_SORT_KEYS | JWT_JSON_COMPACT);
+	{
+		JWT_STAGE_BEGIN(t);
+
+		hdr_json = jwt_json_serialize(hdr, JWT_JSON_SORT_KEYS |
+					      JWT_JSON_COMPACT);
+		JWT_STAGE_END(JWT_STAGE_JSON, t, hdr_json == NULL);
+	}
 	if (hdr_json == NULL)
 		goto oom; // LCOV_EXCL_LINE
 
@@ -965,9 +979,15 @@ char *FUNC(generate)(jwe_common_t *__cmd, const unsigned char *plaintext,
 	 * Compact); a present "aad" member appends '.' || BASE64URL(aad). */
 	if (jwe_build_aad(hdr_b64, __cmd->c.aad_b64, &aad, &aad_len, &aad_owned))
 		goto oom; // LCOV_EXCL_LINE
-	ret = jwe_encrypt_content(__cmd->c.enc, cek, cek_len, iv, iv_len,
-				  aad, aad_len, plaintext, plaintext_len,
-				  &ct, &ct_len, &tag, &tag_len);
+	{
+		JWT_STAGE_BEGIN(t);
+
+		ret = jwe_encrypt_content(__cmd->c.enc, cek, cek_len, iv,
+					  iv_len, aad, aad_len, plaintext,
+					  plaintext_len, &ct, &ct_len, &tag,
+					  &tag_len);
+		JWT_STAGE_END(JWT_STAGE_JWE, t, ret);
+	}
 	if (ret) {
 		// LCOV_EXCL_START
 		jwt_write_error(__cmd, "Content encryption failed");
@@ -1022,9 +1042,39 @@ done:
 
 	return out;
 }
+
+char *FUNC(generate)(jwe_common_t *__cmd, const unsigned char *plaintext,
+		     size_t plaintext_len)
+{
+	char *out;
+
+	if (__cmd == NULL)
+		return NULL;
+
+	JWT_STATS_ENTER(__cmd->c.stats);
+	JWT_PROBE2(jwe_encrypt_start, __cmd->c.enc, plaintext_len);
+	out = __generate(__cmd, plaintext, plaintext_len);
+	JWT_PROBE3(jwe_encrypt_done, __cmd->c.enc, plaintext_len, out == NULL);
+	JWT_STATS_LEAVE(out == NULL);
+
+	return out;
+}
 #endif
 
 #ifdef JWE_CHECKER
+int FUNC(setlimits)(jwe_common_t *__cmd, const jwt_limits_t *limits)
+{
+	if (__cmd == NULL)
+		return 1;
+
+	if (limits == NULL)
+		memset(&__cmd->c.limits, 0, sizeof(__cmd->c.limits));
+	else
+		__cmd->c.limits = *limits;
+
+	return 0;
+}
+
 /* Find the next '.' in @p, niling it and returning the start of the field
  * after it; or NULL if no dot remains. Used to split the 5 compact parts. */
 static char *split_dot(char *p)
@@ -1329,10 +1379,11 @@ static int FUNC(check_crit)(jwe_common_t *__cmd, jwt_json_t *hdr)
 	return 1;
 }
 
-/* @rfc{7516,5.2} Decrypt and authenticate a Compact Serialization JWE. */
+/* @rfc{7516,5.2} Decrypt and authenticate a Compact Serialization JWE of
+ * @token_len octets (@token need not be NUL-terminated). */
 static unsigned char *FUNC(decrypt_compact)(jwe_common_t *__cmd,
 		struct jwe_recipient *recip, const char *token,
-		size_t *plaintext_len)
+		size_t token_len, size_t *plaintext_len)
 {
 	char_auto *dup = NULL;
 	char *p_hdr, *p_ek, *p_iv, *p_ct, *p_tag, *rest;
@@ -1340,17 +1391,19 @@ static unsigned char *FUNC(decrypt_compact)(jwe_common_t *__cmd,
 	char_auto *hdr_json = NULL;
 	int hdr_dlen = 0;
 	jwt_json_t *jalg, *jenc;
+	unsigned char *out;
 	jwe_key_alg_t alg;
 	jwe_enc_t enc;
-	size_t dup_len;
 
-	dup_len = strlen(token) + 1;
-	dup = jwt_malloc(dup_len);
+	/* The one working copy the in-place split needs, sized from the
+	 * caller's length rather than a rescan. */
+	dup = jwt_malloc(token_len + 1);
 	if (dup == NULL) {
 		jwt_write_error(__cmd, "Error allocating memory"); // LCOV_EXCL_LINE
 		return NULL; // LCOV_EXCL_LINE
 	}
-	memcpy(dup, token, dup_len);
+	memcpy(dup, token, token_len);
+	dup[token_len] = '\0';
 
 	/* @rfc{7516,5.2} Split exactly 5 parts (4 dots). */
 	p_hdr = dup;
@@ -1366,6 +1419,15 @@ static unsigned char *FUNC(decrypt_compact)(jwe_common_t *__cmd,
 		return NULL;
 	}
 
+	if (JWT_LIMIT_B64(__cmd->c.limits.max_header_len, p_ek - p_hdr - 1)) {
+		jwt_write_error(__cmd, "Header exceeds an input limit");
+		return NULL;
+	}
+	if (JWT_LIMIT_B64(__cmd->c.limits.max_payload_len, p_tag - p_ct - 1)) {
+		jwt_write_error(__cmd, "Ciphertext exceeds an input limit");
+		return NULL;
+	}
+
 	/* @rfc{7516,5.2} Parse the protected header and confirm alg/enc match
 	 * what the application configured (algorithm allow-list). */
 	hdr_json = jwt_base64uri_decode(p_hdr, &hdr_dlen);
@@ -1374,7 +1436,16 @@ static unsigned char *FUNC(decrypt_compact)(jwe_common_t *__cmd,
 		return NULL;
 	}
 	hdr_json[hdr_dlen] = '\0';
-	hdr = jwt_json_parse(hdr_json, 0, NULL);
+	if (jwt_limits_json(&__cmd->c.limits, hdr_json, hdr_dlen, 1)) {
+		jwt_write_error(__cmd, "Header exceeds an input limit");
+		return NULL;
+	}
+	{
+		JWT_STAGE_BEGIN(t);
+
+		hdr = jwt_json_parse(hdr_json, 0, NULL);
+		JWT_STAGE_END(JWT_STAGE_JSON, t, hdr == NULL);
+	}
 	if (hdr == NULL) {
 		jwt_write_error(__cmd, "Error parsing JWE header");
 		return NULL;
@@ -1408,25 +1479,62 @@ static unsigned char *FUNC(decrypt_compact)(jwe_common_t *__cmd,
 
 	/* For Compact the AAD is just ASCII(protected) (no "aad" member) and the
 	 * "epk" (if any) lives in the protected header. */
-	return FUNC(recover_and_decrypt)(__cmd, recip, hdr, alg, enc, p_hdr,
-					 NULL, p_ek, p_iv, p_ct, p_tag,
-					 plaintext_len);
+	JWT_STAGE_BEGIN(t);
+	JWT_PROBE3(jwe_decrypt_start, alg, enc, JWT_PROBE_KID(recip->key));
+	out = FUNC(recover_and_decrypt)(__cmd, recip, hdr, alg, enc, p_hdr,
+					NULL, p_ek, p_iv, p_ct, p_tag,
+					plaintext_len);
+	JWT_PROBE4(jwe_decrypt_done, alg, enc, JWT_PROBE_KID(recip->key),
+		   out == NULL);
+	JWT_STAGE_END(JWT_STAGE_JWE, t, out == NULL);
+
+	return out;
 }
 
 /* @rfc{7516,5.2} Decrypt and authenticate a Compact Serialization JWE. */
 unsigned char *FUNC(decrypt)(jwe_common_t *__cmd, const char *token,
 			     size_t *plaintext_len)
 {
-	struct jwe_recipient *recip;
+	size_t max;
 
 	if (__cmd == NULL)
 		return NULL;
 
-	if (token == NULL || !strlen(token)) {
+	if (token == NULL) {
+		jwt_write_error(__cmd, "Must pass a token");
+		return NULL;
+	}
+
+	/* Never look further than one octet past the longest token allowed. */
+	max = __cmd->c.limits.max_token_len;
+
+	return FUNC(decrypt_n)(__cmd, token, max && max + 1 ?
+			       strnlen(token, max + 1) : strlen(token),
+			       plaintext_len);
+}
+
+static unsigned char *__decrypt_n(jwe_common_t *__cmd, const char *token,
+				  size_t len, size_t *plaintext_len)
+{
+	struct jwe_recipient *recip;
+
+	if (token == NULL || !len) {
 		jwt_write_error(__cmd, "Must pass a token");
 		return NULL;
 	}
 
+	/* Before anything is allocated for it. */
+	if (__cmd->c.limits.max_token_len && len > __cmd->c.limits.max_token_len) {
+		jwt_write_error(__cmd, "Token exceeds an input limit");
+		return NULL;
+	}
+
+	/* An embedded NUL would end the split copy early. */
+	if (memchr(token, '\0', len) != NULL) {
+		jwt_write_error(__cmd, "Token contains a NUL octet");
+		return NULL;
+	}
+
 	/* @rfc{7516,7.1} The checker is configured with one (alg, enc, key) via
 	 * setkey, which populates the first recipient. */
 	recip = jwe_recipient_first(&__cmd->c);
@@ -1444,7 +1552,22 @@ unsigned char *FUNC(decrypt)(jwe_common_t *__cmd, const char *token,
 	__cmd->c.recovered_aad = NULL;
 	__cmd->c.recovered_aad_len = 0;
 
-	return FUNC(decrypt_compact)(__cmd, recip, token, plaintext_len);
+	return FUNC(decrypt_compact)(__cmd, recip, token, len, plaintext_len);
+}
+
+unsigned char *FUNC(decrypt_n)(jwe_common_t *__cmd, const char *token,
+			       size_t len, size_t *plaintext_len)
+{
+	unsigned char *out;
+
+	if (__cmd == NULL)
+		return NULL;
+
+	JWT_STATS_ENTER(__cmd->c.stats);
+	out = __decrypt_n(__cmd, token, len, plaintext_len);
+	JWT_STATS_LEAVE(out == NULL);
+
+	return out;
 }
 
 /* Get a required string member of @obj. Returns its value or NULL (setting an
@@ -1554,7 +1677,18 @@ static unsigned char *FUNC(decrypt_json)(jwe_common_t *__cmd,
 	int prot_dlen = 0, n_rcp, idx;
 	jwe_enc_t enc;
 
-	obj = jwt_json_parse(token, 0, NULL);
+	/* Its strings are the encoded segments, bounded when decoded. */
+	if (jwt_limits_json(&__cmd->c.limits, token, strlen(token), 0)) {
+		jwt_write_error(__cmd, "Token exceeds an input limit");
+		return NULL;
+	}
+
+	{
+		JWT_STAGE_BEGIN(t);
+
+		obj = jwt_json_parse(token, 0, NULL);
+		JWT_STAGE_END(JWT_STAGE_JSON, t, obj == NULL);
+	}
 	if (obj == NULL) {
 		jwt_write_error(__cmd, "Error parsing JWE JSON");
 		return NULL;
@@ -1566,13 +1700,26 @@ static unsigned char *FUNC(decrypt_json)(jwe_common_t *__cmd,
 	prot_b64 = FUNC(json_str_member)(__cmd, obj, "protected", 1);
 	if (prot_b64 == NULL)
 		return NULL;
+	if (JWT_LIMIT_B64(__cmd->c.limits.max_header_len, strlen(prot_b64))) {
+		jwt_write_error(__cmd, "Header exceeds an input limit");
+		return NULL;
+	}
 	prot_json = jwt_base64uri_decode(prot_b64, &prot_dlen);
 	if (prot_json == NULL || prot_dlen <= 0) {
 		jwt_write_error(__cmd, "Error decoding JWE protected header");
 		return NULL;
 	}
 	prot_json[prot_dlen] = '\0';
-	prot = jwt_json_parse(prot_json, 0, NULL);
+	if (jwt_limits_json(&__cmd->c.limits, prot_json, prot_dlen, 1)) {
+		jwt_write_error(__cmd, "Header exceeds an input limit");
+		return NULL;
+	}
+	{
+		JWT_STAGE_BEGIN(t);
+
+		prot = jwt_json_parse(prot_json, 0, NULL);
+		JWT_STAGE_END(JWT_STAGE_JSON, t, prot == NULL);
+	}
 	if (prot == NULL) {
 		jwt_write_error(__cmd, "Error parsing JWE protected header");
 		return NULL;
@@ -1683,6 +1830,10 @@ static unsigned char *FUNC(decrypt_json)(jwe_common_t *__cmd,
 	tag_b64 = FUNC(json_str_member)(__cmd, obj, "tag", 1);
 	if (iv_b64 == NULL || ct_b64 == NULL || tag_b64 == NULL)
 		return NULL;
+	if (JWT_LIMIT_B64(__cmd->c.limits.max_payload_len, strlen(ct_b64))) {
+		jwt_write_error(__cmd, "Ciphertext exceeds an input limit");
+		return NULL;
+	}
 
 	/* Optional "aad" member: validate and decode it now, but only surface it
 	 * via get_aad AFTER the content authenticates (an unauthenticated aad
@@ -1724,9 +1875,19 @@ static unsigned char *FUNC(decrypt_json)(jwe_common_t *__cmd,
 	/* The ECDH-ES "epk" is read from the selected effective header.
 	 * recover_and_decrypt funnels any CEK-recovery failure to a random CEK so
 	 * the tag check fails uniformly (no Bleichenbacher-style oracle). */
-	out = FUNC(recover_and_decrypt)(__cmd, recip, eff, recip->key_alg, enc,
-					prot_b64, aad_b64, ek_b64, iv_b64,
-					ct_b64, tag_b64, plaintext_len);
+	{
+		JWT_STAGE_BEGIN(t);
+
+		JWT_PROBE3(jwe_decrypt_start, recip->key_alg, enc,
+			   JWT_PROBE_KID(recip->key));
+		out = FUNC(recover_and_decrypt)(__cmd, recip, eff,
+						recip->key_alg, enc, prot_b64,
+						aad_b64, ek_b64, iv_b64, ct_b64,
+						tag_b64, plaintext_len);
+		JWT_PROBE4(jwe_decrypt_done, recip->key_alg, enc,
+			   JWT_PROBE_KID(recip->key), out == NULL);
+		JWT_STAGE_END(JWT_STAGE_JWE, t, out == NULL);
+	}
 
 	/* Surface the (now authenticated) aad only on success. */
 	if (out != NULL && aad_raw != NULL) {
@@ -1746,17 +1907,20 @@ oom:
 
 /* @rfc{7516,7} Decrypt a JWE in any serialization, auto-detecting compact vs
  * JSON: a token whose first non-space character is '{' is JSON. */
-unsigned char *FUNC(decrypt_all)(jwe_common_t *__cmd, const char *token,
-				 size_t *plaintext_len)
+static unsigned char *__decrypt_all(jwe_common_t *__cmd, const char *token,
+				    size_t *plaintext_len)
 {
 	struct jwe_recipient *recip;
+	size_t max = __cmd->c.limits.max_token_len;
 	const char *p;
 
-	if (__cmd == NULL)
+	if (token == NULL || *token == '\0') {
+		jwt_write_error(__cmd, "Must pass a token");
 		return NULL;
+	}
 
-	if (token == NULL || !strlen(token)) {
-		jwt_write_error(__cmd, "Must pass a token");
+	if (max && max + 1 && strnlen(token, max + 1) > max) {
+		jwt_write_error(__cmd, "Token exceeds an input limit");
 		return NULL;
 	}
 
@@ -1780,7 +1944,23 @@ unsigned char *FUNC(decrypt_all)(jwe_common_t *__cmd, const char *token,
 	if (*p == '{')
 		return FUNC(decrypt_json)(__cmd, recip, token, plaintext_len);
 
-	return FUNC(decrypt_compact)(__cmd, recip, token, plaintext_len);
+	return FUNC(decrypt_compact)(__cmd, recip, token, strlen(token),
+				     plaintext_len);
+}
+
+unsigned char *FUNC(decrypt_all)(jwe_common_t *__cmd, const char *token,
+				 size_t *plaintext_len)
+{
+	unsigned char *out;
+
+	if (__cmd == NULL)
+		return NULL;
+
+	JWT_STATS_ENTER(__cmd->c.stats);
+	out = __decrypt_all(__cmd, token, plaintext_len);
+	JWT_STATS_LEAVE(out == NULL);
+
+	return out;
 }
 
 /* @rfc{7516,7.2.1} Return the AAD recovered from the last JSON token. */
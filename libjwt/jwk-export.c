@@ -119,8 +119,12 @@ int jwt_key2jwk(const char *key, size_t len, unsigned int flags,
 		// LCOV_EXCL_STOP
 	}
 
-	/* A public key is marked use=sig; a private (or HMAC) key gets key_ops. */
-	if (r == 0 && !kp.is_private) {
+	/* A public key is marked use=sig; a private (or HMAC) key gets key_ops.
+	 * A key for JWE is marked use=enc either way, which permits every JWE
+	 * key management operation. */
+	if (flags & JWK_KEY_USE_ENC) {
+		jwt_json_obj_set(jwk, "use", jwt_json_create_str("enc"));
+	} else if (r == 0 && !kp.is_private) {
 		jwt_json_obj_set(jwk, "use", jwt_json_create_str("sig"));
 	} else {
 		ops = jwt_json_create_arr();
@@ -147,7 +151,7 @@ int jwt_key2jwk(const char *key, size_t len, unsigned int flags,
 	}
 
 	jwt_json_obj_set(jwk, "kty", jwt_json_create_str(kty));
-	if (kp.alg[0])
+	if (kp.alg[0] && !(flags & JWK_KEY_USE_ENC))
 		jwt_json_obj_set(jwk, "alg", jwt_json_create_str(kp.alg));
 	if (kp.crv[0])
 		jwt_json_obj_set(jwk, "crv", jwt_json_create_str(kp.crv));
@@ -13,7 +13,10 @@
 #include "jwt-private.h"
 
 #ifdef HAVE_LIBCURL
+#include <pthread.h>
+#include <stdint.h>
 #include <strings.h>
+#include <time.h>
 #include <curl/curl.h>
 
 struct jwks_data {
@@ -33,6 +36,63 @@ struct jwks_data {
  * how long a key set is trusted without revalidation and guards now + age from
  * overflowing time_t. One week. */
 #define JWKS_MAX_TTL		(7 * 24 * 60 * 60)
+/* Background refresh: the backoff after a failed fetch (ms), doubled from the
+ * first to the last on each failure in a row. */
+#define JWKS_BACKOFF_MIN	1000
+#define JWKS_BACKOFF_MAX	(300 * 1000)
+
+/* A URL source's background refresher (jwks_refresh_start()). Verifies hold
+ * @lock shared for as long as they use the keys; the thread takes it
+ * exclusively only to swap new keys in, never across a fetch. @mutex guards
+ * the schedule, the cache's @last_fetch and the set's error, so that a verify
+ * callback may use the set's other functions while it holds @lock. */
+struct jwks_refresher {
+	pthread_t thread;
+	pthread_rwlock_t lock;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;	/* On CLOCK_MONOTONIC			*/
+	long long due;		/* When to fetch next (ms, monotonic)	*/
+	unsigned int failures;	/* Failed fetches in a row		*/
+	unsigned int seed;	/* For the backoff jitter		*/
+	int wake;		/* A kid miss asked for a fetch		*/
+	int stop;		/* Set to end the thread		*/
+};
+
+void jwks_read_lock(const jwk_set_t *jwk_set)
+{
+	if (jwk_set != NULL && jwk_set->refresher != NULL)
+		pthread_rwlock_rdlock(&jwk_set->refresher->lock);
+}
+
+void jwks_read_unlock(const jwk_set_t *jwk_set)
+{
+	if (jwk_set != NULL && jwk_set->refresher != NULL)
+		pthread_rwlock_unlock(&jwk_set->refresher->lock);
+}
+
+static void jwks_write_lock(jwk_set_t *jwk_set)
+{
+	if (jwk_set->refresher != NULL)
+		pthread_rwlock_wrlock(&jwk_set->refresher->lock);
+}
+
+static void jwks_write_unlock(jwk_set_t *jwk_set)
+{
+	if (jwk_set->refresher != NULL)
+		pthread_rwlock_unlock(&jwk_set->refresher->lock);
+}
+
+void jwks_error_lock(const jwk_set_t *jwk_set)
+{
+	if (jwk_set->refresher != NULL)
+		pthread_mutex_lock(&jwk_set->refresher->mutex);
+}
+
+void jwks_error_unlock(const jwk_set_t *jwk_set)
+{
+	if (jwk_set->refresher != NULL)
+		pthread_mutex_unlock(&jwk_set->refresher->mutex);
+}
 
 /* A fetch result: the body plus the caching metadata from the response. */
 struct curl_result {
@@ -159,11 +219,27 @@ static size_t header_cb(char *buf, size_t size, size_t nitems, void *ctx)
 	return len;
 }
 
+/* Abandon a background fetch once its refresher is being stopped. */
+static int xferinfo_cb(void *ctx, curl_off_t dltotal, curl_off_t dlnow,
+		       curl_off_t ultotal, curl_off_t ulnow)
+{
+	const int *stop = ctx;
+
+	(void)dltotal;
+	(void)dlnow;
+	(void)ultotal;
+	(void)ulnow;
+
+	return __atomic_load_n(stop, __ATOMIC_ACQUIRE);
+}
+
 /* Fetch @url, capturing the body and the response's caching metadata. When
  * @if_none_match is set it is sent as a conditional GET (so a 304 is possible).
- * Returns 0 on a completed request (out->status carries the HTTP code). */
+ * A fetch is abandoned once *@stop is set (if @stop is not NULL). Returns 0 on
+ * a completed request (out->status carries the HTTP code). */
 static int __curl_fetch(jwk_set_t *jwk_set, const char *url, int verify,
-			const char *if_none_match, struct curl_result *out)
+			const char *if_none_match, const int *stop,
+			struct curl_result *out)
 {
 	static int curl_inited;
 	struct curl_slist *hdrs = NULL;
@@ -198,6 +274,12 @@ static int __curl_fetch(jwk_set_t *jwk_set, const char *url, int verify,
 	curl_easy_setopt(curl, CURLOPT_MAXFILESIZE,
 			 (long)JWKS_MAX_RESPONSE_SIZE);
 
+	if (stop != NULL) {
+		curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, xferinfo_cb);
+		curl_easy_setopt(curl, CURLOPT_XFERINFODATA, (void *)stop);
+		curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+	}
+
 	/* Hostname verification is meaningless without peer (CA chain)
 	 * verification, so tie the two together: any verify >= 1 enables full
 	 * verification; only verify == 0 (explicitly insecure) disables it. */
@@ -210,6 +292,7 @@ static int __curl_fetch(jwk_set_t *jwk_set, const char *url, int verify,
 		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, hdrs);
 	}
 
+	JWT_PROBE2(jwks_fetch_start, url, if_none_match != NULL);
 	res = curl_easy_perform(curl);
 	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &out->status);
 
@@ -219,16 +302,21 @@ static int __curl_fetch(jwk_set_t *jwk_set, const char *url, int verify,
 	curl_easy_cleanup(curl);
 
 	if (res != CURLE_OK) {
+		jwks_error_lock(jwk_set);
 		jwt_write_error(jwk_set, "%s", curl_easy_strerror(res));
+		jwks_error_unlock(jwk_set);
 		jwt_freemem(data.buf);
 		jwt_freemem(out->etag);
 		out->etag = NULL;
+		JWT_PROBE4(jwks_fetch_done, url, out->status, 0, 1);
 		return 1;
 	}
 
 	out->body = data.buf;
 	out->len = data.size;
 
+	JWT_PROBE4(jwks_fetch_done, url, out->status, out->len, 0);
+
 	return 0;
 }
 
@@ -237,7 +325,7 @@ static char *__curl_get(jwk_set_t *jwk_set, const char *url, size_t *len,
 {
 	struct curl_result r;
 
-	if (__curl_fetch(jwk_set, url, verify, NULL, &r))
+	if (__curl_fetch(jwk_set, url, verify, NULL, NULL, &r))
 		return NULL;
 
 	jwt_freemem(r.etag);	/* the one-shot loader ignores caching headers */
@@ -292,36 +380,47 @@ static char *cache_strdup(const char *s)
  * keeps the previously cached keys and sets an error (so a transient 4xx/5xx or
  * an unfollowed redirect does not wipe a good cache). On a successful refresh
  * the ETag and expiry are updated; @last_fetch is stamped by the caller on every
- * attempt (so a failed attempt still consumes the cooldown). */
-static void cache_apply(jwk_set_t *jwk_set, struct curl_result *r)
+ * attempt (so a failed attempt still consumes the cooldown). New keys are
+ * loaded into a set of their own and swapped in whole, so a refresher's
+ * readers see either the old keys or the new ones. Returns 0 if applied. */
+static int cache_apply(jwk_set_t *jwk_set, struct curl_result *r)
 {
 	struct jwks_url_cache *c = jwk_set->cache;
+	jwk_set_t *tmp = NULL;
 	time_t now = time(NULL);
+	int ok = 1;
 	long age;
 
+	/* A 2xx with a garbage/empty body must not wipe a previously good
+	 * cache. Parsed before anything is locked. */
+	if (r->status != 304 && r->status >= 200 && r->status < 300) {
+		tmp = r->body ? jwks_create_strn(r->body, r->len) : NULL;
+		ok = (tmp != NULL && !jwks_error(tmp) &&
+		      jwks_item_count(tmp) > 0);
+	}
+
 	if (r->status == 304) {
 		/* Not Modified: keep the existing keys. */
 	} else if (r->status >= 200 && r->status < 300) {
-		/* Replace, but only if the new body is a usable JWKS; a 2xx with
-		 * a garbage/empty body must not wipe a previously good cache. */
-		jwk_set_t *tmp = jwks_create(r->body);
-		int ok = (tmp != NULL && !jwks_error(tmp) &&
-			  jwks_item_count(tmp) > 0);
-
-		jwks_free(tmp);
 		if (!ok) {
+			jwks_error_lock(jwk_set);
 			jwt_write_error(jwk_set,
 				"JWKS refresh returned no usable keys");
-			return;	/* keep the previously cached keys */
+			jwks_error_unlock(jwk_set);
+			goto fail;	/* keep the previously cached keys */
 		}
-		jwks_item_free_all(jwk_set);
-		jwks_load_strn(jwk_set, r->body, r->len);
+		/* @tmp leaves with the old keys. */
+		jwks_write_lock(jwk_set);
+		jwks_items_swap(jwk_set, tmp);
+		jwks_write_unlock(jwk_set);
 	} else {
 		/* HTTP error (e.g. 4xx/5xx, or an unfollowed 3xx): retain the
 		 * previously cached keys per the documented contract. */
+		jwks_error_lock(jwk_set);
 		jwt_write_error(jwk_set,
 			"JWKS refresh failed (HTTP status %ld)", r->status);
-		return;
+		jwks_error_unlock(jwk_set);
+		goto fail;
 	}
 
 	if (r->etag != NULL) {
@@ -338,6 +437,19 @@ static void cache_apply(jwk_set_t *jwk_set, struct curl_result *r)
 	if (age > JWKS_MAX_TTL)
 		age = JWKS_MAX_TTL;
 	c->expiry = now + age;
+
+	jwks_free(tmp);
+
+	JWT_PROBE3(jwks_cache_apply, c->url, r->status, 0);
+
+	return 0;
+
+fail:
+	jwks_free(tmp);
+
+	JWT_PROBE3(jwks_cache_apply, c->url, r->status, 1);
+
+	return 1;
 }
 
 jwk_set_t *jwks_load_fromurl_cached(jwk_set_t *jwk_set, const char *url,
@@ -362,6 +474,17 @@ jwk_set_t *jwks_load_fromurl_cached(jwk_set_t *jwk_set, const char *url,
 
 	c = jwk_set->cache;
 
+	/* The refresher keeps the keys fresh: never fetch here. */
+	if (jwk_set->refresher != NULL) {
+		if (strcmp(c->url, url)) {
+			jwks_error_lock(jwk_set);
+			jwt_write_error(jwk_set,
+				"Cannot change the URL of a refreshed JWKS source");
+			jwks_error_unlock(jwk_set);
+		}
+		return jwk_set;
+	}
+
 	/* First use, or the URL changed: (re)initialize the cache and fetch. */
 	if (c == NULL || c->url == NULL || strcmp(c->url, url)) {
 		if (c == NULL) {
@@ -384,7 +507,7 @@ jwk_set_t *jwks_load_fromurl_cached(jwk_set_t *jwk_set, const char *url,
 								: JWKS_DEFAULT_COOLDOWN;
 
 		c->last_fetch = time(NULL);
-		if (__curl_fetch(jwk_set, url, c->verify, NULL, &r))
+		if (__curl_fetch(jwk_set, url, c->verify, NULL, NULL, &r))
 			return jwk_set;	/* error set; no keys yet */
 		cache_apply(jwk_set, &r);
 		jwt_freemem(r.body);
@@ -398,7 +521,7 @@ jwk_set_t *jwks_load_fromurl_cached(jwk_set_t *jwk_set, const char *url,
 
 	/* Stale: conditional GET. On failure keep the (stale) keys + set error. */
 	c->last_fetch = time(NULL);
-	if (__curl_fetch(jwk_set, url, c->verify, c->etag, &r))
+	if (__curl_fetch(jwk_set, url, c->verify, c->etag, NULL, &r))
 		return jwk_set;
 	cache_apply(jwk_set, &r);
 	jwt_freemem(r.body);
@@ -418,6 +541,20 @@ jwk_set_t *jwks_refresh_fromurl(jwk_set_t *jwk_set)
 
 	c = jwk_set->cache;
 
+	/* The refresher fetches; a verify must not wait for it. */
+	if (jwk_set->refresher != NULL) {
+		struct jwks_refresher *rf = jwk_set->refresher;
+
+		pthread_mutex_lock(&rf->mutex);
+		if (time(NULL) - c->last_fetch >= c->cooldown) {
+			rf->wake = 1;
+			pthread_cond_signal(&rf->cond);
+		}
+		pthread_mutex_unlock(&rf->mutex);
+
+		return jwk_set;
+	}
+
 	/* @rfc{8725} Cooldown: bound how often a kid-miss can force an outbound
 	 * fetch, so random unknown kids cannot amplify into a request flood. The
 	 * attempt is stamped BEFORE the fetch so that a failing/unreachable origin
@@ -427,7 +564,7 @@ jwk_set_t *jwks_refresh_fromurl(jwk_set_t *jwk_set)
 		return jwk_set;
 
 	c->last_fetch = time(NULL);
-	if (__curl_fetch(jwk_set, c->url, c->verify, c->etag, &r))
+	if (__curl_fetch(jwk_set, c->url, c->verify, c->etag, NULL, &r))
 		return jwk_set;
 	cache_apply(jwk_set, &r);
 	jwt_freemem(r.body);
@@ -436,6 +573,186 @@ jwk_set_t *jwks_refresh_fromurl(jwk_set_t *jwk_set)
 	return jwk_set;
 }
 
+/* The schedule runs on the monotonic clock, so that stepping the wall clock
+ * neither delays a renewal nor hurries one. */
+static long long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Renew the keys of @c four fifths of the way to their (wall clock) expiry,
+ * but no sooner than the cooldown (or the shortest backoff) from now: an
+ * origin sending "max-age=0" must not be polled every second. */
+static long long refresh_due(const struct jwks_url_cache *c)
+{
+	long long now = now_ms(), floor = (long long)c->cooldown * 1000;
+	long long due = now + (long long)(c->expiry - time(NULL)) * 1000 / 5 * 4;
+
+	if (floor < JWKS_BACKOFF_MIN)
+		floor = JWKS_BACKOFF_MIN;
+
+	return due < now + floor ? now + floor : due;
+}
+
+/* After the @failures'th failed fetch in a row, wait half the backoff and a
+ * random part of the other half ("equal jitter"). */
+static long long refresh_backoff(struct jwks_refresher *rf)
+{
+	long long delay = JWKS_BACKOFF_MIN;
+	unsigned int i;
+
+	for (i = 1; i < rf->failures && delay < JWKS_BACKOFF_MAX; i++)
+		delay *= 2;
+	if (delay > JWKS_BACKOFF_MAX)
+		delay = JWKS_BACKOFF_MAX;
+
+	return now_ms() + delay / 2 + (long long)rand_r(&rf->seed) *
+		(delay / 2 + 1) / ((long long)RAND_MAX + 1);
+}
+
+static void *refresher_loop(void *arg)
+{
+	jwk_set_t *jwk_set = arg;
+	struct jwks_refresher *rf = jwk_set->refresher;
+	struct jwks_url_cache *c = jwk_set->cache;
+	struct curl_result r;
+	struct timespec ts;
+	int failed;
+
+	pthread_mutex_lock(&rf->mutex);
+
+	while (!__atomic_load_n(&rf->stop, __ATOMIC_ACQUIRE)) {
+		if (!rf->wake && now_ms() < rf->due) {
+			ts.tv_sec = (time_t)(rf->due / 1000);
+			ts.tv_nsec = (long)(rf->due % 1000) * 1000000;
+			pthread_cond_timedwait(&rf->cond, &rf->mutex, &ts);
+			continue;
+		}
+
+		rf->wake = 0;
+		c->last_fetch = time(NULL);
+		pthread_mutex_unlock(&rf->mutex);
+
+		/* The current keys are used until this is applied. */
+		failed = __curl_fetch(jwk_set, c->url, c->verify, c->etag,
+				      &rf->stop, &r);
+		if (!failed) {
+			failed = cache_apply(jwk_set, &r);
+			jwt_freemem(r.body);
+			jwt_freemem(r.etag);
+		}
+
+		/* The error is that of the fetches failing since the last
+		 * one that did not. */
+		pthread_mutex_lock(&rf->mutex);
+		if (!failed) {
+			jwk_set->error = 0;
+			jwk_set->error_msg[0] = '\0';
+		}
+
+		if (failed) {
+			rf->failures++;
+			rf->due = refresh_backoff(rf);
+		} else {
+			rf->failures = 0;
+			rf->due = refresh_due(c);
+		}
+	}
+
+	pthread_mutex_unlock(&rf->mutex);
+
+	return NULL;
+}
+
+int jwks_refresh_start(jwk_set_t *jwk_set)
+{
+	struct jwks_refresher *rf;
+	pthread_rwlockattr_t attr;
+	pthread_condattr_t cattr;
+
+	if (jwk_set == NULL)
+		return 1;
+
+	if (jwk_set->cache == NULL || jwk_set->cache->url == NULL) {
+		jwt_write_error(jwk_set, "Not a cached JWKS source");
+		return 1;
+	}
+
+	if (jwk_set->refresher != NULL)
+		return 0;
+
+	rf = jwt_malloc(sizeof(*rf));
+	if (rf == NULL)
+		return 1; // LCOV_EXCL_LINE
+	memset(rf, 0, sizeof(*rf));
+
+	rf->seed = (unsigned int)time(NULL) ^ (unsigned int)(uintptr_t)jwk_set;
+
+	/* Keys already stale (or never fetched) are renewed at once. */
+	if (jwk_set->cache->expiry > time(NULL))
+		rf->due = refresh_due(jwk_set->cache);
+	else
+		rf->due = now_ms();
+
+	/* A steady stream of verifies must not keep the keys from being
+	 * swapped, so a waiting swap goes ahead of new verifies. */
+	pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+	pthread_rwlockattr_setkind_np(&attr,
+		PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+	pthread_rwlock_init(&rf->lock, &attr);
+	pthread_rwlockattr_destroy(&attr);
+	pthread_mutex_init(&rf->mutex, NULL);
+	pthread_condattr_init(&cattr);
+	pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+	pthread_cond_init(&rf->cond, &cattr);
+	pthread_condattr_destroy(&cattr);
+
+	jwk_set->refresher = rf;
+
+	if (pthread_create(&rf->thread, NULL, refresher_loop, jwk_set)) {
+		// LCOV_EXCL_START
+		jwk_set->refresher = NULL;
+		pthread_cond_destroy(&rf->cond);
+		pthread_mutex_destroy(&rf->mutex);
+		pthread_rwlock_destroy(&rf->lock);
+		jwt_freemem(rf);
+		jwt_write_error(jwk_set, "Could not start the JWKS refresher");
+		return 1;
+		// LCOV_EXCL_STOP
+	}
+
+	return 0;
+}
+
+void jwks_refresh_stop(jwk_set_t *jwk_set)
+{
+	struct jwks_refresher *rf;
+
+	if (jwk_set == NULL || jwk_set->refresher == NULL)
+		return;
+
+	rf = jwk_set->refresher;
+
+	pthread_mutex_lock(&rf->mutex);
+	__atomic_store_n(&rf->stop, 1, __ATOMIC_RELEASE);
+	pthread_cond_signal(&rf->cond);
+	pthread_mutex_unlock(&rf->mutex);
+
+	pthread_join(rf->thread, NULL);
+
+	jwk_set->refresher = NULL;
+	pthread_cond_destroy(&rf->cond);
+	pthread_mutex_destroy(&rf->mutex);
+	pthread_rwlock_destroy(&rf->lock);
+	jwt_freemem(rf);
+}
+
 #else
 
 jwk_set_t *jwks_load_fromurl(jwk_set_t *jwk_set, const char *url, int verify)
@@ -460,6 +777,38 @@ jwk_set_t *jwks_refresh_fromurl(jwk_set_t *jwk_set)
 	return jwk_set;
 }
 
+int jwks_refresh_start(jwk_set_t *jwk_set)
+{
+	(void)jwk_set;
+	return 1;
+}
+
+void jwks_refresh_stop(jwk_set_t *jwk_set)
+{
+	(void)jwk_set;
+}
+
+/* Without libcurl there is never a refresher to lock against. */
+void jwks_read_lock(const jwk_set_t *jwk_set)
+{
+	(void)jwk_set;
+}
+
+void jwks_read_unlock(const jwk_set_t *jwk_set)
+{
+	(void)jwk_set;
+}
+
+void jwks_error_lock(const jwk_set_t *jwk_set)
+{
+	(void)jwk_set;
+}
+
+void jwks_error_unlock(const jwk_set_t *jwk_set)
+{
+	(void)jwk_set;
+}
+
 #endif
 
 jwk_set_t *jwks_create_fromurl(const char *url, int verify)
@@ -0,0 +1,434 @@
+/* Copyright (C) 2026 maClara, LLC <info@maclara-llc.com>
+   This file is part of the JWT C Library
+
+   SPDX-License-Identifier:  MPL-2.0
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0. If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/* Lookup index over a jwk_set_t.
+ *
+ * @rfc{7517,4.5} "kid" lookups go through an open-addressing (linear probe)
+ * table, so a keyring of thousands of keys resolves a kid in O(1) rather than
+ * a list walk with strcmp. Only the first key with a given kid is indexed,
+ * which is the key the list walk would have returned.
+ *
+ * Keyless verification scans go through per-algorithm candidate lists: every
+ * usable key whose kty fits the algorithm and whose "alg" is that algorithm
+ * or absent, in keyring order. The algorithm fixes the kty, so this is the
+ * (kty, alg) index; jwt_alg_t is small and dense, so it is a direct table.
+ * Keys whose size or curve cannot pass that algorithm's key checks are left
+ * out too, so no crypto is run on them. A scan tries the keys that verified
+ * most recently first (jwks_scan_begin()): a client without a "kid" is most
+ * likely signing with the key it used last, and after a rotation the new key
+ * moves to the front as soon as it is seen.
+ *
+ * @rfc{7638} thumbprint lookups use the same kind of table as "kid", one per
+ * hash. These are built on the first lookup for that hash, from each item's
+ * cached thumbprint, since computing them costs a SHA pass per key.
+ *
+ * The index is rebuilt by every operation that adds or removes keys and is
+ * only read by lookups, so a keyring that is not being modified can be
+ * searched from many threads at once; the lazily built thumbprint tables are
+ * published atomically. If anything cannot be built (out of memory) the
+ * lookups fall back to walking the list. */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <jwt.h>
+
+#include "jwt-private.h"
+
+#define JWKS_N_THUMBPRINT	(JWK_THUMBPRINT_SHA512 + 1)
+
+struct jwks_slot {
+	uint32_t hash;
+	const char *key;	/* Borrowed from @item (its kid or thumbprint)	*/
+	jwk_item_t *item;	/* NULL for an empty slot			*/
+};
+
+/* Open-addressing string -> item table, linear probing. */
+struct jwks_table {
+	struct jwks_slot *slots;
+	size_t mask;		/* slot count - 1 (a power of two)		*/
+};
+
+struct jwks_index {
+	struct jwks_table kid;
+	struct jwks_table *tp[JWKS_N_THUMBPRINT];	/* built on first use	*/
+
+	/* byalg[alg] is n_byalg[alg] entries into the one @members block. */
+	jwk_item_t **members;
+	jwk_item_t **byalg[JWT_ALG_INVAL];
+	size_t n_byalg[JWT_ALG_INVAL];
+};
+
+/* FNV-1a, 32-bit. */
+static uint32_t kid_hash(const char *kid)
+{
+	uint32_t h = 2166136261u;
+
+	while (*kid)
+		h = (h ^ (unsigned char)*kid++) * 16777619u;
+
+	return h;
+}
+
+/* Is @item's size, and curve if it has one, right for @alg? The sizes are
+ * the ones jwt_verify_sig() requires; the curves are the ones @rfc{7518,3.4},
+ * @rfc{8037,3.1} and @rfc{8812,3.2} pair with each algorithm. */
+static int key_fits_alg(const jwk_item_t *item, jwt_alg_t alg)
+{
+	const char *crv = item->curve[0] ? item->curve : NULL;
+
+	switch (alg) {
+	case JWT_ALG_HS256:
+		return item->bits >= 256;
+	case JWT_ALG_HS384:
+		return item->bits >= 384;
+	case JWT_ALG_HS512:
+		return item->bits >= 512;
+
+	case JWT_ALG_RS256:
+	case JWT_ALG_RS384:
+	case JWT_ALG_RS512:
+	case JWT_ALG_PS256:
+	case JWT_ALG_PS384:
+	case JWT_ALG_PS512:
+		return item->bits >= 2048;
+
+	case JWT_ALG_ES256:
+		return item->bits == 256 && (!crv || !strcmp(crv, "P-256"));
+	case JWT_ALG_ES256K:
+		return item->bits == 256 && (!crv || !strcmp(crv, "secp256k1"));
+	case JWT_ALG_ES384:
+		return item->bits == 384 && (!crv || !strcmp(crv, "P-384"));
+	case JWT_ALG_ES512:
+		return item->bits == 521 && (!crv || !strcmp(crv, "P-521"));
+
+	case JWT_ALG_EDDSA:
+		return (item->bits == 256 || item->bits == 456) &&
+			(!crv || !strcmp(crv, "Ed25519") ||
+			 !strcmp(crv, "Ed448"));
+
+	default:
+		return 1;
+	}
+}
+
+/* Can @item serve a signature made with @alg? The same kty and alg gates
+ * the verify path applies, so nothing it would skip is listed, and then
+ * only a key of the right size and curve. */
+static int alg_candidate(const jwk_item_t *item, jwt_alg_t alg)
+{
+	if (item->error || jwt_alg_required_kty(alg) != item->kty)
+		return 0;
+
+	if (item->alg != JWT_ALG_NONE && item->alg != alg)
+		return 0;
+
+	return key_fits_alg(item, alg);
+}
+
+/* Size @t for @n keys, at most half full so probe runs stay short. */
+static int table_init(struct jwks_table *t, size_t n)
+{
+	size_t slots;
+
+	for (slots = 8; slots < n * 2; slots <<= 1)
+		;
+
+	t->slots = jwt_malloc(slots * sizeof(*t->slots));
+	if (t->slots == NULL)
+		return 1; // LCOV_EXCL_LINE
+
+	memset(t->slots, 0, slots * sizeof(*t->slots));
+	t->mask = slots - 1;
+
+	return 0;
+}
+
+static void table_insert(struct jwks_table *t, const char *key,
+			 jwk_item_t *item)
+{
+	uint32_t h = kid_hash(key);
+	size_t i = h & t->mask;
+
+	for (;; i = (i + 1) & t->mask) {
+		struct jwks_slot *slot = &t->slots[i];
+
+		if (slot->item == NULL) {
+			slot->hash = h;
+			slot->key = key;
+			slot->item = item;
+			return;
+		}
+
+		/* First one in keyring order wins. */
+		if (slot->hash == h && !strcmp(slot->key, key))
+			return;
+	}
+}
+
+static jwk_item_t *table_find(const struct jwks_table *t, const char *key)
+{
+	uint32_t h = kid_hash(key);
+	size_t i;
+
+	for (i = h & t->mask; t->slots[i].item != NULL; i = (i + 1) & t->mask) {
+		if (t->slots[i].hash == h && !strcmp(t->slots[i].key, key))
+			return t->slots[i].item;
+	}
+
+	return NULL;
+}
+
+static void table_free(struct jwks_table *t)
+{
+	if (t == NULL)
+		return;
+
+	jwt_freemem(t->slots);
+	jwt_freemem(t);
+}
+
+static void index_free(struct jwks_index *idx)
+{
+	int i;
+
+	if (idx == NULL)
+		return;
+
+	for (i = 0; i < JWKS_N_THUMBPRINT; i++)
+		table_free(idx->tp[i]);
+	jwt_freemem(idx->kid.slots);
+	jwt_freemem(idx->members);
+	jwt_freemem(idx);
+}
+
+void jwks_index_free(jwk_set_t *jwk_set)
+{
+	if (jwk_set == NULL)
+		return;
+
+	index_free(jwk_set->index);
+	jwk_set->index = NULL;
+}
+
+void jwks_index_rebuild(jwk_set_t *jwk_set)
+{
+	struct jwks_index *idx;
+	jwk_item_t *item;
+	size_t n_kid = 0, n_members = 0, pos;
+	int a;
+
+	if (jwk_set == NULL)
+		return;
+
+	jwks_index_free(jwk_set);
+
+	list_for_each_entry(item, &jwk_set->head, node) {
+		if (item->kid != NULL)
+			n_kid++;
+		for (a = 0; a < JWT_ALG_INVAL; a++)
+			n_members += alg_candidate(item, (jwt_alg_t)a);
+	}
+
+	/* Nothing to index; the list walk is already as fast. */
+	if (jwk_set->head.next == &jwk_set->head)
+		return;
+
+	idx = jwt_malloc(sizeof(*idx));
+	if (idx == NULL)
+		return; // LCOV_EXCL_LINE
+	memset(idx, 0, sizeof(*idx));
+
+	idx->members = jwt_malloc((n_members ? n_members : 1) *
+				  sizeof(*idx->members));
+	if (idx->members == NULL || table_init(&idx->kid, n_kid)) {
+		// LCOV_EXCL_START
+		index_free(idx);
+		return;
+		// LCOV_EXCL_STOP
+	}
+
+	list_for_each_entry(item, &jwk_set->head, node) {
+		if (item->kid != NULL)
+			table_insert(&idx->kid, item->kid, item);
+	}
+
+	/* One pass per algorithm keeps each list in keyring order. */
+	pos = 0;
+	for (a = 0; a < JWT_ALG_INVAL; a++) {
+		size_t start = pos;
+
+		list_for_each_entry(item, &jwk_set->head, node) {
+			if (alg_candidate(item, (jwt_alg_t)a))
+				idx->members[pos++] = item;
+		}
+		idx->byalg[a] = &idx->members[start];
+		idx->n_byalg[a] = pos - start;
+	}
+
+	jwk_set->index = idx;
+}
+
+int jwks_index_bykid(const jwk_set_t *jwk_set, const char *kid,
+		     jwk_item_t **out)
+{
+	const struct jwks_index *idx = jwk_set->index;
+
+	if (idx == NULL)
+		return 0;
+
+	*out = table_find(&idx->kid, kid);
+
+	return 1;
+}
+
+/* The @alg thumbprint table, built on first use. Concurrent first lookups
+ * may each build one; the first published wins and the rest are dropped. */
+static struct jwks_table *tp_table(const jwk_set_t *jwk_set,
+				   struct jwks_index *idx,
+				   jwk_thumbprint_alg_t alg)
+{
+	struct jwks_table *t, *expected = NULL;
+	jwk_item_t *item;
+	size_t n = 0;
+
+	t = __atomic_load_n(&idx->tp[alg], __ATOMIC_ACQUIRE);
+	if (t != NULL)
+		return t;
+
+	list_for_each_entry(item, &jwk_set->head, node)
+		n++;
+
+	t = jwt_malloc(sizeof(*t));
+	if (t == NULL)
+		return NULL; // LCOV_EXCL_LINE
+	if (table_init(t, n)) {
+		// LCOV_EXCL_START
+		jwt_freemem(t);
+		return NULL;
+		// LCOV_EXCL_STOP
+	}
+
+	list_for_each_entry(item, &jwk_set->head, node) {
+		const char *tp = jwks_item_thumbprint_get(item, alg);
+
+		if (tp != NULL)
+			table_insert(t, tp, item);
+	}
+
+	if (!__atomic_compare_exchange_n(&idx->tp[alg], &expected, t, 0,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		table_free(t);
+		t = expected;
+	}
+
+	return t;
+}
+
+int jwks_index_bythumbprint(const jwk_set_t *jwk_set, jwk_thumbprint_alg_t alg,
+			    const char *thumbprint, jwk_item_t **out)
+{
+	struct jwks_index *idx = jwk_set->index;
+	struct jwks_table *t;
+
+	if (idx == NULL || alg < 0 || alg >= JWKS_N_THUMBPRINT)
+		return 0;
+
+	t = tp_table(jwk_set, idx, alg);
+	if (t == NULL)
+		return 0; // LCOV_EXCL_LINE
+
+	*out = table_find(t, thumbprint);
+
+	return 1;
+}
+
+jwk_item_t *const *jwks_index_byalg(const jwk_set_t *jwk_set, jwt_alg_t alg,
+				    size_t *count)
+{
+	const struct jwks_index *idx = jwk_set->index;
+
+	if (idx == NULL || alg >= JWT_ALG_INVAL)
+		return NULL;
+
+	*count = idx->n_byalg[alg];
+
+	return idx->byalg[alg];
+}
+
+/* Order the candidates for @alg, most recently successful first. Keys that
+ * never verified keep their keyring order, after the rest. A list too long
+ * for the stack that cannot be copied is scanned in keyring order. */
+int jwks_scan_begin(struct jwks_scan *scan, const jwk_set_t *jwk_set,
+		    jwt_alg_t alg)
+{
+	jwk_item_t *const *cand;
+	size_t i, j, n;
+
+	memset(scan, 0, sizeof(*scan));
+
+	cand = jwks_index_byalg(jwk_set, alg, &n);
+	if (cand == NULL)
+		return 0;
+
+	scan->items = cand;
+	scan->n = n;
+
+	if (n < 2)
+		return 1;
+
+	if (n <= JWKS_SCAN_STACK) {
+		scan->sorted = scan->stack;
+	} else {
+		scan->sorted = jwt_malloc(n * sizeof(*scan->sorted));
+		if (scan->sorted == NULL)
+			return 1; // LCOV_EXCL_LINE
+	}
+
+	/* Insertion sort: short lists, and mostly in order already. */
+	for (i = 0; i < n; i++) {
+		jwk_item_t *item = cand[i];
+		unsigned long used = __atomic_load_n(&item->scan_used,
+						     __ATOMIC_RELAXED);
+
+		for (j = i; j > 0; j--) {
+			if (__atomic_load_n(&scan->sorted[j - 1]->scan_used,
+					    __ATOMIC_RELAXED) >= used)
+				break;
+			scan->sorted[j] = scan->sorted[j - 1];
+		}
+		scan->sorted[j] = item;
+	}
+	scan->items = scan->sorted;
+
+	return 1;
+}
+
+void jwks_scan_hit(const jwk_set_t *jwk_set, const jwk_item_t *item)
+{
+	jwk_set_t *set = (jwk_set_t *)jwk_set;
+	jwk_item_t *it = (jwk_item_t *)item;
+	unsigned long now;
+
+	/* The key that verified last is usually the one verifying again;
+	 * leave the shared clock alone then. */
+	now = __atomic_load_n(&set->scan_clock, __ATOMIC_RELAXED);
+	if (now && __atomic_load_n(&it->scan_used, __ATOMIC_RELAXED) == now)
+		return;
+
+	now = __atomic_add_fetch(&set->scan_clock, 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&it->scan_used, now, __ATOMIC_RELAXED);
+}
+
+void jwks_scan_end(struct jwks_scan *scan)
+{
+	if (scan->sorted != NULL && scan->sorted != scan->stack)
+		jwt_freemem(scan->sorted);
+	scan->sorted = NULL;
+}
@@ -435,18 +435,34 @@ int jwks_item_key_oct(const jwk_item_t *item, const unsigned char **buf,
 
 int jwks_error(const jwk_set_t *jwk_set)
 {
+	int error;
+
 	if (jwk_set == NULL)
 		return 1;
 
-	return jwk_set->error ? 1 : 0;
+	jwks_error_lock(jwk_set);
+	error = jwk_set->error ? 1 : 0;
+	jwks_error_unlock(jwk_set);
+
+	return error;
 }
 
 const char *jwks_error_msg(const jwk_set_t *jwk_set)
 {
+	/* A refresher may rewrite the set's own buffer at any time. */
+	static __thread char msg[JWT_ERR_LEN];
+
 	if (jwk_set == NULL)
 		return NULL;
 
-	return jwk_set->error_msg;
+	if (jwk_set->refresher == NULL)
+		return jwk_set->error_msg;
+
+	jwks_error_lock(jwk_set);
+	memcpy(msg, jwk_set->error_msg, sizeof(msg));
+	jwks_error_unlock(jwk_set);
+
+	return msg;
 }
 
 void jwks_error_clear(jwk_set_t *jwk_set)
@@ -454,8 +470,10 @@ void jwks_error_clear(jwk_set_t *jwk_set)
 	if (jwk_set == NULL)
 		return;
 
+	jwks_error_lock(jwk_set);
 	jwk_set->error = 0;
 	memset(jwk_set->error_msg, 0, sizeof(jwk_set->error_msg));
+	jwks_error_unlock(jwk_set);
 }
 
 static int jwks_item_add(jwk_set_t *jwk_set, jwk_item_t *item)
@@ -469,6 +487,9 @@ jwk_item_t *jwks_find_bykid(jwk_set_t *jwk_set, const char *kid)
 {
 	jwk_item_t *item = NULL;
 
+	if (jwks_index_bykid(jwk_set, kid, &item))
+		return item;
+
 	list_for_each_entry(item, &jwk_set->head, node) {
 		if (item->kid == NULL || strcmp(item->kid, kid))
 			continue;
@@ -480,7 +501,11 @@ jwk_item_t *jwks_find_bykid(jwk_set_t *jwk_set, const char *kid)
 
 static void __item_free(jwk_item_t *todel)
 {
+	int i;
+
 	if (todel->provider == JWT_CRYPTO_OPS_ANY) {
+		if (todel->hmac != NULL)
+			todel->hmac->free(todel->hmac);
 		jwt_scrub_and_free(todel->oct.key, todel->oct.len);
 	} else {
 		/* Free the provider_data via the backend that PARSED the key, not
@@ -496,13 +521,15 @@ static void __item_free(jwk_item_t *todel)
 	/* A few non-crypto specific things. */
 	jwt_freemem(todel->kid);
 	if (todel->x5c != NULL) {
-		size_t i;
+		size_t j;
 
-		for (i = 0; i < todel->x5c_count; i++)
-			jwt_freemem(todel->x5c[i].der);
+		for (j = 0; j < todel->x5c_count; j++)
+			jwt_freemem(todel->x5c[j].der);
 		jwt_freemem(todel->x5c);
 	}
 	jwt_json_releasep(&todel->json);
+	for (i = 0; i <= JWK_THUMBPRINT_SHA512; i++)
+		jwt_freemem(todel->thumbprint[i]);
 	list_del(&todel->node);
 
 	/* Free the container and the item itself. */
@@ -529,6 +556,7 @@ int jwks_item_free(jwk_set_t *jwk_set, const size_t index)
 		return 0;
 
 	__item_free(todel);
+	jwks_index_rebuild(jwk_set);
 
 	return 1;
 }
@@ -556,27 +584,66 @@ int jwks_item_free_bad(jwk_set_t *jwk_set)
 		count++;
 	}
 
+	if (count)
+		jwks_index_rebuild(jwk_set);
+
 	return count;
 }
 
 int jwks_item_free_all(jwk_set_t *jwk_set)
 {
-	int i;
+	jwk_item_t *item, *pos;
+	int i = 0;
 
 	if (jwk_set == NULL)
 		return 0;
 
-	for (i = 0; jwks_item_free(jwk_set, 0); i++)
-		/* do nothing */;
+	/* Drop the index first; nothing is left for it to point at. */
+	jwks_index_free(jwk_set);
+
+	list_for_each_entry_safe(item, pos, &jwk_set->head, node) {
+		__item_free(item);
+		i++;
+	}
 
 	return i;
 }
 
+/* Splice the items of @from onto the (empty) head @to. */
+static void items_move(ll_t *to, ll_t *from)
+{
+	if (from->next == from) {
+		INIT_LIST_HEAD(to);
+		return;
+	}
+
+	to->next = from->next;
+	to->prev = from->prev;
+	to->next->prev = to;
+	to->prev->next = to;
+}
+
+void jwks_items_swap(jwk_set_t *a, jwk_set_t *b)
+{
+	struct jwks_index *index = a->index;
+	ll_t head;
+
+	items_move(&head, &a->head);
+	items_move(&a->head, &b->head);
+	items_move(&b->head, &head);
+
+	a->index = b->index;
+	b->index = index;
+}
+
 void jwks_free(jwk_set_t *jwk_set)
 {
 	if (jwk_set == NULL)
 		return;
 
+	/* The refresher's thread uses the set until it is joined. */
+	jwks_refresh_stop(jwk_set);
+
 	jwks_item_free_all(jwk_set);
 	if (jwk_set->cache != NULL) {
 		jwt_freemem(jwk_set->cache->url);
@@ -628,6 +695,8 @@ static jwk_set_t *jwks_process(jwk_set_t *jwk_set, jwt_json_t *j_all, jwt_json_e
                 }
         }
 
+	jwks_index_rebuild(jwk_set);
+
         return jwk_set;
 }
 
@@ -750,6 +819,8 @@ static void jwks_process_array(jwk_set_t *jwk_set, jwt_json_t *j_array)
 		if (jwk_item != NULL)
 			jwks_item_add(jwk_set, jwk_item);
 	}
+
+	jwks_index_rebuild(jwk_set);
 }
 
 jwk_set_t *jwks_load_fromkey(jwk_set_t *jwk_set, const char *key,
@@ -1170,8 +1241,11 @@ char *jwt_jwk_thumbprint(const jwt_json_t *jwk, jwk_key_type_t kty, int bits)
 	return out;
 }
 
-char *jwks_item_thumbprint(const jwk_item_t *item, jwk_thumbprint_alg_t alg)
+const char *jwks_item_thumbprint_get(const jwk_item_t *item,
+				     jwk_thumbprint_alg_t alg)
 {
+	char *tp, *expected = NULL;
+	char **slot;
 	int bits;
 
 	if (item == NULL || item->error || item->json == NULL)
@@ -1191,13 +1265,49 @@ char *jwks_item_thumbprint(const jwk_item_t *item, jwk_thumbprint_alg_t alg)
 		return NULL;
 	}
 
-	return jwt_jwk_thumbprint(item->json, item->kty, bits);
+	/* The caches (this and the backend's provider_cache) are the only
+	 * things a lookup writes to a key. */
+	slot = (char **)&item->thumbprint[alg];
+
+	tp = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+	if (tp != NULL)
+		return tp;
+
+	tp = jwt_jwk_thumbprint(item->json, item->kty, bits);
+	if (tp == NULL)
+		return NULL;
+
+	/* A racing first caller may have published one already. */
+	if (!__atomic_compare_exchange_n(slot, &expected, tp, 0,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		jwt_freemem(tp);
+		tp = expected;
+	}
+
+	return tp;
+}
+
+char *jwks_item_thumbprint(const jwk_item_t *item, jwk_thumbprint_alg_t alg)
+{
+	const char *tp = jwks_item_thumbprint_get(item, alg);
+	char *out;
+	size_t len;
+
+	if (tp == NULL)
+		return NULL;
+
+	len = strlen(tp) + 1;
+	out = jwt_malloc(len);
+	if (out == NULL)
+		return NULL; // LCOV_EXCL_LINE
+	memcpy(out, tp, len);
+
+	return out;
 }
 
 char *jwks_item_thumbprint_uri(const jwk_item_t *item, jwk_thumbprint_alg_t alg)
 {
-	char_auto *tp = NULL;
-	const char *label;
+	const char *tp, *label;
 	char *out = NULL;
 	size_t len;
 
@@ -1217,7 +1327,7 @@ char *jwks_item_thumbprint_uri(const jwk_item_t *item, jwk_thumbprint_alg_t alg)
 		return NULL;
 	}
 
-	tp = jwks_item_thumbprint(item, alg);
+	tp = jwks_item_thumbprint_get(item, alg);
 	if (tp == NULL)
 		return NULL;
 
@@ -1241,8 +1351,11 @@ jwk_item_t *jwks_find_bythumbprint(jwk_set_t *jwk_set, jwk_thumbprint_alg_t alg,
 	if (jwk_set == NULL || thumbprint == NULL)
 		return NULL;
 
+	if (jwks_index_bythumbprint(jwk_set, alg, thumbprint, &item))
+		return item;
+
 	list_for_each_entry(item, &jwk_set->head, node) {
-		char_auto *tp = jwks_item_thumbprint(item, alg);
+		const char *tp = jwks_item_thumbprint_get(item, alg);
 
 		if (tp != NULL && !strcmp(tp, thumbprint))
 			return item;
@@ -0,0 +1,440 @@
+/* Copyright (C) 2026 maClara, LLC <info@maclara-llc.com>
+   This file is part of the JWT C Library
+
+   SPDX-License-Identifier:  MPL-2.0
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0. If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/* Vector kernels for base64url (@rfc{4648,5}) encode and decode.
+ *
+ * These only ever handle whole blocks from the front of the input. The scalar
+ * code in jwt.c finishes the tail, and re-examines any block a kernel declined
+ * (one holding a byte outside [A-Za-z0-9_-]), so every error is reported by the
+ * one scalar implementation and the accepted alphabet is identical on every
+ * path: '+', '/' and '=' are rejected the same way with or without SIMD.
+ *
+ * x86-64 picks SSE4.1 or AVX2 at runtime via per-function target attributes,
+ * so the library itself is still built for the baseline ISA. NEON is part of
+ * the aarch64 baseline and needs no runtime check. */
+
+#include <stddef.h>
+#include <string.h>
+
+#include <jwt.h>
+
+#include "jwt-private.h"
+
+#if (defined(__x86_64__) || defined(_M_X64)) && defined(__GNUC__)
+#define JWT_B64_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define JWT_B64_NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef JWT_B64_X86
+
+typedef enum {
+	B64_KERNEL_UNKNOWN = 0,
+	B64_KERNEL_SCALAR,
+	B64_KERNEL_SSE41,
+	B64_KERNEL_AVX2,
+} b64_kernel_t;
+
+static b64_kernel_t b64_kernel;
+
+/* Probe once; racing first callers all store the same answer. */
+static b64_kernel_t b64_kernel_get(void)
+{
+	b64_kernel_t k = __atomic_load_n(&b64_kernel, __ATOMIC_RELAXED);
+
+	if (k != B64_KERNEL_UNKNOWN)
+		return k;
+
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		k = B64_KERNEL_AVX2;
+	else if (__builtin_cpu_supports("sse4.1"))
+		k = B64_KERNEL_SSE41;
+	else
+		k = B64_KERNEL_SCALAR; // LCOV_EXCL_LINE
+
+	__atomic_store_n(&b64_kernel, k, __ATOMIC_RELAXED);
+
+	return k;
+}
+
+/* 16 ASCII characters to their 6-bit values. Returns 0 if any character is
+ * outside the base64url alphabet (bytes >= 0x80 compare as negative, so they
+ * miss every range). */
+__attribute__((target("sse4.1")))
+static inline int sse_decode_lookup(__m128i in, __m128i *vals)
+{
+	const __m128i upper = _mm_and_si128(
+		_mm_cmpgt_epi8(in, _mm_set1_epi8('A' - 1)),
+		_mm_cmplt_epi8(in, _mm_set1_epi8('Z' + 1)));
+	const __m128i lower = _mm_and_si128(
+		_mm_cmpgt_epi8(in, _mm_set1_epi8('a' - 1)),
+		_mm_cmplt_epi8(in, _mm_set1_epi8('z' + 1)));
+	const __m128i digit = _mm_and_si128(
+		_mm_cmpgt_epi8(in, _mm_set1_epi8('0' - 1)),
+		_mm_cmplt_epi8(in, _mm_set1_epi8('9' + 1)));
+	const __m128i dash = _mm_cmpeq_epi8(in, _mm_set1_epi8('-'));
+	const __m128i under = _mm_cmpeq_epi8(in, _mm_set1_epi8('_'));
+	__m128i valid, off;
+
+	valid = _mm_or_si128(_mm_or_si128(upper, lower),
+			     _mm_or_si128(digit, _mm_or_si128(dash, under)));
+	if (_mm_movemask_epi8(valid) != 0xFFFF)
+		return 0;
+
+	/* Per-class offset from ASCII to the 6-bit value. */
+	off = _mm_and_si128(upper, _mm_set1_epi8(-'A'));
+	off = _mm_blendv_epi8(off, _mm_set1_epi8(26 - 'a'), lower);
+	off = _mm_blendv_epi8(off, _mm_set1_epi8(52 - '0'), digit);
+	off = _mm_blendv_epi8(off, _mm_set1_epi8(62 - '-'), dash);
+	off = _mm_blendv_epi8(off, _mm_set1_epi8(63 - '_'), under);
+
+	*vals = _mm_add_epi8(in, off);
+
+	return 1;
+}
+
+/* Pack sixteen 6-bit values (four per 32-bit lane, first in the low byte)
+ * into 12 octets at the front of the register. */
+__attribute__((target("sse4.1")))
+static inline __m128i sse_decode_pack(__m128i vals)
+{
+	/* [a b c d] -> [a<<6|b, c<<6|d] -> a<<18|b<<12|c<<6|d */
+	vals = _mm_maddubs_epi16(vals, _mm_set1_epi32(0x01400140));
+	vals = _mm_madd_epi16(vals, _mm_set1_epi32(0x00011000));
+
+	return _mm_shuffle_epi8(vals, _mm_setr_epi8(2, 1, 0, 6, 5, 4,
+						    10, 9, 8, 14, 13, 12,
+						    -1, -1, -1, -1));
+}
+
+__attribute__((target("sse4.1")))
+static size_t sse_decode(const char *src, size_t len, unsigned char *out)
+{
+	size_t i = 0, j = 0;
+	__m128i vals;
+
+	/* A 16-byte store writes 4 octets past the 12 decoded; keep at least
+	 * 8 more input characters (6 more output octets) behind it. */
+	while (len - i >= 24) {
+		if (!sse_decode_lookup(_mm_loadu_si128((const __m128i *)(src + i)),
+				       &vals))
+			break;
+		_mm_storeu_si128((__m128i *)(out + j), sse_decode_pack(vals));
+		i += 16;
+		j += 12;
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_decode(const char *src, size_t len, unsigned char *out)
+{
+	const __m256i pack_perm = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+	size_t i = 0, j = 0;
+
+	/* A 32-byte store writes 8 octets past the 24 decoded; keep at least
+	 * 12 more input characters (9 more output octets) behind it. */
+	while (len - i >= 44) {
+		const __m256i in = _mm256_loadu_si256((const __m256i *)(src + i));
+		__m256i upper, lower, digit, dash, under, valid, off, vals;
+
+		upper = _mm256_and_si256(
+			_mm256_cmpgt_epi8(in, _mm256_set1_epi8('A' - 1)),
+			_mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), in));
+		lower = _mm256_and_si256(
+			_mm256_cmpgt_epi8(in, _mm256_set1_epi8('a' - 1)),
+			_mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), in));
+		digit = _mm256_and_si256(
+			_mm256_cmpgt_epi8(in, _mm256_set1_epi8('0' - 1)),
+			_mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), in));
+		dash = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('-'));
+		under = _mm256_cmpeq_epi8(in, _mm256_set1_epi8('_'));
+
+		valid = _mm256_or_si256(
+			_mm256_or_si256(upper, lower),
+			_mm256_or_si256(digit, _mm256_or_si256(dash, under)));
+		if (_mm256_movemask_epi8(valid) != -1)
+			break;
+
+		off = _mm256_and_si256(upper, _mm256_set1_epi8(-'A'));
+		off = _mm256_blendv_epi8(off, _mm256_set1_epi8(26 - 'a'), lower);
+		off = _mm256_blendv_epi8(off, _mm256_set1_epi8(52 - '0'), digit);
+		off = _mm256_blendv_epi8(off, _mm256_set1_epi8(62 - '-'), dash);
+		off = _mm256_blendv_epi8(off, _mm256_set1_epi8(63 - '_'), under);
+		vals = _mm256_add_epi8(in, off);
+
+		/* As sse_decode_pack(), per 128-bit lane, then close the
+		 * 4-octet gap between the two 12-octet halves. */
+		vals = _mm256_maddubs_epi16(vals, _mm256_set1_epi32(0x01400140));
+		vals = _mm256_madd_epi16(vals, _mm256_set1_epi32(0x00011000));
+		vals = _mm256_shuffle_epi8(vals, _mm256_setr_epi8(
+			2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+			2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+		vals = _mm256_permutevar8x32_epi32(vals, pack_perm);
+
+		_mm256_storeu_si256((__m256i *)(out + j), vals);
+		i += 32;
+		j += 24;
+	}
+
+	/* Finish what is left of the fast range 16 at a time. */
+	return i + sse_decode(src + i, len - i, out + j);
+}
+
+/* Spread 12 octets into sixteen 6-bit indices (one per byte, in output
+ * order): the shuffle lines each 3-octet group up as [b1 b0 b2 b1], then the
+ * multiplies shift each 6-bit field down to the bottom of its byte. */
+__attribute__((target("sse4.1")))
+static inline __m128i sse_encode_split(__m128i in)
+{
+	__m128i t0, t1, t2, t3;
+
+	in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4,
+						7, 6, 8, 7, 10, 9, 11, 10));
+	t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+	t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+	t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+
+	return _mm_or_si128(t1, t3);
+}
+
+/* Sixteen 6-bit indices to base64url ASCII. */
+__attribute__((target("sse4.1")))
+static inline __m128i sse_encode_translate(__m128i idx)
+{
+	__m128i off;
+
+	/* 63 -> '_' unless a smaller class below claims the byte. */
+	off = _mm_set1_epi8('_' - 63);
+	off = _mm_blendv_epi8(off, _mm_set1_epi8('-' - 62),
+			      _mm_cmpeq_epi8(idx, _mm_set1_epi8(62)));
+	off = _mm_blendv_epi8(off, _mm_set1_epi8('0' - 52),
+			      _mm_cmplt_epi8(idx, _mm_set1_epi8(62)));
+	off = _mm_blendv_epi8(off, _mm_set1_epi8('a' - 26),
+			      _mm_cmplt_epi8(idx, _mm_set1_epi8(52)));
+	off = _mm_blendv_epi8(off, _mm_set1_epi8('A'),
+			      _mm_cmplt_epi8(idx, _mm_set1_epi8(26)));
+
+	return _mm_add_epi8(idx, off);
+}
+
+__attribute__((target("sse4.1")))
+static size_t sse_encode(const unsigned char *in, size_t len, char *out)
+{
+	size_t i = 0, j = 0;
+
+	/* Each step reads 16 octets but consumes 12. */
+	while (len - i >= 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+
+		v = sse_encode_translate(sse_encode_split(v));
+		_mm_storeu_si128((__m128i *)(out + j), v);
+		i += 12;
+		j += 16;
+	}
+
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t avx2_encode(const unsigned char *in, size_t len, char *out)
+{
+	size_t i = 0, j = 0;
+
+	/* Two 12-octet groups per step, one per 128-bit lane. The 32-byte
+	 * load starts 4 octets early so the lanes hold in[i-4 .. i+28); the
+	 * split shuffle then skips those 4 in the low lane. */
+	if (len < 28)
+		return sse_encode(in, len, out);
+
+	/* First 12 octets via SSE so the shifted load below is in bounds. */
+	j = 16;
+	i = 12;
+	_mm_storeu_si128((__m128i *)out, sse_encode_translate(sse_encode_split(
+		_mm_loadu_si128((const __m128i *)in))));
+
+	while (len - i >= 28) {
+		__m256i v, t0, t1, t2, t3;
+		__m256i off;
+
+		v = _mm256_loadu_si256((const __m256i *)(in + i - 4));
+		v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(
+			5, 4, 6, 5, 8, 7, 9, 8, 11, 10, 12, 11, 14, 13, 15, 14,
+			1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+		t0 = _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00));
+		t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+		t2 = _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0));
+		t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+		v = _mm256_or_si256(t1, t3);
+
+		off = _mm256_set1_epi8('_' - 63);
+		off = _mm256_blendv_epi8(off, _mm256_set1_epi8('-' - 62),
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8(62)));
+		off = _mm256_blendv_epi8(off, _mm256_set1_epi8('0' - 52),
+			_mm256_cmpgt_epi8(_mm256_set1_epi8(62), v));
+		off = _mm256_blendv_epi8(off, _mm256_set1_epi8('a' - 26),
+			_mm256_cmpgt_epi8(_mm256_set1_epi8(52), v));
+		off = _mm256_blendv_epi8(off, _mm256_set1_epi8('A'),
+			_mm256_cmpgt_epi8(_mm256_set1_epi8(26), v));
+		v = _mm256_add_epi8(v, off);
+
+		_mm256_storeu_si256((__m256i *)(out + j), v);
+		i += 24;
+		j += 32;
+	}
+
+	return i + sse_encode(in + i, len - i, out + j);
+}
+
+#endif /* JWT_B64_X86 */
+
+#ifdef JWT_B64_NEON
+
+/* 16 ASCII characters to their 6-bit values; sets *bad on any character
+ * outside the base64url alphabet. */
+static inline uint8x16_t neon_decode_lookup(uint8x16_t in, uint8x16_t *bad)
+{
+	const uint8x16_t upper = vcleq_u8(vsubq_u8(in, vdupq_n_u8('A')),
+					  vdupq_n_u8(25));
+	const uint8x16_t lower = vcleq_u8(vsubq_u8(in, vdupq_n_u8('a')),
+					  vdupq_n_u8(25));
+	const uint8x16_t digit = vcleq_u8(vsubq_u8(in, vdupq_n_u8('0')),
+					  vdupq_n_u8(9));
+	const uint8x16_t dash = vceqq_u8(in, vdupq_n_u8('-'));
+	const uint8x16_t under = vceqq_u8(in, vdupq_n_u8('_'));
+	uint8x16_t off;
+
+	*bad = vorrq_u8(*bad, vmvnq_u8(vorrq_u8(vorrq_u8(upper, lower),
+		vorrq_u8(digit, vorrq_u8(dash, under)))));
+
+	off = vandq_u8(upper, vdupq_n_u8((uint8_t)-'A'));
+	off = vbslq_u8(lower, vdupq_n_u8((uint8_t)(26 - 'a')), off);
+	off = vbslq_u8(digit, vdupq_n_u8((uint8_t)(52 - '0')), off);
+	off = vbslq_u8(dash, vdupq_n_u8((uint8_t)(62 - '-')), off);
+	off = vbslq_u8(under, vdupq_n_u8((uint8_t)(63 - '_')), off);
+
+	return vaddq_u8(in, off);
+}
+
+static size_t neon_decode(const char *src, size_t len, unsigned char *out)
+{
+	size_t i = 0, j = 0;
+
+	/* 64 characters de-interleaved into the four sextets of each group,
+	 * re-interleaved as 48 octets. Stores are exact; no slack needed. */
+	while (len - i >= 64) {
+		uint8x16x4_t in = vld4q_u8((const uint8_t *)(src + i));
+		uint8x16_t bad = vdupq_n_u8(0);
+		uint8x16x3_t o;
+		uint8x16_t a, b, c, d;
+
+		a = neon_decode_lookup(in.val[0], &bad);
+		b = neon_decode_lookup(in.val[1], &bad);
+		c = neon_decode_lookup(in.val[2], &bad);
+		d = neon_decode_lookup(in.val[3], &bad);
+		if (vmaxvq_u8(bad))
+			break;
+
+		o.val[0] = vorrq_u8(vshlq_n_u8(a, 2), vshrq_n_u8(b, 4));
+		o.val[1] = vorrq_u8(vshlq_n_u8(b, 4), vshrq_n_u8(c, 2));
+		o.val[2] = vorrq_u8(vshlq_n_u8(c, 6), d);
+		vst3q_u8(out + j, o);
+		i += 64;
+		j += 48;
+	}
+
+	return i;
+}
+
+static const uint8_t neon_b64url_alphabet[64] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+static size_t neon_encode(const unsigned char *in, size_t len, char *out)
+{
+	const uint8x16_t m6 = vdupq_n_u8(0x3F);
+	uint8x16x4_t tbl;
+	size_t i = 0, j = 0;
+
+	tbl.val[0] = vld1q_u8(neon_b64url_alphabet);
+	tbl.val[1] = vld1q_u8(neon_b64url_alphabet + 16);
+	tbl.val[2] = vld1q_u8(neon_b64url_alphabet + 32);
+	tbl.val[3] = vld1q_u8(neon_b64url_alphabet + 48);
+
+	while (len - i >= 48) {
+		uint8x16x3_t v = vld3q_u8(in + i);
+		uint8x16x4_t o;
+
+		o.val[0] = vshrq_n_u8(v.val[0], 2);
+		o.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(v.val[0], 4),
+					     vshrq_n_u8(v.val[1], 4)), m6);
+		o.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(v.val[1], 2),
+					     vshrq_n_u8(v.val[2], 6)), m6);
+		o.val[3] = vandq_u8(v.val[2], m6);
+
+		o.val[0] = vqtbl4q_u8(tbl, o.val[0]);
+		o.val[1] = vqtbl4q_u8(tbl, o.val[1]);
+		o.val[2] = vqtbl4q_u8(tbl, o.val[2]);
+		o.val[3] = vqtbl4q_u8(tbl, o.val[3]);
+		vst4q_u8((uint8_t *)(out + j), o);
+		i += 48;
+		j += 64;
+	}
+
+	return i;
+}
+
+#endif /* JWT_B64_NEON */
+
+size_t jwt_base64uri_decode_simd(const char *src, size_t len,
+				 unsigned char *out)
+{
+#if defined(JWT_B64_X86)
+	switch (b64_kernel_get()) {
+	case B64_KERNEL_AVX2:
+		return avx2_decode(src, len, out);
+	case B64_KERNEL_SSE41:
+		return sse_decode(src, len, out);
+	default:
+		return 0; // LCOV_EXCL_LINE
+	}
+#elif defined(JWT_B64_NEON)
+	return neon_decode(src, len, out);
+#else
+	(void)src;
+	(void)len;
+	(void)out;
+	return 0;
+#endif
+}
+
+size_t jwt_base64uri_encode_simd(const unsigned char *in, size_t len,
+				 char *out)
+{
+#if defined(JWT_B64_X86)
+	switch (b64_kernel_get()) {
+	case B64_KERNEL_AVX2:
+		return avx2_encode(in, len, out);
+	case B64_KERNEL_SSE41:
+		return sse_encode(in, len, out);
+	default:
+		return 0; // LCOV_EXCL_LINE
+	}
+#elif defined(JWT_B64_NEON)
+	return neon_encode(in, len, out);
+#else
+	(void)in;
+	(void)len;
+	(void)out;
+	return 0;
+#endif
+}
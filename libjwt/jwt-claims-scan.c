@@ -0,0 +1,725 @@
+/* Copyright (C) 2026 maClara, LLC <info@maclara-llc.com>
+   This file is part of the JWT C Library
+
+   SPDX-License-Identifier:  MPL-2.0
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0. If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/* Registered claims read straight from a decoded payload.
+ *
+ * The checker's claim checks need only a few top-level members: "exp",
+ * "nbf", "iss", "sub", "aud" and the names given to jwt_checker_require().
+ * A JSON tree costs an allocation per value, so a payload carrying a 50 KB
+ * permission list is thousands of them, built and freed on every verify just
+ * to read those. When nothing will see the jwt_t afterwards, the checker
+ * instead makes one pass over the payload here and keeps only what it checks:
+ * integers, and strings as views into the payload buffer.
+ *
+ * The pass still validates the whole payload the way the Jansson backend
+ * does, so a payload one rejects the other does too: UTF-8, escapes and
+ * surrogate pairs, no NUL, number syntax (with integer and real overflow
+ * errors), the nesting limit, nothing after the top-level value, and
+ * @rfc{8725,2.4} duplicate member names at every level. (Jansson lets one
+ * NUL octet slip through after a number or literal; that is not JSON and is
+ * refused here.) Duplicates are refused whichever JSON backend is built.
+ * Strings are unescaped in place, so a view is plain bytes. */
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <jwt.h>
+
+#include "jwt-private.h"
+
+/* Jansson's JSON_PARSER_MAX_DEPTH. */
+#define SCAN_MAX_DEPTH		2048
+#define SCAN_STACK_KEYS		64
+#define SCAN_PAIRWISE_KEYS	8
+
+enum scan_type {
+	SCAN_STR,
+	SCAN_INT,
+	SCAN_ARRAY,
+	SCAN_OTHER,
+};
+
+struct scan_value {
+	enum scan_type type;
+	long long int_val;
+	struct jwt_json_view str;
+};
+
+/* A growable list of views, starting in a caller-provided array. */
+struct view_list {
+	struct jwt_json_view *v;
+	size_t n;
+	size_t cap;
+};
+
+struct scan {
+	char *p;
+	char *end;
+	unsigned int depth;
+	struct jwt_claims_scan *cs;
+
+	/* Member names of every object still open, innermost last. */
+	struct view_list keys;
+	struct jwt_json_view keys_buf[SCAN_STACK_KEYS];
+};
+
+static int view_list_add(struct view_list *l, struct jwt_json_view *inline_buf,
+			 const struct jwt_json_view *v)
+{
+	struct jwt_json_view *grown;
+
+	if (l->n == l->cap) {
+		grown = jwt_malloc(l->cap * 2 * sizeof(*grown));
+		if (grown == NULL)
+			return 1; // LCOV_EXCL_LINE
+
+		memcpy(grown, l->v, l->n * sizeof(*grown));
+		if (l->v != inline_buf)
+			jwt_freemem(l->v);
+
+		l->v = grown;
+		l->cap *= 2;
+	}
+
+	l->v[l->n++] = *v;
+
+	return 0;
+}
+
+static int aud_add(struct jwt_claims_scan *cs, const struct jwt_json_view *v)
+{
+	struct view_list l = { cs->aud, cs->n_aud, cs->aud_cap };
+
+	if (view_list_add(&l, cs->aud_buf, v))
+		return 1; // LCOV_EXCL_LINE
+
+	cs->aud = l.v;
+	cs->n_aud = l.n;
+	cs->aud_cap = l.cap;
+
+	return 0;
+}
+
+static int view_eq(const struct jwt_json_view *v, const char *str)
+{
+	size_t len = strlen(str);
+
+	return v->len == len && !memcmp(v->str, str, len);
+}
+
+static int view_cmp(const void *a, const void *b)
+{
+	const struct jwt_json_view *x = a, *y = b;
+	int ret;
+
+	ret = memcmp(x->str, y->str, x->len < y->len ? x->len : y->len);
+	if (ret)
+		return ret;
+
+	return (x->len > y->len) - (x->len < y->len);
+}
+
+static void skip_ws(struct scan *s)
+{
+	while (s->p < s->end && (*s->p == ' ' || *s->p == '\t' ||
+				 *s->p == '\n' || *s->p == '\r'))
+		s->p++;
+}
+
+static int hex4(const char *p, unsigned int *out)
+{
+	unsigned int v = 0;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		char c = p[i];
+
+		v <<= 4;
+		if (c >= '0' && c <= '9')
+			v |= c - '0';
+		else if (c >= 'a' && c <= 'f')
+			v |= c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F')
+			v |= c - 'A' + 10;
+		else
+			return 1;
+	}
+
+	*out = v;
+
+	return 0;
+}
+
+static size_t put_utf8(char *w, unsigned int cp)
+{
+	if (cp < 0x80) {
+		w[0] = (char)cp;
+		return 1;
+	} else if (cp < 0x800) {
+		w[0] = (char)(0xc0 | (cp >> 6));
+		w[1] = (char)(0x80 | (cp & 0x3f));
+		return 2;
+	} else if (cp < 0x10000) {
+		w[0] = (char)(0xe0 | (cp >> 12));
+		w[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+		w[2] = (char)(0x80 | (cp & 0x3f));
+		return 3;
+	}
+
+	w[0] = (char)(0xf0 | (cp >> 18));
+	w[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+	w[2] = (char)(0x80 | ((cp >> 6) & 0x3f));
+	w[3] = (char)(0x80 | (cp & 0x3f));
+
+	return 4;
+}
+
+/* The length of the well-formed UTF-8 sequence at @u, or 0. Overlong forms,
+ * surrogates and anything past U+10FFFF are not well-formed. */
+static size_t utf8_len(const unsigned char *u, size_t avail)
+{
+	unsigned int cp;
+	size_t n, i;
+
+	if (u[0] >= 0xc2 && u[0] <= 0xdf) {
+		n = 2;
+		cp = u[0] & 0x1f;
+	} else if ((u[0] & 0xf0) == 0xe0) {
+		n = 3;
+		cp = u[0] & 0x0f;
+	} else if (u[0] >= 0xf0 && u[0] <= 0xf4) {
+		n = 4;
+		cp = u[0] & 0x07;
+	} else {
+		return 0;
+	}
+
+	if (n > avail)
+		return 0;
+
+	for (i = 1; i < n; i++) {
+		if ((u[i] & 0xc0) != 0x80)
+			return 0;
+		cp = (cp << 6) | (u[i] & 0x3f);
+	}
+
+	if ((n == 3 && cp < 0x800) || (n == 4 && cp < 0x10000) ||
+	    cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff))
+		return 0;
+
+	return n;
+}
+
+/* Decode one "\uXXXX", or a surrogate pair of them, at @r. Returns the
+ * octets consumed, or 0. */
+static size_t scan_uescape(const char *r, const char *end, unsigned int *cp)
+{
+	unsigned int lo;
+
+	if (end - r < 6 || hex4(r + 2, cp))
+		return 0;
+
+	if (*cp >= 0xdc00 && *cp <= 0xdfff)
+		return 0;
+
+	if (*cp >= 0xd800 && *cp <= 0xdbff) {
+		if (end - r < 12 || r[6] != '\\' || r[7] != 'u' ||
+		    hex4(r + 8, &lo) || lo < 0xdc00 || lo > 0xdfff)
+			return 0;
+
+		*cp = 0x10000 + ((*cp - 0xd800) << 10) + (lo - 0xdc00);
+
+		return 12;
+	}
+
+	/* Jansson refuses NUL in strings unless asked not to. */
+	return *cp ? 6 : 0;
+}
+
+/* The string at s->p (on its opening quote), unescaped in place. An escape
+ * is never shorter than what it decodes to, so writing never overtakes
+ * reading. */
+static int scan_string(struct scan *s, struct jwt_json_view *v)
+{
+	char *r = s->p + 1, *w, *end = s->end;
+	unsigned int cp;
+	size_t n;
+
+	/* The usual plain run, which needs no rewriting. */
+	while (r < end && *r != '"' && *r != '\\' &&
+	       (unsigned char)*r >= 0x20 && (unsigned char)*r < 0x80)
+		r++;
+
+	w = r;
+
+	while (r < end) {
+		unsigned char c = *r;
+
+		if (c == '"') {
+			v->str = s->p + 1;
+			v->len = w - v->str;
+			s->p = r + 1;
+			return 0;
+		}
+
+		if (c < 0x20)
+			return 1;
+
+		if (c >= 0x80) {
+			n = utf8_len((const unsigned char *)r, end - r);
+			if (n == 0)
+				return 1;
+			memmove(w, r, n);
+			w += n;
+			r += n;
+			continue;
+		}
+
+		if (c != '\\') {
+			*w++ = *r++;
+			continue;
+		}
+
+		if (end - r < 2)
+			return 1;
+
+		switch (r[1]) {
+		case '"':
+		case '\\':
+		case '/':
+			*w++ = r[1];
+			break;
+		case 'b':
+			*w++ = '\b';
+			break;
+		case 'f':
+			*w++ = '\f';
+			break;
+		case 'n':
+			*w++ = '\n';
+			break;
+		case 'r':
+			*w++ = '\r';
+			break;
+		case 't':
+			*w++ = '\t';
+			break;
+		case 'u':
+			n = scan_uescape(r, end, &cp);
+			if (n == 0)
+				return 1;
+			w += put_utf8(w, cp);
+			r += n;
+			continue;
+		default:
+			return 1;
+		}
+
+		r += 2;
+	}
+
+	return 1;
+}
+
+static int is_digit(const char *p, const char *end)
+{
+	return p < end && *p >= '0' && *p <= '9';
+}
+
+/* Would strtod() overflow on the real [@p, @end)? Jansson reports that as a
+ * parse error. The number is 0.DDD... x 10^@mag once its leading zeroes are
+ * gone; only a @mag of 309 can land either side of DBL_MAX, so only then is
+ * strtod() asked, on the digits rewritten as an integer and an exponent so
+ * the locale's decimal point never matters. */
+static int real_overflows(const char *p, const char *end)
+{
+	char digits[340];
+	long mag = 0, e = 0;
+	size_t n = 0;
+	int seen = 0, frac = 0, neg_e = 0;
+	double d;
+
+	if (*p == '-')
+		p++;
+
+	for (; p < end && *p != 'e' && *p != 'E'; p++) {
+		if (*p == '.') {
+			frac = 1;
+			continue;
+		}
+
+		if (!seen && *p == '0') {
+			if (frac)
+				mag--;
+			continue;
+		}
+
+		seen = 1;
+		if (!frac)
+			mag++;
+		if (n < sizeof(digits) - 16)
+			digits[n++] = *p;
+	}
+
+	if (!seen)
+		return 0;
+
+	if (p < end) {
+		p++;
+		if (*p == '-' || *p == '+')
+			neg_e = (*p++ == '-');
+		for (; p < end; p++)
+			if (e < 100000)
+				e = e * 10 + (*p - '0');
+		mag += neg_e ? -e : e;
+	}
+
+	if (mag != 309)
+		return mag > 309;
+
+	snprintf(digits + n, sizeof(digits) - n, "e%ld", 309 - (long)n);
+
+	errno = 0;
+	d = strtod(digits, NULL);
+
+	return errno == ERANGE && isinf(d);
+}
+
+static int scan_number(struct scan *s, struct scan_value *v)
+{
+	char *p = s->p, *end = s->end, *start = s->p, *digits;
+	unsigned long long mag = 0, limit;
+	int neg = 0, real = 0;
+
+	if (*p == '-') {
+		neg = 1;
+		p++;
+	}
+
+	if (!is_digit(p, end))
+		return 1;
+
+	digits = p;
+	if (*p == '0') {
+		p++;
+		if (is_digit(p, end))
+			return 1;
+	} else {
+		while (is_digit(p, end))
+			p++;
+	}
+
+	if (p < end && *p == '.') {
+		p++;
+		real = 1;
+		if (!is_digit(p, end))
+			return 1;
+		while (is_digit(p, end))
+			p++;
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		real = 1;
+		if (p < end && (*p == '-' || *p == '+'))
+			p++;
+		if (!is_digit(p, end))
+			return 1;
+		while (is_digit(p, end))
+			p++;
+	}
+
+	s->p = p;
+
+	if (real) {
+		v->type = SCAN_OTHER;
+		return real_overflows(start, p);
+	}
+
+	/* An integer must fit a json_int_t, as in Jansson. */
+	limit = neg ? (unsigned long long)INT64_MAX + 1 : INT64_MAX;
+	for (; digits < p; digits++) {
+		unsigned int d = *digits - '0';
+
+		if (mag > (limit - d) / 10)
+			return 1;
+		mag = mag * 10 + d;
+	}
+
+	v->type = SCAN_INT;
+	v->int_val = neg ? (long long)(0 - mag) : (long long)mag;
+
+	return 0;
+}
+
+static int scan_literal(struct scan *s, const char *lit)
+{
+	size_t len = strlen(lit);
+
+	if ((size_t)(s->end - s->p) < len || memcmp(s->p, lit, len))
+		return 1;
+
+	s->p += len;
+
+	return 0;
+}
+
+static int scan_value(struct scan *s, struct scan_value *v, int aud);
+
+/* The members of the object at s->p. Its names go on s->keys while it is
+ * open and are checked for duplicates once it closes. The top-level object's
+ * members are the claims. */
+static int scan_object(struct scan *s)
+{
+	struct jwt_claims_scan *cs = s->cs;
+	int top = (s->depth == 1);
+	size_t first = s->keys.n, i;
+	struct jwt_json_view key;
+	struct scan_value v;
+
+	s->p++;
+	skip_ws(s);
+
+	if (s->p < s->end && *s->p == '}') {
+		s->p++;
+		return 0;
+	}
+
+	for (;;) {
+		if (s->p >= s->end || *s->p != '"')
+			return 1;
+		if (scan_string(s, &key) ||
+		    view_list_add(&s->keys, s->keys_buf, &key))
+			return 1;
+
+		skip_ws(s);
+		if (s->p >= s->end || *s->p++ != ':')
+			return 1;
+
+		if (!top) {
+			if (scan_value(s, &v, 0))
+				return 1;
+		} else if (view_eq(&key, "exp") || view_eq(&key, "nbf")) {
+			int exp = (key.str[0] == 'e');
+
+			if (scan_value(s, &v, 0))
+				return 1;
+			cs->found |= exp ? JWT_CLAIM_EXP : JWT_CLAIM_NBF;
+			if (v.type == SCAN_INT) {
+				cs->typed |= exp ? JWT_CLAIM_EXP : JWT_CLAIM_NBF;
+				if (exp)
+					cs->exp = (jwt_long_t)v.int_val;
+				else
+					cs->nbf = (jwt_long_t)v.int_val;
+			}
+		} else if (view_eq(&key, "aud")) {
+			if (scan_value(s, &v, 1))
+				return 1;
+			cs->found |= JWT_CLAIM_AUD;
+			if (v.type == SCAN_STR && aud_add(cs, &v.str))
+				return 1; // LCOV_EXCL_LINE
+			if (v.type == SCAN_STR || v.type == SCAN_ARRAY)
+				cs->typed |= JWT_CLAIM_AUD;
+		} else {
+			jwt_claims_t claim = 0;
+
+			if (scan_value(s, &v, 0))
+				return 1;
+
+			if (view_eq(&key, "iss"))
+				claim = JWT_CLAIM_ISS;
+			else if (view_eq(&key, "sub"))
+				claim = JWT_CLAIM_SUB;
+			else if (view_eq(&key, "jti"))
+				claim = JWT_CLAIM_JTI;
+
+			cs->found |= claim;
+			if (claim && v.type == SCAN_STR) {
+				cs->typed |= claim;
+				if (claim == JWT_CLAIM_ISS)
+					cs->iss = v.str;
+				else if (claim == JWT_CLAIM_SUB)
+					cs->sub = v.str;
+				else
+					cs->jti = v.str;
+			}
+		}
+
+		if (top) {
+			for (i = 0; i < cs->n_names; i++)
+				if (view_eq(&key, cs->names[i]))
+					cs->names_found |= 1ULL << i;
+		}
+
+		skip_ws(s);
+		if (s->p >= s->end)
+			return 1;
+		if (*s->p == '}') {
+			s->p++;
+			break;
+		}
+		if (*s->p++ != ',')
+			return 1;
+		skip_ws(s);
+	}
+
+	/* @rfc{8725,2.4} No name twice. A few names are compared pairwise;
+	 * more are sorted, putting a repeated name next to itself. */
+	if (s->keys.n - first <= SCAN_PAIRWISE_KEYS) {
+		size_t j;
+
+		for (i = first + 1; i < s->keys.n; i++)
+			for (j = first; j < i; j++)
+				if (!view_cmp(&s->keys.v[j], &s->keys.v[i]))
+					return 1;
+	} else {
+		qsort(s->keys.v + first, s->keys.n - first, sizeof(key),
+		      view_cmp);
+		for (i = first + 1; i < s->keys.n; i++)
+			if (!view_cmp(&s->keys.v[i - 1], &s->keys.v[i]))
+				return 1;
+	}
+	s->keys.n = first;
+
+	return 0;
+}
+
+/* The elements of the array at s->p. With @aud, the string elements are
+ * the audiences. */
+static int scan_array(struct scan *s, int aud)
+{
+	struct jwt_claims_scan *cs = s->cs;
+	struct scan_value v;
+
+	s->p++;
+	skip_ws(s);
+
+	if (s->p < s->end && *s->p == ']') {
+		s->p++;
+		return 0;
+	}
+
+	for (;;) {
+		if (scan_value(s, &v, 0))
+			return 1;
+
+		if (aud && v.type == SCAN_STR && aud_add(cs, &v.str))
+			return 1; // LCOV_EXCL_LINE
+
+		skip_ws(s);
+		if (s->p >= s->end)
+			return 1;
+		if (*s->p == ']') {
+			s->p++;
+			return 0;
+		}
+		if (*s->p++ != ',')
+			return 1;
+	}
+}
+
+/* Like Jansson, every value counts towards the depth, scalars included. */
+static int scan_value(struct scan *s, struct scan_value *v, int aud)
+{
+	int ret;
+
+	skip_ws(s);
+	if (s->p >= s->end || ++s->depth > SCAN_MAX_DEPTH)
+		return 1;
+
+	v->type = SCAN_OTHER;
+
+	switch (*s->p) {
+	case '{':
+		ret = scan_object(s);
+		break;
+
+	case '[':
+		v->type = SCAN_ARRAY;
+		ret = scan_array(s, aud);
+		break;
+
+	case '"':
+		v->type = SCAN_STR;
+		ret = scan_string(s, &v->str);
+		break;
+
+	case 't':
+		ret = scan_literal(s, "true");
+		break;
+
+	case 'f':
+		ret = scan_literal(s, "false");
+		break;
+
+	case 'n':
+		ret = scan_literal(s, "null");
+		break;
+
+	default:
+		ret = scan_number(s, v);
+	}
+
+	s->depth--;
+
+	return ret;
+}
+
+int jwt_claims_scan(struct jwt_claims_scan *cs, char *buf, size_t len,
+		    char * const *names, size_t n_names)
+{
+	struct scan s;
+	struct scan_value v;
+	int ret;
+
+	memset(cs, 0, sizeof(*cs));
+	cs->aud = cs->aud_buf;
+	cs->aud_cap = ARRAY_SIZE(cs->aud_buf);
+	cs->names = names;
+	cs->n_names = n_names;
+
+	if (n_names > JWT_CLAIMS_SCAN_NAMES)
+		return 1; // LCOV_EXCL_LINE
+
+	memset(&s, 0, sizeof(s));
+	s.p = buf;
+	s.end = buf + len;
+	s.cs = cs;
+	s.keys.v = s.keys_buf;
+	s.keys.cap = ARRAY_SIZE(s.keys_buf);
+
+	/* As Jansson without JSON_DECODE_ANY: an object or an array, and
+	 * nothing but whitespace after it. */
+	skip_ws(&s);
+	if (s.p >= s.end || (*s.p != '{' && *s.p != '['))
+		ret = 1;
+	else
+		ret = scan_value(&s, &v, 0);
+
+	if (!ret) {
+		skip_ws(&s);
+		ret = s.p != s.end;
+	}
+
+	if (s.keys.v != s.keys_buf)
+		jwt_freemem(s.keys.v);
+
+	return ret;
+}
+
+void jwt_claims_scan_free(struct jwt_claims_scan *cs)
+{
+	if (cs->aud != cs->aud_buf)
+		jwt_freemem(cs->aud);
+	cs->aud = cs->aud_buf;
+	cs->n_aud = 0;
+}
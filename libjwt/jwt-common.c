@@ -71,6 +71,8 @@ void FUNC(free)(jwt_common_t *__cmd)
 	jwt_freemem(__cmd->c.embedded_jkt);
 	if (__cmd->c.embedded_owned != NULL)
 		jwks_free(__cmd->c.embedded_owned);
+	jwt_verify_cache_free(__cmd->c.cache);
+	JWT_STATS_FREE(__cmd->c.stats);
 
 	memset(__cmd, 0, sizeof(*__cmd));
 
@@ -97,11 +99,13 @@ jwt_common_t *FUNC(new)(void)
 	__cmd->c.headers = jwt_json_create();
 	__cmd->c.claims = CLAIMS_DEF;
 
-	if (!__cmd->c.payload || !__cmd->c.headers) {
+	if (!__cmd->c.payload || !__cmd->c.headers ||
+	    JWT_STATS_NEW(__cmd->c.stats)) {
 		// LCOV_EXCL_START
 		jwt_json_release(__cmd->c.payload);
 		jwt_json_release(__cmd->c.headers);
 		jwt_freemem(__cmd);
+		return NULL;
 		// LCOV_EXCL_STOP
 	}
 
@@ -206,7 +210,7 @@ const char *FUNC(error_msg)(const jwt_common_t *__cmd)
 	if (__cmd == NULL)
 		return NULL;
 
-	return __cmd->error_msg;
+	return jwt_error_msg(__cmd);
 }
 
 void FUNC(error_clear)(jwt_common_t *__cmd)
@@ -214,10 +218,27 @@ void FUNC(error_clear)(jwt_common_t *__cmd)
 	if (__cmd == NULL)
 		return;
 
-	__cmd->error = 0;
-	__cmd->error_msg[0] = '\0';
+	jwt_clear_error(__cmd);
+}
+
+#ifdef JWT_CHECKER
+jwt_error_t FUNC(error_code)(const jwt_common_t *__cmd)
+{
+	if (__cmd == NULL)
+		return JWT_ERR_OTHER;
+
+	return jwt_error_code(__cmd);
 }
 
+jwt_claims_t FUNC(error_claims)(const jwt_common_t *__cmd)
+{
+	if (__cmd == NULL)
+		return 0;
+
+	return __cmd->error ? __cmd->error_claims : 0;
+}
+#endif
+
 #ifdef JWT_BUILDER
 int FUNC(enable_iat)(jwt_common_t *__cmd, int enable)
 {
@@ -267,6 +288,42 @@ void *FUNC(getctx)(jwt_common_t *__cmd)
 	return __cmd->c.cb_ctx;
 }
 
+int FUNC(setarena)(jwt_common_t *__cmd, size_t size)
+{
+	if (__cmd == NULL)
+		return 1;
+
+	/* Route the JSON backend through jwt_malloc() too, as jwt_set_alloc()
+	 * does, so its nodes can come from the arena. */
+	if (size)
+		jwt_json_set_alloc(jwt_malloc, __jwt_freemem);
+
+	__cmd->c.arena = size;
+
+	return 0;
+}
+
+int FUNC(stats)(const jwt_common_t *__cmd, jwt_stats_t *stats)
+{
+	if (__cmd == NULL || stats == NULL)
+		return 1;
+
+	return JWT_STATS_READ(__cmd->c.stats, stats);
+}
+
+/* @rfc{7515,7.2} Spread the signatures of a JWS JSON Serialization over up to
+ * @threads threads, counting the caller's. 0 keeps them all on the calling
+ * thread, one after the other, as before. */
+int FUNC(setthreads)(jwt_common_t *__cmd, unsigned int threads)
+{
+	if (__cmd == NULL)
+		return 1;
+
+	__cmd->c.sig_threads = threads;
+
+	return 0;
+}
+
 /* @rfc{7519,4.1.7} Register the jti (JWT ID) callback. The builder variant
  * takes a generator (produces an id); the checker variant takes a verifier
  * (validates/consumes one). jti is driven entirely by the callback pointer
@@ -557,63 +614,142 @@ int FUNC(time_leeway)(jwt_common_t *__cmd, jwt_claims_t claim, time_t secs)
 }
 
 #ifdef JWT_CHECKER
+/* Drop the per-verify state left by a previous verify: the signature list
+ * and any confirmed embedded key. */
+static void __verify_reset(jwt_common_t *__cmd)
+{
+	struct jwt_signature *s, *tmp;
+
+	list_for_each_entry_safe(s, tmp, &__cmd->c.signatures, node) {
+		list_del(&s->node);
+		jwt_signature_free(s);
+	}
+	__cmd->c.n_signatures = 0;
+	__cmd->c.last_sig_count = 0;
+
+	/* @rfc{7515,4.1.3} Drop a confirmed embedded key from a prior verify
+	 * before it can be borrowed by this one. */
+	if (__cmd->c.embedded_owned != NULL) {
+		jwks_free(__cmd->c.embedded_owned);
+		__cmd->c.embedded_owned = NULL;
+	}
+}
+
 int FUNC(verify)(jwt_common_t *__cmd, const char *token)
 {
-	JWT_CONFIG_DECLARE(config);
-	unsigned int payload_len;
-	jwt_auto_t *jwt = NULL;
+	size_t max;
 
 	if (__cmd == NULL)
 		return 1;
 
-	if (token == NULL || !strlen(token)) {
+	if (token == NULL) {
 		jwt_write_error(__cmd, "Must pass a token");
 		return 1;
 	}
 
-	/* Clear any signature state from a prior verify (checker reuse). */
-	{
-		struct jwt_signature *s, *tmp;
+	/* Never look further than one octet past the longest token allowed. */
+	max = __cmd->c.limits.max_token_len;
 
-		list_for_each_entry_safe(s, tmp, &__cmd->c.signatures, node) {
-			list_del(&s->node);
-			jwt_signature_free(s);
-		}
-		__cmd->c.n_signatures = 0;
-		__cmd->c.last_sig_count = 0;
-
-		/* @rfc{7515,4.1.3} Drop a confirmed embedded key from a prior
-		 * verify before it can be borrowed by this one. */
-		if (__cmd->c.embedded_owned != NULL) {
-			jwks_free(__cmd->c.embedded_owned);
-			__cmd->c.embedded_owned = NULL;
-		}
+	return FUNC(verify_n)(__cmd, token, max && max + 1 ?
+			      strnlen(token, max + 1) : strlen(token));
+}
+
+/* Decode the claims @jwt_parse_header() left, from the arena if there is
+ * one. */
+static int __verify_decode_claims(jwt_common_t *__cmd, jwt_t *jwt)
+{
+	int arena = 0, ret;
+	JWT_STAGE_BEGIN(t);
+
+	if (__cmd->c.arena)
+		arena = jwt_arena_set(1);
+	ret = jwt_parse_claims(jwt);
+	jwt_arena_set(arena);
+	JWT_STAGE_END(JWT_STAGE_PARSE, t, ret);
+
+	if (ret)
+		jwt_copy_error(__cmd, jwt);
+
+	return ret;
+}
+
+static int __verify_n(jwt_common_t *__cmd, const char *token, size_t len)
+{
+	JWT_CONFIG_DECLARE(config);
+	unsigned int payload_len;
+	jwt_auto_t *jwt = NULL;
+	int arena = 0, ret;
+
+	if (token == NULL || !len) {
+		jwt_write_error(__cmd, "Must pass a token");
+		return 1;
 	}
 
+	/* The signing input length is carried as an unsigned int below. */
+	if (len > UINT_MAX) {
+		jwt_set_error(__cmd, JWT_ERR_MALFORMED, "Token too large");
+		return 1;
+	}
+
+	/* Before anything is allocated for it. */
+	if (__cmd->c.limits.max_token_len && len > __cmd->c.limits.max_token_len) {
+		jwt_set_error(__cmd, JWT_ERR_LIMIT,
+			      "Token exceeds an input limit");
+		return 1;
+	}
+
+	/* Clear any signature state from a prior verify (checker reuse). */
+	__verify_reset(__cmd);
+
 	/* @rfc{7515,7.2} A token whose first non-whitespace byte is '{' is a
 	 * JWS JSON Serialization; otherwise it is the Compact form. */
 	{
-		const char *p = token;
+		const char *p = token, *end = token + len;
 
-		while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' ||
+				   *p == '\r'))
 			p++;
-		if (*p == '{')
-			return jwt_verify_json(__cmd, token);
+		if (p < end && *p == '{')
+			return jwt_verify_json(__cmd, token, len);
 	}
 
+	/* Decode the jwt_t and its JSON from the arena, if there is one. */
+	if (__cmd->c.arena)
+		arena = jwt_arena_set(1);
+
 	jwt = jwt_new();
 	if (jwt == NULL) {
 		// LCOV_EXCL_START
+		jwt_arena_set(arena);
 		jwt_write_error(__cmd, "Could not allocate JWT object");
 		return 1;
 		// LCOV_EXCL_STOP
 	}
 
-	/* First parsing pass, error will be set for us */
-        if (jwt_parse(jwt, token, &payload_len)) {
+	jwt->limits = &__cmd->c.limits;
+
+	/* First parsing pass: the header only, error will be set for us */
+	{
+		JWT_STAGE_BEGIN(t);
+		JWT_PROBE1(parse_start, len);
+		ret = jwt_parse_header(jwt, token, len, &payload_len);
+		JWT_PROBE3(parse_done, len, jwt->alg, ret);
+		JWT_STAGE_END(JWT_STAGE_PARSE, t, ret);
+	}
+	jwt_arena_set(arena);
+	if (ret) {
 		jwt_copy_error(__cmd, jwt);
 		return 1;
-	};
+	}
+
+	jwt->checker = __cmd;
+
+	/* Everything up to jwt_verify_bind() looks only at the header, so
+	 * most rejected tokens never have their payload decoded. */
+	if (jwt_verify_policy(jwt)) {
+		jwt_copy_error(__cmd, jwt);
+		return 1;
+	}
 
 	config.key = __cmd->c.key;
 	config.alg = __cmd->c.alg;
@@ -626,11 +762,13 @@ int FUNC(verify)(jwt_common_t *__cmd, const char *token)
 	 * or at checker free) so jwt_checker_sig_key() can borrow the key. */
 	if (__cmd->c.embedded_jwk) {
 		const jwk_item_t *ek = NULL;
+		JWT_STAGE_BEGIN(t);
 
 		__cmd->c.embedded_owned =
 			jwt_embedded_jwk_key(&__cmd->c, jwt->headers, &ek);
+		JWT_STAGE_END(JWT_STAGE_KEY, t, ek == NULL);
 		if (ek == NULL) {
-			jwt_write_error(__cmd,
+			jwt_set_error(__cmd, JWT_ERR_KID_UNKNOWN,
 				"Embedded JWK is missing or not confirmed");
 			return 1;
 		}
@@ -638,10 +776,16 @@ int FUNC(verify)(jwt_common_t *__cmd, const char *token)
 		config.alg = jwt->alg;
 	}
 
-	/* Let the user handle this and update config */
-        if (__cmd->c.cb && __cmd->c.cb(jwt, &config)) {
-		jwt_write_error(__cmd, "User callback returned error");
-		return 1;
+	/* Let the user handle this and update config. The callback may look
+	 * at the claims, so they are decoded for it. */
+	if (__cmd->c.cb) {
+		if (__verify_decode_claims(__cmd, jwt))
+			return 1;
+
+		if (__cmd->c.cb(jwt, &config)) {
+			jwt_write_error(__cmd, "User callback returned error");
+			return 1;
+		}
 	}
 
 	/* @rfc{7515,4.1.11} Enforce the "crit" header. Done after the
@@ -657,10 +801,27 @@ int FUNC(verify)(jwt_common_t *__cmd, const char *token)
 		return 1;
 
 	jwt->key = config.key;
-	jwt->checker = __cmd;
+
+	{
+		JWT_STAGE_BEGIN(t);
+		ret = jwt_verify_bind(jwt, &config, len - (payload_len + 1));
+		JWT_STAGE_END(JWT_STAGE_KEY, t, ret);
+	}
+	if (ret) {
+		jwt_copy_error(__cmd, jwt);
+		return 1;
+	}
+
+	/* Only now is the payload worth decoding. The jti callback is handed
+	 * the jwt_t, so it needs the claims built; otherwise (and unless the
+	 * callback above already built them) jwt_verify_complete() checks them
+	 * from a scan of the payload and the tree is never made. */
+	if ((__cmd->c.jti_check || __cmd->c.n_require > JWT_CLAIMS_SCAN_NAMES) &&
+	    __verify_decode_claims(__cmd, jwt))
+		return 1;
 
 	/* Finish it up */
-	jwt = jwt_verify_complete(jwt, &config, token, payload_len);
+	jwt = jwt_verify_complete(jwt, &config, token, len, payload_len);
 
 	/* Copy any errors back */
 	jwt_copy_error(__cmd, jwt);
@@ -681,6 +842,50 @@ int FUNC(verify)(jwt_common_t *__cmd, const char *token)
 	return __cmd->error;
 }
 
+int FUNC(verify_n)(jwt_common_t *__cmd, const char *token, size_t len)
+{
+	const jwk_set_t *ring;
+	int ret;
+
+	if (__cmd == NULL)
+		return 1;
+
+	JWT_STATS_ENTER(__cmd->c.stats);
+
+	/* A keyring refreshed in the background keeps its keys until the
+	 * verify, and any callback, is done with them. */
+	ring = __cmd->c.keyring;
+	jwks_read_lock(ring);
+
+	if (!__cmd->c.arena || jwt_arena_enter(__cmd->c.arena)) {
+		ret = __verify_n(__cmd, token, len);
+	} else {
+		/* The jwt_t is freed on the way out of __verify_n(), before
+		 * the arena is reset. */
+		ret = __verify_n(__cmd, token, len);
+		jwt_arena_leave();
+	}
+
+	jwks_read_unlock(ring);
+
+	JWT_STATS_LEAVE(ret);
+
+	return ret;
+}
+
+int jwt_checker_setlimits(jwt_checker_t *checker, const jwt_limits_t *limits)
+{
+	if (checker == NULL)
+		return 1;
+
+	if (limits == NULL)
+		memset(&checker->c.limits, 0, sizeof(checker->c.limits));
+	else
+		checker->c.limits = *limits;
+
+	return 0;
+}
+
 int jwt_checker_setkeyring(jwt_checker_t *checker, const jwk_set_t *keyring,
 			   jwt_verify_policy_t policy)
 {
@@ -814,6 +1019,44 @@ int jwt_checker_require(jwt_checker_t *checker, const char **claims,
 	return 0;
 }
 
+int jwt_checker_cache(jwt_checker_t *checker, unsigned int entries, time_t ttl)
+{
+	struct jwt_verify_cache *cache = NULL;
+
+	if (checker == NULL)
+		return 1;
+
+	if (ttl < 0) {
+		jwt_write_error(checker, "Invalid cache TTL");
+		return 1;
+	}
+
+	if (entries) {
+		cache = jwt_verify_cache_new(entries, ttl);
+		if (cache == NULL) {
+			jwt_write_error(checker, "Error allocating memory"); // LCOV_EXCL_LINE
+			return 1; // LCOV_EXCL_LINE
+		}
+	}
+
+	/* Replacing the cache also drops everything it held. */
+	jwt_verify_cache_free(checker->c.cache);
+	checker->c.cache = cache;
+
+	return 0;
+}
+
+int jwt_checker_cache_stats(const jwt_checker_t *checker, unsigned long *hits,
+			    unsigned long *misses, unsigned int *entries)
+{
+	if (checker == NULL || checker->c.cache == NULL)
+		return 1;
+
+	jwt_verify_cache_stats(checker->c.cache, hits, misses, entries);
+
+	return 0;
+}
+
 /* Reject an out-of-range thumbprint selector at configure time (jwks_item_thumbprint
  * also rejects it later, but failing here gives a clearer error). */
 static int thumbprint_alg_ok(jwt_checker_t *checker, jwk_thumbprint_alg_t alg)
@@ -931,6 +1174,294 @@ const jwk_item_t *jwt_checker_sig_key(const jwt_checker_t *checker,
 
 	return (s != NULL && s->verified) ? s->key : NULL;
 }
+
+jwt_checker_shared_t *jwt_checker_freeze(jwt_checker_t *checker)
+{
+	jwt_checker_shared_t *shared;
+
+	if (checker == NULL)
+		return NULL;
+
+	shared = jwt_malloc(sizeof(*shared));
+	if (shared == NULL) {
+		jwt_write_error(checker, "Error allocating memory"); // LCOV_EXCL_LINE
+		return NULL; // LCOV_EXCL_LINE
+	}
+
+	/* Nothing from a verify run before the freeze is carried into the
+	 * shared configuration. */
+	__verify_reset(checker);
+	FUNC(error_clear)(checker);
+
+	shared->checker = checker;
+	shared->refs = 1;
+
+	return shared;
+}
+
+jwt_checker_shared_t *jwt_checker_shared_ref(jwt_checker_shared_t *shared)
+{
+	if (shared == NULL)
+		return NULL;
+
+	__atomic_add_fetch(&shared->refs, 1, __ATOMIC_RELAXED);
+
+	return shared;
+}
+
+void jwt_checker_shared_unref(jwt_checker_shared_t *shared)
+{
+	if (shared == NULL)
+		return;
+
+	if (__atomic_sub_fetch(&shared->refs, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+
+	jwt_checker_free(shared->checker);
+	jwt_freemem(shared);
+}
+
+/* Borrow @src's configuration into @view for a verify. The members a verify
+ * writes are then pointed back at the view's own. */
+static void __view_borrow(jwt_checker_t *view, const jwt_checker_t *src)
+{
+	view->c = src->c;
+	INIT_LIST_HEAD(&view->c.signatures);
+	view->c.n_signatures = 0;
+	view->c.last_sig_count = 0;
+	view->c.embedded_owned = NULL;
+}
+
+jwt_verify_ctx_t *jwt_verify_ctx_new(void)
+{
+	jwt_verify_ctx_t *ctx = jwt_malloc(sizeof(*ctx));
+
+	if (ctx == NULL)
+		return NULL; // LCOV_EXCL_LINE
+
+	memset(ctx, 0, sizeof(*ctx));
+	INIT_LIST_HEAD(&ctx->view.c.signatures);
+
+	return ctx;
+}
+
+void jwt_verify_ctx_free(jwt_verify_ctx_t *ctx)
+{
+	if (ctx == NULL)
+		return;
+
+	/* Everything else in the view is borrowed from a shared checker. */
+	__verify_reset(&ctx->view);
+
+	memset(ctx, 0, sizeof(*ctx));
+
+	jwt_freemem(ctx);
+}
+
+int jwt_checker_shared_verify(const jwt_checker_shared_t *shared,
+			      jwt_verify_ctx_t *ctx, const char *token,
+			      size_t len)
+{
+	jwt_checker_t *view;
+
+	if (ctx == NULL)
+		return 1;
+
+	view = &ctx->view;
+
+	__verify_reset(view);
+	FUNC(error_clear)(view);
+
+	if (shared == NULL) {
+		jwt_write_error(view, "Must pass a shared checker");
+		return 1;
+	}
+
+	__view_borrow(view, shared->checker);
+
+	return FUNC(verify_n)(view, token, len);
+}
+
+int jwt_verify_ctx_error(const jwt_verify_ctx_t *ctx)
+{
+	if (ctx == NULL)
+		return 1;
+
+	return FUNC(error)(&ctx->view);
+}
+
+const char *jwt_verify_ctx_error_msg(const jwt_verify_ctx_t *ctx)
+{
+	if (ctx == NULL)
+		return NULL;
+
+	return FUNC(error_msg)(&ctx->view);
+}
+
+jwt_error_t jwt_verify_ctx_error_code(const jwt_verify_ctx_t *ctx)
+{
+	if (ctx == NULL)
+		return JWT_ERR_OTHER;
+
+	return FUNC(error_code)(&ctx->view);
+}
+
+jwt_claims_t jwt_verify_ctx_error_claims(const jwt_verify_ctx_t *ctx)
+{
+	if (ctx == NULL)
+		return 0;
+
+	return FUNC(error_claims)(&ctx->view);
+}
+
+unsigned int jwt_verify_ctx_sig_count(const jwt_verify_ctx_t *ctx)
+{
+	if (ctx == NULL)
+		return 0;
+
+	return jwt_checker_sig_count(&ctx->view);
+}
+
+int jwt_verify_ctx_sig_verified(const jwt_verify_ctx_t *ctx,
+				unsigned int index)
+{
+	if (ctx == NULL)
+		return 0;
+
+	return jwt_checker_sig_verified(&ctx->view, index);
+}
+
+const jwk_item_t *jwt_verify_ctx_sig_key(const jwt_verify_ctx_t *ctx,
+					 unsigned int index)
+{
+	if (ctx == NULL)
+		return NULL;
+
+	return jwt_checker_sig_key(&ctx->view, index);
+}
+
+/* Tokens are handed to the workers this many at a time. */
+#define BATCH_CHUNK	16
+
+struct batch_job {
+	const jwt_checker_t *checker;
+	const char *const *tokens;
+	const size_t *lens;
+	jwt_verify_result_t *results;
+	size_t n;
+	size_t next;		/* Next unclaimed index			*/
+	size_t failed;
+};
+
+static void *batch_worker(void *arg)
+{
+	struct batch_job *job = arg;
+	jwt_checker_t view;
+	size_t failed = 0;
+
+	/* Borrow once; each verify resets only its own signature state. */
+	memset(&view, 0, sizeof(view));
+	__view_borrow(&view, job->checker);
+
+	for (;;) {
+		size_t pos, end;
+
+		pos = __atomic_fetch_add(&job->next, BATCH_CHUNK,
+					 __ATOMIC_RELAXED);
+		if (pos >= job->n)
+			break;
+		end = pos + BATCH_CHUNK < job->n ? pos + BATCH_CHUNK : job->n;
+
+		for (; pos < end; pos++) {
+			jwt_verify_result_t *r = &job->results[pos];
+			const char *token = job->tokens[pos];
+
+			FUNC(error_clear)(&view);
+
+			if (token == NULL)
+				jwt_write_error(&view, "Must pass a token");
+			else
+				FUNC(verify_n)(&view, token, job->lens ?
+					       job->lens[pos] : strlen(token));
+
+			r->error = view.error;
+			r->code = FUNC(error_code)(&view);
+			r->claims = FUNC(error_claims)(&view);
+			if (view.error_str != NULL) {
+				r->error_msg = view.error_str;
+			} else if (view.error) {
+				memcpy(r->error_buf, view.error_msg,
+				       strlen(view.error_msg) + 1);
+				r->error_msg = r->error_buf;
+			} else {
+				r->error_msg = "";
+			}
+			if (r->error)
+				failed++;
+		}
+	}
+
+	__verify_reset(&view);
+
+	__atomic_add_fetch(&job->failed, failed, __ATOMIC_RELAXED);
+
+	return NULL;
+}
+
+int jwt_checker_verify_batch(jwt_checker_t *checker, const char *const *tokens,
+			     const size_t *lens, size_t n,
+			     jwt_verify_result_t *results, unsigned int threads)
+{
+	struct batch_job job;
+	pthread_t *tids = NULL;
+	unsigned int t, started = 0;
+
+	if (checker == NULL)
+		return 1;
+
+	if (n == 0)
+		return 0;
+
+	if (tokens == NULL || results == NULL) {
+		jwt_write_error(checker, "Must pass tokens and results");
+		return 1;
+	}
+
+	memset(&job, 0, sizeof(job));
+	job.checker = checker;
+	job.tokens = tokens;
+	job.lens = lens;
+	job.results = results;
+	job.n = n;
+
+	/* The calling thread is one of the workers. */
+	if (threads > 1 && n > BATCH_CHUNK) {
+		size_t want = (n + BATCH_CHUNK - 1) / BATCH_CHUNK;
+
+		if (threads > want)
+			threads = want;
+		tids = jwt_malloc((threads - 1) * sizeof(*tids));
+	}
+
+	/* Any thread that cannot be started just leaves more to the rest. */
+	if (tids != NULL) {
+		for (t = 0; t < threads - 1; t++) {
+			if (pthread_create(&tids[started], NULL, batch_worker,
+					   &job))
+				break; // LCOV_EXCL_LINE
+			started++;
+		}
+	}
+
+	batch_worker(&job);
+
+	for (t = 0; t < started; t++)
+		pthread_join(tids[t], NULL);
+
+	jwt_freemem(tids);
+
+	return job.failed != 0;
+}
 #endif
 
 #ifdef JWT_BUILDER
@@ -1051,20 +1582,27 @@ jwt_signature_t *jwt_builder_add_signature(jwt_builder_t *builder,
 	return s;
 }
 
-char *FUNC(generate)(jwt_common_t *__cmd)
+static char *__generate(jwt_common_t *__cmd)
 {
 	JWT_CONFIG_DECLARE(config);
 	jwt_auto_t *jwt = NULL;
 	char *out = NULL;
 	jwt_value_t jval;
 	time_t tm = time(NULL);
+	int arena = 0;
 
-	if (__cmd == NULL)
-		return NULL;
+	/* Build the jwt_t and its JSON from the arena, if there is one. The
+	 * callbacks, signing and the output are all outside it. */
+	if (__cmd->c.arena)
+		arena = jwt_arena_set(1);
 
 	jwt = jwt_malloc(sizeof(*jwt));
-	if (jwt == NULL)
-		return NULL; // LCOV_EXCL_LINE
+	if (jwt == NULL) {
+		// LCOV_EXCL_START
+		jwt_arena_set(arena);
+		return NULL;
+		// LCOV_EXCL_STOP
+	}
 
 	memset(jwt, 0, sizeof(*jwt));
 
@@ -1090,6 +1628,8 @@ char *FUNC(generate)(jwt_common_t *__cmd)
 		jwt_claim_set(jwt, &jval);
 	}
 
+	jwt_arena_set(arena);
+
 	/* @rfc{7519,4.1.7} Let the application generate the jti. Done before
 	 * the generic callback so the callback can still inspect or override
 	 * it. The returned string is set as "jti" and then freed. */
@@ -1203,4 +1743,28 @@ char *FUNC(generate)(jwt_common_t *__cmd)
 
 	return out;
 }
+
+char *FUNC(generate)(jwt_common_t *__cmd)
+{
+	char *out;
+
+	if (__cmd == NULL)
+		return NULL;
+
+	JWT_STATS_ENTER(__cmd->c.stats);
+	JWT_PROBE2(generate_start, __cmd->c.alg, JWT_PROBE_KID(__cmd->c.key));
+
+	if (!__cmd->c.arena || jwt_arena_enter(__cmd->c.arena)) {
+		out = __generate(__cmd);
+	} else {
+		out = __generate(__cmd);
+		jwt_arena_leave();
+	}
+
+	JWT_PROBE3(generate_done, __cmd->c.alg, JWT_PROBE_KID(__cmd->c.key),
+		   out == NULL);
+	JWT_STATS_LEAVE(out == NULL);
+
+	return out;
+}
 #endif
@@ -113,6 +113,18 @@ int jwt_crypto_ops_supports_jwk(void)
 	return jwt_ops->jwk_implemented ? 1 : 0;
 }
 
+int jwt_set_crypto_openssl_libctx(void *libctx, const char *propq)
+{
+#ifdef HAVE_OPENSSL
+	return openssl_set_libctx(libctx, propq);
+#else
+	(void)libctx;
+	(void)propq;
+
+	return 1;
+#endif
+}
+
 JWT_CONSTRUCTOR
 void jwt_init()
 {
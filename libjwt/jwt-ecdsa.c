@@ -0,0 +1,172 @@
+/* Copyright (C) 2026 maClara, LLC <info@maclara-llc.com>
+   This file is part of the JWT C Library
+
+   SPDX-License-Identifier:  MPL-2.0
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0. If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/* ECDSA signature encodings.
+ *
+ * @rfc{7518,3.4} puts an ECDSA signature in a JWS as the fixed-width
+ * concatenation R || S, each left-padded to the octet length of the curve
+ * order. Crypto libraries speak the X9.62 DER form instead:
+ *
+ *     ECDSA-Sig-Value ::= SEQUENCE { r INTEGER, s INTEGER }
+ *
+ * Both directions are plain byte shuffling, so they are done here into the
+ * caller's buffers, with no BIGNUMs and no allocation, for every backend.
+ * Decoding is strict DER: definite minimal lengths, minimal non-negative
+ * INTEGERs, and nothing after the SEQUENCE. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <jwt.h>
+
+#include "jwt-private.h"
+
+/* Write a DER length, returning the octets used. Our lengths are < 256. */
+static size_t der_put_len(unsigned char *p, size_t len)
+{
+	if (len < 0x80) {
+		p[0] = (unsigned char)len;
+		return 1;
+	}
+
+	p[0] = 0x81;
+	p[1] = (unsigned char)len;
+
+	return 2;
+}
+
+/* The DER INTEGER body for the @n-octet big-endian @v: leading zeroes
+ * dropped, and a zero octet added back if the top bit is set. */
+static size_t int_body(const unsigned char *v, size_t n, size_t *skip)
+{
+	size_t i = 0;
+
+	while (i < n - 1 && v[i] == 0)
+		i++;
+
+	*skip = i;
+
+	return (n - i) + ((v[i] & 0x80) ? 1 : 0);
+}
+
+static size_t der_put_int(unsigned char *p, const unsigned char *v, size_t n)
+{
+	size_t skip, body, pos = 0;
+
+	body = int_body(v, n, &skip);
+
+	p[pos++] = 0x02;
+	pos += der_put_len(p + pos, body);
+	if (body > n - skip)
+		p[pos++] = 0x00;
+	memcpy(p + pos, v + skip, n - skip);
+
+	return pos + n - skip;
+}
+
+int jwt_ecdsa_raw2der(const unsigned char *raw, size_t raw_len,
+		      unsigned char *der, size_t der_size)
+{
+	size_t n = raw_len / 2, skip, r_len, s_len, seq, pos = 0;
+
+	if (raw_len == 0 || (raw_len & 1) || n > JWT_ECDSA_FIELD_MAX)
+		return -1;
+
+	/* Tag + one-octet length on each INTEGER, since n + 1 < 0x80. */
+	r_len = 2 + int_body(raw, n, &skip);
+	s_len = 2 + int_body(raw + n, n, &skip);
+	seq = r_len + s_len;
+
+	if (der_size < seq + (seq < 0x80 ? 2 : 3))
+		return -1; // LCOV_EXCL_LINE
+
+	der[pos++] = 0x30;
+	pos += der_put_len(der + pos, seq);
+	pos += der_put_int(der + pos, raw, n);
+	pos += der_put_int(der + pos, raw + n, n);
+
+	return (int)pos;
+}
+
+/* Read a DER length at *@p (before @end), short or 0x81 form, minimal. */
+static int der_get_len(const unsigned char **p, const unsigned char *end,
+		       size_t *len)
+{
+	if (*p >= end)
+		return 1;
+
+	if (**p < 0x80) {
+		*len = *(*p)++;
+		return 0;
+	}
+
+	/* Only the one-octet long form fits our sizes, and it must be
+	 * needed: DER forbids 0x81 for lengths under 0x80. */
+	if (**p != 0x81 || end - *p < 2 || (*p)[1] < 0x80)
+		return 1;
+
+	*len = (*p)[1];
+	*p += 2;
+
+	return 0;
+}
+
+/* Read one INTEGER into the @n-octet, left-padded @out. */
+static int der_get_int(const unsigned char **p, const unsigned char *end,
+		       unsigned char *out, size_t n)
+{
+	const unsigned char *v;
+	size_t len;
+
+	if (*p >= end || *(*p)++ != 0x02)
+		return 1;
+	if (der_get_len(p, end, &len) || len == 0 || len > (size_t)(end - *p))
+		return 1;
+
+	v = *p;
+	*p += len;
+
+	/* Non-negative, and no redundant leading zero. */
+	if (v[0] & 0x80)
+		return 1;
+	if (len > 1 && v[0] == 0x00 && !(v[1] & 0x80))
+		return 1;
+
+	if (v[0] == 0x00 && len > 1) {
+		v++;
+		len--;
+	}
+
+	if (len > n)
+		return 1;
+
+	memset(out, 0, n - len);
+	memcpy(out + (n - len), v, len);
+
+	return 0;
+}
+
+int jwt_ecdsa_der2raw(const unsigned char *der, size_t der_len,
+		      unsigned char *raw, size_t raw_len)
+{
+	const unsigned char *p = der, *end = der + der_len;
+	size_t n = raw_len / 2, len;
+
+	if (raw_len == 0 || (raw_len & 1) || n > JWT_ECDSA_FIELD_MAX)
+		return 1;
+
+	if (der_len < 2 || *p++ != 0x30)
+		return 1;
+	if (der_get_len(&p, end, &len) || len != (size_t)(end - p))
+		return 1;
+
+	if (der_get_int(&p, end, raw, n) || der_get_int(&p, end, raw + n, n))
+		return 1;
+
+	return p != end;
+}
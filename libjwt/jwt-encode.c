@@ -16,7 +16,10 @@
 
 static int write_js(const jwt_json_t *js, char **buf)
 {
+	JWT_STAGE_BEGIN(t);
+
 	*buf = jwt_json_serialize(js, JWT_JSON_SORT_KEYS | JWT_JSON_COMPACT);
+	JWT_STAGE_END(JWT_STAGE_JSON, t, *buf == NULL);
 
 	return *buf == NULL ? 1 : 0;
 }
@@ -208,6 +211,107 @@ static jwt_json_t *build_protected(jwt_t *jwt, struct jwt_signature *s,
 	return prot;
 }
 
+/* One signature to make: its protected header and signing input are built on
+ * the calling thread, and the signing may then run on any. */
+struct sign_job {
+	struct jwt_signature *s;
+	char *prot_b64;
+	char *input;
+	size_t input_len;
+	char *rawsig;
+	unsigned int rawsig_len;
+	struct jwt scratch;	/* alg, key and error for jwt_sign()	*/
+};
+
+struct sign_jobs {
+	struct sign_job *jobs;
+	size_t n;
+	int stop;
+};
+
+static void sign_jobs_free(struct sign_jobs *sj)
+{
+	size_t i;
+
+	if (sj->jobs == NULL)
+		return;
+
+	for (i = 0; i < sj->n; i++) {
+		jwt_freemem(sj->jobs[i].prot_b64);
+		jwt_freemem(sj->jobs[i].input);
+		jwt_freemem(sj->jobs[i].rawsig);
+	}
+	jwt_freemem(sj->jobs);
+	sj->jobs = NULL;
+}
+
+/* Build the protected header and signing input of one signature. */
+static int prepare_sign(jwt_t *jwt, struct sign_job *job, const char *payload,
+			size_t payload_len)
+{
+	struct jwt_signature *s = job->s;
+	jwt_json_auto_t *prot = NULL;
+	char *buf = NULL;
+	int prot_len;
+	jwt_alg_t alg;
+
+	/* Resolve the algorithm: explicit, else inferred from the key
+	 * (e.g. setkey(NONE, key)). "none" is not allowed in a JSON JWS. */
+	alg = (s->alg != JWT_ALG_NONE) ? s->alg
+		: (s->key ? s->key->alg : JWT_ALG_NONE);
+	if (alg == JWT_ALG_NONE) {
+		jwt_write_error(jwt,
+			"A JSON-serialized JWS cannot use \"none\"");
+		return 1;
+	}
+
+	prot = build_protected(jwt, s, alg);
+	if (prot == NULL)
+		return 1; // LCOV_EXCL_LINE
+
+	if (s->header && jwt_header_params_overlap(prot, s->header)) {
+		jwt_write_error(jwt,
+			"protected and unprotected headers overlap");
+		return 1;
+	}
+
+	if (write_js(prot, &buf))
+		return 1; // LCOV_EXCL_LINE
+	prot_len = jwt_base64uri_encode(&job->prot_b64, buf, (int)strlen(buf));
+	jwt_freemem(buf);
+	if (prot_len <= 0) {
+		jwt_write_error(jwt, "Error encoding protected header"); // LCOV_EXCL_LINE
+		return 1; // LCOV_EXCL_LINE
+	}
+
+	/* @rfc{7797,3} Signing input: BASE64URL(protected) "." payload
+	 * (payload is base64url or raw per b64; binary-safe). */
+	job->input_len = (size_t)prot_len + 1 + payload_len;
+	job->input = jwt_malloc(job->input_len + 1);
+	if (job->input == NULL)
+		return 1; // LCOV_EXCL_LINE
+	memcpy(job->input, job->prot_b64, prot_len);
+	job->input[prot_len] = '.';
+	memcpy(job->input + prot_len + 1, payload, payload_len);
+	job->input[job->input_len] = '\0';
+
+	job->scratch.alg = alg;
+	job->scratch.key = s->key;
+
+	return 0;
+}
+
+/* Sign one prepared signature; the first failure stops the rest. */
+static void run_sign(void *arg, size_t i)
+{
+	struct sign_jobs *sj = arg;
+	struct sign_job *job = &sj->jobs[i];
+
+	if (jwt_sign(&job->scratch, &job->rawsig, &job->rawsig_len,
+		     job->input, (unsigned int)job->input_len))
+		__atomic_store_n(&sj->stop, 1, __ATOMIC_RELEASE);
+}
+
 /* @rfc{7515,7.2} Emit the JWS JSON Serialization. @jwt carries the finalized
  * shared claims (the payload) and the shared base protected header; @cmd carries
  * the signature list and the format (Flattened or General). Each signature signs
@@ -216,8 +320,9 @@ char *jwt_encode_json(jwt_t *jwt, struct jwt_common *cmd)
 {
 	char_auto *payload = NULL;
 	char *buf = NULL;
-	size_t payload_len;
+	size_t payload_len, i;
 	struct jwt_signature *s;
+	struct sign_jobs sj = { 0 };
 	jwt_json_auto_t *out_obj = NULL;
 	jwt_json_t *sig_arr = NULL, *v;
 
@@ -245,67 +350,49 @@ char *jwt_encode_json(jwt_t *jwt, struct jwt_common *cmd)
 			return NULL; // LCOV_EXCL_LINE
 	}
 
-	list_for_each_entry(s, &cmd->signatures, node) {
-		jwt_json_auto_t *prot = NULL;
-		char_auto *prot_b64 = NULL, *sig_b64 = NULL, *input = NULL;
-		char *rawsig = NULL;
-		unsigned int rawsig_len = 0;
-		size_t input_len;
-		int prot_len, enc;
-		jwt_alg_t alg;
-
-		/* Resolve the algorithm: explicit, else inferred from the key
-		 * (e.g. setkey(NONE, key)). "none" is not allowed in a JSON JWS. */
-		alg = (s->alg != JWT_ALG_NONE) ? s->alg
-			: (s->key ? s->key->alg : JWT_ALG_NONE);
-		if (alg == JWT_ALG_NONE) {
-			jwt_write_error(jwt,
-				"A JSON-serialized JWS cannot use \"none\"");
-			return NULL;
-		}
+	sj.n = (size_t)cmd->n_signatures;
+	sj.jobs = jwt_malloc(sj.n * sizeof(*sj.jobs));
+	if (sj.jobs == NULL)
+		return NULL; // LCOV_EXCL_LINE
+	memset(sj.jobs, 0, sj.n * sizeof(*sj.jobs));
 
-		prot = build_protected(jwt, s, alg);
-		if (prot == NULL)
-			return NULL; // LCOV_EXCL_LINE
+	/* Headers and signing inputs, in order on this thread. */
+	i = 0;
+	list_for_each_entry(s, &cmd->signatures, node) {
+		sj.jobs[i].s = s;
+		if (prepare_sign(jwt, &sj.jobs[i++], payload, payload_len))
+			goto out;
+	}
 
-		if (s->header && jwt_header_params_overlap(prot, s->header)) {
-			jwt_write_error(jwt,
-				"protected and unprotected headers overlap");
-			return NULL;
-		}
+	/* Then the signing: one at a time, or on the worker threads. */
+	if (cmd->sig_threads) {
+		jwt_workers_run(cmd->sig_threads, sj.n, run_sign, &sj,
+				&sj.stop);
+	} else {
+		for (i = 0; i < sj.n && !sj.stop; i++)
+			run_sign(&sj, i);
+	}
 
-		if (write_js(prot, &buf))
-			return NULL; // LCOV_EXCL_LINE
-		prot_len = jwt_base64uri_encode(&prot_b64, buf, (int)strlen(buf));
-		jwt_freemem(buf);
-		if (prot_len <= 0) {
-			jwt_write_error(jwt, "Error encoding protected header"); // LCOV_EXCL_LINE
-			return NULL; // LCOV_EXCL_LINE
-		}
-		/* The return counts stripped '=' padding; use the true length. */
-		prot_len = (int)strlen(prot_b64);
-
-		/* @rfc{7797,3} Signing input: BASE64URL(protected) "." payload
-		 * (payload is base64url or raw per b64; binary-safe). */
-		input_len = (size_t)prot_len + 1 + payload_len;
-		input = jwt_malloc(input_len + 1);
-		if (input == NULL)
-			return NULL; // LCOV_EXCL_LINE
-		memcpy(input, prot_b64, prot_len);
-		input[prot_len] = '.';
-		memcpy(input + prot_len + 1, payload, payload_len);
-		input[input_len] = '\0';
+	/* Report the first signature, in order, that failed. */
+	if (sj.stop) {
+		for (i = 0; !sj.jobs[i].scratch.error; i++)
+			;
+		jwt_copy_error(jwt, &sj.jobs[i].scratch);
+		goto out;
+	}
 
-		jwt->alg = alg;
-		jwt->key = s->key;
-		if (jwt_sign(jwt, &rawsig, &rawsig_len, input, input_len))
-			return NULL;
+	for (i = 0; i < sj.n; i++) {
+		struct sign_job *job = &sj.jobs[i];
+		char_auto *sig_b64 = NULL;
+		int enc;
 
-		enc = jwt_base64uri_encode(&sig_b64, rawsig, (int)rawsig_len);
-		jwt_freemem(rawsig);
+		enc = jwt_base64uri_encode(&sig_b64, job->rawsig,
+					   (int)job->rawsig_len);
 		if (enc <= 0) {
-			jwt_write_error(jwt, "Error encoding signature"); // LCOV_EXCL_LINE
-			return NULL; // LCOV_EXCL_LINE
+			// LCOV_EXCL_START
+			jwt_write_error(jwt, "Error encoding signature");
+			goto out;
+			// LCOV_EXCL_STOP
 		}
 
 		if (cmd->format == JWT_FORMAT_JSON_GENERAL) {
@@ -313,20 +400,30 @@ char *jwt_encode_json(jwt_t *jwt, struct jwt_common *cmd)
 
 			if (sig_obj == NULL || jwt_json_arr_append(sig_arr,
 								   sig_obj))
-				return NULL; // LCOV_EXCL_LINE
-			if (fill_sig_json(sig_obj, prot_b64, s->header, sig_b64))
-				return NULL; // LCOV_EXCL_LINE
+				goto out; // LCOV_EXCL_LINE
+			if (fill_sig_json(sig_obj, job->prot_b64,
+					  job->s->header, sig_b64))
+				goto out; // LCOV_EXCL_LINE
 		} else {
 			/* Flattened: hoist the single signature to top level. */
-			if (fill_sig_json(out_obj, prot_b64, s->header, sig_b64))
-				return NULL; // LCOV_EXCL_LINE
+			if (fill_sig_json(out_obj, job->prot_b64,
+					  job->s->header, sig_b64))
+				goto out; // LCOV_EXCL_LINE
 		}
 	}
 
-	buf = jwt_json_serialize(out_obj, JWT_JSON_COMPACT);
+	{
+		JWT_STAGE_BEGIN(t);
+
+		buf = jwt_json_serialize(out_obj, JWT_JSON_COMPACT);
+		JWT_STAGE_END(JWT_STAGE_JSON, t, buf == NULL);
+	}
 	if (buf == NULL)
 		jwt_write_error(jwt, "Error serializing JWS JSON"); // LCOV_EXCL_LINE
 
+out:
+	sign_jobs_free(&sj);
+
 	return buf;
 }
 
@@ -545,8 +642,7 @@ int jwt_build_payload_part(jwt_t *jwt, char **out, size_t *out_len)
 		n = jwt_base64uri_encode(out, (const char *)bytes, (int)len);
 		if (n <= 0)
 			return 1; // LCOV_EXCL_LINE
-		/* The return counts stripped '=' padding; the string is shorter. */
-		*out_len = strlen(*out);
+		*out_len = (size_t)n;
 	} else {
 		char *copy = jwt_malloc(len + 1);
 
@@ -601,7 +697,7 @@ int jwt_apply_b64_header(jwt_t *jwt)
 	return 0;
 }
 
-static int jwt_encode(jwt_t *jwt, char **out)
+static int jwt_encode(jwt_t *jwt, char **out, size_t *out_len)
 {
 	char_auto *head = NULL, *payload = NULL, *sig_b64 = NULL;
 	char *buf = NULL, *si = NULL, *token = NULL, *p;
@@ -628,8 +724,6 @@ static int jwt_encode(jwt_t *jwt, char **out)
 		return 1;
 		// LCOV_EXCL_STOP
 	}
-	/* The return counts stripped '=' padding; use the true string length. */
-	head_len = (int)strlen(head);
 
 	/* @rfc{7797} Payload part (base64url or raw). */
 	if (jwt_build_payload_part(jwt, &payload, &payload_len)) {
@@ -704,6 +798,7 @@ static int jwt_encode(jwt_t *jwt, char **out)
 	*p = '\0';
 
 	*out = token;
+	*out_len = token_len;
 
 	return 0;
 }
@@ -711,9 +806,16 @@ static int jwt_encode(jwt_t *jwt, char **out)
 char *jwt_encode_str(jwt_t *jwt)
 {
 	char *str = NULL;
+	size_t len = 0;
+	int ret;
 
-	if (jwt_encode(jwt, &str))
+	JWT_PROBE2(encode_start, jwt->alg, JWT_PROBE_KID(jwt->key));
+
+	ret = jwt_encode(jwt, &str, &len);
+	if (ret)
 		jwt_freemem(str);
 
+	JWT_PROBE4(encode_done, jwt->alg, JWT_PROBE_KID(jwt->key), len, ret);
+
 	return str;
 }
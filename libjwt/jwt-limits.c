@@ -0,0 +1,97 @@
+/* Copyright (C) 2026 maClara, LLC <info@maclara-llc.com>
+   This file is part of the JWT C Library
+
+   SPDX-License-Identifier:  MPL-2.0
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0. If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/* Input limits for untrusted tokens (jwt_checker_setlimits()).
+ *
+ * The JSON backends build a tree of everything they are given, one
+ * allocation per value, and neither bounds the members or string lengths
+ * of what they parse. So before a document is handed to one, it gets a
+ * single pass here that looks only at its structure: strings, brackets and
+ * commas. Nothing is allocated, and the pass stops at the first limit the
+ * document is over, so what a hostile document costs is bounded by the
+ * limits, not by its size. It does not validate the JSON; the backend
+ * still does that, and a document that is not JSON may pass here. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <jwt.h>
+
+#include "jwt-private.h"
+
+static int is_ws(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+int jwt_limits_json(const jwt_limits_t *lim, const char *buf, size_t len,
+		    int strings)
+{
+	const char *p = buf, *end = buf + len, *q;
+	size_t max_str = strings ? lim->max_string_len : 0;
+	size_t members = 0, str = 0;
+	unsigned int depth = 0;
+	int in_str = 0;
+
+	if (!lim->max_depth && !lim->max_members && !max_str)
+		return 0;
+
+	for (; p < end; p++) {
+		if (in_str) {
+			if (*p == '"') {
+				in_str = 0;
+				continue;
+			}
+
+			/* An escape is counted as it is written. */
+			if (*p == '\\' && p + 1 < end) {
+				p++;
+				str++;
+			}
+
+			if (max_str && ++str > max_str)
+				return 1;
+
+			continue;
+		}
+
+		switch (*p) {
+		case '"':
+			in_str = 1;
+			str = 0;
+			break;
+
+		case '{':
+		case '[':
+			if (lim->max_depth && ++depth > lim->max_depth)
+				return 1;
+
+			/* A container with anything in it has one more
+			 * member than it has commas. */
+			for (q = p + 1; q < end && is_ws(*q); q++)
+				;
+			if (q < end && *q != '}' && *q != ']' &&
+			    lim->max_members && ++members > lim->max_members)
+				return 1;
+			break;
+
+		case '}':
+		case ']':
+			if (depth)
+				depth--;
+			break;
+
+		case ',':
+			if (lim->max_members && ++members > lim->max_members)
+				return 1;
+			break;
+		}
+	}
+
+	return 0;
+}
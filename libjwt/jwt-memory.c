@@ -6,6 +6,8 @@
    License, v. 2.0. If a copy of the MPL was not distributed with this
    file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -17,12 +19,238 @@
 static jwt_malloc_t pfn_malloc;
 static jwt_free_t pfn_free;
 
+/* Per-thread bump arena (jwt_checker_setarena(), jwt_builder_setarena()).
+ *
+ * A verify or generate enters the calling thread's arena for its duration
+ * and switches allocation on only while it decodes or builds the jwt_t, so
+ * that object and its JSON trees come from a few large blocks. Nothing that
+ * outlives the call (keys, caches, results) is allocated while it is on.
+ * Freeing arena memory is a no-op; the whole arena is reset in one step when
+ * the outermost call leaves it. Entering nests, so a callback may verify with
+ * another checker on the same thread. */
+#define ARENA_ALIGN	16
+#define ARENA_MIN	4096
+
+struct jwt_arena_block {
+	struct jwt_arena_block *next;
+	size_t size;		/* Usable octets in @data			*/
+	size_t used;
+	unsigned char *data;
+};
+
+struct jwt_arena {
+	struct jwt_arena_block *blocks;	/* Current block first		*/
+	size_t total;			/* Used across all blocks	*/
+	unsigned int depth;		/* Nested enters		*/
+	int on;				/* jwt_malloc() draws from it	*/
+};
+
+static __thread struct jwt_arena *tls_arena;
+static pthread_key_t arena_key;
+static pthread_once_t arena_once = PTHREAD_ONCE_INIT;
+
+static void *raw_malloc(size_t size)
+{
+	return pfn_malloc ? pfn_malloc(size) : malloc(size);
+}
+
+static void raw_free(void *ptr)
+{
+	if (pfn_free)
+		pfn_free(ptr);
+	else
+		free(ptr);
+}
+
+static struct jwt_arena_block *arena_block_new(size_t size)
+{
+	struct jwt_arena_block *b;
+	size_t hdr = (sizeof(*b) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+	if (size < ARENA_MIN)
+		size = ARENA_MIN;
+
+	b = raw_malloc(hdr + size);
+	if (b == NULL)
+		return NULL;
+
+	b->next = NULL;
+	b->size = size;
+	b->used = 0;
+	b->data = (unsigned char *)b + hdr;
+
+	return b;
+}
+
+static void arena_destroy(void *arg)
+{
+	struct jwt_arena *a = arg;
+	struct jwt_arena_block *b, *next;
+
+	if (a == NULL)
+		return;
+
+	for (b = a->blocks; b != NULL; b = next) {
+		next = b->next;
+		raw_free(b);
+	}
+	raw_free(a);
+}
+
+static void arena_key_init(void)
+{
+	pthread_key_create(&arena_key, arena_destroy);
+}
+
+static void *arena_alloc(struct jwt_arena *a, size_t size)
+{
+	struct jwt_arena_block *b = a->blocks;
+	size_t need = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	void *p;
+
+	if (need < size)
+		return NULL; // LCOV_EXCL_LINE
+
+	if (b == NULL || b->size - b->used < need) {
+		/* Grow geometrically, and always fit the request. */
+		b = arena_block_new(a->blocks ? a->blocks->size * 2 : need);
+		if (b != NULL && b->size < need) {
+			raw_free(b);
+			b = arena_block_new(need);
+		}
+		if (b == NULL)
+			return NULL; // LCOV_EXCL_LINE
+		b->next = a->blocks;
+		a->blocks = b;
+	}
+
+	p = b->data + b->used;
+	b->used += need;
+	a->total += need;
+
+	return p;
+}
+
+static int arena_owns(const struct jwt_arena *a, const void *ptr)
+{
+	const struct jwt_arena_block *b;
+	uintptr_t p = (uintptr_t)ptr;
+
+	for (b = a->blocks; b != NULL; b = b->next) {
+		if (p >= (uintptr_t)b->data && p < (uintptr_t)b->data + b->size)
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Back to empty. If the last call needed more than one block, replace them
+ * with a single block big enough for it, so the next one needs only that. */
+static void arena_reset(struct jwt_arena *a)
+{
+	struct jwt_arena_block *b, *next;
+	size_t total = a->total;
+
+	a->total = 0;
+
+	if (a->blocks == NULL)
+		return;
+
+	if (a->blocks->next == NULL) {
+		a->blocks->used = 0;
+		return;
+	}
+
+	for (b = a->blocks; b != NULL; b = next) {
+		next = b->next;
+		raw_free(b);
+	}
+	a->blocks = arena_block_new(total);
+}
+
+int jwt_arena_enter(size_t size)
+{
+	struct jwt_arena *a = tls_arena;
+
+	if (a == NULL) {
+		pthread_once(&arena_once, arena_key_init);
+
+		a = raw_malloc(sizeof(*a));
+		if (a == NULL)
+			return 1; // LCOV_EXCL_LINE
+		memset(a, 0, sizeof(*a));
+
+		if (pthread_setspecific(arena_key, a)) {
+			// LCOV_EXCL_START
+			raw_free(a);
+			return 1;
+			// LCOV_EXCL_STOP
+		}
+		tls_arena = a;
+	}
+
+	/* Size the first block as asked; a failure here just means the first
+	 * allocation makes one. */
+	if (a->blocks == NULL)
+		a->blocks = arena_block_new(size);
+
+	a->depth++;
+
+	return 0;
+}
+
+void jwt_arena_leave(void)
+{
+	struct jwt_arena *a = tls_arena;
+
+	if (a == NULL || a->depth == 0)
+		return; // LCOV_EXCL_LINE
+
+	if (--a->depth == 0) {
+		a->on = 0;
+		arena_reset(a);
+	}
+}
+
+int jwt_arena_set(int on)
+{
+	struct jwt_arena *a = tls_arena;
+	int prev;
+
+	if (a == NULL || a->depth == 0)
+		return 0;
+
+	prev = a->on;
+	a->on = on;
+
+	return prev;
+}
+
+void jwt_arena_release(void)
+{
+	struct jwt_arena *a = tls_arena;
+
+	/* Not while a call on this thread is using it. */
+	if (a == NULL || a->depth)
+		return;
+
+	pthread_setspecific(arena_key, NULL);
+	tls_arena = NULL;
+	arena_destroy(a);
+}
+
 void *jwt_malloc(size_t size)
 {
-	if (pfn_malloc)
-		return pfn_malloc(size);
+	struct jwt_arena *a = tls_arena;
+
+	if (a != NULL && a->on) {
+		void *p = arena_alloc(a, size);
 
-	return malloc(size);
+		if (p != NULL)
+			return p;
+	}
+
+	return raw_malloc(size);
 }
 
 int jwt_set_alloc(jwt_malloc_t pmalloc, jwt_free_t pfree)
@@ -49,8 +277,11 @@ void jwt_get_alloc(jwt_malloc_t *pmalloc, jwt_free_t *pfree)
 /* Should call the macros instead */
 void __jwt_freemem(void *ptr)
 {
-	if (pfn_free)
-		pfn_free(ptr);
-	else
-		free(ptr);
+	struct jwt_arena *a = tls_arena;
+
+	/* Arena memory goes back when the arena is reset. */
+	if (a != NULL && a->depth && arena_owns(a, ptr))
+		return;
+
+	raw_free(ptr);
 }
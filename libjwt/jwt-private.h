@@ -39,7 +39,10 @@
 #define JWT_CONFIG_DECLARE(__name) \
 	jwt_config_t __name = { NULL, JWT_ALG_NONE, NULL}
 
-#define JWT_ERR_LEN 256
+#define JWT_ERR_LEN JWT_ERROR_MSG_LEN
+
+/* The largest HS* MAC (HS512), in octets. */
+#define JWT_HMAC_MAX 64
 
 JWT_NO_EXPORT
 extern struct jwt_crypto_ops *jwt_ops;
@@ -52,24 +55,94 @@ extern struct jwt_crypto_ops *jwt_ops;
 JWT_NO_EXPORT
 struct jwt_crypto_ops *jwt_item_ops(const jwk_item_t *item);
 
-/* This can be used on anything with an error and error_msg field */
+/* This can be used on anything with an error and error_msg field. The first
+ * error stands. */
 #define jwt_write_error(__obj, __fmt, __args...)	\
 ({							\
-	if (!strlen((__obj)->error_msg))		\
+	if (!(__obj)->error)				\
 		snprintf((__obj)->error_msg,		\
 			 sizeof((__obj)->error_msg),	\
 		 __fmt, ##__args);			\
 	(__obj)->error = 1;				\
 })
 
+/* The rest are for the jwt_t, builder and checker, which also carry a
+ * jwt_error_t. jwt_set_error() rejects with a fixed message: only the code
+ * and a pointer to the message are stored, so a token turned down on the
+ * verify path costs no formatting; error_msg() returns @error_str. */
+#define jwt_set_error(__obj, __code, __msg)		\
+({							\
+	if (!(__obj)->error) {				\
+		(__obj)->error_code = (__code);		\
+		(__obj)->error_str = (__msg);		\
+	}						\
+	(__obj)->error = 1;				\
+})
+
+/* jwt_write_error(), with a code for a message that needs formatting. */
+#define jwt_write_error_code(__obj, __code, __fmt, __args...)	\
+({								\
+	if (!(__obj)->error)					\
+		(__obj)->error_code = (__code);			\
+	jwt_write_error(__obj, __fmt, ##__args);		\
+})
+
+/* A claims failure: @__failed is the jwt_claims_t that failed. */
+#define jwt_set_claims_error(__obj, __failed)			\
+({								\
+	if (!(__obj)->error)					\
+		(__obj)->error_claims = (__failed);		\
+	jwt_set_error(__obj, jwt_claims_error_code(__failed),	\
+		      "Failed one or more claims");		\
+})
+
+#define jwt_clear_error(__obj)					\
+({								\
+	(__obj)->error = 0;					\
+	(__obj)->error_msg[0] = '\0';				\
+	(__obj)->error_code = JWT_ERR_NONE;			\
+	(__obj)->error_str = NULL;				\
+	(__obj)->error_claims = 0;				\
+})
+
+/* A fixed message is shared, not copied; a formatted one is copied up to
+ * its end, not the whole buffer. */
 #define jwt_copy_error(__dst, __src)				\
 ({								\
-	strncpy((__dst)->error_msg, (__src)->error_msg,		\
-		sizeof((__dst)->error_msg) - 1);		\
-	(__dst)->error_msg[sizeof((__dst)->error_msg) - 1] = '\0';	\
+	size_t __n = 0;						\
+	if ((__src)->error_str == NULL)				\
+		__n = strnlen((__src)->error_msg,		\
+			      sizeof((__dst)->error_msg) - 1);	\
+	memcpy((__dst)->error_msg, (__src)->error_msg, __n);	\
+	(__dst)->error_msg[__n] = '\0';				\
 	(__dst)->error = (__src)->error;			\
+	(__dst)->error_code = (__src)->error_code;		\
+	(__dst)->error_str = (__src)->error_str;		\
+	(__dst)->error_claims = (__src)->error_claims;		\
 })
 
+/* The code of an error on the verify path: JWT_ERR_OTHER for one written
+ * without a code of its own. */
+#define jwt_error_code(__obj)					\
+	(!(__obj)->error ? JWT_ERR_NONE :			\
+	 (__obj)->error_code ? (__obj)->error_code : JWT_ERR_OTHER)
+
+/* The message of an error on the verify path. */
+#define jwt_error_msg(__obj)					\
+	((__obj)->error_str ? (__obj)->error_str : (__obj)->error_msg)
+
+/* The jwt_error_t for the claims in @failed (see jwt_error_t). */
+static inline jwt_error_t jwt_claims_error_code(jwt_claims_t failed)
+{
+	if (failed & JWT_CLAIM_EXP)
+		return JWT_ERR_EXPIRED;
+	if (failed & JWT_CLAIM_NBF)
+		return JWT_ERR_NOT_BEFORE;
+	if (failed & ~JWT_CLAIM_JTI)
+		return JWT_ERR_CLAIMS;
+	return JWT_ERR_REPLAY;
+}
+
 /******************************/
 
 struct jwt_common {
@@ -152,18 +225,62 @@ struct jwt_common {
 	 * it must outlive the verify (jwt_checker_sig_key() borrows it), so it is
 	 * reset at the start of each verify and freed at checker free. */
 	jwk_set_t *embedded_owned;
+
+	/* checker: the verified-signature cache (jwt_checker_cache()), or NULL.
+	 * Locked internally, so a shared checker's views may all use it. */
+	struct jwt_verify_cache *cache;
+
+	/* First block size for the per-thread decode/build arena, or 0 for
+	 * none (jwt_checker_setarena(), jwt_builder_setarena()). */
+	size_t arena;
+
+	/* Threads to sign or verify the signatures of a JWS JSON Serialization
+	 * on (jwt_builder_setthreads(), jwt_checker_setthreads()), or 0 to do
+	 * them all, in order, on the calling thread. */
+	unsigned int sig_threads;
+
+	/* checker: limits on the tokens it will look at (jwt_checker_setlimits()).
+	 * All 0, the default, is no limits. */
+	jwt_limits_t limits;
+
+#ifdef LIBJWT_HAVE_STATS
+	/* Per-stage counters (jwt_checker_stats(), jwt_builder_stats()). A
+	 * shared checker's views borrow the pointer, so they all add to it. */
+	jwt_stats_t *stats;
+#endif
 };
 
 struct jwt_builder {
 	struct jwt_common c;
 	int error;
 	char error_msg[JWT_ERR_LEN];
+	jwt_error_t error_code;
+	const char *error_str;
+	jwt_claims_t error_claims;
 };
 
 struct jwt_checker {
 	struct jwt_common c;
 	int error;
 	char error_msg[JWT_ERR_LEN];
+	jwt_error_t error_code;
+	const char *error_str;
+	jwt_claims_t error_claims;
+};
+
+/* A checker frozen by jwt_checker_freeze() for use from many threads. The
+ * checker it owns is never written again, so verifies read its configuration
+ * without locking; only @refs changes, atomically. */
+struct jwt_checker_shared {
+	jwt_checker_t *checker;
+	unsigned int refs;
+};
+
+/* Per-call state for verifying against a jwt_checker_shared. @view is a
+ * checker whose configuration is a shallow copy, borrowed for the duration
+ * of one verify; the signature list, embedded key and error are its own. */
+struct jwt_verify_ctx {
+	struct jwt_checker view;
 };
 
 /* @rfc{7515,7.2.1} One JWS signature: its own "alg" and PROTECTED header (the
@@ -256,6 +373,14 @@ struct jwe_common {
 	 * JSON serialization's "aad" member, handed back via get_aad(). */
 	unsigned char *recovered_aad;
 	size_t recovered_aad_len;
+
+	/* checker: limits on the tokens it will look at (jwe_checker_setlimits()). */
+	jwt_limits_t limits;
+
+#ifdef LIBJWT_HAVE_STATS
+	/* Per-stage counters (jwe_checker_stats(), jwe_builder_stats()). */
+	jwt_stats_t *stats;
+#endif
 };
 
 struct jwe_builder {
@@ -279,6 +404,9 @@ struct jwt {
 	jwt_alg_t alg;
 	int error;
 	char error_msg[JWT_ERR_LEN];
+	jwt_error_t error_code;
+	const char *error_str;
+	jwt_claims_t error_claims;
 
 	/* @rfc{7797} An opaque payload (instead of JSON @claims), and the b64 /
 	 * detached flags, threaded from the builder/checker into encode/verify.
@@ -288,6 +416,14 @@ struct jwt {
 	int b64;
 	int detached;
 
+	/* The still-encoded claims of a token being verified, until
+	 * jwt_parse_claims() decodes them. A view into the caller's token. */
+	const char *claims_b64;
+	size_t claims_b64_len;
+
+	/* The checker's limits while its token is decoded, or NULL. */
+	const jwt_limits_t *limits;
+
 	union {
 		struct jwt_checker *checker;
 		struct jwt_builder *builder;
@@ -306,13 +442,86 @@ struct jwks_url_cache {
 	time_t last_fetch;	/* Time of the last network fetch (cooldown)	*/
 };
 
+/* A URL source's background refresher (jwks_refresh_start()), in
+ * jwks-curl.c. */
+struct jwks_refresher;
+
 struct jwk_set {
 	ll_t head;
 	int error;
 	char error_msg[JWT_ERR_LEN];
 	struct jwks_url_cache *cache;	/* @rfc{7517} URL cache, or NULL	*/
+	struct jwks_refresher *refresher;	/* Background refresh, or NULL	*/
+	struct jwks_index *index;	/* kid / alg lookup index, or NULL	*/
+	unsigned long scan_clock;	/* Keyless verifies that found a key	*/
 };
 
+/* While a refresher runs, its thread swaps new keys into the set between
+ * readers: a verify holds the set's keys still with jwks_read_lock() for as
+ * long as it uses them. Both are no-ops for a set without a refresher (or
+ * NULL). The thread also writes the set's error, under jwks_error_lock(),
+ * which is a no-op without a refresher too (but @jwk_set must not be NULL).
+ * jwks_items_swap() exchanges the keys and index of two sets. */
+JWT_NO_EXPORT
+void jwks_read_lock(const jwk_set_t *jwk_set);
+JWT_NO_EXPORT
+void jwks_read_unlock(const jwk_set_t *jwk_set);
+JWT_NO_EXPORT
+void jwks_error_lock(const jwk_set_t *jwk_set);
+JWT_NO_EXPORT
+void jwks_error_unlock(const jwk_set_t *jwk_set);
+JWT_NO_EXPORT
+void jwks_items_swap(jwk_set_t *a, jwk_set_t *b);
+
+/* The jwk_set lookup index (jwks-index.c). Every operation that adds or
+ * removes items calls jwks_index_rebuild() once it is done; lookups only read
+ * it. jwks_index_bykid() returns 0 if there is no index, in which case the
+ * caller walks the list; otherwise 1, with *@out the first item carrying
+ * @kid, or NULL. jwks_index_byalg() returns the usable keys for @alg in
+ * keyring order (see alg_candidate()), or NULL if there is no index. */
+JWT_NO_EXPORT
+void jwks_index_rebuild(jwk_set_t *jwk_set);
+JWT_NO_EXPORT
+void jwks_index_free(jwk_set_t *jwk_set);
+JWT_NO_EXPORT
+int jwks_index_bykid(const jwk_set_t *jwk_set, const char *kid,
+		     jwk_item_t **out);
+JWT_NO_EXPORT
+jwk_item_t *const *jwks_index_byalg(const jwk_set_t *jwk_set, jwt_alg_t alg,
+				    size_t *count);
+
+/* The candidates of a keyless verify scan for one alg (jwks_scan_begin()),
+ * most recently successful first. jwks_scan_begin() returns 0 if there is no
+ * index, in which case the caller walks the list. Each key that verifies is
+ * passed to jwks_scan_hit(), which is safe on a keyring shared by threads. */
+#define JWKS_SCAN_STACK 32
+
+struct jwks_scan {
+	jwk_item_t *const *items;
+	size_t n;
+	jwk_item_t **sorted;	/* Owned by the scan if not @stack	*/
+	jwk_item_t *stack[JWKS_SCAN_STACK];
+};
+
+JWT_NO_EXPORT
+int jwks_scan_begin(struct jwks_scan *scan, const jwk_set_t *jwk_set,
+		    jwt_alg_t alg);
+JWT_NO_EXPORT
+void jwks_scan_hit(const jwk_set_t *jwk_set, const jwk_item_t *item);
+JWT_NO_EXPORT
+void jwks_scan_end(struct jwks_scan *scan);
+/* As jwks_index_bykid(), by @rfc{7638} thumbprint. */
+JWT_NO_EXPORT
+int jwks_index_bythumbprint(const jwk_set_t *jwk_set, jwk_thumbprint_alg_t alg,
+			    const char *thumbprint, jwk_item_t **out);
+
+/* @rfc{7638} The thumbprint of @item, computed on first use and cached on the
+ * item (published atomically, so a shared keyring needs no lock). Borrowed;
+ * valid as long as the item. NULL for an unusable key or a bad @alg. */
+JWT_NO_EXPORT
+const char *jwks_item_thumbprint_get(const jwk_item_t *item,
+				     jwk_thumbprint_alg_t alg);
+
 /**
  * This data structure is produced by importing a JWK or JWKS into a
  * @ref jwk_set_t object. Generally, you would not change any values here
@@ -331,6 +540,15 @@ struct jwk_cert {
 	size_t len;
 };
 
+/* HS* key state a backend prepares on an oct key (jwk_item.hmac) on first
+ * use. The backend's own state starts with this header, so the key can be
+ * freed, and another backend can tell the state is not its own, without
+ * knowing the layout. */
+struct jwk_hmac_state {
+	jwt_crypto_provider_t provider;	/* Backend that built it	*/
+	void (*free)(struct jwk_hmac_state *state);
+};
+
 struct jwk_item {
 	ll_t node;
 	char *pem;		/**< If not NULL, contains PEM string of this key	*/
@@ -355,6 +573,10 @@ struct jwk_item {
 	struct jwk_cert *x5c;	/**< @rfc{7517,4.7} decoded DER cert chain (or NULL)	*/
 	size_t x5c_count;	/**< Number of certificates in @ref jwk_item.x5c	*/
 	jwt_json_t *json;	/**< The jwt_json_t for this key			*/
+	char *thumbprint[JWK_THUMBPRINT_SHA512 + 1];/**< @rfc{7638} per-hash cache, set once on first use */
+	void *provider_cache;	/**< Backend operation state for this key, set once on first use */
+	struct jwk_hmac_state *hmac;/**< Prepared HS* state of an ``"oct"`` key, set once on first use */
+	unsigned long scan_used;/**< jwk_set.scan_clock when it last verified a keyless signature, or 0 */
 };
 
 /* Crypto operations */
@@ -397,6 +619,10 @@ struct jwt_crypto_ops {
 	int (*verify_sha_pem)(jwt_t *jwt, const char *head,
 		unsigned int head_len, unsigned char *sig,
 		int sig_len);
+	/* Optional: the HS* MAC of @str into @out, which holds JWT_HMAC_MAX
+	 * octets, without allocating. NULL to go through sign_sha_hmac. */
+	int (*hmac_sha)(jwt_t *jwt, const char *str, unsigned int str_len,
+		unsigned char *out, unsigned int *len);
 
 	/* Parsing a JWK to prepare it for use */
 	int jwk_implemented;
@@ -517,6 +743,9 @@ struct jwt_crypto_ops {
 #ifdef HAVE_OPENSSL
 JWT_NO_EXPORT
 extern struct jwt_crypto_ops jwt_openssl_ops;
+/* Takes an OSSL_LIB_CTX *; see jwt_set_crypto_openssl_libctx(). */
+JWT_NO_EXPORT
+int openssl_set_libctx(void *ctx, const char *pq);
 #endif
 #ifdef HAVE_GNUTLS
 JWT_NO_EXPORT
@@ -533,6 +762,19 @@ void *jwt_malloc(size_t size);
 JWT_NO_EXPORT
 void __jwt_freemem(void *ptr);
 
+/* The calling thread's arena (jwt-memory.c). jwt_arena_enter() starts a
+ * scope, with a first block of @size octets if the arena is new; it returns
+ * non-zero if there is no arena, in which case do not leave. While a scope
+ * is open, jwt_arena_set(1) makes jwt_malloc() draw from the arena and
+ * returns the previous setting to restore. Leaving the outermost scope
+ * resets the arena, so nothing allocated from it may outlive the scope. */
+JWT_NO_EXPORT
+int jwt_arena_enter(size_t size);
+JWT_NO_EXPORT
+void jwt_arena_leave(void);
+JWT_NO_EXPORT
+int jwt_arena_set(int on);
+
 JWT_NO_EXPORT
 jwt_t *jwt_new(void);
 
@@ -624,6 +866,41 @@ int jwt_base64uri_encode(char **_dst, const char *plain, int plain_len);
 JWT_NO_EXPORT
 void *jwt_base64uri_decode(const char *src, int *ret_len);
 
+/* Decode @len octets of base64url at @src (which need not be NUL-terminated)
+ * directly into @out, which must hold JWT_BASE64URI_DECODE_SIZE(len) octets.
+ * Returns the decoded length, or -1 if @src is not unpadded base64url. */
+#define JWT_BASE64URI_DECODE_SIZE(__len) ((((size_t)(__len) + 3) / 4) * 3)
+/* The unpadded base64url length of @__len octets. */
+#define JWT_BASE64URI_ENCODE_LEN(__len) (((size_t)(__len) * 4 + 2) / 3)
+JWT_NO_EXPORT
+int jwt_base64uri_decode_buf(const char *src, size_t len, unsigned char *out);
+
+/* SIMD bulk kernels behind the base64url routines (jwt-base64-simd.c). Each
+ * handles whole blocks from the front and returns the number of input octets
+ * it consumed (0 if no kernel applies); the caller finishes the rest. Decode
+ * stops before any block holding a non-base64url character and may write up
+ * to 8 octets past what it decoded, within JWT_BASE64URI_DECODE_SIZE(len). */
+JWT_NO_EXPORT
+size_t jwt_base64uri_decode_simd(const char *src, size_t len,
+				 unsigned char *out);
+JWT_NO_EXPORT
+size_t jwt_base64uri_encode_simd(const unsigned char *in, size_t len,
+				 char *out);
+
+/* ECDSA signatures between the JWS R || S form and DER (jwt-ecdsa.c). The
+ * field (R or S) is at most 66 octets, for P-521, and the DER form of two
+ * such fields at most JWT_ECDSA_DER_MAX octets. raw2der returns the DER
+ * length or -1; der2raw fills all @raw_len octets of @raw and returns 0, or
+ * non-zero if @der is not a strict DER ECDSA-Sig-Value that fits. */
+#define JWT_ECDSA_FIELD_MAX	66
+#define JWT_ECDSA_DER_MAX	(2 * (JWT_ECDSA_FIELD_MAX + 3) + 3)
+JWT_NO_EXPORT
+int jwt_ecdsa_raw2der(const unsigned char *raw, size_t raw_len,
+		      unsigned char *der, size_t der_size);
+JWT_NO_EXPORT
+int jwt_ecdsa_der2raw(const unsigned char *der, size_t der_len,
+		      unsigned char *raw, size_t raw_len);
+
 /* Standard (non-URL) base64, used for the @rfc{7517,4.7} "x5c" certificate
  * chain. @out must hold at least 4*((inlen+2)/3) (encode) or 3*(inlen/4)
  * (decode) octets; both return the number of octets written. */
@@ -636,7 +913,7 @@ unsigned int base64_decode(const char *in, unsigned int inlen,
 
 JWT_NO_EXPORT
 jwt_t *jwt_verify_sig(jwt_t *jwt, const char *head, unsigned int head_len,
-                   const char *sig);
+		      const char *sig_b64, size_t sig_b64_len);
 JWT_NO_EXPORT
 int jwt_sign(jwt_t *jwt, char **out, unsigned int *len, const char *str,
 	     unsigned int str_len);
@@ -648,15 +925,176 @@ jwt_value_error_t __setter(jwt_json_t *which, jwt_value_t *value);
 JWT_NO_EXPORT
 jwt_value_error_t __getter(jwt_json_t *which, jwt_value_t *value);
 
+/* Run @fn(@arg, i) for each i in [0, @n) on up to @threads threads, the
+ * calling one included (jwt-workers.c). No job is started after *@stop (if
+ * given) becomes non-zero; each job sees only its own index. */
+typedef void (*jwt_worker_fn)(void *arg, size_t i);
+
+JWT_NO_EXPORT
+void jwt_workers_run(unsigned int threads, size_t n, jwt_worker_fn fn,
+		     void *arg, const int *stop);
+
+/* Per-stage statistics (jwt-stats.c). An operation enters the counters of
+ * its checker or builder for the calling thread (jwt_stats_set() returns
+ * the previous ones, to restore), so the helpers it reaches (base64, JSON,
+ * signing) add to them without being passed them; a thread with none set
+ * counts nothing. jwt_stats_call() counts the operation itself. Stages are
+ * timed with JWT_STAGE_BEGIN() and JWT_STAGE_END(), which, like everything
+ * here, compile out without LIBJWT_HAVE_STATS. These are macros, not
+ * #ifdefs, so the jwt-common.c and jwe-common.c templates can use them. */
+#ifdef LIBJWT_HAVE_STATS
+JWT_NO_EXPORT
+jwt_stats_t *jwt_stats_new(void);
+JWT_NO_EXPORT
+jwt_stats_t *jwt_stats_set(jwt_stats_t *stats);
 JWT_NO_EXPORT
-int jwt_parse(jwt_t *jwt, const char *token, unsigned int *len);
+jwt_stats_t *jwt_stats_get(void);
+JWT_NO_EXPORT
+void jwt_stats_call(int failed);
+JWT_NO_EXPORT
+unsigned long long jwt_stats_begin(void);
+JWT_NO_EXPORT
+void jwt_stats_end(jwt_stage_t stage, unsigned long long start, int failed);
+JWT_NO_EXPORT
+void jwt_stats_read(const jwt_stats_t *stats, jwt_stats_t *out);
+
+#define JWT_STATS_NEW(__s)	(((__s) = jwt_stats_new()) == NULL)
+#define JWT_STATS_FREE(__s)	jwt_freemem(__s)
+#define JWT_STATS_READ(__s, __out) ({		\
+	jwt_stats_read(__s, __out);		\
+	0;					\
+})
+#define JWT_STATS_ENTER(__s)	\
+	jwt_stats_t *__jwt_stats_prev = jwt_stats_set(__s)
+#define JWT_STATS_LEAVE(__failed) ({		\
+	jwt_stats_call(__failed);		\
+	jwt_stats_set(__jwt_stats_prev);	\
+})
+#define JWT_STAGE_BEGIN(__t)	unsigned long long __t = jwt_stats_begin()
+#define JWT_STAGE_END(__stage, __t, __failed) \
+	jwt_stats_end(__stage, __t, __failed)
+#else
+#define JWT_STATS_NEW(__s)	0
+#define JWT_STATS_FREE(__s)	do { } while (0)
+#define JWT_STATS_READ(__s, __out) 1
+#define JWT_STATS_ENTER(__s)	do { } while (0)
+#define JWT_STATS_LEAVE(__failed) do { } while (0)
+#define JWT_STAGE_BEGIN(__t)	do { } while (0)
+#define JWT_STAGE_END(__stage, __t, __failed) do { } while (0)
+#endif
+
+/* USDT probes, provider "libjwt" (WITH_USDT). A probe is a single nop until
+ * a tracer attaches to it, and its arguments are only values already at
+ * hand, so an untraced process pays nothing for them. Paired *_start and
+ * *_done probes bracket an operation for latency. Macros for the same reason
+ * as the stats ones above. */
+#ifdef HAVE_USDT
+#include <sys/sdt.h>
+#define JWT_PROBE1(__n, __a)		STAP_PROBE1(libjwt, __n, __a)
+#define JWT_PROBE2(__n, __a, __b)	STAP_PROBE2(libjwt, __n, __a, __b)
+#define JWT_PROBE3(__n, __a, __b, __c)	\
+	STAP_PROBE3(libjwt, __n, __a, __b, __c)
+#define JWT_PROBE4(__n, __a, __b, __c, __d) \
+	STAP_PROBE4(libjwt, __n, __a, __b, __c, __d)
+#else
+#define JWT_PROBE1(__n, __a)		do { } while (0)
+#define JWT_PROBE2(__n, __a, __b)	do { } while (0)
+#define JWT_PROBE3(__n, __a, __b, __c)	do { } while (0)
+#define JWT_PROBE4(__n, __a, __b, __c, __d) do { } while (0)
+#endif
+
+/* The "kid" of @__key (a jwk_item_t), or NULL, for a probe argument. */
+#define JWT_PROBE_KID(__key)	((__key) ? (__key)->kid : NULL)
+
+/* A string in a scanned payload: unescaped, not NUL-terminated. */
+struct jwt_json_view {
+	const char *str;
+	size_t len;
+};
+
+/* At most this many names can be looked for by jwt_claims_scan(). */
+#define JWT_CLAIMS_SCAN_NAMES	64
+
+/* The registered claims jwt_claims_scan() found in a payload (jwt-claims-scan.c).
+ * @found has the JWT_CLAIM_* bit of each one present, @typed only of those
+ * of the type the checker reads them as: an integer "exp" or "nbf", a string
+ * "iss", "sub" or "jti", and a string or array "aud". The string elements of
+ * "aud" are @aud[0 .. @n_aud). Bit i of @names_found is set if @names[i] is
+ * a member. Views point into the scanned buffer. */
+struct jwt_claims_scan {
+	unsigned int found;
+	unsigned int typed;
+	jwt_long_t exp;
+	jwt_long_t nbf;
+	struct jwt_json_view iss;
+	struct jwt_json_view sub;
+	struct jwt_json_view jti;
+	struct jwt_json_view *aud;
+	size_t n_aud;
+	size_t aud_cap;
+	struct jwt_json_view aud_buf[4];
+	char * const *names;
+	size_t n_names;
+	unsigned long long names_found;
+};
+
+JWT_NO_EXPORT
+int jwt_claims_scan(struct jwt_claims_scan *cs, char *buf, size_t len,
+		    char * const *names, size_t n_names);
+JWT_NO_EXPORT
+void jwt_claims_scan_free(struct jwt_claims_scan *cs);
+
+/* Input limits (jwt-limits.c). jwt_limits_json() returns non-zero if the
+ * JSON document @buf[0 .. @len) is over the depth or member limit of @lim,
+ * or with @strings, its string length limit. */
+JWT_NO_EXPORT
+int jwt_limits_json(const jwt_limits_t *lim, const char *buf, size_t len,
+		    int strings);
+/* Whether @__len octets of unpadded base64url decode to more than @__max
+ * octets (0 is no limit). Nothing is decoded to tell. */
+#define JWT_LIMIT_B64(__max, __len)					\
+	((__max) && ((size_t)(__len) / 4 * 3 +				\
+		     (size_t)(__len) % 4 * 3 / 4) > (__max))
+
+/* A Compact token is verified header first: jwt_parse_header() decodes only
+ * the header, jwt_verify_policy() and jwt_verify_bind() reject on it, and
+ * only then is the payload decoded. jwt_verify_complete() checks the claims
+ * with jwt_claims_scan() unless jwt_parse_claims() has already built the
+ * tree for something that will look at the jwt_t. */
+JWT_NO_EXPORT
+int jwt_parse_header(jwt_t *jwt, const char *token, size_t token_len,
+		     unsigned int *len);
+JWT_NO_EXPORT
+int jwt_parse_claims(jwt_t *jwt);
+JWT_NO_EXPORT
+int jwt_verify_policy(jwt_t *jwt);
+JWT_NO_EXPORT
+int jwt_verify_bind(jwt_t *jwt, const jwt_config_t *config, size_t sig_len);
 JWT_NO_EXPORT
 int jwt_check_crit(jwt_t *jwt, char * const *understood);
 JWT_NO_EXPORT
 int jwt_write_crit(jwt_t *jwt, char * const *crit);
 JWT_NO_EXPORT
 jwt_t *jwt_verify_complete(jwt_t *jwt, const jwt_config_t *config,
-			   const char *token, unsigned int payload_len);
+			   const char *token, size_t token_len,
+			   unsigned int payload_len);
+
+/* The checker's verified-signature cache (jwt-verify-cache.c). A lookup
+ * returns 1 if this exact token already verified against @key with @alg (and
+ * counts a hit or a miss); add records that it just did. */
+JWT_NO_EXPORT
+struct jwt_verify_cache *jwt_verify_cache_new(unsigned int size, time_t ttl);
+JWT_NO_EXPORT
+void jwt_verify_cache_free(struct jwt_verify_cache *c);
+JWT_NO_EXPORT
+int jwt_verify_cache_lookup(struct jwt_verify_cache *c, const char *token,
+			    size_t len, const jwk_item_t *key, jwt_alg_t alg);
+JWT_NO_EXPORT
+void jwt_verify_cache_add(struct jwt_verify_cache *c, const char *token,
+			  size_t len, const jwk_item_t *key, jwt_alg_t alg);
+JWT_NO_EXPORT
+void jwt_verify_cache_stats(struct jwt_verify_cache *c, unsigned long *hits,
+			    unsigned long *misses, unsigned int *entries);
 
 JWT_NO_EXPORT
 char *jwt_encode_str(jwt_t *jwt);
@@ -696,7 +1134,7 @@ int jwt_apply_b64_header(jwt_t *jwt);
 /* Checker: parse + verify a JWS JSON Serialization against the checker's
  * key/keyring and policy. Returns 0 if the policy is satisfied. */
 JWT_NO_EXPORT
-int jwt_verify_json(jwt_checker_t *checker, const char *token);
+int jwt_verify_json(jwt_checker_t *checker, const char *token, size_t len);
 
 /* @rfc{7515,4.1.3} Build + confirm a verification key from the protected
  * header's "jwk" (embedded-JWK verify). Returns an owned jwk_set_t (caller
@@ -0,0 +1,119 @@
+/* Copyright (C) 2026 maClara, LLC <info@maclara-llc.com>
+   This file is part of the JWT C Library
+
+   SPDX-License-Identifier:  MPL-2.0
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0. If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/* Per-stage statistics for checkers and builders (jwt_checker_stats()).
+ *
+ * A verify, generate or decrypt enters its object's counters for the calling
+ * thread, the way the arena is entered, so the helpers deep below it can
+ * count their stage without the counters being passed down. Counters are only
+ * ever added to, with relaxed atomics, so a shared checker's threads need no
+ * lock and a reader never stops them. Built without WITH_STATS, none of this
+ * is compiled and the macros in jwt-private.h are empty. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <jwt.h>
+
+#include "jwt-private.h"
+
+#ifdef LIBJWT_HAVE_STATS
+
+static __thread jwt_stats_t *tls_stats;
+
+static inline void stat_add(unsigned long long *ctr, unsigned long long n)
+{
+	__atomic_fetch_add(ctr, n, __ATOMIC_RELAXED);
+}
+
+static inline unsigned long long stat_get(const unsigned long long *ctr)
+{
+	return __atomic_load_n(ctr, __ATOMIC_RELAXED);
+}
+
+jwt_stats_t *jwt_stats_new(void)
+{
+	jwt_stats_t *stats = jwt_malloc(sizeof(*stats));
+
+	if (stats != NULL)
+		memset(stats, 0, sizeof(*stats));
+
+	return stats;
+}
+
+jwt_stats_t *jwt_stats_set(jwt_stats_t *stats)
+{
+	jwt_stats_t *prev = tls_stats;
+
+	tls_stats = stats;
+
+	return prev;
+}
+
+jwt_stats_t *jwt_stats_get(void)
+{
+	return tls_stats;
+}
+
+void jwt_stats_call(int failed)
+{
+	if (tls_stats == NULL)
+		return;
+
+	stat_add(&tls_stats->calls, 1);
+	if (failed)
+		stat_add(&tls_stats->failures, 1);
+}
+
+unsigned long long jwt_stats_begin(void)
+{
+	struct timespec ts;
+
+	/* Nothing to count into: skip the clock. */
+	if (tls_stats == NULL)
+		return 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long long)ts.tv_sec * 1000000000ULL +
+		(unsigned long long)ts.tv_nsec;
+}
+
+void jwt_stats_end(jwt_stage_t stage, unsigned long long start, int failed)
+{
+	jwt_stage_stats_t *st;
+	unsigned long long now;
+
+	if (tls_stats == NULL || !start)
+		return;
+
+	now = jwt_stats_begin();
+	st = &tls_stats->stage[stage];
+
+	stat_add(&st->count, 1);
+	stat_add(&st->ns, now - start);
+	if (failed)
+		stat_add(&st->failures, 1);
+}
+
+void jwt_stats_read(const jwt_stats_t *stats, jwt_stats_t *out)
+{
+	int i;
+
+	out->calls = stat_get(&stats->calls);
+	out->failures = stat_get(&stats->failures);
+
+	for (i = 0; i < JWT_STAGE_COUNT; i++) {
+		out->stage[i].count = stat_get(&stats->stage[i].count);
+		out->stage[i].failures = stat_get(&stats->stage[i].failures);
+		out->stage[i].ns = stat_get(&stats->stage[i].ns);
+	}
+}
+
+#endif /* LIBJWT_HAVE_STATS */
@@ -0,0 +1,256 @@
+/* Copyright (C) 2026 maClara, LLC <info@maclara-llc.com>
+   This file is part of the JWT C Library
+
+   SPDX-License-Identifier:  MPL-2.0
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0. If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/* Verified-signature cache for the checker (jwt_checker_cache()).
+ *
+ * An entry records that a Compact token's signature verified against a key.
+ * It is found by a hash of the token, but a hit also needs the stored token to
+ * match byte for byte, so a hash collision can never stand in for a verify.
+ * The key is identified by its @rfc{7638} SHA-256 thumbprint, which covers
+ * exactly the key material, so the same key loaded twice (or a new embedded
+ * JWK each verify) still hits while a different key at a reused address never
+ * does.
+ *
+ * Only the signature is cached. The token is still parsed, and the callback,
+ * "crit", claims (so exp/nbf against the current time) and jti callback all run
+ * on every verify; a hit skips only jwt_verify_sig().
+ *
+ * Entries are kept on an LRU list (most recent first) and chained in a hash
+ * table. The cache is bounded by entry count, and an entry also expires @ttl
+ * seconds after it was added. A shared checker (jwt_checker_freeze()) may use
+ * its cache from many threads, so every operation holds the cache's mutex.
+ * An evicted entry is freed only after the mutex is dropped, since freeing
+ * may call the user's jwt_set_alloc() hook. */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <jwt.h>
+
+#include "jwt-private.h"
+
+struct jwt_cache_entry {
+	ll_t lru;
+	struct jwt_cache_entry *chain;	/* Next in the hash bucket		*/
+	uint64_t hash;
+	jwt_alg_t alg;
+	time_t added;
+	size_t len;			/* Token length				*/
+	const char *tp;			/* Key thumbprint, after the token	*/
+	char token[];
+};
+
+struct jwt_verify_cache {
+	pthread_mutex_t lock;
+	unsigned int size;		/* Max entries				*/
+	unsigned int count;
+	time_t ttl;			/* Seconds; 0 for no time limit		*/
+	ll_t lru;			/* Most recently used first		*/
+	struct jwt_cache_entry **buckets;
+	size_t mask;
+	unsigned long hits;
+	unsigned long misses;
+};
+
+/* A word at a time; only needs to spread tokens over the buckets. */
+static uint64_t token_hash(const char *token, size_t len)
+{
+	uint64_t h = 0x9e3779b97f4a7c15ull ^ len, w;
+
+	for (; len >= 8; token += 8, len -= 8) {
+		memcpy(&w, token, 8);
+		h = (h ^ w) * 0xff51afd7ed558ccdull;
+		h ^= h >> 32;
+	}
+	if (len) {
+		w = 0;
+		memcpy(&w, token, len);
+		h = (h ^ w) * 0xff51afd7ed558ccdull;
+		h ^= h >> 32;
+	}
+
+	return h;
+}
+
+static void cache_lock(struct jwt_verify_cache *c)
+{
+	pthread_mutex_lock(&c->lock);
+}
+
+static void cache_unlock(struct jwt_verify_cache *c)
+{
+	pthread_mutex_unlock(&c->lock);
+}
+
+/* Takes @e out of the cache; the caller frees it once unlocked. */
+static void entry_unlink(struct jwt_verify_cache *c, struct jwt_cache_entry *e)
+{
+	struct jwt_cache_entry **pp = &c->buckets[e->hash & c->mask];
+
+	while (*pp != e)
+		pp = &(*pp)->chain;
+	*pp = e->chain;
+
+	list_del(&e->lru);
+	c->count--;
+}
+
+struct jwt_verify_cache *jwt_verify_cache_new(unsigned int size, time_t ttl)
+{
+	struct jwt_verify_cache *c;
+	size_t slots;
+
+	c = jwt_malloc(sizeof(*c));
+	if (c == NULL)
+		return NULL; // LCOV_EXCL_LINE
+	memset(c, 0, sizeof(*c));
+
+	/* Keep the chains short: at least as many buckets as entries. */
+	for (slots = 8; slots < size; slots <<= 1)
+		;
+
+	c->buckets = jwt_malloc(slots * sizeof(*c->buckets));
+	if (c->buckets == NULL) {
+		// LCOV_EXCL_START
+		jwt_freemem(c);
+		return NULL;
+		// LCOV_EXCL_STOP
+	}
+	memset(c->buckets, 0, slots * sizeof(*c->buckets));
+
+	pthread_mutex_init(&c->lock, NULL);
+	c->mask = slots - 1;
+	c->size = size;
+	c->ttl = ttl;
+	INIT_LIST_HEAD(&c->lru);
+
+	return c;
+}
+
+void jwt_verify_cache_free(struct jwt_verify_cache *c)
+{
+	struct jwt_cache_entry *e, *tmp;
+
+	if (c == NULL)
+		return;
+
+	list_for_each_entry_safe(e, tmp, &c->lru, lru)
+		jwt_freemem(e);
+
+	pthread_mutex_destroy(&c->lock);
+	jwt_freemem(c->buckets);
+	jwt_freemem(c);
+}
+
+int jwt_verify_cache_lookup(struct jwt_verify_cache *c, const char *token,
+			    size_t len, const jwk_item_t *key, jwt_alg_t alg)
+{
+	struct jwt_cache_entry *e, *stale = NULL;
+	const char *tp;
+	uint64_t h;
+	time_t now;
+	int hit = 0;
+
+	tp = jwks_item_thumbprint_get(key, JWK_THUMBPRINT_SHA256);
+	if (tp == NULL)
+		return 0;
+
+	h = token_hash(token, len);
+	now = time(NULL);
+
+	cache_lock(c);
+
+	for (e = c->buckets[h & c->mask]; e != NULL; e = e->chain) {
+		if (e->hash != h || e->len != len || e->alg != alg ||
+		    memcmp(e->token, token, len) || strcmp(e->tp, tp))
+			continue;
+
+		if (c->ttl && now - e->added >= c->ttl) {
+			entry_unlink(c, e);
+			stale = e;
+			break;
+		}
+
+		list_del(&e->lru);
+		list_add(&e->lru, &c->lru);
+		hit = 1;
+		break;
+	}
+
+	if (hit)
+		c->hits++;
+	else
+		c->misses++;
+
+	cache_unlock(c);
+
+	jwt_freemem(stale);
+
+	return hit;
+}
+
+void jwt_verify_cache_add(struct jwt_verify_cache *c, const char *token,
+			  size_t len, const jwk_item_t *key, jwt_alg_t alg)
+{
+	struct jwt_cache_entry *e, *old = NULL, **bucket;
+	const char *tp;
+	size_t tp_len;
+
+	tp = jwks_item_thumbprint_get(key, JWK_THUMBPRINT_SHA256);
+	if (tp == NULL)
+		return;
+	tp_len = strlen(tp) + 1;
+
+	/* Built outside the lock; a racing add of the same token just leaves
+	 * a duplicate that ages out. */
+	e = jwt_malloc(sizeof(*e) + len + 1 + tp_len);
+	if (e == NULL)
+		return; // LCOV_EXCL_LINE
+
+	e->hash = token_hash(token, len);
+	e->alg = alg;
+	e->added = time(NULL);
+	e->len = len;
+	memcpy(e->token, token, len);
+	e->token[len] = '\0';
+	memcpy(e->token + len + 1, tp, tp_len);
+	e->tp = e->token + len + 1;
+
+	cache_lock(c);
+
+	if (c->count >= c->size) {
+		old = list_entry(c->lru.prev, struct jwt_cache_entry, lru);
+		entry_unlink(c, old);
+	}
+
+	bucket = &c->buckets[e->hash & c->mask];
+	e->chain = *bucket;
+	*bucket = e;
+	list_add(&e->lru, &c->lru);
+	c->count++;
+
+	cache_unlock(c);
+
+	jwt_freemem(old);
+}
+
+void jwt_verify_cache_stats(struct jwt_verify_cache *c, unsigned long *hits,
+			    unsigned long *misses, unsigned int *entries)
+{
+	cache_lock(c);
+	if (hits)
+		*hits = c->hits;
+	if (misses)
+		*misses = c->misses;
+	if (entries)
+		*entries = c->count;
+	cache_unlock(c);
+}
@@ -15,54 +15,132 @@
 
 #include "jwt-private.h"
 
-static jwt_json_t *jwt_base64uri_decode_to_json(char *src)
+/* Decoded headers and claim sets up to this size are staged on the stack;
+ * only larger segments cost a heap allocation. */
+#define JWT_SEGMENT_STACK_BUF	2048
+
+/* @rfc{8725,2.4} Non-zero if the JSON document @buf[0 .. @len) has a duplicate
+ * member at any depth (or is not JSON at all). Jansson refuses duplicates while parsing. json-c keeps
+ * the last and cannot be told otherwise, so there jwt_claims_scan(), which
+ * refuses them too, reads the document first. It unescapes in place, so it
+ * reads a copy. */
+static int jwt_json_dup_check(const unsigned char *buf, size_t len)
 {
-	jwt_json_t *js;
-	char *buf;
-	int len;
+#ifdef HAVE_JSON_C
+	struct jwt_claims_scan cs;
+	char *copy;
+	int ret;
 
-	buf = jwt_base64uri_decode(src, &len);
+	copy = jwt_malloc(len);
+	if (copy == NULL)
+		return 1; // LCOV_EXCL_LINE
+	memcpy(copy, buf, len);
 
-	if (buf == NULL)
-		return NULL; // LCOV_EXCL_LINE
+	ret = jwt_claims_scan(&cs, copy, len, NULL, 0);
+
+	jwt_claims_scan_free(&cs);
+	jwt_freemem(copy);
 
-	buf[len] = '\0';
+	return ret;
+#else
+	(void)buf;
+	(void)len;
+
+	return 0;
+#endif
+}
+
+/* Decode the base64url segment @src[0 .. @len) and parse it as JSON. @src is a
+ * view into the caller's token: it is neither copied nor NUL-terminated, and
+ * the decoded octets go to the JSON backend length-bounded. With @lim, a
+ * segment decoding to more than @max octets, or JSON over its limits, sets
+ * @over and is never parsed. */
+static jwt_json_t *jwt_base64uri_decode_to_json(const char *src, size_t len,
+						const jwt_limits_t *lim,
+						size_t max, int *over)
+{
+	unsigned char stack_buf[JWT_SEGMENT_STACK_BUF];
+	unsigned char *buf = stack_buf;
+	jwt_json_t *js = NULL;
+	int dec_len;
+
+	*over = 0;
+	if (lim != NULL && JWT_LIMIT_B64(max, len)) {
+		*over = 1;
+		return NULL;
+	}
+
+	if (JWT_BASE64URI_DECODE_SIZE(len) > sizeof(stack_buf)) {
+		buf = jwt_malloc(JWT_BASE64URI_DECODE_SIZE(len));
+		if (buf == NULL)
+			return NULL; // LCOV_EXCL_LINE
+	}
+
+	dec_len = jwt_base64uri_decode_buf(src, len, buf);
 
 	/* @rfc{8725,2.4} Reject duplicate members in the token header/payload so
 	 * a peer that selects a different occurrence cannot be made to disagree
-	 * with us about a claim/header. Supported by the Jansson backend; json-c
-	 * cannot reject duplicates (it keeps the last), a documented limitation. */
-	js = jwt_json_parse(buf, JWT_JSON_REJECT_DUPLICATES, NULL);
+	 * with us about a claim/header, whichever JSON backend is built. */
+	if (dec_len > 0 && lim != NULL &&
+	    jwt_limits_json(lim, (const char *)buf, dec_len, 1)) {
+		*over = 1;
+	} else if (dec_len > 0) {
+		JWT_STAGE_BEGIN(t);
+
+		if (!jwt_json_dup_check(buf, dec_len))
+			js = jwt_json_parse_buf((const char *)buf, dec_len,
+						JWT_JSON_REJECT_DUPLICATES,
+						NULL);
+		JWT_STAGE_END(JWT_STAGE_JSON, t, js == NULL);
+	}
 
-	jwt_freemem(buf);
+	if (buf != stack_buf)
+		jwt_freemem(buf);
 
 	return js;
 }
 
-static int jwt_parse_payload(jwt_t *jwt, char *payload)
+static int jwt_parse_payload(jwt_t *jwt, const char *payload, size_t len)
 {
+	const jwt_limits_t *lim = jwt->limits;
+	int over;
+
 	if (jwt->claims)
 		jwt_json_releasep(&(jwt->claims));
 
-	jwt->claims = jwt_base64uri_decode_to_json(payload);
+	jwt->claims = jwt_base64uri_decode_to_json(payload, len, lim,
+				lim ? lim->max_payload_len : 0, &over);
+	if (over) {
+		jwt_set_error(jwt, JWT_ERR_LIMIT,
+			      "Payload exceeds an input limit");
+		return 1;
+	}
 	if (!jwt->claims) {
-		jwt_write_error(jwt, "Error parsing payload");
+		jwt_set_error(jwt, JWT_ERR_MALFORMED, "Error parsing payload");
 		return 1;
 	}
 
 	return 0;
 }
 
-static int jwt_parse_head(jwt_t *jwt, char *head)
+static int jwt_parse_head(jwt_t *jwt, const char *head, size_t len)
 {
+	const jwt_limits_t *lim = jwt->limits;
 	jwt_json_t *jalg;
+	int over;
 
 	if (jwt->headers)
 		jwt_json_releasep(&(jwt->headers));
 
-	jwt->headers = jwt_base64uri_decode_to_json(head);
+	jwt->headers = jwt_base64uri_decode_to_json(head, len, lim,
+				lim ? lim->max_header_len : 0, &over);
+	if (over) {
+		jwt_set_error(jwt, JWT_ERR_LIMIT,
+			      "Header exceeds an input limit");
+		return 1;
+	}
 	if (!jwt->headers) {
-		jwt_write_error(jwt, "Error parsing header");
+		jwt_set_error(jwt, JWT_ERR_MALFORMED, "Error parsing header");
 		return 1;
 	}
 
@@ -75,14 +153,16 @@ static int jwt_parse_head(jwt_t *jwt, char *head)
 		jwt->alg = jwt_str_alg(alg);
 
 		if (jwt->alg >= JWT_ALG_INVAL) {
-			jwt_write_error(jwt, "Invalid ALG: [%s]", alg);
+			jwt_write_error_code(jwt, JWT_ERR_ALG_DENIED,
+					     "Invalid ALG: [%s]", alg);
 			return 1;
 		}
 
 		return 0;
 	}
 
-	jwt_write_error(jwt, "Missing or invalid \"alg\" header");
+	jwt_set_error(jwt, JWT_ERR_MALFORMED,
+		      "Missing or invalid \"alg\" header");
 
 	return 1;
 }
@@ -208,38 +288,31 @@ static int jwt_payload_b64(jwt_t *jwt, int *b64)
 	return 0;
 }
 
-int jwt_parse(jwt_t *jwt, const char *token, unsigned int *len)
+/* Header pass over the caller's token: the segments are (pointer, length)
+ * views into @token[0 .. @token_len), never copied. Only the header is
+ * decoded; the payload is located and left for jwt_parse_claims(), so a token
+ * the header already disqualifies never has its payload decoded or parsed.
+ * @token need not be NUL-terminated. */
+int jwt_parse_header(jwt_t *jwt, const char *token, size_t token_len,
+		     unsigned int *len)
 {
-	char_auto *buf = NULL;
-	char *payload, *sig, *dot, *lastdot = NULL;
-	int buf_len = strlen(token) + 1;
+	const char *end, *payload, *dot;
 	int b64;
 
-	buf = jwt_malloc(buf_len);
-	if (!buf) {
-		// LCOV_EXCL_START
-		jwt_write_error(jwt, "Error allocating memory");
-		return 1;
-		// LCOV_EXCL_STOP
-	}
-
-	/* buf_len includes nil */
-	memcpy(buf, token, buf_len);
+	end = token + token_len;
 
 	/* Header: everything up to the first '.'. */
-	for (payload = buf; payload[0] != '.'; payload++) {
-		if (payload[0] == '\0') {
-			jwt_write_error(jwt,
-				"No dot found looking for end of header");
-			return 1;
-		}
+	payload = memchr(token, '.', token_len);
+	if (payload == NULL) {
+		jwt_set_error(jwt, JWT_ERR_MALFORMED,
+			      "No dot found looking for end of header");
+		return 1;
 	}
-	payload[0] = '\0';
-	payload++;
 
 	/* Parse the header now so we know the "b64" setting. */
-	if (jwt_parse_head(jwt, buf))
+	if (jwt_parse_head(jwt, token, payload - token))
 		return 1;
+	payload++;
 
 	/* @rfc{7797} Determine the payload encoding (and enforce crit). */
 	if (jwt_payload_b64(jwt, &b64))
@@ -248,42 +321,57 @@ int jwt_parse(jwt_t *jwt, const char *token, unsigned int *len)
 
 	if (b64) {
 		/* Standard: the payload is between the 1st and 2nd '.'. */
-		for (sig = payload; sig[0] != '.'; sig++) {
-			if (sig[0] == '\0') {
-				jwt_write_error(jwt,
-					"No dot found looking for end of payload");
-				return 1;
-			}
+		dot = memchr(payload, '.', end - payload);
+		if (dot == NULL) {
+			jwt_set_error(jwt, JWT_ERR_MALFORMED,
+				"No dot found looking for end of payload");
+			return 1;
 		}
-		sig[0] = '\0';
-		sig++;	/* point past the dot, as the b64=false branch does */
 
-		if (jwt_parse_payload(jwt, payload))
-			return 1;
+		jwt->claims_b64 = payload;
+		jwt->claims_b64_len = dot - payload;
 	} else {
 		/* @rfc{7797,5.2} Unencoded: the signature is after the LAST '.'
 		 * and the raw payload (which may itself contain '.') is between
 		 * the 1st and last '.'. The raw payload is not JSON claims. */
-		for (dot = payload; dot[0] != '\0'; dot++) {
-			if (dot[0] == '.')
-				lastdot = dot;
-		}
-		if (lastdot == NULL) {
-			jwt_write_error(jwt,
+		for (dot = end; dot > payload && dot[-1] != '.'; dot--)
+			;
+		if (dot == payload) {
+			jwt_set_error(jwt, JWT_ERR_MALFORMED,
 				"No dot found looking for signature");
 			return 1;
 		}
-		*lastdot = '\0';
-		sig = lastdot + 1;
+		dot--;
+
+		if (jwt->limits && jwt->limits->max_payload_len &&
+		    (size_t)(dot - payload) > jwt->limits->max_payload_len) {
+			jwt_set_error(jwt, JWT_ERR_LIMIT,
+				      "Payload exceeds an input limit");
+			return 1;
+		}
 	}
 
-	/* @rfc{7515,5.1}/@rfc{7797,3} The signing input is buf[0 .. sig's dot],
+	/* @rfc{7515,5.1}/@rfc{7797,3} The signing input is token[0 .. dot),
 	 * i.e. BASE64URL(header) "." (base64url or raw) payload. */
-	*len = (sig - 1) - buf;
+	*len = dot - token;
 
 	return 0;
 }
 
+/* Payload pass: decode the claims jwt_parse_header() located, once. Nothing
+ * to do for an unencoded payload or if they are already decoded. */
+int jwt_parse_claims(jwt_t *jwt)
+{
+	const char *payload = jwt->claims_b64;
+
+	if (payload == NULL)
+		return 0;
+
+	jwt->claims_b64 = NULL;
+
+	return jwt_parse_payload(jwt, payload, jwt->claims_b64_len);
+}
+
 /* @rfc{7519,4.1.3} "aud" may be a single string OR an array of strings. Return
  * 1 if the expected audience is among the array elements, 0 otherwise. */
 static int __aud_matches_array(jwt_t *jwt, const char *want)
@@ -405,7 +493,7 @@ static int __verify_required(jwt_t *jwt)
 		 * an array "aud") still returns a non-NOEXIST error, i.e. present. */
 		jwt_set_GET_STR(&jval, name);
 		if (jwt_claim_get(jwt, &jval) == JWT_VALUE_ERR_NOEXIST) {
-			jwt_write_error(jwt,
+			jwt_write_error_code(jwt, JWT_ERR_CLAIMS,
 				"Required claim \"%s\" is missing", name);
 			return 1;
 		}
@@ -414,6 +502,158 @@ static int __verify_required(jwt_t *jwt)
 	return 0;
 }
 
+static int __scan_str_ok(const struct jwt_json_view *v, const char *want)
+{
+	size_t len = strlen(want);
+
+	return v->len == len && !memcmp(v->str, want, len);
+}
+
+/* __check_str_claim() against a scan: absent or not a string fails, and
+ * "aud" passes if the expected audience is the string or in the array. */
+static int __scan_check_str(jwt_t *jwt, const struct jwt_claims_scan *cs,
+			    jwt_claims_t claim)
+{
+	const char *want;
+	size_t i;
+
+	if (!(jwt->checker->c.claims & claim))
+		return 0;
+
+	want = jwt_checker_claim_get(jwt->checker, claim);
+	if (want == NULL || !(cs->typed & claim))
+		return 1;
+
+	switch (claim) {
+	case JWT_CLAIM_ISS:
+		return !__scan_str_ok(&cs->iss, want);
+	case JWT_CLAIM_SUB:
+		return !__scan_str_ok(&cs->sub, want);
+	default:
+		for (i = 0; i < cs->n_aud; i++)
+			if (__scan_str_ok(&cs->aud[i], want))
+				return 0;
+		return 1;
+	}
+}
+
+/* __verify_claims() against a scan of the payload. */
+static jwt_claims_t __scan_verify_claims(jwt_t *jwt,
+					 const struct jwt_claims_scan *cs)
+{
+	jwt_checker_t *checker = jwt->checker;
+	time_t now = time(NULL);
+	jwt_claims_t failed = 0;
+
+	/* A registered time claim that is not an integer fails, as its
+	 * jwt_claim_get() type error does. */
+	if (checker->c.claims & JWT_CLAIM_EXP && cs->found & JWT_CLAIM_EXP) {
+		if (!(cs->typed & JWT_CLAIM_EXP) ||
+		    cs->exp <= (now - checker->c.exp))
+			failed |= JWT_CLAIM_EXP;
+	}
+
+	if (checker->c.claims & JWT_CLAIM_NBF && cs->found & JWT_CLAIM_NBF) {
+		if (!(cs->typed & JWT_CLAIM_NBF) ||
+		    cs->nbf > (now + checker->c.nbf))
+			failed |= JWT_CLAIM_NBF;
+	}
+
+	if (__scan_check_str(jwt, cs, JWT_CLAIM_ISS))
+		failed |= JWT_CLAIM_ISS;
+
+	if (__scan_check_str(jwt, cs, JWT_CLAIM_SUB))
+		failed |= JWT_CLAIM_SUB;
+
+	if (__scan_check_str(jwt, cs, JWT_CLAIM_AUD))
+		failed |= JWT_CLAIM_AUD;
+
+	return failed;
+}
+
+/* The payload checks of jwt_verify_complete() without a JSON tree: decode
+ * the payload jwt_parse_header() located, scan it, and check the registered
+ * and required claims against what the scan kept. Nothing can see the jwt_t
+ * afterwards, so the claims are never built. */
+static int __verify_claims_scan(jwt_t *jwt)
+{
+	jwt_checker_t *checker = jwt->checker;
+	char stack_buf[JWT_SEGMENT_STACK_BUF], *buf = stack_buf;
+	struct jwt_claims_scan cs;
+	size_t len = jwt->claims_b64_len, i;
+	int dec_len, scanned, ret = 1;
+	jwt_claims_t failed;
+
+	if (JWT_LIMIT_B64(checker->c.limits.max_payload_len, len)) {
+		jwt_set_error(jwt, JWT_ERR_LIMIT,
+			      "Payload exceeds an input limit");
+		return 1;
+	}
+
+	if (JWT_BASE64URI_DECODE_SIZE(len) > sizeof(stack_buf)) {
+		buf = jwt_malloc(JWT_BASE64URI_DECODE_SIZE(len));
+		if (buf == NULL) {
+			// LCOV_EXCL_START
+			jwt_set_error(jwt, JWT_ERR_MALFORMED, "Error parsing payload");
+			return 1;
+			// LCOV_EXCL_STOP
+		}
+	}
+
+	dec_len = jwt_base64uri_decode_buf(jwt->claims_b64, len,
+					   (unsigned char *)buf);
+
+	if (dec_len <= 0) {
+		jwt_set_error(jwt, JWT_ERR_MALFORMED, "Error parsing payload");
+		goto out;
+	}
+
+	if (jwt_limits_json(&checker->c.limits, buf, dec_len, 1)) {
+		jwt_set_error(jwt, JWT_ERR_LIMIT,
+			      "Payload exceeds an input limit");
+		goto out;
+	}
+
+	{
+		JWT_STAGE_BEGIN(t);
+
+		scanned = !jwt_claims_scan(&cs, buf, dec_len,
+					   checker->c.require,
+					   checker->c.n_require);
+		JWT_STAGE_END(JWT_STAGE_JSON, t, !scanned);
+	}
+	if (!scanned) {
+		jwt_set_error(jwt, JWT_ERR_MALFORMED, "Error parsing payload");
+		goto done;
+	}
+
+	failed = __scan_verify_claims(jwt, &cs);
+	if (failed) {
+		jwt_set_claims_error(jwt, failed);
+		goto done;
+	}
+
+	/* @rfc{9068} Required claims must be present, of any type. */
+	for (i = 0; i < checker->c.n_require; i++) {
+		if (!(cs.names_found & (1ULL << i))) {
+			jwt_write_error_code(jwt, JWT_ERR_CLAIMS,
+					     "Required claim \"%s\" is missing",
+					     checker->c.require[i]);
+			goto done;
+		}
+	}
+
+	ret = 0;
+
+done:
+	jwt_claims_scan_free(&cs);
+out:
+	if (buf != stack_buf)
+		jwt_freemem(buf);
+
+	return ret;
+}
+
 /* @rfc{7515,4.1.3} Build and CONFIRM the verification key from a protected
  * header's "jwk". The header key is attacker-supplied, so it is accepted only
  * after its thumbprint matches the checker's pin (c->embedded_jkt) or is found
@@ -428,7 +668,7 @@ jwk_set_t *jwt_embedded_jwk_key(struct jwt_common *c, jwt_json_t *headers,
 	char *jwk_str;
 	jwk_set_t *ks;
 	const jwk_item_t *item;
-	char *tp;
+	const char *tp;
 	int ok;
 
 	*out = NULL;
@@ -466,7 +706,7 @@ jwk_set_t *jwt_embedded_jwk_key(struct jwt_common *c, jwt_json_t *headers,
 	}
 
 	/* Confirm the attacker-supplied key against the pin or the allowlist. */
-	tp = jwks_item_thumbprint(item, c->embedded_alg);
+	tp = jwks_item_thumbprint_get(item, c->embedded_alg);
 	if (tp == NULL) {
 		jwks_free(ks);
 		return NULL;
@@ -478,7 +718,6 @@ jwk_set_t *jwt_embedded_jwk_key(struct jwt_common *c, jwt_json_t *headers,
 		ok = (c->embedded_keyring != NULL &&
 		      jwks_find_bythumbprint((jwk_set_t *)c->embedded_keyring,
 					     c->embedded_alg, tp) != NULL);
-	jwt_freemem(tp);
 
 	if (!ok) {
 		jwks_free(ks);
@@ -566,32 +805,28 @@ static int jwt_typ_alg_ok(jwt_t *jwt)
 	return 1;
 }
 
-static int __verify_config_post(jwt_t *jwt, const jwt_config_t *config,
-				unsigned int sig_len)
+/* @rfc{8725} The typ expectation and algorithm allowlist. These need only
+ * the header, so they run before anything else looks at the token. */
+int jwt_verify_policy(jwt_t *jwt)
 {
-	/* @rfc{8725} Enforce the typ expectation / algorithm allowlist first. */
 	if (!jwt_typ_alg_ok(jwt)) {
-		jwt_write_error(jwt,
+		jwt_set_error(jwt, JWT_ERR_ALG_DENIED,
 			"Token rejected by \"typ\" or algorithm policy");
 		return 1;
 	}
 
-	/* Yes, we do this before checking a signature. @rfc{7797} An unencoded
-	 * (b64=false) payload is opaque, not JSON claims, so skip claim checks. */
-	if (jwt->b64 && __verify_claims(jwt)) {
-		/* TODO Pass back the ORd list of claims failed. */
-		jwt_write_error(jwt, "Failed one or more claims");
-		return 1;
-	}
-
-	/* @rfc{9068} Required claims must be present (also JSON-claims only). */
-	if (jwt->b64 && __verify_required(jwt))
-		return 1;
+	return 0;
+}
 
+/* Check for conflicts between the token's header and the key and alg the
+ * caller settled on. Also header-only, so done before the payload is
+ * decoded. */
+int jwt_verify_bind(jwt_t *jwt, const jwt_config_t *config, size_t sig_len)
+{
 	if (!sig_len) {
 		if (config->key || config->alg != JWT_ALG_NONE ||
 		    jwt->alg != JWT_ALG_NONE) {
-			jwt_write_error(jwt,
+			jwt_set_error(jwt, JWT_ERR_ALG_DENIED,
 				"Expected a signature, but JWT has none");
 			return 1;
 		}
@@ -601,12 +836,13 @@ static int __verify_config_post(jwt_t *jwt, const jwt_config_t *config,
 
 	/* Signature is known to be present from this point */
 	if (jwt->alg == JWT_ALG_NONE) {
-		jwt_write_error(jwt, "JWT has signature block, but no alg set");
+		jwt_set_error(jwt, JWT_ERR_MALFORMED,
+			      "JWT has signature block, but no alg set");
 		return 1;
 	}
 
 	if (config->key == NULL) {
-		jwt_write_error(jwt,
+		jwt_set_error(jwt, JWT_ERR_KID_UNKNOWN,
 			"JWT has signature, but no key was given");
 		return 1;
 	}
@@ -614,12 +850,14 @@ static int __verify_config_post(jwt_t *jwt, const jwt_config_t *config,
 	/* Key is known to be given at this point */
 	if (config->alg == JWT_ALG_NONE) {
 		if (config->key->alg != jwt->alg) {
-			jwt_write_error(jwt, "Key alg does not match JWT");
+			jwt_set_error(jwt, JWT_ERR_ALG_DENIED,
+				      "Key alg does not match JWT");
 			return 1;
 		}
 	} else if (config->key->alg == JWT_ALG_NONE) {
 		if (config->alg != jwt->alg) {
-			jwt_write_error(jwt, "Config alg does not match JWT");
+			jwt_set_error(jwt, JWT_ERR_ALG_DENIED,
+				      "Config alg does not match JWT");
 			return 1;
 		}
 	} else if (config->alg != config->key->alg) {
@@ -643,11 +881,13 @@ static int __verify_config_post(jwt_t *jwt, const jwt_config_t *config,
 	 * agreement with whichever alg the caller pinned. Purely additive: no
 	 * legitimately-pinned token is newly rejected. */
 	if (config->alg != JWT_ALG_NONE && jwt->alg != config->alg) {
-		jwt_write_error(jwt, "JWT alg does not match pinned config alg");
+		jwt_set_error(jwt, JWT_ERR_ALG_DENIED,
+			      "JWT alg does not match pinned config alg");
 		return 1;
 	} else if (config->key->alg != JWT_ALG_NONE &&
 		   jwt->alg != config->key->alg) {
-		jwt_write_error(jwt, "JWT alg does not match pinned key alg");
+		jwt_set_error(jwt, JWT_ERR_ALG_DENIED,
+			      "JWT alg does not match pinned key alg");
 		return 1;
 	}
 
@@ -656,42 +896,84 @@ static int __verify_config_post(jwt_t *jwt, const jwt_config_t *config,
 	 * confusion (GHSA-q843-6q5f-w55g) even if a malformed JWK has an
 	 * "alg" hint that disagrees with its "kty". */
 	if (jwt_alg_required_kty(jwt->alg) != config->key->kty) {
-		jwt_write_error(jwt, "Key type does not match JWT alg");
+		jwt_set_error(jwt, JWT_ERR_ALG_DENIED,
+			      "Key type does not match JWT alg");
 		return 1;
 	}
 
 	return 0;
 }
 
+/* The payload half of a Compact verify: claims, signature, then jti. The
+ * header checks (jwt_verify_policy(), "crit", jwt_verify_bind()) have passed
+ * and the claims have been decoded. */
 jwt_t *jwt_verify_complete(jwt_t *jwt, const jwt_config_t *config,
-			   const char *token, unsigned int payload_len)
+			   const char *token, size_t token_len,
+			   unsigned int payload_len)
 {
 	const char *sig;
-	unsigned int sig_len;
+	size_t sig_len;
 
+	/* jwt_parse_header() left payload_len at the dot before the signature. */
 	sig = token + (payload_len + 1);
-	sig_len = strlen(sig);
+	sig_len = token_len - (payload_len + 1);
 
-	/* Check for conflicts in user request and JWT, and run the read-only
-	 * claim checks (exp/nbf/iss/sub/aud). */
-	if (__verify_config_post(jwt, config, sig_len))
-		return jwt;
+	/* Yes, we do this before checking a signature. @rfc{7797} An unencoded
+	 * (b64=false) payload is opaque, not JSON claims, so skip claim checks.
+	 * Claims still undecoded are checked from a scan of the payload. */
+	if (jwt->b64) {
+		jwt_claims_t failed;
+		JWT_STAGE_BEGIN(t);
+
+		if (jwt->claims_b64 != NULL) {
+			__verify_claims_scan(jwt);
+		} else if ((failed = __verify_claims(jwt))) {
+			jwt_set_claims_error(jwt, failed);
+		} else {
+			/* @rfc{9068} Required claims must be present. */
+			__verify_required(jwt);
+		}
+
+		JWT_STAGE_END(JWT_STAGE_CLAIMS, t, jwt->error);
+		if (jwt->error)
+			return jwt;
+	}
 
 	/* After all the checks, if we don't have a sig, we can move on. */
 	if (sig_len) {
+		struct jwt_verify_cache *cache = jwt->checker ?
+			jwt->checker->c.cache : NULL;
+
 		/* At this point, config is never NULL */
 		jwt->key = config->key;
 
-		jwt = jwt_verify_sig(jwt, token, payload_len, sig);
-		if (jwt->error)
-			return jwt;
+		/* A cache hit means these exact bytes already verified against
+		 * this key; everything above and the jti check below still ran. */
+		if (cache == NULL || !jwt_verify_cache_lookup(cache, token,
+				token_len, jwt->key, jwt->alg)) {
+			jwt = jwt_verify_sig(jwt, token, payload_len, sig,
+					     sig_len);
+			if (jwt->error)
+				return jwt;
+
+			if (cache != NULL)
+				jwt_verify_cache_add(cache, token, token_len,
+						     jwt->key, jwt->alg);
+		}
 	}
 
 	/* Signature has now verified (or there is none and "none" was
 	 * permitted). Only now run the jti replay callback, which may mutate
 	 * external state and must not fire on an unauthenticated token. */
-	if (__verify_jti(jwt))
-		jwt_write_error(jwt, "Failed one or more claims");
+	if (jwt->checker->c.jti_check) {
+		jwt_claims_t failed;
+		JWT_STAGE_BEGIN(t);
+
+		failed = __verify_jti(jwt);
+		if (failed)
+			jwt_set_claims_error(jwt, failed);
+		JWT_STAGE_END(JWT_STAGE_CLAIMS, t, jwt->error);
+	}
 
 	return jwt;
 }
@@ -733,6 +1015,7 @@ static int build_sig_entry(jwt_checker_t *checker, jwt_json_t *entry)
 	const char *prot_b64, *sig_b64, *alg_str;
 	struct jwt_signature *s;
 	jwt_alg_t alg;
+	int over;
 
 	prot_b64 = json_str(entry, "protected");
 	sig_b64 = json_str(entry, "signature");
@@ -742,10 +1025,18 @@ static int build_sig_entry(jwt_checker_t *checker, jwt_json_t *entry)
 		return 1;
 	}
 
-	prot_obj = jwt_base64uri_decode_to_json((char *)prot_b64);
+	prot_obj = jwt_base64uri_decode_to_json(prot_b64, strlen(prot_b64),
+				&checker->c.limits,
+				checker->c.limits.max_header_len, &over);
+	if (over) {
+		jwt_set_error(checker, JWT_ERR_LIMIT,
+			      "Header exceeds an input limit");
+		return 1;
+	}
 	if (prot_obj == NULL || !jwt_json_is_object(prot_obj)) {
 		jwt_json_release(prot_obj);
-		jwt_write_error(checker, "JWS protected header is not valid JSON");
+		jwt_set_error(checker, JWT_ERR_MALFORMED,
+			      "JWS protected header is not valid JSON");
 		return 1;
 	}
 
@@ -755,7 +1046,8 @@ static int build_sig_entry(jwt_checker_t *checker, jwt_json_t *entry)
 	alg = alg_str ? jwt_str_alg(alg_str) : JWT_ALG_INVAL;
 	if (alg == JWT_ALG_NONE || alg >= JWT_ALG_INVAL) {
 		jwt_json_release(prot_obj);
-		jwt_write_error(checker, "JWS signature has an invalid \"alg\"");
+		jwt_set_error(checker, JWT_ERR_ALG_DENIED,
+			      "JWS signature has an invalid \"alg\"");
 		return 1;
 	}
 
@@ -801,6 +1093,38 @@ static int build_sig_entry(jwt_checker_t *checker, jwt_json_t *entry)
 	return 0;
 }
 
+/* One signature's verify: its key is chosen on the calling thread (where the
+ * user callback runs), and the crypto may then run on any thread. */
+struct sig_job {
+	struct jwt_signature *s;
+	const jwk_item_t *key;	/* Explicit key, else scan @ring	*/
+	const jwk_set_t *ring;	/* Keyring to scan, or NULL		*/
+	char *input;		/* protected_b64 "." payload_b64	*/
+	int skip;		/* Not accepted before any crypto	*/
+	int unknown_kid;	/* Skipped: "kid" not in the keyring	*/
+};
+
+struct sig_jobs {
+	struct sig_job *jobs;
+	size_t n;
+	jwt_verify_policy_t policy;
+	int early;		/* Stop once the policy is decided	*/
+	int stop;
+};
+
+static void sig_jobs_free(struct sig_jobs *sj)
+{
+	size_t i;
+
+	if (sj->jobs == NULL)
+		return;
+
+	for (i = 0; i < sj->n; i++)
+		jwt_freemem(sj->jobs[i].input);
+	jwt_freemem(sj->jobs);
+	sj->jobs = NULL;
+}
+
 /* Try one candidate key against signature @s over @input. Applies the
  * algorithm/key-type anti-confusion gate (GHSA-q843-6q5f-w55g) before any
  * verify, and routes the crypto to the key's origin backend via jwt_item_ops()
@@ -827,40 +1151,37 @@ static void try_candidate(jwt_t *jwt, struct jwt_signature *s,
 
 	jwt->alg = s->alg;
 	jwt->key = key;
-	jwt->error = 0;
-	jwt->error_msg[0] = '\0';
+	jwt_clear_error(jwt);
 
-	jwt_verify_sig(jwt, input, input_len, s->sig_b64);
+	jwt_verify_sig(jwt, input, input_len, s->sig_b64, strlen(s->sig_b64));
 
 	if (!jwt->error) {
 		s->verified = 1;
 		s->key = key;
 	}
-
-	/* Don't let a failed attempt's error leak into the checker result. */
-	jwt->error = 0;
-	jwt->error_msg[0] = '\0';
 }
 
-/* Verify one signature entry: run the optional per-signature callback, select
- * the key (the checker's single key, a "kid"-named keyring key, or every
- * compatible keyring key), and verify. */
-static int verify_entry(jwt_checker_t *checker, jwt_t *jwt,
-			struct jwt_signature *s, const char *payload_b64,
-			int payload_len)
+/* Prepare one signature entry: check its header, run the optional
+ * per-signature callback, and select the key (the checker's single key, a
+ * "kid"-named keyring key, or every compatible keyring key). */
+static int prepare_entry(jwt_checker_t *checker, jwt_t *jwt,
+			 struct jwt_signature *s, const char *payload_b64,
+			 int payload_len, struct sig_job *job)
 {
 	JWT_CONFIG_DECLARE(config);
 	const jwk_set_t *ring = checker->c.keyring;
-	char_auto *input = NULL;
 	const char *kid;
 	int prot_len, scan;
 
+	job->s = s;
+	job->skip = 1;
+
 	/* @rfc{7515,5.1} Signing input is the VERBATIM protected_b64 "." payload_b64. */
 	prot_len = (int)strlen(s->protected_b64);
-	input = jwt_malloc((size_t)prot_len + payload_len + 2);
-	if (input == NULL)
+	job->input = jwt_malloc((size_t)prot_len + payload_len + 2);
+	if (job->input == NULL)
 		return 1; // LCOV_EXCL_LINE
-	sprintf(input, "%s.%s", s->protected_b64, payload_b64);
+	sprintf(job->input, "%s.%s", s->protected_b64, payload_b64);
 
 	/* This signature's header drives crit/callback. */
 	jwt->headers = s->protected;
@@ -894,9 +1215,12 @@ static int verify_entry(jwt_checker_t *checker, jwt_t *jwt,
 	 * fallback), or the checker's single key. A keyless keyring entry scans. */
 	kid = json_str(s->protected, "kid");
 	if (ring != NULL) {
+		JWT_STAGE_BEGIN(t);
+
 		config.key = (kid != NULL)
 			? jwks_find_bykid((jwk_set_t *)ring, kid) : NULL;
 		scan = (kid == NULL);
+		JWT_STAGE_END(JWT_STAGE_KEY, t, !scan && config.key == NULL);
 	} else {
 		config.key = checker->c.key;
 		scan = 0;
@@ -910,88 +1234,195 @@ static int verify_entry(jwt_checker_t *checker, jwt_t *jwt,
 		return 0;
 	}
 
-	if (config.key != NULL) {
-		/* Explicit key (kid match, single key, or callback override). */
-		try_candidate(jwt, s, config.key, input, (unsigned int)strlen(input));
-	} else if (scan) {
-		size_t i, n = jwks_item_count(ring);
+	/* Explicit key (kid match, single key, or callback override). */
+	job->key = config.key;
+	job->ring = (config.key == NULL && scan) ? ring : NULL;
+	job->skip = (job->key == NULL && job->ring == NULL);
+	job->unknown_kid = (job->skip && ring != NULL && kid != NULL);
+
+	jwt->headers = NULL;
+
+	return 0;
+}
 
-		for (i = 0; i < n && !s->verified; i++) {
-			const jwk_item_t *k = jwks_item_get(ring, i);
-			jwt_alg_t kalg = jwks_item_alg(k);
+/* Whether another job has already decided the policy. */
+static int sig_jobs_stopped(struct sig_jobs *sj)
+{
+	return sj->early && __atomic_load_n(&sj->stop, __ATOMIC_ACQUIRE);
+}
 
-			if (kalg != JWT_ALG_NONE && kalg != s->alg)
-				continue;
-			try_candidate(jwt, s, k, input, (unsigned int)strlen(input));
+/* Verify one prepared signature. Each run has its own scratch JWT, as only
+ * the alg, key and error are used to verify; runs may share the keys. */
+static void run_entry(void *arg, size_t i)
+{
+	struct sig_jobs *sj = arg;
+	struct sig_job *job = &sj->jobs[i];
+	struct jwt_signature *s = job->s;
+	unsigned int input_len;
+	struct jwt scratch;
+
+	if (!job->skip) {
+		memset(&scratch, 0, sizeof(scratch));
+		input_len = (unsigned int)strlen(job->input);
+
+		if (job->key != NULL) {
+			try_candidate(&scratch, s, job->key, job->input,
+				      input_len);
+		} else {
+			const jwk_set_t *ring = job->ring;
+			struct jwks_scan scan;
+			size_t k, n;
+			int indexed;
+
+			/* Only the keys that can serve this alg, from the
+			 * keyring's index, the last to verify one first;
+			 * without an index, every key is offered. */
+			{
+				JWT_STAGE_BEGIN(t);
+				indexed = jwks_scan_begin(&scan, ring, s->alg);
+				JWT_STAGE_END(JWT_STAGE_KEY, t, 0);
+			}
+			if (indexed) {
+				for (k = 0; k < scan.n && !s->verified; k++) {
+					if (sig_jobs_stopped(sj))
+						break;
+					try_candidate(&scratch, s,
+						      scan.items[k],
+						      job->input, input_len);
+				}
+				jwks_scan_end(&scan);
+				if (s->verified)
+					jwks_scan_hit(ring, s->key);
+				else if (k < scan.n)
+					return;
+			} else {
+				n = jwks_item_count(ring);
+				for (k = 0; k < n && !s->verified; k++) {
+					const jwk_item_t *key;
+					jwt_alg_t kalg;
+
+					if (sig_jobs_stopped(sj))
+						return;
+					key = jwks_item_get(ring, k);
+					kalg = jwks_item_alg(key);
+					if (kalg != JWT_ALG_NONE &&
+					    kalg != s->alg)
+						continue;
+					try_candidate(&scratch, s, key,
+						      job->input, input_len);
+				}
+			}
 		}
 	}
 
-	jwt->headers = NULL;
-
-	return 0;
+	/* @rfc{7515,7.2} One verified signature settles ANY; one that is not
+	 * settles ALL. */
+	if (sj->early && (s->verified ?
+			  sj->policy != JWT_VERIFY_POLICY_ALL :
+			  sj->policy == JWT_VERIFY_POLICY_ALL))
+		__atomic_store_n(&sj->stop, 1, __ATOMIC_RELEASE);
 }
 
-int jwt_verify_json(jwt_checker_t *checker, const char *token)
+/* Parse a JWS JSON Serialization into the checker's signature list. Returns
+ * the parsed token, which the list and *@payload_b64 point into, or NULL with
+ * the error set. */
+static jwt_json_t *parse_json_token(jwt_checker_t *checker, const char *token,
+				    size_t len, const char **payload_b64)
 {
 	jwt_json_auto_t *root = NULL;
-	jwt_json_t *payload_j, *sigs;
-	jwt_auto_t *jwt = NULL;
-	const char *payload_b64;
-	struct jwt_signature *s;
-	int n_verified = 0, sig_ok, payload_len, pb64 = 1;
-	size_t n_entries;
-
-	/* Reset for a reused checker. */
-	checker->error = 0;
-	checker->error_msg[0] = '\0';
-	checker->c.last_sig_count = 0;
+	jwt_json_t *payload_j, *sigs, *ret;
+	size_t i;
+	JWT_STAGE_BEGIN(t);
+
+	/* The serialization's strings are the encoded segments, which are
+	 * bounded when they are decoded. */
+	if (jwt_limits_json(&checker->c.limits, token, len, 0)) {
+		JWT_STAGE_END(JWT_STAGE_JSON, t, 1);
+		jwt_set_error(checker, JWT_ERR_LIMIT,
+			      "Token exceeds an input limit");
+		return NULL;
+	}
 
-	root = jwt_json_parse(token, JWT_JSON_REJECT_DUPLICATES, NULL);
+	root = jwt_json_parse_buf(token, len, JWT_JSON_REJECT_DUPLICATES, NULL);
+	JWT_STAGE_END(JWT_STAGE_JSON, t, root == NULL);
 	if (root == NULL || !jwt_json_is_object(root)) {
-		jwt_write_error(checker, "Invalid JWS JSON Serialization");
-		return 1;
+		jwt_set_error(checker, JWT_ERR_MALFORMED,
+			      "Invalid JWS JSON Serialization");
+		return NULL;
 	}
 
 	payload_j = jwt_json_obj_get(root, "payload");
 	if (payload_j == NULL || !jwt_json_is_string(payload_j)) {
-		jwt_write_error(checker,
+		jwt_set_error(checker, JWT_ERR_MALFORMED,
 			"JWS JSON Serialization missing a \"payload\"");
-		return 1;
+		return NULL;
 	}
-	payload_b64 = jwt_json_str_val(payload_j);
-	payload_len = (int)strlen(payload_b64);
+	*payload_b64 = jwt_json_str_val(payload_j);
 
 	/* @rfc{7515,7.2} General has a "signatures" array; Flattened hoists a
 	 * single signature's members to the top level. They are exclusive. */
 	sigs = jwt_json_obj_get(root, "signatures");
 	if (sigs != NULL) {
-		size_t i, cnt;
+		size_t cnt;
 
 		if (jwt_json_obj_get(root, "protected") ||
 		    jwt_json_obj_get(root, "signature") ||
 		    jwt_json_obj_get(root, "header")) {
 			jwt_write_error(checker,
 				"JWS JSON mixes General and Flattened members");
-			return 1;
+			return NULL;
 		}
 		if (!jwt_json_is_array(sigs)) {
 			jwt_write_error(checker,
 				"\"signatures\" must be an array");
-			return 1;
+			return NULL;
 		}
 		cnt = jwt_json_arr_size(sigs);
 		if (cnt == 0) {
 			jwt_write_error(checker,
 				"\"signatures\" must not be empty");
-			return 1;
+			return NULL;
 		}
 		for (i = 0; i < cnt; i++) {
 			if (build_sig_entry(checker, jwt_json_arr_get(sigs, i)))
-				return 1;
+				return NULL;
 		}
 	} else if (build_sig_entry(checker, root)) {
-		return 1;
+		return NULL;
+	}
+
+	ret = root;
+	root = NULL;
+
+	return ret;
+}
+
+int jwt_verify_json(jwt_checker_t *checker, const char *token, size_t len)
+{
+	jwt_json_auto_t *root = NULL;
+	jwt_auto_t *jwt = NULL;
+	const char *payload_b64 = NULL;
+	struct jwt_signature *s;
+	struct sig_jobs sj = { 0 };
+	int n_verified = 0, n_unknown = 0, sig_ok, payload_len, pb64 = 1;
+	size_t n_entries, i;
+	jwt_claims_t failed;
+
+	/* Reset for a reused checker. */
+	jwt_clear_error(checker);
+	checker->c.last_sig_count = 0;
+
+	{
+		JWT_STAGE_BEGIN(t);
+		JWT_PROBE1(parse_start, len);
+		root = parse_json_token(checker, token, len, &payload_b64);
+		/* Each signature has its own "alg" (verify_done has it). */
+		JWT_PROBE3(parse_done, len, JWT_ALG_NONE, root == NULL);
+		JWT_STAGE_END(JWT_STAGE_PARSE, t, root == NULL);
 	}
+	if (root == NULL)
+		return 1;
+	payload_len = (int)strlen(payload_b64);
 
 	n_entries = checker->c.n_signatures;
 	checker->c.last_sig_count = (unsigned int)n_entries;
@@ -1027,26 +1458,72 @@ int jwt_verify_json(jwt_checker_t *checker, const char *token)
 	 * jwt->headers only ever borrows each signature's protected header. */
 	jwt_json_releasep(&jwt->headers);
 	if (pb64) {
-		jwt->claims = jwt_base64uri_decode_to_json((char *)payload_b64);
+		const jwt_limits_t *lim = &checker->c.limits;
+		int over;
+		JWT_STAGE_BEGIN(t);
+
+		jwt->claims = jwt_base64uri_decode_to_json(payload_b64,
+				payload_len, lim, lim->max_payload_len, &over);
+		JWT_STAGE_END(JWT_STAGE_PARSE, t, jwt->claims == NULL);
+		if (over) {
+			jwt_set_error(checker, JWT_ERR_LIMIT,
+				      "Payload exceeds an input limit");
+			return 1;
+		}
 		if (jwt->claims == NULL) {
-			jwt_write_error(checker, "Error parsing payload");
+			jwt_set_error(checker, JWT_ERR_MALFORMED,
+				      "Error parsing payload");
 			return 1;
 		}
 	} else {
+		if (checker->c.limits.max_payload_len &&
+		    (size_t)payload_len > checker->c.limits.max_payload_len) {
+			jwt_set_error(checker, JWT_ERR_LIMIT,
+				      "Payload exceeds an input limit");
+			return 1;
+		}
 		jwt->claims = jwt_json_create();
 		if (jwt->claims == NULL)
 			return 1; // LCOV_EXCL_LINE
 	}
 
+	/* Headers, callbacks and key selection, in order on this thread. */
+	sj.jobs = jwt_malloc(n_entries * sizeof(*sj.jobs));
+	if (sj.jobs == NULL) {
+		jwt_write_error(checker, "Error allocating memory"); // LCOV_EXCL_LINE
+		return 1; // LCOV_EXCL_LINE
+	}
+	memset(sj.jobs, 0, n_entries * sizeof(*sj.jobs));
+	sj.n = n_entries;
+	sj.policy = checker->c.policy;
+
+	i = 0;
 	list_for_each_entry(s, &checker->c.signatures, node) {
-		if (verify_entry(checker, jwt, s, payload_b64, payload_len)) {
-			jwt->headers = NULL;
+		if (prepare_entry(checker, jwt, s, payload_b64, payload_len,
+				  &sj.jobs[i++])) {
+			sig_jobs_free(&sj);
 			return 1;
 		}
-		if (s->verified)
+	}
+
+	/* Then the crypto: every signature, one at a time, or on the worker
+	 * threads until the policy is decided either way. */
+	if (checker->c.sig_threads) {
+		sj.early = 1;
+		jwt_workers_run(checker->c.sig_threads, sj.n, run_entry, &sj,
+				&sj.stop);
+	} else {
+		for (i = 0; i < sj.n; i++)
+			run_entry(&sj, i);
+	}
+
+	for (i = 0; i < sj.n; i++) {
+		if (sj.jobs[i].s->verified)
 			n_verified++;
+		else if (sj.jobs[i].unknown_kid)
+			n_unknown++;
 	}
-	jwt->headers = NULL;
+	sig_jobs_free(&sj);
 
 	/* @rfc{7515,7.2} Policy: ANY accepts on the first verified signature;
 	 * ALL requires every signature in the token to verify. */
@@ -1056,20 +1533,29 @@ int jwt_verify_json(jwt_checker_t *checker, const char *token)
 		sig_ok = (n_verified >= 1);
 
 	if (!sig_ok) {
-		jwt_write_error(checker,
+		/* Nothing to try at all: every "kid" missed the keyring. */
+		jwt_write_error_code(checker, n_unknown == (int)n_entries ?
+				     JWT_ERR_KID_UNKNOWN : JWT_ERR_BAD_SIG,
 			"Signature policy not met (%d of %zu verified)",
 			n_verified, n_entries);
-	} else if (jwt->b64 && __verify_claims(jwt)) {
-		jwt_write_error(checker, "Failed one or more claims");
+		return checker->error;
+	}
+
+	JWT_STAGE_BEGIN(t);
+
+	if (jwt->b64 && (failed = __verify_claims(jwt))) {
+		jwt_set_claims_error(checker, failed);
 	} else if (jwt->b64 && __verify_required(jwt)) {
 		/* @rfc{9068} Required-claims-present, same as the compact path; the
 		 * specific "missing" error is written on the jwt. */
 		jwt_copy_error(checker, jwt);
-	} else if (__verify_jti(jwt)) {
+	} else if ((failed = __verify_jti(jwt))) {
 		/* jti runs only after signature + claims succeed. */
-		jwt_write_error(checker, "Failed one or more claims");
+		jwt_set_claims_error(checker, failed);
 	}
 
+	JWT_STAGE_END(JWT_STAGE_CLAIMS, t, checker->error);
+
 	return checker->error;
 }
 
@@ -1077,15 +1563,13 @@ int jwt_verify_json(jwt_checker_t *checker, const char *token)
 static int detached_b64(const char *prot_b64)
 {
 	jwt_json_auto_t *hdr = NULL;
-	char_auto *copy = NULL;
 	jwt_json_t *jb;
+	int over;
 
 	if (prot_b64 == NULL)
 		return 1;
-	copy = jwt_str_dup(prot_b64);
-	if (copy == NULL)
-		return 1; // LCOV_EXCL_LINE
-	hdr = jwt_base64uri_decode_to_json(copy);
+	hdr = jwt_base64uri_decode_to_json(prot_b64, strlen(prot_b64), NULL, 0,
+					   &over);
 	if (hdr == NULL)
 		return 1;
 	jb = jwt_json_obj_get(hdr, "b64");
@@ -1153,7 +1637,8 @@ int jwt_checker_verify_detached(jwt_checker_t *checker, const char *token,
 
 		root = jwt_json_parse(token, JWT_JSON_REJECT_DUPLICATES, NULL);
 		if (root == NULL || !jwt_json_is_object(root)) {
-			jwt_write_error(checker, "Invalid JWS JSON Serialization");
+			jwt_set_error(checker, JWT_ERR_MALFORMED,
+				      "Invalid JWS JSON Serialization");
 			return 1;
 		}
 
@@ -0,0 +1,93 @@
+/* Copyright (C) 2026 maClara, LLC <info@maclara-llc.com>
+   This file is part of the JWT C Library
+
+   SPDX-License-Identifier:  MPL-2.0
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0. If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/* Spread independent jobs over a few threads for the length of one call.
+ *
+ * The signatures of a multi-signature JWS are signed or verified with no
+ * shared state but their (thread-safe) keys, so each is a job. Threads are
+ * started for the call and joined before it returns, as for
+ * jwt_checker_verify_batch(); the calling thread works too. Jobs are handed
+ * out one at a time, and no new one is started once the caller says the
+ * outcome is decided. */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <jwt.h>
+
+#include "jwt-private.h"
+
+struct workers {
+	jwt_worker_fn fn;
+	void *arg;
+	size_t n;
+	size_t next;
+	const int *stop;
+#ifdef LIBJWT_HAVE_STATS
+	jwt_stats_t *stats;	/* The caller's, for the jobs to count into	*/
+#endif
+};
+
+static void *workers_loop(void *data)
+{
+	struct workers *w = data;
+	size_t i;
+
+#ifdef LIBJWT_HAVE_STATS
+	jwt_stats_set(w->stats);
+#endif
+
+	for (;;) {
+		if (w->stop && __atomic_load_n(w->stop, __ATOMIC_ACQUIRE))
+			break;
+
+		i = __atomic_fetch_add(&w->next, 1, __ATOMIC_RELAXED);
+		if (i >= w->n)
+			break;
+
+		w->fn(w->arg, i);
+	}
+
+	return NULL;
+}
+
+void jwt_workers_run(unsigned int threads, size_t n, jwt_worker_fn fn,
+		     void *arg, const int *stop)
+{
+	struct workers w = { .fn = fn, .arg = arg, .n = n, .stop = stop };
+	pthread_t *tids = NULL;
+	unsigned int t, started = 0;
+
+#ifdef LIBJWT_HAVE_STATS
+	w.stats = jwt_stats_get();
+#endif
+
+	if (threads > n)
+		threads = (unsigned int)n;
+
+	if (threads > 1)
+		tids = jwt_malloc((threads - 1) * sizeof(*tids));
+
+	/* Any thread that cannot be started just leaves more to the rest. */
+	if (tids != NULL) {
+		for (t = 0; t < threads - 1; t++) {
+			if (pthread_create(&tids[started], NULL, workers_loop,
+					   &w))
+				break; // LCOV_EXCL_LINE
+			started++;
+		}
+	}
+
+	workers_loop(&w);
+
+	for (t = 0; t < started; t++)
+		pthread_join(tids[t], NULL);
+
+	jwt_freemem(tids);
+}
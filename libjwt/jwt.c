@@ -326,8 +326,8 @@ fallback_ops:
 	return jwt_ops->sign_sha_hmac(jwt, out, len, str, str_len);
 }
 
-int jwt_sign(jwt_t *jwt, char **out, unsigned int *len, const char *str,
-	     unsigned int str_len)
+static int __sign(jwt_t *jwt, char **out, unsigned int *len, const char *str,
+		  unsigned int str_len)
 {
 	struct jwt_crypto_ops *ops;
 
@@ -402,69 +402,112 @@ int jwt_sign(jwt_t *jwt, char **out, unsigned int *len, const char *str,
 	}
 }
 
-/* A time-safe strcmp function */
-static int _crypto_strcmp(const char *str1, const char *str2)
+int jwt_sign(jwt_t *jwt, char **out, unsigned int *len, const char *str,
+	     unsigned int str_len)
 {
-	/* Get the LONGEST length */
-	int len1 = strlen(str1);
-	int len2 = strlen(str2);
-	int len_max = len1 >= len2 ? len1 : len2;
-
-	int i;
-	volatile int ret = 0;
+	int ret;
+	JWT_STAGE_BEGIN(t);
 
-	/* Iterate the entire longest string no matter what. Only testing
-	 * the shortest string would still allow attacks for
-	 * "a" == "aKJSDHkjashaaHJASJ", adding a character each time one
-	 * is found. */
-	for (i = 0; i < len_max; i++) {
-		char c1, c2;
+	JWT_PROBE3(sign_start, jwt->alg, JWT_PROBE_KID(jwt->key), str_len);
+	ret = __sign(jwt, out, len, str, str_len);
+	JWT_PROBE4(sign_done, jwt->alg, JWT_PROBE_KID(jwt->key), str_len, ret);
+	JWT_STAGE_END(JWT_STAGE_SIGNATURE, t, ret);
 
-		c1 = (i < len1) ? str1[i] : 0;
-		c2 = (i < len2) ? str2[i] : 0;
+	return ret;
+}
 
-		ret |= c1 ^ c2;
-	}
+/* A time-safe comparison of @len octets */
+static int _crypto_memcmp(const unsigned char *a, const unsigned char *b,
+			  size_t len)
+{
+	volatile unsigned char ret = 0;
+	size_t i;
 
-	/* Don't forget to check length */
-	ret |= len1 ^ len2;
+	for (i = 0; i < len; i++)
+		ret |= a[i] ^ b[i];
 
-	return ret;
+	return ret != 0;
 }
 
-static int _verify_sha_hmac(jwt_t *jwt, const char *head,
-			    unsigned int head_len, const char *sig)
+/* The HS* MAC of @str into @out (JWT_HMAC_MAX octets). Backends that can
+ * write it in place (from a key schedule kept on the key) do; otherwise the
+ * signing path's buffer is copied. */
+static int hmac_buf(jwt_t *jwt, const char *str, unsigned int str_len,
+		    unsigned char *out, unsigned int *len)
 {
 	char_auto *res = NULL;
-	char_auto *buf = NULL;
-	unsigned int res_len;
-	int ret;
 
-	ret = jwt_sign(jwt, &res, &res_len, head, head_len);
-	if (ret)
+#ifndef USE_KCAPI_MD
+	if (jwt_ops->hmac_sha != NULL)
+		return jwt_ops->hmac_sha(jwt, str, str_len, out, len);
+#endif
+
+	if (sign_sha_hmac(jwt, &res, len, str, str_len))
 		return 1; // LCOV_EXCL_LINE
 
-	ret = jwt_base64uri_encode(&buf, res, res_len);
-	if (ret <= 0)
+	if (*len > JWT_HMAC_MAX)
+		return 1; // LCOV_EXCL_LINE
+
+	memcpy(out, res, *len);
+
+	return 0;
+}
+
+static int _verify_sha_hmac(jwt_t *jwt, const char *head,
+			    unsigned int head_len, const char *sig,
+			    size_t sig_len)
+{
+	unsigned char mac[JWT_HMAC_MAX];
+	unsigned char got[JWT_BASE64URI_DECODE_SIZE(
+		JWT_BASE64URI_ENCODE_LEN(JWT_HMAC_MAX))];
+	unsigned int mac_len;
+	int got_len;
+
+	if (__check_hmac(jwt))
+		return 1;
+
+	if (hmac_buf(jwt, head, head_len, mac, &mac_len))
 		return 1; // LCOV_EXCL_LINE
 
-	return _crypto_strcmp(buf, sig) ? 1 : 0;
+	/* Compare octets rather than encodings, so the signature is decoded
+	 * straight onto the stack. The decoder ignores any bits left over in
+	 * the last character, so also require that they are zero: only the
+	 * one canonical encoding of the MAC is accepted, as before. */
+	if (sig_len != JWT_BASE64URI_ENCODE_LEN(mac_len))
+		return 1;
+
+	got_len = jwt_base64uri_decode_buf(sig, sig_len, got);
+	if (got_len != (int)mac_len)
+		return 1;
+	if ((sig_len & 3) != 0 && got[got_len] != 0)
+		return 1;
+
+	return _crypto_memcmp(mac, got, mac_len);
 }
 
+/* Decoded signatures up to this size (RSA-8192, every EC and EdDSA alg) are
+ * staged on the stack; larger ones (e.g. ML-DSA) use the heap. */
+#define JWT_SIG_STACK_BUF	1024
+
 jwt_t *jwt_verify_sig(jwt_t *jwt, const char *head, unsigned int head_len,
-		      const char *sig_b64)
+		      const char *sig_b64, size_t sig_b64_len)
 {
 	struct jwt_crypto_ops *ops;
+	unsigned char stack_sig[JWT_SIG_STACK_BUF];
+	unsigned char *sig = stack_sig;
 	int sig_len;
-	char_auto *sig = NULL;
+	JWT_STAGE_BEGIN(t);
+
+	JWT_PROBE3(verify_start, jwt->alg, JWT_PROBE_KID(jwt->key), head_len);
 
 	switch (jwt->alg) {
 	/* HMAC */
 	case JWT_ALG_HS256:
 	case JWT_ALG_HS384:
 	case JWT_ALG_HS512:
-		if (_verify_sha_hmac(jwt, head, head_len, sig_b64))
-			jwt_write_error(jwt, "Token failed verification");
+		if (_verify_sha_hmac(jwt, head, head_len, sig_b64, sig_b64_len))
+			jwt_set_error(jwt, JWT_ERR_BAD_SIG,
+				      "Token failed verification");
 		break;
 
 	/* RSA */
@@ -495,9 +538,18 @@ jwt_t *jwt_verify_sig(jwt_t *jwt, const char *head, unsigned int head_len,
 		if (__check_key_bits(jwt))
 			break;
 
-		sig = jwt_base64uri_decode(sig_b64, &sig_len);
-		if (sig == NULL) {
-			jwt_write_error(jwt, "Error decoding signature");
+		if (JWT_BASE64URI_DECODE_SIZE(sig_b64_len) > sizeof(stack_sig)) {
+			sig = jwt_malloc(JWT_BASE64URI_DECODE_SIZE(sig_b64_len));
+			if (sig == NULL) {
+				jwt_write_error(jwt, "Error allocating memory"); // LCOV_EXCL_LINE
+				break; // LCOV_EXCL_LINE
+			}
+		}
+
+		sig_len = jwt_base64uri_decode_buf(sig_b64, sig_b64_len, sig);
+		if (sig_len <= 0) {
+			jwt_set_error(jwt, JWT_ERR_MALFORMED,
+				      "Error decoding signature");
 			break;
 		}
 
@@ -508,9 +560,9 @@ jwt_t *jwt_verify_sig(jwt_t *jwt, const char *head, unsigned int head_len,
 			break; // LCOV_EXCL_LINE
 		}
 
-		if (ops->verify_sha_pem(jwt, head, head_len,
-					(unsigned char *)sig, sig_len))
-			jwt_write_error(jwt, "Token failed verification");
+		if (ops->verify_sha_pem(jwt, head, head_len, sig, sig_len))
+			jwt_set_error(jwt, JWT_ERR_BAD_SIG,
+				      "Token failed verification");
 		break;
 
 	/* You wut, mate? */
@@ -519,13 +571,19 @@ jwt_t *jwt_verify_sig(jwt_t *jwt, const char *head, unsigned int head_len,
 		jwt_write_error(jwt, "Unknown algorigthm");
 	} // LCOV_EXCL_STOP
 
+	if (sig != stack_sig)
+		jwt_freemem(sig);
+
+	JWT_PROBE4(verify_done, jwt->alg, JWT_PROBE_KID(jwt->key), head_len,
+		   jwt->error);
+	JWT_STAGE_END(JWT_STAGE_SIGNATURE, t, jwt->error);
+
 	return jwt;
 }
 
 /* This is a public domain base64 implementation written by WEI Zhicheng.
    https://github.com/zhicheng/base64 */
 #define BASE64_ENCODE_OUT_SIZE(s) ((unsigned int)((((s) + 2) / 3) * 4 + 1))
-#define BASE64_DECODE_OUT_SIZE(s) ((unsigned int)(((s) / 4) * 3))
 #define BASE64_PAD '='
 #define BASE64DE_FIRST '+'
 #define BASE64DE_LAST 'z'
@@ -593,6 +651,62 @@ static const unsigned char base64de[] = {
 	    49,  50,  51, 255, 255, 255, 255, 255
 };
 
+/* BASE 64 URL encode table */
+static const char base64urlen[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+/* ASCII order for BASE 64 URL decode; 255 for anything outside the
+ * [A-Za-z0-9_-] alphabet, including '+', '/' and '='. */
+static const unsigned char base64urlde[] = {
+	/* nul, soh, stx, etx, eot, enq, ack, bel, */
+	   255, 255, 255, 255, 255, 255, 255, 255,
+
+	/*  bs,  ht,  nl,  vt,  np,  cr,  so,  si, */
+	   255, 255, 255, 255, 255, 255, 255, 255,
+
+	/* dle, dc1, dc2, dc3, dc4, nak, syn, etb, */
+	   255, 255, 255, 255, 255, 255, 255, 255,
+
+	/* can,  em, sub, esc,  fs,  gs,  rs,  us, */
+	   255, 255, 255, 255, 255, 255, 255, 255,
+
+	/*  sp, '!', '"', '#', '$', '%', '&', ''', */
+	   255, 255, 255, 255, 255, 255, 255, 255,
+
+	/* '(', ')', '*', '+', ',', '-', '.', '/', */
+	   255, 255, 255, 255, 255,  62, 255, 255,
+
+	/* '0', '1', '2', '3', '4', '5', '6', '7', */
+	    52,  53,  54,  55,  56,  57,  58,  59,
+
+	/* '8', '9', ':', ';', '<', '=', '>', '?', */
+	    60,  61, 255, 255, 255, 255, 255, 255,
+
+	/* '@', 'A', 'B', 'C', 'D', 'E', 'F', 'G', */
+	   255,   0,   1,   2,   3,   4,   5,   6,
+
+	/* 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O', */
+	     7,   8,   9,  10,  11,  12,  13,  14,
+
+	/* 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', */
+	    15,  16,  17,  18,  19,  20,  21,  22,
+
+	/* 'X', 'Y', 'Z', '[', '\', ']', '^', '_', */
+	    23,  24,  25, 255, 255, 255, 255,  63,
+
+	/* '`', 'a', 'b', 'c', 'd', 'e', 'f', 'g', */
+	   255,  26,  27,  28,  29,  30,  31,  32,
+
+	/* 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', */
+	    33,  34,  35,  36,  37,  38,  39,  40,
+
+	/* 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', */
+	    41,  42,  43,  44,  45,  46,  47,  48,
+
+	/* 'x', 'y', 'z', '{', '|', '}', '~', del, */
+	    49,  50,  51, 255, 255, 255, 255, 255
+};
+
 unsigned int
 base64_encode(const unsigned char *in, unsigned int inlen, char *out)
 {
@@ -688,93 +802,133 @@ base64_decode(const char *in, unsigned int inlen, unsigned char *out)
 	return j;
 }
 
+static int base64uri_decode_buf(const char *src, size_t len,
+				unsigned char *out)
+{
+	size_t i;
+	int j;
+	unsigned char c;
+
+	/* The decoded length must fit the int return. A single trailing
+	 * sextet cannot encode a whole octet, so len % 4 == 1 is malformed. */
+	if (len > INT_MAX || (len & 0x3) == 1)
+		return -1;
+
+	/* Bulk of the input through a vector kernel, if there is one. It only
+	 * takes whole 4-character groups and stops short of any block that is
+	 * not clean base64url, leaving the rest (and the error) to the loop. */
+	i = jwt_base64uri_decode_simd(src, len, out);
+	j = (int)(i / 4 * 3);
+
+	for (; i < len; i++) {
+		/* @rfc{7515,2}, @rfc{7517,3} JWS/JWE token segments and JWK member
+		 * values are unpadded base64url: the alphabet is exactly
+		 * [A-Za-z0-9_-]. The table rejects the standard-base64 characters
+		 * '+' and '/' and any literal padding '=' (which would otherwise
+		 * truncate the input silently), so a value cannot be re-spelled in
+		 * the standard alphabet yet decode to the same bytes. */
+		c = (unsigned char)src[i];
+		if (c & 0x80)
+			return -1;
+		c = base64urlde[c];
+		if (c == 255)
+			return -1;
+
+		switch (i & 0x3) {
+		case 0:
+			out[j] = (c << 2) & 0xFF;
+			break;
+		case 1:
+			out[j++] |= (c >> 4) & 0x3;
+			out[j] = (c & 0xF) << 4;
+			break;
+		case 2:
+			out[j++] |= (c >> 2) & 0xF;
+			out[j] = (c & 0x3) << 6;
+			break;
+		case 3:
+			out[j++] |= c;
+			break;
+		}
+	}
+
+	return j;
+}
+
+int jwt_base64uri_decode_buf(const char *src, size_t len, unsigned char *out)
+{
+	int ret;
+	JWT_STAGE_BEGIN(t);
+
+	ret = base64uri_decode_buf(src, len, out);
+	JWT_STAGE_END(JWT_STAGE_BASE64, t, ret < 0);
+
+	return ret;
+}
+
 void *jwt_base64uri_decode(const char *src, int *ret_len)
 {
-	void *buf;
-	char *new;
-	int len, i, z;
+	unsigned char *buf;
+	size_t len;
+	int out_len;
 
 	if (src == NULL || ret_len == NULL)
 		return NULL; // LCOV_EXCL_LINE
 			     // Should really be an abort
 
 	/* Decode based on RFC-4648 URI safe encoding. */
-	len = (int)strlen(src);
-
-	/* Validate length */
-	z = (len % 4);
-	switch (z) {
-	case 0:
-		/* No added padding */
-		break;
-
-	case 2:
-		/* 2 added = for padding */
-		break;
+	len = strlen(src);
 
-	case 3:
-		/* 1 added = for padding */
-		z = 1;
-		break;
+	/* One allocation: the url alphabet is decoded in place of a translated
+	 * standard-base64 copy. The extra octet lets callers NUL-terminate. */
+	buf = jwt_malloc(JWT_BASE64URI_DECODE_SIZE(len) + 1);
+	if (buf == NULL)
+		return NULL; // LCOV_EXCL_LINE
 
-	default:
-		/* Something bad */
+	out_len = jwt_base64uri_decode_buf(src, len, buf);
+	if (out_len <= 0) {
+		jwt_freemem(buf);
 		return NULL;
 	}
 
-	new = jwt_malloc(len + z + 1);
-	if (!new)
-		return NULL; // LCOV_EXCL_LINE
-
-	for (i = 0; i < len; i++) {
-		char c = src[i];
+	*ret_len = out_len;
 
-		/* @rfc{7515,2}, @rfc{7517,3} JWS/JWE token segments and JWK member
-		 * values are unpadded base64url: the alphabet is exactly
-		 * [A-Za-z0-9_-]. Reject the standard-base64 characters '+' and '/'
-		 * and any literal padding '=' (which would otherwise truncate the
-		 * input silently), so a value cannot be re-spelled in the standard
-		 * alphabet yet decode to the same bytes. '-' and '_' are translated
-		 * to their standard-alphabet form for the decoder below. */
-		switch (c) {
-		case '-':
-			new[i] = '+';
-			break;
-		case '_':
-			new[i] = '/';
-			break;
-		default:
-			if (!((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') ||
-			      (c >= '0' && c <= '9'))) {
-				jwt_freemem(new);
-				return NULL;
-			}
-			new[i] = c;
-		}
-	}
+	return buf;
+}
 
-	for (; z > 0; z--)
-		new[i++] = '=';
+/* base64url encode @inlen octets without padding. Writes exactly
+ * ceil(4 * inlen / 3) characters (no NUL) and returns that count. */
+static size_t base64uri_encode_buf(const unsigned char *in, size_t inlen,
+				   char *out)
+{
+	size_t i, j;
+	JWT_STAGE_BEGIN(t);
 
-	new[i] = '\0';
-	len = i;
+	i = jwt_base64uri_encode_simd(in, inlen, out);
+	j = i / 3 * 4;
 
-	/* Now we have a standard base64 encoded string. */
-	buf = jwt_malloc(BASE64_DECODE_OUT_SIZE(len) + 1);
-	if (buf == NULL) {
-		// LCOV_EXCL_START
-		jwt_freemem(new);
-		return NULL;
-		// LCOV_EXCL_STOP
+	for (; inlen - i >= 3; i += 3) {
+		out[j++] = base64urlen[in[i] >> 2];
+		out[j++] = base64urlen[((in[i] & 0x3) << 4) | (in[i + 1] >> 4)];
+		out[j++] = base64urlen[((in[i + 1] & 0xF) << 2) | (in[i + 2] >> 6)];
+		out[j++] = base64urlen[in[i + 2] & 0x3F];
 	}
 
-	*ret_len = base64_decode(new, len, buf);
-	jwt_freemem(new);
+	switch (inlen - i) {
+	case 1:
+		out[j++] = base64urlen[in[i] >> 2];
+		out[j++] = base64urlen[(in[i] & 0x3) << 4];
+		break;
+	case 2:
+		out[j++] = base64urlen[in[i] >> 2];
+		out[j++] = base64urlen[((in[i] & 0x3) << 4) | (in[i + 1] >> 4)];
+		out[j++] = base64urlen[(in[i + 1] & 0xF) << 2];
+		break;
+	}
 
-	if (*ret_len <= 0)
-		jwt_freemem(buf);
+	JWT_STAGE_END(JWT_STAGE_BASE64, t, 0);
 
-	return buf;
+	return j;
 }
 
 int jwt_base64uri_encode(char **_dst, const char *plain, int plain_len)
@@ -795,25 +949,9 @@ int jwt_base64uri_encode(char **_dst, const char *plain, int plain_len)
 		return -1; // LCOV_EXCL_LINE
 	*_dst = dst;
 
-	/* First, a normal base64 encoding */
-	len = base64_encode((const unsigned char *)plain, plain_len, dst);
-
-	/* Now for the URI encoding */
-	for (i = 0; i < len; i++) {
-		switch (dst[i]) {
-		case '+':
-			dst[i] = '-';
-			break;
-		case '/':
-			dst[i] = '_';
-			break;
-		case '=':
-			dst[i] = '\0';
-			break;
-		}
-	}
-
-	/* Just in case there's no padding. */
+	/* Straight to the URI alphabet, no padding to strip. */
+	i = (int)base64uri_encode_buf((const unsigned char *)plain, plain_len,
+				      dst);
 	dst[i] = '\0';
 
 	return i;
@@ -38,7 +38,7 @@ static int import_aes_key(const unsigned char *key, size_t key_len,
 
 	*kid = MBEDTLS_SVC_KEY_ID_INIT;
 
-	if (psa_crypto_init() != PSA_SUCCESS)
+	if (mbedtls_psa_init())
 		return 1; // LCOV_EXCL_LINE
 
 	psa_set_key_type(&attr, PSA_KEY_TYPE_AES);
@@ -58,7 +58,7 @@ int mbedtls_rng(unsigned char *out, size_t len)
 	if (out == NULL || len == 0)
 		return 1; // LCOV_EXCL_LINE
 
-	if (psa_crypto_init() != PSA_SUCCESS)
+	if (mbedtls_psa_init())
 		return 1; // LCOV_EXCL_LINE
 
 	return psa_generate_random(out, len) != PSA_SUCCESS;
@@ -242,7 +242,7 @@ static int import_hmac_key(const unsigned char *mac_key, size_t half,
 	*mac_alg = PSA_ALG_TRUNCATED_MAC(PSA_ALG_HMAC(hash), half);
 	*kid = MBEDTLS_SVC_KEY_ID_INIT;
 
-	if (psa_crypto_init() != PSA_SUCCESS)
+	if (mbedtls_psa_init())
 		return 1; // LCOV_EXCL_LINE
 
 	psa_set_key_type(&attr, PSA_KEY_TYPE_HMAC);
@@ -1007,7 +1007,7 @@ int mbedtls_ecdh_derive(jwe_key_alg_t alg, jwe_enc_t enc,
 	if (ecdh_keydatalen(alg, enc, &keydatalen, &algid))
 		goto out; // LCOV_EXCL_LINE
 
-	if (psa_crypto_init() != PSA_SUCCESS)
+	if (mbedtls_psa_init())
 		goto out; // LCOV_EXCL_LINE
 
 	out = jwt_malloc(keydatalen);
@@ -285,7 +285,7 @@ int mbedtls_key2jwk_params(const char *key, size_t len, jwk_export_t *out)
 	int is_priv = 0, is_rsa, is_ec, ret = 1;
 	size_t parse_len;
 
-	if (psa_crypto_init() != PSA_SUCCESS)
+	if (mbedtls_psa_init())
 		return 1; // LCOV_EXCL_LINE
 
 	/* mbedtls_pk_parse_key wants a NUL-terminated buffer for PEM, with the
@@ -8,6 +8,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include <mbedtls/asn1write.h>
 #include <mbedtls/pk.h>
@@ -19,6 +20,21 @@
 #include "jwt-private.h"
 #include "jwt-mbedtls.h"
 
+static pthread_once_t psa_once = PTHREAD_ONCE_INIT;
+static psa_status_t psa_init_status = PSA_ERROR_BAD_STATE;
+
+static void psa_init_once(void)
+{
+	psa_init_status = psa_crypto_init();
+}
+
+int mbedtls_psa_init(void)
+{
+	pthread_once(&psa_once, psa_init_once);
+
+	return psa_init_status != PSA_SUCCESS;
+}
+
 /* Allocate and zero a native key wrapper for provider_data. */
 static mbedtls_jwk_t *jwk_new(jwk_key_type_t kty)
 {
@@ -106,7 +122,7 @@ int mbedtls_jwk_to_psa(const mbedtls_jwk_t *key, int want_private,
 
 	*kid = MBEDTLS_SVC_KEY_ID_INIT;
 
-	if (psa_crypto_init() != PSA_SUCCESS)
+	if (mbedtls_psa_init())
 		return 1; // LCOV_EXCL_LINE
 
 	if (want_private) {
@@ -731,7 +747,7 @@ int mbedtls_generate_pem(jwk_key_type_t kty, const char *param, jwt_alg_t alg,
 
 	(void)alg;
 
-	if (psa_crypto_init() != PSA_SUCCESS)
+	if (mbedtls_psa_init())
 		return 1; // LCOV_EXCL_LINE
 
 	switch (kty) {
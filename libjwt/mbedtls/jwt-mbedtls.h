@@ -46,6 +46,11 @@ typedef struct {
 	size_t priv_len;
 } mbedtls_jwk_t;
 
+/* psa_crypto_init(), run once for the library instead of before every
+ * operation. Returns 0 once PSA is ready. */
+JWT_NO_EXPORT
+int mbedtls_psa_init(void);
+
 /* Import a short-lived (volatile) PSA key from the stored JWK material with the
  * given algorithm/usage policy. @want_private selects the key-pair (private) vs
  * the public key. On success *kid holds a key the caller must release with
@@ -24,66 +24,197 @@
 
 #include "jwt-mbedtls.h"
 
-/* @rfc{7518,3.2} HMAC with SHA-2 via PSA. The oct key is imported as a volatile
- * PSA HMAC key, used once, and destroyed. */
-static int mbedtls_sign_sha_hmac(jwt_t *jwt, char **out, unsigned int *len,
-                                 const char *str, unsigned int str_len)
-{
-	psa_key_attributes_t attr = PSA_KEY_ATTRIBUTES_INIT;
+/* @rfc{7518,3.2} HMAC with SHA-2 via PSA.
+ *
+ * An oct key is imported into PSA on its first use with each digest and the
+ * key id is kept on the jwk_item_t until the key is freed, so a token costs
+ * one psa_mac_compute() rather than an import, a MAC and a destroy. PSA keys
+ * carry a single algorithm policy, so HS256/384/512 each get their own. */
+#define MBEDTLS_HMAC_N	3
+
+struct mbedtls_hmac_key {
 	mbedtls_svc_key_id_t kid;
-	psa_algorithm_t alg;
-	size_t mac_size, mac_len = 0;
-	psa_status_t st;
+};
 
-	*out = NULL;
+struct mbedtls_hmac_state {
+	struct jwk_hmac_state hdr;
+	struct mbedtls_hmac_key *key[MBEDTLS_HMAC_N];
+};
 
-	switch (jwt->alg) {
+static void mbedtls_hmac_state_free(struct jwk_hmac_state *hdr)
+{
+	struct mbedtls_hmac_state *st = (struct mbedtls_hmac_state *)hdr;
+	int i;
+
+	for (i = 0; i < MBEDTLS_HMAC_N; i++) {
+		if (st->key[i] == NULL)
+			continue;
+		psa_destroy_key(st->key[i]->kid);
+		jwt_freemem(st->key[i]);
+	}
+
+	jwt_freemem(st);
+}
+
+static int hmac_alg(jwt_alg_t alg, int *idx, psa_algorithm_t *psa_alg)
+{
+	switch (alg) {
 	case JWT_ALG_HS256:
-		alg = PSA_ALG_HMAC(PSA_ALG_SHA_256); mac_size = 32; break;
+		*idx = 0; *psa_alg = PSA_ALG_HMAC(PSA_ALG_SHA_256); return 0;
 	case JWT_ALG_HS384:
-		alg = PSA_ALG_HMAC(PSA_ALG_SHA_384); mac_size = 48; break;
+		*idx = 1; *psa_alg = PSA_ALG_HMAC(PSA_ALG_SHA_384); return 0;
 	case JWT_ALG_HS512:
-		alg = PSA_ALG_HMAC(PSA_ALG_SHA_512); mac_size = 64; break;
+		*idx = 2; *psa_alg = PSA_ALG_HMAC(PSA_ALG_SHA_512); return 0;
 	// LCOV_EXCL_START
 	default:
 		return 1;
 	// LCOV_EXCL_STOP
 	}
+}
 
-	if (psa_crypto_init() != PSA_SUCCESS)
-		return 1; // LCOV_EXCL_LINE
+static struct mbedtls_hmac_key *hmac_import(const jwk_item_t *item,
+					    psa_algorithm_t alg)
+{
+	psa_key_attributes_t attr = PSA_KEY_ATTRIBUTES_INIT;
+	struct mbedtls_hmac_key *k;
+	psa_status_t st;
+
+	k = jwt_malloc(sizeof(*k));
+	if (k == NULL)
+		return NULL; // LCOV_EXCL_LINE
 
 	psa_set_key_type(&attr, PSA_KEY_TYPE_HMAC);
 	psa_set_key_usage_flags(&attr, PSA_KEY_USAGE_SIGN_MESSAGE);
 	psa_set_key_algorithm(&attr, alg);
 
-	if (psa_import_key(&attr, jwt->key->oct.key, jwt->key->oct.len, &kid))
+	st = psa_import_key(&attr, item->oct.key, item->oct.len, &k->kid);
+	psa_reset_key_attributes(&attr);
+
+	if (st != PSA_SUCCESS) {
+		// LCOV_EXCL_START
+		jwt_freemem(k);
+		return NULL;
+		// LCOV_EXCL_STOP
+	}
+
+	return k;
+}
+
+/* The PSA key for @jwt's oct key and HMAC @alg, imported on first use. Both
+ * the state and each key are published atomically; a thread that loses the
+ * race drops its own copy. NULL if the key carries another backend's state. */
+static const struct mbedtls_hmac_key *hmac_key(jwt_t *jwt, int idx,
+					       psa_algorithm_t alg)
+{
+	struct jwk_hmac_state **slot, *hdr_exp = NULL;
+	struct mbedtls_hmac_state *st;
+	struct mbedtls_hmac_key *k, *k_exp = NULL;
+
+	/* Like the thumbprint, this is cached on an otherwise const key. */
+	slot = (struct jwk_hmac_state **)&jwt->key->hmac;
+
+	st = (struct mbedtls_hmac_state *)__atomic_load_n(slot,
+							  __ATOMIC_ACQUIRE);
+	if (st == NULL) {
+		st = jwt_malloc(sizeof(*st));
+		if (st == NULL)
+			return NULL; // LCOV_EXCL_LINE
+		memset(st, 0, sizeof(*st));
+		st->hdr.provider = JWT_CRYPTO_OPS_MBEDTLS;
+		st->hdr.free = mbedtls_hmac_state_free;
+
+		if (!__atomic_compare_exchange_n(slot, &hdr_exp, &st->hdr, 0,
+						 __ATOMIC_ACQ_REL,
+						 __ATOMIC_ACQUIRE)) {
+			jwt_freemem(st);
+			st = (struct mbedtls_hmac_state *)hdr_exp;
+		}
+	}
+
+	if (st->hdr.provider != JWT_CRYPTO_OPS_MBEDTLS)
+		return NULL; // LCOV_EXCL_LINE
+
+	k = __atomic_load_n(&st->key[idx], __ATOMIC_ACQUIRE);
+	if (k != NULL)
+		return k;
+
+	k = hmac_import(jwt->key, alg);
+	if (k == NULL)
+		return NULL; // LCOV_EXCL_LINE
+
+	if (!__atomic_compare_exchange_n(&st->key[idx], &k_exp, k, 0,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		psa_destroy_key(k->kid);
+		jwt_freemem(k);
+		k = k_exp;
+	}
+
+	return k;
+}
+
+static int mbedtls_hmac_sha(jwt_t *jwt, const char *str, unsigned int str_len,
+			    unsigned char *out, unsigned int *len)
+{
+	const struct mbedtls_hmac_key *k;
+	struct mbedtls_hmac_key *tmp = NULL;
+	psa_algorithm_t alg;
+	size_t mac_len = 0;
+	psa_status_t st;
+	int idx;
+
+	if (hmac_alg(jwt->alg, &idx, &alg))
+		return 1; // LCOV_EXCL_LINE
+
+	if (mbedtls_psa_init())
 		return 1; // LCOV_EXCL_LINE
 
-	*out = jwt_malloc(mac_size);
-	if (*out == NULL) {
+	k = hmac_key(jwt, idx, alg);
+	if (k == NULL) {
+		/* Could not keep one; use a key just for this token. */
 		// LCOV_EXCL_START
-		psa_destroy_key(kid);
-		return 1;
+		tmp = hmac_import(jwt->key, alg);
+		if (tmp == NULL)
+			return 1;
+		k = tmp;
 		// LCOV_EXCL_STOP
 	}
 
-	st = psa_mac_compute(kid, alg, (const unsigned char *)str, str_len,
-			     (unsigned char *)*out, mac_size, &mac_len);
-	psa_destroy_key(kid);
+	st = psa_mac_compute(k->kid, alg, (const unsigned char *)str, str_len,
+			     out, JWT_HMAC_MAX, &mac_len);
 
-	if (st != PSA_SUCCESS) {
+	if (tmp != NULL) {
 		// LCOV_EXCL_START
-		jwt_freemem(*out);
-		return 1;
+		psa_destroy_key(tmp->kid);
+		jwt_freemem(tmp);
 		// LCOV_EXCL_STOP
 	}
 
+	if (st != PSA_SUCCESS)
+		return 1; // LCOV_EXCL_LINE
+
 	*len = (unsigned int)mac_len;
 
 	return 0;
 }
 
+static int mbedtls_sign_sha_hmac(jwt_t *jwt, char **out, unsigned int *len,
+                                 const char *str, unsigned int str_len)
+{
+	*out = jwt_malloc(JWT_HMAC_MAX);
+	if (*out == NULL)
+		return 1; // LCOV_EXCL_LINE
+
+	if (mbedtls_hmac_sha(jwt, str, str_len, (unsigned char *)*out, len)) {
+		// LCOV_EXCL_START
+		jwt_freemem(*out);
+		*out = NULL;
+		return 1;
+		// LCOV_EXCL_STOP
+	}
+
+	return 0;
+}
+
 /* Map a JWS signing alg to its PSA signature algorithm (hash included). Returns
  * 0 on success. EdDSA is handled by the caller (rejected); HMAC never reaches
  * here. */
@@ -224,7 +355,8 @@ static int mbedtls_verify_sha_pem(jwt_t *jwt, const char *head,
 	if (psa_verify_message(kid, alg, (const unsigned char *)head, head_len,
 			       sig, (size_t)sig_len)) {
 		psa_destroy_key(kid);
-		return jwt_write_error(jwt, "JWT[MbedTLS]: Failed to verify signature");
+		return jwt_set_error(jwt, JWT_ERR_BAD_SIG,
+				     "JWT[MbedTLS]: Failed to verify signature");
 	}
 	psa_destroy_key(kid);
 
@@ -252,7 +384,7 @@ static int mbedtls_sha(int sha_bits, const unsigned char *in, size_t in_len,
 		return 1; // LCOV_EXCL_LINE
 	}
 
-	if (psa_crypto_init() != PSA_SUCCESS)
+	if (mbedtls_psa_init())
 		return 1; // LCOV_EXCL_LINE
 
 	if (psa_hash_compute(alg, in, in_len, out, PSA_HASH_LENGTH(alg),
@@ -289,7 +421,7 @@ static int mbedtls_pbkdf2(int sha_bits, const unsigned char *pw, size_t pw_len,
 		return 1; // LCOV_EXCL_LINE
 	}
 
-	if (psa_crypto_init() != PSA_SUCCESS)
+	if (mbedtls_psa_init())
 		return 1; // LCOV_EXCL_LINE
 
 	/* The PBKDF2 password is imported as a PSA key (PSA_KEY_TYPE_PASSWORD);
@@ -348,6 +480,7 @@ struct jwt_crypto_ops jwt_mbedtls_ops = {
 	.provider		= JWT_CRYPTO_OPS_MBEDTLS,
 
 	.sign_sha_hmac		= mbedtls_sign_sha_hmac,
+	.hmac_sha		= mbedtls_hmac_sha,
 	.sign_sha_pem		= mbedtls_sign_sha_pem,
 	.verify_sha_pem		= mbedtls_verify_sha_pem,
 	.pbkdf2			= mbedtls_pbkdf2,
@@ -11,7 +11,6 @@
 
 #include <openssl/evp.h>
 #include <openssl/rand.h>
-#include <openssl/hmac.h>
 #include <openssl/crypto.h>
 #include <openssl/rsa.h>
 #include <openssl/core_names.h>
@@ -28,13 +27,13 @@
 #define GCM_TAG_LEN 16
 
 /* @rfc{7516,5.1} CSPRNG for CEK/IV generation and the @rfc{7516,11.5}
- * random-CEK fallback. Backed by OpenSSL RAND_bytes. */
+ * random-CEK fallback. Backed by OpenSSL RAND_bytes_ex(). */
 int openssl_rng(unsigned char *out, size_t len)
 {
 	if (out == NULL || len == 0)
 		return 1; // LCOV_EXCL_LINE
 
-	if (RAND_bytes(out, (int)len) != 1)
+	if (RAND_bytes_ex(openssl_libctx(), out, len, 0) != 1)
 		return 1; // LCOV_EXCL_LINE
 
 	return 0;
@@ -45,11 +44,11 @@ static const EVP_CIPHER *gcm_cipher(jwe_enc_t enc)
 {
 	switch (enc) {
 	case JWE_ENC_A128GCM:
-		return EVP_aes_128_gcm();
+		return openssl_cipher(OSSL_AES_128_GCM);
 	case JWE_ENC_A192GCM:
-		return EVP_aes_192_gcm();
+		return openssl_cipher(OSSL_AES_192_GCM);
 	case JWE_ENC_A256GCM:
-		return EVP_aes_256_gcm();
+		return openssl_cipher(OSSL_AES_256_GCM);
 	// LCOV_EXCL_START
 	default:
 		return NULL;
@@ -193,22 +192,22 @@ out:
  * the (equal) MAC/ENC key half-length, which is also the truncated tag length
  * T_LEN. Returns 0 on success. */
 static int cbc_params(jwe_enc_t enc, const EVP_CIPHER **cipher,
-		      const EVP_MD **md, size_t *half)
+		      int *md, size_t *half)
 {
 	switch (enc) {
 	case JWE_ENC_A128CBC_HS256:
-		*cipher = EVP_aes_128_cbc();
-		*md = EVP_sha256();
+		*cipher = openssl_cipher(OSSL_AES_128_CBC);
+		*md = OSSL_MD_SHA256;
 		*half = 16;
 		return 0;
 	case JWE_ENC_A192CBC_HS384:
-		*cipher = EVP_aes_192_cbc();
-		*md = EVP_sha384();
+		*cipher = openssl_cipher(OSSL_AES_192_CBC);
+		*md = OSSL_MD_SHA384;
 		*half = 24;
 		return 0;
 	case JWE_ENC_A256CBC_HS512:
-		*cipher = EVP_aes_256_cbc();
-		*md = EVP_sha512();
+		*cipher = openssl_cipher(OSSL_AES_256_CBC);
+		*md = OSSL_MD_SHA512;
 		*half = 32;
 		return 0;
 	// LCOV_EXCL_START
@@ -222,7 +221,7 @@ static int cbc_params(jwe_enc_t enc, const EVP_CIPHER **cipher,
  * AAD || IV || CT || AL, where AL is the 64-bit big-endian bit-length of the
  * AAD, truncated to the leftmost T_LEN (= half) octets. @out must hold at
  * least EVP_MAX_MD_SIZE bytes. */
-static int cbc_hmac_tag(const EVP_MD *md, const unsigned char *mac_key,
+static int cbc_hmac_tag(int md, const unsigned char *mac_key,
 			size_t half, const unsigned char *aad, size_t aad_len,
 			const unsigned char *iv, size_t iv_len,
 			const unsigned char *ct, size_t ct_len,
@@ -250,7 +249,7 @@ static int cbc_hmac_tag(const EVP_MD *md, const unsigned char *mac_key,
 	if (ct_len) { memcpy(buf + off, ct, ct_len); off += ct_len; }
 	memcpy(buf + off, al, sizeof(al));
 
-	if (HMAC(md, mac_key, (int)half, buf, buf_len, out, &mdlen) != NULL &&
+	if (!openssl_hmac(md, mac_key, half, buf, buf_len, out, &mdlen) &&
 	    mdlen >= half)
 		ret = 0;
 
@@ -268,7 +267,7 @@ int openssl_encrypt_aes_cbc_hmac(jwe_enc_t enc, const unsigned char *cek,
 	unsigned char **tag, size_t *tag_len)
 {
 	const EVP_CIPHER *cipher = NULL;
-	const EVP_MD *md = NULL;
+	int md = 0;
 	EVP_CIPHER_CTX *ctx = NULL;
 	unsigned char hmac[EVP_MAX_MD_SIZE];
 	unsigned char *out = NULL, *t = NULL;
@@ -276,7 +275,7 @@ int openssl_encrypt_aes_cbc_hmac(jwe_enc_t enc, const unsigned char *cek,
 	size_t half;
 	int len, ret = 1;
 
-	if (cbc_params(enc, &cipher, &md, &half) ||
+	if (cbc_params(enc, &cipher, &md, &half) || cipher == NULL ||
 	    cek_len != jwe_enc_cek_len(enc) || iv_len != 16)
 		return 1; // LCOV_EXCL_LINE
 
@@ -333,7 +332,7 @@ int openssl_decrypt_aes_cbc_hmac(jwe_enc_t enc, const unsigned char *cek,
 	unsigned char **pt, size_t *pt_len)
 {
 	const EVP_CIPHER *cipher = NULL;
-	const EVP_MD *md = NULL;
+	int md = 0;
 	EVP_CIPHER_CTX *ctx = NULL;
 	unsigned char hmac[EVP_MAX_MD_SIZE];
 	unsigned char *out = NULL;
@@ -341,7 +340,7 @@ int openssl_decrypt_aes_cbc_hmac(jwe_enc_t enc, const unsigned char *cek,
 	size_t half;
 	int len, ret = 1;
 
-	if (cbc_params(enc, &cipher, &md, &half) ||
+	if (cbc_params(enc, &cipher, &md, &half) || cipher == NULL ||
 	    cek_len != jwe_enc_cek_len(enc) || iv_len != 16 ||
 	    tag_len != half)
 		return 1; // LCOV_EXCL_LINE
@@ -392,11 +391,11 @@ static const EVP_CIPHER *kw_cipher(size_t key_len)
 {
 	switch (key_len) {
 	case 16:
-		return EVP_aes_128_wrap();
+		return openssl_cipher(OSSL_AES_128_WRAP);
 	case 24:
-		return EVP_aes_192_wrap();
+		return openssl_cipher(OSSL_AES_192_WRAP);
 	case 32:
-		return EVP_aes_256_wrap();
+		return openssl_cipher(OSSL_AES_256_WRAP);
 	// LCOV_EXCL_START
 	default:
 		return NULL;
@@ -535,11 +534,13 @@ static int oaep_set_md(EVP_PKEY_CTX *pctx, jwe_key_alg_t alg)
 	const EVP_MD *md;
 
 	if (alg == JWE_ALG_RSA_OAEP)
-		md = EVP_sha1();
+		md = openssl_md(OSSL_MD_SHA1);
 	else if (alg == JWE_ALG_RSA_OAEP_256)
-		md = EVP_sha256();
+		md = openssl_md(OSSL_MD_SHA256);
 	else
 		return 1; // LCOV_EXCL_LINE
+	if (md == NULL)
+		return 1; // LCOV_EXCL_LINE
 
 	if (EVP_PKEY_CTX_set_rsa_padding(pctx, RSA_PKCS1_OAEP_PADDING) <= 0)
 		return 1; // LCOV_EXCL_LINE
@@ -565,7 +566,8 @@ static int rsa_oaep_encrypt_pkey(jwe_key_alg_t alg, EVP_PKEY *pkey,
 	if (pkey == NULL)
 		return 1; // LCOV_EXCL_LINE
 
-	pctx = EVP_PKEY_CTX_new(pkey, NULL);
+	pctx = EVP_PKEY_CTX_new_from_pkey(openssl_libctx(), pkey,
+					  openssl_propq());
 	if (pctx == NULL)
 		return 1; // LCOV_EXCL_LINE
 
@@ -618,7 +620,8 @@ static int rsa_oaep_decrypt_pkey(jwe_key_alg_t alg, EVP_PKEY *pkey,
 	if (pkey == NULL)
 		return 1; // LCOV_EXCL_LINE
 
-	pctx = EVP_PKEY_CTX_new(pkey, NULL);
+	pctx = EVP_PKEY_CTX_new_from_pkey(openssl_libctx(), pkey,
+					  openssl_propq());
 	if (pctx == NULL)
 		return 1; // LCOV_EXCL_LINE
 
@@ -747,7 +750,7 @@ static int concat_kdf(const unsigned char *z, size_t z_len,
 
 	mdctx = EVP_MD_CTX_new();
 	if (mdctx != NULL &&
-	    EVP_DigestInit_ex(mdctx, EVP_sha256(), NULL) == 1 &&
+	    EVP_DigestInit_ex(mdctx, openssl_md(OSSL_MD_SHA256), NULL) == 1 &&
 	    EVP_DigestUpdate(mdctx, buf, off) == 1 &&
 	    EVP_DigestFinal_ex(mdctx, hash, &hlen) == 1) {
 		memcpy(out, hash, keydatalen);
@@ -879,7 +882,8 @@ static EVP_PKEY *epk_from_json(jwt_json_t *epk, const char *want_crv)
 	if (params == NULL)
 		goto out; // LCOV_EXCL_LINE
 
-	pctx = EVP_PKEY_CTX_new_from_name(NULL, "EC", NULL);
+	pctx = EVP_PKEY_CTX_new_from_name(openssl_libctx(), "EC",
+					  openssl_propq());
 	if (pctx == NULL || EVP_PKEY_fromdata_init(pctx) <= 0 ||
 	    EVP_PKEY_fromdata(pctx, &pkey, EVP_PKEY_PUBLIC_KEY, params) <= 0)
 		pkey = NULL; // LCOV_EXCL_LINE
@@ -959,7 +963,8 @@ static EVP_PKEY *okp_epk_from_json(jwt_json_t *epk, const char *want_crv)
 	if (xb == NULL || xlen <= 0)
 		goto out; // LCOV_EXCL_LINE
 
-	pkey = EVP_PKEY_new_raw_public_key_ex(NULL, want_crv, NULL, xb,
+	pkey = EVP_PKEY_new_raw_public_key_ex(openssl_libctx(), want_crv,
+					      openssl_propq(), xb,
 					      (size_t)xlen);
 
 out:
@@ -972,7 +977,8 @@ out:
 static int ecdh_z(EVP_PKEY *priv, EVP_PKEY *peer, unsigned char **z,
 		  size_t *z_len)
 {
-	EVP_PKEY_CTX *dctx = EVP_PKEY_CTX_new(priv, NULL);
+	EVP_PKEY_CTX *dctx = EVP_PKEY_CTX_new_from_pkey(openssl_libctx(), priv,
+							 openssl_propq());
 	unsigned char *buf = NULL;
 	size_t len = 0;
 	int ret = 1;
@@ -1042,7 +1048,8 @@ int openssl_ecdh_derive(jwe_key_alg_t alg, jwe_enc_t enc,
 		 * (X25519/X448) keygen directly by name; EC needs the group
 		 * set on the context. */
 		if (is_okp) {
-			gctx = EVP_PKEY_CTX_new_from_name(NULL, crv, NULL);
+			gctx = EVP_PKEY_CTX_new_from_name(openssl_libctx(),
+							  crv, openssl_propq());
 			if (gctx == NULL || EVP_PKEY_keygen_init(gctx) <= 0)
 				goto out; // LCOV_EXCL_LINE
 		} else {
@@ -1053,7 +1060,8 @@ int openssl_ecdh_derive(jwe_key_alg_t alg, jwe_enc_t enc,
 			else if (!strcmp(crv, "P-521")) ossl_crv = "secp521r1";
 			else goto out;
 
-			gctx = EVP_PKEY_CTX_new_from_name(NULL, "EC", NULL);
+			gctx = EVP_PKEY_CTX_new_from_name(openssl_libctx(),
+							  "EC", openssl_propq());
 			if (gctx == NULL || EVP_PKEY_keygen_init(gctx) <= 0)
 				goto out; // LCOV_EXCL_LINE
 			if (EVP_PKEY_CTX_set_group_name(gctx, ossl_crv) <= 0)
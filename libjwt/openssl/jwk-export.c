@@ -227,34 +227,36 @@ static void export_rsa(EVP_PKEY *pkey, int priv, jwk_export_t *out)
 	add_bn(pkey, OSSL_PKEY_PARAM_RSA_COEFFICIENT1, out, "qi");
 }
 
-/* Read an EVP_PKEY from a BIO. Tries, in order: PEM public, PEM private, DER
+/* Read an EVP_PKEY from @key. Tries, in order: PEM public, PEM private, DER
  * public (SubjectPublicKeyInfo), DER private (PKCS#8/traditional). Sets *priv
  * to 1 if a private key was read. Returns NULL if none parsed. */
-static EVP_PKEY *read_pkey(BIO *bio, int *priv)
+static EVP_PKEY *read_pkey(BIO *bio, const char *key, size_t len, int *priv)
 {
+	const unsigned char *p = (const unsigned char *)key;
+	OSSL_LIB_CTX *libctx = openssl_libctx();
+	const char *propq = openssl_propq();
 	EVP_PKEY *pkey;
 
 	*priv = 0;
 
-	pkey = PEM_read_bio_PUBKEY(bio, NULL, NULL, NULL);
+	pkey = PEM_read_bio_PUBKEY_ex(bio, NULL, NULL, NULL, libctx, propq);
 	if (pkey != NULL)
 		return pkey;
 
 	BIO_reset(bio);
-	pkey = PEM_read_bio_PrivateKey(bio, NULL, NULL, NULL);
+	pkey = PEM_read_bio_PrivateKey_ex(bio, NULL, NULL, NULL, libctx, propq);
 	if (pkey != NULL) {
 		*priv = 1;
 		return pkey;
 	}
 
 	/* Not PEM, try DER. */
-	BIO_reset(bio);
-	pkey = d2i_PUBKEY_bio(bio, NULL);
+	pkey = d2i_PUBKEY_ex(NULL, &p, (long)len, libctx, propq);
 	if (pkey != NULL)
 		return pkey;
 
 	BIO_reset(bio);
-	pkey = d2i_PrivateKey_bio(bio, NULL);
+	pkey = d2i_PrivateKey_ex_bio(bio, NULL, libctx, propq);
 	if (pkey != NULL)
 		*priv = 1;
 
@@ -272,7 +274,7 @@ int openssl_key2jwk_params(const char *key, size_t len, jwk_export_t *out)
 	if (bio == NULL)
 		return 1; // LCOV_EXCL_LINE
 
-	pkey = read_pkey(bio, &priv);
+	pkey = read_pkey(bio, key, len, &priv);
 	BIO_free(bio);
 
 	/* Not a parseable key; the common code may try the HMAC fallback. */
@@ -240,13 +240,17 @@ int openssl_process_eddsa(jwt_json_t *jwk, jwk_item_t *item)
 
 	crv_str = jwt_json_str_val(crv);
 	if (!strcmp(crv_str, "Ed25519"))
-		pctx = EVP_PKEY_CTX_new_from_name(NULL, "ED25519", NULL);
+		pctx = EVP_PKEY_CTX_new_from_name(openssl_libctx(), "ED25519",
+						  openssl_propq());
 	else if (!strcmp(crv_str, "Ed448"))
-		pctx = EVP_PKEY_CTX_new_from_name(NULL, "ED448", NULL);
+		pctx = EVP_PKEY_CTX_new_from_name(openssl_libctx(), "ED448",
+						  openssl_propq());
 	else if (!strcmp(crv_str, "X25519"))
-		pctx = EVP_PKEY_CTX_new_from_name(NULL, "X25519", NULL);
+		pctx = EVP_PKEY_CTX_new_from_name(openssl_libctx(), "X25519",
+						  openssl_propq());
 	else if (!strcmp(crv_str, "X448"))
-		pctx = EVP_PKEY_CTX_new_from_name(NULL, "X448", NULL);
+		pctx = EVP_PKEY_CTX_new_from_name(openssl_libctx(), "X448",
+						  openssl_propq());
 	else {
 		jwt_write_error(item,
                         "Unknown curve [%s] (note, curves are case sensitive)",
@@ -360,7 +364,8 @@ int openssl_process_mldsa(jwt_json_t *jwk, jwk_item_t *item)
 	if (priv != NULL)
 		item->is_private_key = is_priv = 1;
 
-	pctx = EVP_PKEY_CTX_new_from_name(NULL, alg_str, NULL);
+	pctx = EVP_PKEY_CTX_new_from_name(openssl_libctx(), alg_str,
+					  openssl_propq());
 	if (pctx == NULL) {
 		// LCOV_EXCL_START
 		jwt_write_error(item, "Error creating pkey context");
@@ -469,8 +474,9 @@ int openssl_process_rsa(jwt_json_t *jwk, jwk_item_t *item)
 		goto cleanup_rsa;
 	}
 
-	pctx = EVP_PKEY_CTX_new_from_name(NULL, is_rsa_pss ? "RSA-PSS" : "RSA",
-					  NULL);
+	pctx = EVP_PKEY_CTX_new_from_name(openssl_libctx(),
+					  is_rsa_pss ? "RSA-PSS" : "RSA",
+					  openssl_propq());
 	if (pctx == NULL) {
 		// LCOV_EXCL_START
 		jwt_write_error(item, "Error creating pkey context");
@@ -590,7 +596,8 @@ int openssl_process_ec(jwt_json_t *jwk, jwk_item_t *item)
 	if (d != NULL)
 		item->is_private_key = priv = 1;
 
-	pctx = EVP_PKEY_CTX_new_from_name(NULL, "EC", NULL);
+	pctx = EVP_PKEY_CTX_new_from_name(openssl_libctx(), "EC",
+					  openssl_propq());
 	if (pctx == NULL) {
 		// LCOV_EXCL_START
 		jwt_write_error(item, "Error creating pkey context");
@@ -659,6 +666,7 @@ void openssl_process_item_free(jwk_item_t *item)
 	if (item == NULL || item->provider != JWT_CRYPTO_OPS_OPENSSL)
 		return;
 
+	openssl_key_cache_free(item);
 	EVP_PKEY_free(item->provider_data);
 	if (item->pem) {
 		OPENSSL_cleanse(item->pem, strlen(item->pem));
@@ -694,7 +702,8 @@ int openssl_generate_pem(jwk_key_type_t kty, const char *param, jwt_alg_t alg,
 		else if (!strcmp(crv, "secp256k1"))	ossl = "secp256k1";
 		else return 1;
 
-		ctx = EVP_PKEY_CTX_new_from_name(NULL, "EC", NULL);
+		ctx = EVP_PKEY_CTX_new_from_name(openssl_libctx(), "EC",
+						 openssl_propq());
 		if (ctx == NULL || EVP_PKEY_keygen_init(ctx) <= 0)
 			goto out; // LCOV_EXCL_LINE
 		if (EVP_PKEY_CTX_set_group_name(ctx, ossl) <= 0)
@@ -707,7 +716,8 @@ int openssl_generate_pem(jwk_key_type_t kty, const char *param, jwt_alg_t alg,
 		if (strcmp(crv, "Ed25519") && strcmp(crv, "Ed448") &&
 		    strcmp(crv, "X25519") && strcmp(crv, "X448"))
 			return 1;
-		ctx = EVP_PKEY_CTX_new_from_name(NULL, crv, NULL);
+		ctx = EVP_PKEY_CTX_new_from_name(openssl_libctx(), crv,
+						 openssl_propq());
 		if (ctx == NULL || EVP_PKEY_keygen_init(ctx) <= 0)
 			goto out; // LCOV_EXCL_LINE
 		break;
@@ -719,8 +729,9 @@ int openssl_generate_pem(jwk_key_type_t kty, const char *param, jwt_alg_t alg,
 
 		if (bits < 2048)
 			return 1;
-		ctx = EVP_PKEY_CTX_new_from_name(NULL, is_pss ? "RSA-PSS" : "RSA",
-						 NULL);
+		ctx = EVP_PKEY_CTX_new_from_name(openssl_libctx(),
+						 is_pss ? "RSA-PSS" : "RSA",
+						 openssl_propq());
 		if (ctx == NULL || EVP_PKEY_keygen_init(ctx) <= 0)
 			goto out; // LCOV_EXCL_LINE
 		if (EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, (int)bits) <= 0)
@@ -735,7 +746,8 @@ int openssl_generate_pem(jwk_key_type_t kty, const char *param, jwt_alg_t alg,
 
 		if (name == NULL)
 			return 1;
-		ctx = EVP_PKEY_CTX_new_from_name(NULL, name, NULL);
+		ctx = EVP_PKEY_CTX_new_from_name(openssl_libctx(), name,
+						 openssl_propq());
 		if (ctx == NULL || EVP_PKEY_keygen_init(ctx) <= 0)
 			goto out; // LCOV_EXCL_LINE
 		break;
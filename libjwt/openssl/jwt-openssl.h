@@ -17,6 +17,8 @@ int openssl_process_rsa(jwt_json_t *jwk, jwk_item_t *item);
 int openssl_process_ec(jwt_json_t *jwk, jwk_item_t *item);
 void openssl_process_item_free(jwk_item_t *item);
 JWT_NO_EXPORT
+void openssl_key_cache_free(jwk_item_t *item);
+JWT_NO_EXPORT
 int openssl_key2jwk_params(const char *key, size_t len, jwk_export_t *out);
 JWT_NO_EXPORT
 int openssl_generate_pem(jwk_key_type_t kty, const char *param, jwt_alg_t alg,
@@ -81,4 +83,48 @@ int openssl_ecdh_derive(jwe_key_alg_t alg, jwe_enc_t enc,
 	const jwk_item_t *key, int for_encrypt, jwt_json_t *hdr,
 	unsigned char **dk, size_t *dk_len);
 
+/* Library context and fetched algorithms (libctx.c). The ids index the
+ * backend's caches of fetched objects. */
+enum {
+	OSSL_MD_SHA1,
+	OSSL_MD_SHA256,
+	OSSL_MD_SHA384,
+	OSSL_MD_SHA512,
+	OSSL_MD_COUNT
+};
+
+enum {
+	OSSL_AES_128_GCM,
+	OSSL_AES_192_GCM,
+	OSSL_AES_256_GCM,
+	OSSL_AES_128_CBC,
+	OSSL_AES_192_CBC,
+	OSSL_AES_256_CBC,
+	OSSL_AES_128_WRAP,
+	OSSL_AES_192_WRAP,
+	OSSL_AES_256_WRAP,
+	OSSL_CIPHER_COUNT
+};
+
+JWT_NO_EXPORT
+OSSL_LIB_CTX *openssl_libctx(void);
+JWT_NO_EXPORT
+const char *openssl_propq(void);
+JWT_NO_EXPORT
+int openssl_md_id(int sha_bits);
+JWT_NO_EXPORT
+const EVP_MD *openssl_md(int id);
+JWT_NO_EXPORT
+const EVP_CIPHER *openssl_cipher(int id);
+JWT_NO_EXPORT
+EVP_MAC_CTX *openssl_hmac_new(int id, const void *key, size_t key_len);
+JWT_NO_EXPORT
+int openssl_hmac_keyed(const EVP_MAC_CTX *keyed, const unsigned char *in,
+		       size_t in_len, unsigned char *out,
+		       unsigned int *out_len);
+JWT_NO_EXPORT
+int openssl_hmac(int id, const void *key, size_t key_len,
+		 const unsigned char *in, size_t in_len,
+		 unsigned char *out, unsigned int *out_len);
+
 #endif /* JWT_OPENSSL_H */
@@ -0,0 +1,284 @@
+/* Copyright (C) 2026 maClara, LLC <info@maclara-llc.com>
+   This file is part of the JWT C Library
+
+   SPDX-License-Identifier:  MPL-2.0
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0. If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/* OpenSSL 3 library context and the algorithms fetched from it.
+ *
+ * Passing EVP_sha256() and friends, or calling HMAC(), makes OpenSSL 3 look
+ * up an implementation in the provider store on every operation, and that
+ * lookup takes the store's lock. Instead, each digest, MAC and cipher the
+ * backend uses is fetched once, on first use, and kept until the library
+ * context changes. After the first use a lookup is one atomic load.
+ *
+ * The library context and property query are OpenSSL's defaults unless the
+ * application picks its own with jwt_set_crypto_openssl_libctx() (e.g. one
+ * with only the FIPS provider loaded). Keys, contexts and random bytes the
+ * backend creates then come from it as well. */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/evp.h>
+#include <openssl/core_names.h>
+#include <openssl/crypto.h>
+#include <openssl/params.h>
+
+#include <jwt.h>
+
+#include "jwt-private.h"
+#include "jwt-openssl.h"
+
+static const char *md_names[OSSL_MD_COUNT] = {
+	[OSSL_MD_SHA1]		= "SHA1",
+	[OSSL_MD_SHA256]	= "SHA256",
+	[OSSL_MD_SHA384]	= "SHA384",
+	[OSSL_MD_SHA512]	= "SHA512",
+};
+
+static const char *cipher_names[OSSL_CIPHER_COUNT] = {
+	[OSSL_AES_128_GCM]	= "AES-128-GCM",
+	[OSSL_AES_192_GCM]	= "AES-192-GCM",
+	[OSSL_AES_256_GCM]	= "AES-256-GCM",
+	[OSSL_AES_128_CBC]	= "AES-128-CBC",
+	[OSSL_AES_192_CBC]	= "AES-192-CBC",
+	[OSSL_AES_256_CBC]	= "AES-256-CBC",
+	[OSSL_AES_128_WRAP]	= "AES-128-WRAP",
+	[OSSL_AES_192_WRAP]	= "AES-192-WRAP",
+	[OSSL_AES_256_WRAP]	= "AES-256-WRAP",
+};
+
+static OSSL_LIB_CTX *libctx;
+static char *propq;
+
+static EVP_MD *mds[OSSL_MD_COUNT];
+static EVP_CIPHER *ciphers[OSSL_CIPHER_COUNT];
+/* HMAC contexts with the digest (and a throwaway key) set, to copy from. */
+static EVP_MAC_CTX *hmacs[OSSL_MD_COUNT];
+
+OSSL_LIB_CTX *openssl_libctx(void)
+{
+	return libctx;
+}
+
+const char *openssl_propq(void)
+{
+	return propq;
+}
+
+/* The SHA-2 digest id for @sha_bits, or -1. */
+int openssl_md_id(int sha_bits)
+{
+	switch (sha_bits) {
+	case 256:
+		return OSSL_MD_SHA256;
+	case 384:
+		return OSSL_MD_SHA384;
+	case 512:
+		return OSSL_MD_SHA512;
+	default:
+		return -1;
+	}
+}
+
+const EVP_MD *openssl_md(int id)
+{
+	EVP_MD *md, *expected = NULL;
+
+	md = __atomic_load_n(&mds[id], __ATOMIC_ACQUIRE);
+	if (md != NULL)
+		return md;
+
+	md = EVP_MD_fetch(libctx, md_names[id], propq);
+	if (md == NULL)
+		return NULL;
+
+	/* A racing first caller may have published one already. */
+	if (!__atomic_compare_exchange_n(&mds[id], &expected, md, 0,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		EVP_MD_free(md);
+		md = expected;
+	}
+
+	return md;
+}
+
+const EVP_CIPHER *openssl_cipher(int id)
+{
+	EVP_CIPHER *cipher, *expected = NULL;
+
+	cipher = __atomic_load_n(&ciphers[id], __ATOMIC_ACQUIRE);
+	if (cipher != NULL)
+		return cipher;
+
+	cipher = EVP_CIPHER_fetch(libctx, cipher_names[id], propq);
+	if (cipher == NULL)
+		return NULL;
+
+	if (!__atomic_compare_exchange_n(&ciphers[id], &expected, cipher, 0,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		EVP_CIPHER_free(cipher);
+		cipher = expected;
+	}
+
+	return cipher;
+}
+
+/* A context can only be duplicated once it has a key, so the template gets
+ * a throwaway one. Every copy is re-keyed before use. */
+static EVP_MAC_CTX *hmac_template(int id)
+{
+	static const unsigned char dummy[32];
+	EVP_MAC_CTX *ctx, *expected = NULL;
+	OSSL_PARAM params[3];
+	EVP_MAC *mac;
+	int n;
+
+	ctx = __atomic_load_n(&hmacs[id], __ATOMIC_ACQUIRE);
+	if (ctx != NULL)
+		return ctx;
+
+	mac = EVP_MAC_fetch(libctx, OSSL_MAC_NAME_HMAC, propq);
+	if (mac == NULL)
+		return NULL; // LCOV_EXCL_LINE
+
+	ctx = EVP_MAC_CTX_new(mac);
+	EVP_MAC_free(mac);
+	if (ctx == NULL)
+		return NULL; // LCOV_EXCL_LINE
+
+	/* The digest is fetched with the same property query. */
+	n = 0;
+	params[n++] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+						       (char *)md_names[id], 0);
+	if (propq != NULL)
+		params[n++] = OSSL_PARAM_construct_utf8_string(
+			OSSL_MAC_PARAM_PROPERTIES, propq, 0);
+	params[n] = OSSL_PARAM_construct_end();
+
+	if (!EVP_MAC_init(ctx, dummy, sizeof(dummy), params)) {
+		// LCOV_EXCL_START
+		EVP_MAC_CTX_free(ctx);
+		return NULL;
+		// LCOV_EXCL_STOP
+	}
+
+	if (!__atomic_compare_exchange_n(&hmacs[id], &expected, ctx, 0,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		EVP_MAC_CTX_free(ctx);
+		ctx = expected;
+	}
+
+	return ctx;
+}
+
+EVP_MAC_CTX *openssl_hmac_new(int id, const void *key, size_t key_len)
+{
+	EVP_MAC_CTX *tmpl, *ctx;
+
+	tmpl = hmac_template(id);
+	if (tmpl == NULL)
+		return NULL; // LCOV_EXCL_LINE
+
+	ctx = EVP_MAC_CTX_dup(tmpl);
+	if (ctx == NULL)
+		return NULL; // LCOV_EXCL_LINE
+
+	if (!EVP_MAC_init(ctx, key, key_len, NULL)) {
+		// LCOV_EXCL_START
+		EVP_MAC_CTX_free(ctx);
+		return NULL;
+		// LCOV_EXCL_STOP
+	}
+
+	return ctx;
+}
+
+static int hmac_finish(EVP_MAC_CTX *ctx, const unsigned char *in,
+		       size_t in_len, unsigned char *out,
+		       unsigned int *out_len)
+{
+	size_t len = 0;
+
+	if (!EVP_MAC_update(ctx, in, in_len) ||
+	    !EVP_MAC_final(ctx, out, &len, EVP_MAX_MD_SIZE))
+		return 1; // LCOV_EXCL_LINE
+
+	*out_len = (unsigned int)len;
+
+	return 0;
+}
+
+int openssl_hmac_keyed(const EVP_MAC_CTX *keyed, const unsigned char *in,
+		       size_t in_len, unsigned char *out,
+		       unsigned int *out_len)
+{
+	EVP_MAC_CTX *ctx;
+	int ret;
+
+	/* @keyed is shared; work on a copy of its pad state. */
+	ctx = EVP_MAC_CTX_dup(keyed);
+	if (ctx == NULL)
+		return 1; // LCOV_EXCL_LINE
+
+	ret = hmac_finish(ctx, in, in_len, out, out_len);
+	EVP_MAC_CTX_free(ctx);
+
+	return ret;
+}
+
+int openssl_hmac(int id, const void *key, size_t key_len,
+		 const unsigned char *in, size_t in_len,
+		 unsigned char *out, unsigned int *out_len)
+{
+	EVP_MAC_CTX *ctx;
+	int ret;
+
+	ctx = openssl_hmac_new(id, key, key_len);
+	if (ctx == NULL)
+		return 1; // LCOV_EXCL_LINE
+
+	ret = hmac_finish(ctx, in, in_len, out, out_len);
+	EVP_MAC_CTX_free(ctx);
+
+	return ret;
+}
+
+static void openssl_fetch_flush(void)
+{
+	int i;
+
+	for (i = 0; i < OSSL_MD_COUNT; i++) {
+		EVP_MD_free(mds[i]);
+		mds[i] = NULL;
+		EVP_MAC_CTX_free(hmacs[i]);
+		hmacs[i] = NULL;
+	}
+
+	for (i = 0; i < OSSL_CIPHER_COUNT; i++) {
+		EVP_CIPHER_free(ciphers[i]);
+		ciphers[i] = NULL;
+	}
+}
+
+int openssl_set_libctx(void *ctx, const char *pq)
+{
+	char *copy = NULL;
+
+	if (pq != NULL) {
+		copy = OPENSSL_strdup(pq);
+		if (copy == NULL)
+			return 1; // LCOV_EXCL_LINE
+	}
+
+	openssl_fetch_flush();
+
+	OPENSSL_free(propq);
+	propq = copy;
+	libctx = ctx;
+
+	return 0;
+}
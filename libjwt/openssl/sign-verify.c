@@ -11,13 +11,15 @@
 
 #include <openssl/bio.h>
 #include <openssl/evp.h>
-#include <openssl/hmac.h>
 #include <openssl/buffer.h>
 #include <openssl/pem.h>
 #include <openssl/bn.h>
 #include <openssl/rsa.h>
 #include <openssl/opensslv.h>
 #include <openssl/err.h>
+#include <openssl/kdf.h>
+#include <openssl/core_names.h>
+#include <openssl/params.h>
 
 #include <jwt.h>
 
@@ -27,28 +29,90 @@
 
 /* Routines to support crypto in LibJWT using OpenSSL. */
 
-static int openssl_sign_sha_hmac(jwt_t *jwt, char **out, unsigned int *len,
-				 const char *str, unsigned int str_len)
+/* HS* key state: per digest, an HMAC context already keyed with the oct
+ * key, so the inner and outer pad blocks are hashed once per key instead of
+ * once per token. Each MAC is computed on a copy. Hung off the key and
+ * published like the sign/verify templates below. */
+struct openssl_hmac_state {
+	struct jwk_hmac_state hdr;
+	EVP_MAC_CTX *ctx[OSSL_MD_COUNT];
+};
+
+static void openssl_hmac_state_free(struct jwk_hmac_state *hdr)
 {
-	const EVP_MD *alg;
-	void *key;
-	size_t key_len;
+	struct openssl_hmac_state *st = (struct openssl_hmac_state *)hdr;
+	int i;
 
-	key = jwt->key->oct.key;
-	key_len = jwt->key->oct.len;
+	for (i = 0; i < OSSL_MD_COUNT; i++)
+		EVP_MAC_CTX_free(st->ctx[i]);
 
-	*out = NULL;
+	OPENSSL_free(st);
+}
+
+/* @jwt's key, keyed for @md, or NULL if it cannot be cached (including
+ * when another backend already hung its own state on the key). */
+static const EVP_MAC_CTX *openssl_hmac_state(jwt_t *jwt, int md)
+{
+	struct jwk_hmac_state **slot, *hdr_exp = NULL;
+	struct openssl_hmac_state *st;
+	EVP_MAC_CTX *ctx, *ctx_exp = NULL;
+
+	/* Like the thumbprint, this is cached on an otherwise const key. */
+	slot = (struct jwk_hmac_state **)&jwt->key->hmac;
+
+	st = (struct openssl_hmac_state *)__atomic_load_n(slot,
+							  __ATOMIC_ACQUIRE);
+	if (st == NULL) {
+		st = OPENSSL_zalloc(sizeof(*st));
+		if (st == NULL)
+			return NULL; // LCOV_EXCL_LINE
+		st->hdr.provider = JWT_CRYPTO_OPS_OPENSSL;
+		st->hdr.free = openssl_hmac_state_free;
+
+		if (!__atomic_compare_exchange_n(slot, &hdr_exp, &st->hdr, 0,
+						 __ATOMIC_ACQ_REL,
+						 __ATOMIC_ACQUIRE)) {
+			OPENSSL_free(st);
+			st = (struct openssl_hmac_state *)hdr_exp;
+		}
+	}
+
+	if (st->hdr.provider != JWT_CRYPTO_OPS_OPENSSL)
+		return NULL; // LCOV_EXCL_LINE
+
+	ctx = __atomic_load_n(&st->ctx[md], __ATOMIC_ACQUIRE);
+	if (ctx != NULL)
+		return ctx;
+
+	ctx = openssl_hmac_new(md, jwt->key->oct.key, jwt->key->oct.len);
+	if (ctx == NULL)
+		return NULL; // LCOV_EXCL_LINE
+
+	if (!__atomic_compare_exchange_n(&st->ctx[md], &ctx_exp, ctx, 0,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		EVP_MAC_CTX_free(ctx);
+		ctx = ctx_exp;
+	}
+
+	return ctx;
+}
+
+static int openssl_hmac_sha(jwt_t *jwt, const char *str, unsigned int str_len,
+			    unsigned char *out, unsigned int *len)
+{
+	const EVP_MAC_CTX *keyed;
+	int md;
 
 	switch (jwt->alg) {
 	/* HMAC */
 	case JWT_ALG_HS256:
-		alg = EVP_sha256();
+		md = OSSL_MD_SHA256;
 		break;
 	case JWT_ALG_HS384:
-		alg = EVP_sha384();
+		md = OSSL_MD_SHA384;
 		break;
 	case JWT_ALG_HS512:
-		alg = EVP_sha512();
+		md = OSSL_MD_SHA512;
 		break;
 	// LCOV_EXCL_START
 	default:
@@ -56,12 +120,25 @@ static int openssl_sign_sha_hmac(jwt_t *jwt, char **out, unsigned int *len,
 	// LCOV_EXCL_STOP
 	}
 
+	keyed = openssl_hmac_state(jwt, md);
+	if (keyed != NULL)
+		return openssl_hmac_keyed(keyed, (const unsigned char *)str,
+					  str_len, out, len);
+
+	// LCOV_EXCL_START
+	return openssl_hmac(md, jwt->key->oct.key, jwt->key->oct.len,
+			    (const unsigned char *)str, str_len, out, len);
+	// LCOV_EXCL_STOP
+}
+
+static int openssl_sign_sha_hmac(jwt_t *jwt, char **out, unsigned int *len,
+				 const char *str, unsigned int str_len)
+{
 	*out = jwt_malloc(EVP_MAX_MD_SIZE);
 	if (*out == NULL)
 		return 1; // LCOV_EXCL_LINE
 
-	if (HMAC(alg, key, key_len, (const unsigned char *)str, str_len,
-		 (unsigned char *)*out, len) == NULL) {
+	if (openssl_hmac_sha(jwt, str, str_len, (unsigned char *)*out, len)) {
 		// LCOV_EXCL_START
 		jwt_freemem(*out);
 		*out = NULL;
@@ -72,52 +149,150 @@ static int openssl_sign_sha_hmac(jwt_t *jwt, char **out, unsigned int *len,
 	return 0;
 }
 
-static int jwt_ec_d2i(jwt_t *jwt, char **out, unsigned int *len,
-		      unsigned char *sig, unsigned int slen)
+/* Per-key DigestSign/DigestVerify templates.
+ *
+ * Initializing an operation (fetching the digest and signature method,
+ * binding the key, setting PSS parameters) costs about as much as hashing a
+ * typical token. So for RSA, RSA-PSS and EC keys each (operation, alg) is
+ * initialized once per key, and every sign or verify starts from a copy of
+ * that context instead. The templates hang off the key, are built on first
+ * use and published atomically (like the thumbprint cache), and are only
+ * ever read after that, so a key shared between threads needs no lock.
+ * EdDSA and ML-DSA are one-shot and are set up fresh each time. */
+enum { OSSL_OP_SIGN, OSSL_OP_VERIFY, OSSL_OP_COUNT };
+
+struct openssl_key_cache {
+	EVP_MD_CTX *tmpl[OSSL_OP_COUNT][JWT_ALG_INVAL];
+};
+
+static int openssl_md_init(EVP_MD_CTX *mdctx, int op, const EVP_MD *alg,
+			   EVP_PKEY *pkey, int type)
 {
-	unsigned int bn_len, r_len, s_len, buf_len;
-	ECDSA_SIG *ec_sig = NULL;
-	const BIGNUM *ec_sig_r;
-	const BIGNUM *ec_sig_s;
-	unsigned char *buf;
-
-	/* Get the sig from the DER encoded version. */
-	ec_sig = d2i_ECDSA_SIG(NULL, (const unsigned char **)&sig, slen);
-	if (ec_sig == NULL)
+	const char *mdname = alg ? EVP_MD_get0_name(alg) : NULL;
+	EVP_PKEY_CTX *pkey_ctx = NULL;
+	int ret;
+
+	if (op == OSSL_OP_SIGN)
+		ret = EVP_DigestSignInit_ex(mdctx, &pkey_ctx, mdname,
+					    openssl_libctx(), openssl_propq(),
+					    pkey, NULL);
+	else
+		ret = EVP_DigestVerifyInit_ex(mdctx, &pkey_ctx, mdname,
+					      openssl_libctx(), openssl_propq(),
+					      pkey, NULL);
+	if (ret != 1)
 		return 1; // LCOV_EXCL_LINE
 
-	ECDSA_SIG_get0(ec_sig, &ec_sig_r, &ec_sig_s);
-	r_len = BN_num_bytes(ec_sig_r);
-	s_len = BN_num_bytes(ec_sig_s);
-	bn_len = (jwt->key->bits + 7) / 8;
-	if ((r_len > bn_len) || (s_len > bn_len)) {
+	/* Required for RSA-PSS */
+	if (type != EVP_PKEY_RSA_PSS)
+		return 0;
+
+	if (EVP_PKEY_CTX_set_rsa_padding(pkey_ctx, RSA_PKCS1_PSS_PADDING) < 0)
+		return 1; // LCOV_EXCL_LINE
+	if (EVP_PKEY_CTX_set_rsa_pss_saltlen(pkey_ctx, op == OSSL_OP_SIGN ?
+					     RSA_PSS_SALTLEN_DIGEST :
+					     RSA_PSS_SALTLEN_AUTO) < 0)
+		return 1; // LCOV_EXCL_LINE
+
+	return 0;
+}
+
+static EVP_MD_CTX *openssl_key_tmpl(const jwk_item_t *item, int op,
+				    jwt_alg_t jalg, const EVP_MD *alg,
+				    int type)
+{
+	struct openssl_key_cache *kc, *kc_exp = NULL;
+	EVP_MD_CTX *t, *t_exp = NULL;
+	void **slot;
+
+	/* Like the thumbprint, this is cached on an otherwise const key. */
+	slot = (void **)&item->provider_cache;
+
+	kc = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+	if (kc == NULL) {
+		kc = OPENSSL_zalloc(sizeof(*kc));
+		if (kc == NULL)
+			return NULL; // LCOV_EXCL_LINE
+
+		if (!__atomic_compare_exchange_n(slot, (void **)&kc_exp, kc, 0,
+						 __ATOMIC_ACQ_REL,
+						 __ATOMIC_ACQUIRE)) {
+			OPENSSL_free(kc);
+			kc = kc_exp;
+		}
+	}
+
+	t = __atomic_load_n(&kc->tmpl[op][jalg], __ATOMIC_ACQUIRE);
+	if (t != NULL)
+		return t;
+
+	t = EVP_MD_CTX_new();
+	if (t == NULL)
+		return NULL; // LCOV_EXCL_LINE
+
+	if (openssl_md_init(t, op, alg, item->provider_data, type)) {
 		// LCOV_EXCL_START
-		ECDSA_SIG_free(ec_sig);
-		return 1;
+		EVP_MD_CTX_free(t);
+		return NULL;
 		// LCOV_EXCL_STOP
 	}
 
-	buf_len = 2 * bn_len;
-	buf = jwt_malloc(buf_len);
-	if (buf == NULL) {
+	if (!__atomic_compare_exchange_n(&kc->tmpl[op][jalg], &t_exp, t, 0,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		EVP_MD_CTX_free(t);
+		t = t_exp;
+	}
+
+	return t;
+}
+
+/* A context ready for @op with the token's key and alg, from the key's
+ * template when there is one. */
+static EVP_MD_CTX *openssl_md_ctx(jwt_t *jwt, int op, const EVP_MD *alg,
+				  int type)
+{
+	EVP_PKEY *pkey = jwt->key->provider_data;
+	EVP_MD_CTX *mdctx, *tmpl = NULL;
+
+	mdctx = EVP_MD_CTX_new();
+	if (mdctx == NULL)
+		return NULL; // LCOV_EXCL_LINE
+
+	if (type == EVP_PKEY_RSA || type == EVP_PKEY_RSA_PSS ||
+	    type == EVP_PKEY_EC)
+		tmpl = openssl_key_tmpl(jwt->key, op, jwt->alg, alg, type);
+
+	if (tmpl != NULL && EVP_MD_CTX_copy_ex(mdctx, tmpl) == 1)
+		return mdctx;
+
+	/* No template, or the provider cannot duplicate it. */
+	EVP_MD_CTX_reset(mdctx);
+	if (openssl_md_init(mdctx, op, alg, pkey, type)) {
 		// LCOV_EXCL_START
-		ECDSA_SIG_free(ec_sig);
-		return 1;
+		EVP_MD_CTX_free(mdctx);
+		return NULL;
 		// LCOV_EXCL_STOP
 	}
 
-	/* Pad the bignums with leading zeroes. Ends up looking sort
-	 * of like this "0000rrrrrrrSSSSS". */
-	memset(buf, 0, buf_len);
-	BN_bn2bin(ec_sig_r, buf + (bn_len - r_len));
-	BN_bn2bin(ec_sig_s, buf + (buf_len - s_len));
+	return mdctx;
+}
 
-	ECDSA_SIG_free(ec_sig);
+JWT_NO_EXPORT
+void openssl_key_cache_free(jwk_item_t *item)
+{
+	struct openssl_key_cache *kc = item->provider_cache;
+	int op, a;
 
-	*out = (char *)buf;
-	*len = buf_len;
+	if (kc == NULL)
+		return;
 
-	return 0;
+	for (op = 0; op < OSSL_OP_COUNT; op++) {
+		for (a = 0; a < JWT_ALG_INVAL; a++)
+			EVP_MD_CTX_free(kc->tmpl[op][a]);
+	}
+
+	OPENSSL_free(kc);
+	item->provider_cache = NULL;
 }
 
 #define SIGN_ERROR(_msg) { jwt_write_error(jwt, "JWT[OpenSSL]: " _msg); goto jwt_sign_sha_pem_done; }
@@ -126,10 +301,9 @@ static int openssl_sign_sha_pem(jwt_t *jwt, char **out, unsigned int *len,
 				const char *str, unsigned int str_len)
 {
 	EVP_MD_CTX *mdctx = NULL;
-	EVP_PKEY_CTX *pkey_ctx = NULL;
 	BIO *bufkey = NULL;
 	const EVP_MD *alg;
-	int type;
+	int md, type;
 	EVP_PKEY *pkey = NULL;
 	unsigned char *sig = NULL;
 	size_t slen;
@@ -139,44 +313,44 @@ static int openssl_sign_sha_pem(jwt_t *jwt, char **out, unsigned int *len,
 	switch (jwt->alg) {
 	/* RSA */
 	case JWT_ALG_RS256:
-		alg = EVP_sha256();
+		md = OSSL_MD_SHA256;
 		type = EVP_PKEY_RSA;
 		break;
 	case JWT_ALG_RS384:
-		alg = EVP_sha384();
+		md = OSSL_MD_SHA384;
 		type = EVP_PKEY_RSA;
 		break;
 	case JWT_ALG_RS512:
-		alg = EVP_sha512();
+		md = OSSL_MD_SHA512;
 		type = EVP_PKEY_RSA;
 		break;
 
 	/* RSA-PSS */
 	case JWT_ALG_PS256:
-		alg = EVP_sha256();
+		md = OSSL_MD_SHA256;
 		type = EVP_PKEY_RSA_PSS;
 		break;
 	case JWT_ALG_PS384:
-		alg = EVP_sha384();
+		md = OSSL_MD_SHA384;
 		type = EVP_PKEY_RSA_PSS;
 		break;
 	case JWT_ALG_PS512:
-		alg = EVP_sha512();
+		md = OSSL_MD_SHA512;
 		type = EVP_PKEY_RSA_PSS;
 		break;
 
 	/* ECC */
 	case JWT_ALG_ES256:
 	case JWT_ALG_ES256K:
-		alg = EVP_sha256();
+		md = OSSL_MD_SHA256;
 		type = EVP_PKEY_EC;
 		break;
 	case JWT_ALG_ES384:
-		alg = EVP_sha384();
+		md = OSSL_MD_SHA384;
 		type = EVP_PKEY_EC;
 		break;
 	case JWT_ALG_ES512:
-		alg = EVP_sha512();
+		md = OSSL_MD_SHA512;
 		type = EVP_PKEY_EC;
 		break;
 
@@ -184,7 +358,7 @@ static int openssl_sign_sha_pem(jwt_t *jwt, char **out, unsigned int *len,
 	case JWT_ALG_EDDSA:
 		/* Technically this is sha512 for ED25519 and
 		 * shake256 for ED448 */
-		alg = EVP_md_null();
+		md = -1;
 		type = EVP_PKEY_id(pkey);
 		if (type != EVP_PKEY_ED25519 && type != EVP_PKEY_ED448)
 			SIGN_ERROR("Unknown EdDSA curve"); // LCOV_EXCL_LINE
@@ -198,7 +372,7 @@ static int openssl_sign_sha_pem(jwt_t *jwt, char **out, unsigned int *len,
 	case JWT_ALG_ML_DSA_44:
 	case JWT_ALG_ML_DSA_65:
 	case JWT_ALG_ML_DSA_87:
-		alg = EVP_md_null();
+		md = -1;
 		/* Unreachable in practice: an AKP JWK carries a required "alg"
 		 * that setkey pins to the key, so a variant mismatch is caught
 		 * before signing (cf. the EdDSA curve check above). */
@@ -214,6 +388,10 @@ static int openssl_sign_sha_pem(jwt_t *jwt, char **out, unsigned int *len,
 	// LCOV_EXCL_STOP
 	}
 
+	alg = NULL;
+	if (md >= 0 && (alg = openssl_md(md)) == NULL)
+		SIGN_ERROR("Error fetching digest"); // LCOV_EXCL_LINE
+
 	if (type == EVP_PKEY_RSA_PSS) {
 	       if (EVP_PKEY_id(pkey) != EVP_PKEY_RSA &&
 		   EVP_PKEY_id(pkey) != EVP_PKEY_RSA_PSS) {
@@ -223,50 +401,47 @@ static int openssl_sign_sha_pem(jwt_t *jwt, char **out, unsigned int *len,
 		SIGN_ERROR("Incompatible key"); // LCOV_EXCL_LINE
 	}
 
-	mdctx = EVP_MD_CTX_create();
-	if (mdctx == NULL)
-		SIGN_ERROR("Error creating MD context"); // LCOV_EXCL_LINE
-
 	/* Initialize the DigestSign operation using alg */
-	if (EVP_DigestSignInit(mdctx, &pkey_ctx, alg, NULL, pkey) != 1)
-		SIGN_ERROR("Failued to initialize digest"); // LCOV_EXCL_LINE
-
-	/* Required for RSA-PSS */
-	if (type == EVP_PKEY_RSA_PSS) {
-		if (EVP_PKEY_CTX_set_rsa_padding(pkey_ctx,
-						RSA_PKCS1_PSS_PADDING) < 0)
-			SIGN_ERROR("Error setting RSASSA-PSS padding"); // LCOV_EXCL_LINE
-		if (EVP_PKEY_CTX_set_rsa_pss_saltlen(pkey_ctx,
-						RSA_PSS_SALTLEN_DIGEST) < 0)
-			SIGN_ERROR("Error setting RSASSA-PSS salt length"); // LCOV_EXCL_LINE
-	}
+	mdctx = openssl_md_ctx(jwt, OSSL_OP_SIGN, alg, type);
+	if (mdctx == NULL)
+		SIGN_ERROR("Failed to initialize digest"); // LCOV_EXCL_LINE
 
-	/* Get the size of sig first */
-	if (EVP_DigestSign(mdctx, NULL, &slen, (const unsigned char *)str,
-			   str_len) != 1)
-		SIGN_ERROR("Error checking sig size"); // LCOV_EXCL_LINE
+	if (type == EVP_PKEY_EC) {
+		/* For EC, sign into DER on the stack and hand back the raw
+		 * R/S form, each half padded to the curve's octet length. */
+		unsigned char der[JWT_ECDSA_DER_MAX];
+		unsigned int bn_len = (jwt->key->bits + 7) / 8;
 
-	/* Allocate memory for signature based on returned size */
-	sig = jwt_malloc(slen);
-	if (sig == NULL)
-		SIGN_ERROR("Out of memory"); // LCOV_EXCL_LINE
+		slen = sizeof(der);
+		if (EVP_DigestSign(mdctx, der, &slen,
+				   (const unsigned char *)str, str_len) != 1)
+			SIGN_ERROR("Error singing token"); // LCOV_EXCL_LINE
 
-	/* Actual signing */
-	if (EVP_DigestSign(mdctx, sig, &slen, (const unsigned char *)str,
-			   str_len) != 1)
-		SIGN_ERROR("Error singing token") // LCOV_EXCL_LINE;
+		sig = jwt_malloc(2 * bn_len);
+		if (sig == NULL)
+			SIGN_ERROR("Out of memory"); // LCOV_EXCL_LINE
 
-	if (type == EVP_PKEY_EC) {
-		/* For EC we need to convert to a raw format of R/S. */
-		if (jwt_ec_d2i(jwt, out, len, sig, slen))
+		if (jwt_ecdsa_der2raw(der, slen, sig, 2 * bn_len))
 			SIGN_ERROR("ECDSA failed d2i"); // LCOV_EXCL_LINE
 
-		/* jwt_ec_d2i has updated the out and len pointers on
-		 * success. Either way, we're done with this buffer. */
-		jwt_freemem(sig);
-		sig = NULL;
+		*out = (char *)sig;
+		*len = 2 * bn_len;
 	} else {
-		/* Everything else, just pass back the original sig. */
+		/* Get the size of sig first */
+		if (EVP_DigestSign(mdctx, NULL, &slen,
+				   (const unsigned char *)str, str_len) != 1)
+			SIGN_ERROR("Error checking sig size"); // LCOV_EXCL_LINE
+
+		/* Allocate memory for signature based on returned size */
+		sig = jwt_malloc(slen);
+		if (sig == NULL)
+			SIGN_ERROR("Out of memory"); // LCOV_EXCL_LINE
+
+		/* Actual signing */
+		if (EVP_DigestSign(mdctx, sig, &slen,
+				   (const unsigned char *)str, str_len) != 1)
+			SIGN_ERROR("Error singing token"); // LCOV_EXCL_LINE
+
 		*out = (char *)sig;
 		*len = slen;
 	}
@@ -276,26 +451,23 @@ jwt_sign_sha_pem_done:
 		jwt_freemem(sig); // LCOV_EXCL_LINE
 
 	BIO_free(bufkey);
-	EVP_MD_CTX_destroy(mdctx);
+	EVP_MD_CTX_free(mdctx);
 
 	return jwt->error;
 }
 
 #define VERIFY_ERROR(_msg) { jwt_write_error(jwt, "JWT[OpenSSL]: " _msg); goto jwt_verify_sha_pem_done; }
+#define VERIFY_FAILED(_msg) { jwt_set_error(jwt, JWT_ERR_BAD_SIG, "JWT[OpenSSL]: " _msg); goto jwt_verify_sha_pem_done; }
 
 static int openssl_verify_sha_pem(jwt_t *jwt, const char *head,
 				  unsigned int head_len,
 				  unsigned char *sig, int slen)
 {
 	EVP_MD_CTX *mdctx = NULL;
-	EVP_PKEY_CTX *pkey_ctx = NULL;
-	ECDSA_SIG *ec_sig = NULL;
-	BIGNUM *ec_sig_r = NULL;
-	BIGNUM *ec_sig_s = NULL;
 	EVP_PKEY *pkey = NULL;
 	const EVP_MD *alg;
-	int type;
-	unsigned char *old_sig = NULL;
+	int md, type;
+	unsigned char der[JWT_ECDSA_DER_MAX];
 	BIO *bufkey = NULL;
 
 	pkey = jwt->key->provider_data;
@@ -303,50 +475,50 @@ static int openssl_verify_sha_pem(jwt_t *jwt, const char *head,
 	switch (jwt->alg) {
 	/* RSA */
 	case JWT_ALG_RS256:
-		alg = EVP_sha256();
+		md = OSSL_MD_SHA256;
 		type = EVP_PKEY_RSA;
 		break;
 	case JWT_ALG_RS384:
-		alg = EVP_sha384();
+		md = OSSL_MD_SHA384;
 		type = EVP_PKEY_RSA;
 		break;
 	case JWT_ALG_RS512:
-		alg = EVP_sha512();
+		md = OSSL_MD_SHA512;
 		type = EVP_PKEY_RSA;
 		break;
 
 	/* RSA-PSS */
 	case JWT_ALG_PS256:
-		alg = EVP_sha256();
+		md = OSSL_MD_SHA256;
 		type = EVP_PKEY_RSA_PSS;
 		break;
 	case JWT_ALG_PS384:
-		alg = EVP_sha384();
+		md = OSSL_MD_SHA384;
 		type = EVP_PKEY_RSA_PSS;
 		break;
 	case JWT_ALG_PS512:
-		alg = EVP_sha512();
+		md = OSSL_MD_SHA512;
 		type = EVP_PKEY_RSA_PSS;
 		break;
 
 	/* ECC */
 	case JWT_ALG_ES256:
 	case JWT_ALG_ES256K:
-		alg = EVP_sha256();
+		md = OSSL_MD_SHA256;
 		type = EVP_PKEY_EC;
 		break;
 	case JWT_ALG_ES384:
-		alg = EVP_sha384();
+		md = OSSL_MD_SHA384;
 		type = EVP_PKEY_EC;
 		break;
 	case JWT_ALG_ES512:
-		alg = EVP_sha512();
+		md = OSSL_MD_SHA512;
 		type = EVP_PKEY_EC;
 		break;
 
 	/* EdDSA */
 	case JWT_ALG_EDDSA:
-		alg = NULL;
+		md = -1;
 		if (EVP_PKEY_id(pkey) == EVP_PKEY_ED25519 ||
 		    EVP_PKEY_id(pkey) == EVP_PKEY_ED448)
 			type = EVP_PKEY_id(pkey);
@@ -360,7 +532,7 @@ static int openssl_verify_sha_pem(jwt_t *jwt, const char *head,
 	case JWT_ALG_ML_DSA_44:
 	case JWT_ALG_ML_DSA_65:
 	case JWT_ALG_ML_DSA_87:
-		alg = NULL;
+		md = -1;
 		if (!EVP_PKEY_is_a(pkey, jwt_alg_str(jwt->alg)))
 			VERIFY_ERROR("Key does not match the ML-DSA algorithm");
 		type = EVP_PKEY_id(pkey);
@@ -373,6 +545,10 @@ static int openssl_verify_sha_pem(jwt_t *jwt, const char *head,
 	// LCOV_EXCL_STOP
 	}
 
+	alg = NULL;
+	if (md >= 0 && (alg = openssl_md(md)) == NULL)
+		VERIFY_ERROR("Error fetching digest"); // LCOV_EXCL_LINE
+
 	if (type == EVP_PKEY_RSA_PSS) {
 		if (EVP_PKEY_id(pkey) != EVP_PKEY_RSA_PSS &&
 		    EVP_PKEY_id(pkey) != EVP_PKEY_RSA)
@@ -380,70 +556,33 @@ static int openssl_verify_sha_pem(jwt_t *jwt, const char *head,
 	} else if (type != EVP_PKEY_id(pkey))
 		VERIFY_ERROR("Incompatible key for algorithm");
 
-        if (type == EVP_PKEY_EC) {
-		/* Convert EC sigs back to ASN1. */
-		unsigned int bn_len;
-		unsigned char *p;
-
-		ec_sig = ECDSA_SIG_new();
-		if (ec_sig == NULL)
-			VERIFY_ERROR("Failed to allocate ECDSA sig"); // LCOV_EXCL_LINE
+	if (type == EVP_PKEY_EC) {
+		/* Convert EC sigs back to DER, on the stack. */
+		unsigned int bn_len = (jwt->key->bits + 7) / 8;
 
-		bn_len = (jwt->key->bits + 7) / 8;
 		if ((bn_len * 2) != (unsigned int)slen)
 			VERIFY_ERROR("ECDSA micmatch with sig len"); // LCOV_EXCL_LINE
 
-		ec_sig_r = BN_bin2bn(sig, bn_len, NULL);
-		ec_sig_s = BN_bin2bn(sig + bn_len, bn_len, NULL);
-		if (ec_sig_r  == NULL || ec_sig_s == NULL)
-			VERIFY_ERROR("Error allocating R/S params"); // LCOV_EXCL_LINE
-
-		ECDSA_SIG_set0(ec_sig, ec_sig_r, ec_sig_s);
-
-		slen = i2d_ECDSA_SIG(ec_sig, NULL);
-
-		/* Reset this with the new information */
-		old_sig = sig;
-		sig = jwt_malloc(slen);
-		if (sig == NULL)
-			VERIFY_ERROR("Out of memory"); // LCOV_EXCL_LINE
-
-		p = sig;
-		slen = i2d_ECDSA_SIG(ec_sig, &p);
-
-		if (slen == 0)
+		slen = jwt_ecdsa_raw2der(sig, slen, der, sizeof(der));
+		if (slen < 0)
 			VERIFY_ERROR("Error calculating ECDSA sig"); // LCOV_EXCL_LINE
-	}
 
-	mdctx = EVP_MD_CTX_create();
-	if (mdctx == NULL)
-		VERIFY_ERROR("Error creatign MD context"); // LCOV_EXCL_LINE
+		sig = der;
+	}
 
 	/* Initialize the DigestVerify operation using alg */
-	if (EVP_DigestVerifyInit(mdctx, &pkey_ctx, alg, NULL, pkey) != 1)
+	mdctx = openssl_md_ctx(jwt, OSSL_OP_VERIFY, alg, type);
+	if (mdctx == NULL)
 		VERIFY_ERROR("Error initializing mdctx"); // LCOV_EXCL_LINE
 
-	if (type == EVP_PKEY_RSA_PSS) {
-		if (EVP_PKEY_CTX_set_rsa_padding(pkey_ctx,
-						 RSA_PKCS1_PSS_PADDING) < 0)
-			VERIFY_ERROR("Error setting RSASSA-PSS padding"); // LCOV_EXCL_LINE
-		if (EVP_PKEY_CTX_set_rsa_pss_saltlen(pkey_ctx,
-						     RSA_PSS_SALTLEN_AUTO) < 0)
-			VERIFY_ERROR("Error setting RSASSA-PSS salt length"); // LCOV_EXCL_LINE
-	}
-
 	/* One-shot update and verify */
 	if (EVP_DigestVerify(mdctx, sig, slen, (const unsigned char *)head,
 			     head_len) != 1)
-		VERIFY_ERROR("Failed to verify signature");
+		VERIFY_FAILED("Failed to verify signature");
 
 jwt_verify_sha_pem_done:
-	if (old_sig != NULL)
-		jwt_freemem(sig);
-
 	BIO_free(bufkey);
-	EVP_MD_CTX_destroy(mdctx);
-	ECDSA_SIG_free(ec_sig);
+	EVP_MD_CTX_free(mdctx);
 
 	return jwt->error;
 }
@@ -453,20 +592,14 @@ static int openssl_sha(int sha_bits, const unsigned char *in, size_t in_len,
 		       unsigned char *out, unsigned int *out_len)
 {
 	const EVP_MD *md;
+	int id = openssl_md_id(sha_bits);
 
-	switch (sha_bits) {
-	case 256:
-		md = EVP_sha256();
-		break;
-	case 384:
-		md = EVP_sha384();
-		break;
-	case 512:
-		md = EVP_sha512();
-		break;
-	default:
+	if (id < 0)
+		return 1; // LCOV_EXCL_LINE
+
+	md = openssl_md(id);
+	if (md == NULL)
 		return 1; // LCOV_EXCL_LINE
-	}
 
 	if (EVP_Digest(in, in_len, out, out_len, md, NULL) != 1)
 		return 1; // LCOV_EXCL_LINE
@@ -479,26 +612,42 @@ static int openssl_pbkdf2(int sha_bits, const unsigned char *pw, size_t pw_len,
 			  unsigned int iter, unsigned char *out, size_t dk_len)
 {
 	const EVP_MD *md;
+	OSSL_PARAM params[5];
+	EVP_KDF_CTX *kctx;
+	EVP_KDF *kdf;
+	int id = openssl_md_id(sha_bits);
+	int ret;
 
-	switch (sha_bits) {
-	case 256:
-		md = EVP_sha256();
-		break;
-	case 384:
-		md = EVP_sha384();
-		break;
-	case 512:
-		md = EVP_sha512();
-		break;
-	default:
+	if (id < 0)
 		return 1; // LCOV_EXCL_LINE
-	}
 
-	if (PKCS5_PBKDF2_HMAC((const char *)pw, (int)pw_len, salt, (int)salt_len,
-			      (int)iter, md, (int)dk_len, out) != 1)
+	md = openssl_md(id);
+	if (md == NULL)
 		return 1; // LCOV_EXCL_LINE
 
-	return 0;
+	/* Fetched per call: the iterations dwarf the lookup. */
+	kdf = EVP_KDF_fetch(openssl_libctx(), OSSL_KDF_NAME_PBKDF2,
+			    openssl_propq());
+	if (kdf == NULL)
+		return 1; // LCOV_EXCL_LINE
+	kctx = EVP_KDF_CTX_new(kdf);
+	EVP_KDF_free(kdf);
+	if (kctx == NULL)
+		return 1; // LCOV_EXCL_LINE
+
+	params[0] = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_PASSWORD,
+						      (void *)pw, pw_len);
+	params[1] = OSSL_PARAM_construct_octet_string(OSSL_KDF_PARAM_SALT,
+						      (void *)salt, salt_len);
+	params[2] = OSSL_PARAM_construct_uint(OSSL_KDF_PARAM_ITER, &iter);
+	params[3] = OSSL_PARAM_construct_utf8_string(OSSL_KDF_PARAM_DIGEST,
+			(char *)EVP_MD_get0_name(md), 0);
+	params[4] = OSSL_PARAM_construct_end();
+
+	ret = EVP_KDF_derive(kctx, out, dk_len, params) == 1 ? 0 : 1;
+	EVP_KDF_CTX_free(kctx);
+
+	return ret;
 }
 
 /* Export our ops */
@@ -507,6 +656,7 @@ struct jwt_crypto_ops jwt_openssl_ops = {
 	.provider		= JWT_CRYPTO_OPS_OPENSSL,
 
 	.sign_sha_hmac		= openssl_sign_sha_hmac,
+	.hmac_sha		= openssl_hmac_sha,
 	.sign_sha_pem		= openssl_sign_sha_pem,
 	.verify_sha_pem		= openssl_verify_sha_pem,
 
@@ -77,6 +77,53 @@ START_TEST(rt_256_cbc)
 }
 END_TEST
 
+START_TEST(decrypt_n)
+{
+	jwe_builder_auto_t *builder = NULL;
+	jwe_checker_auto_t *checker = NULL;
+	char_auto *tok = NULL;
+	char *buf;
+	unsigned char *pt = NULL;
+	size_t tok_len, pt_len = 0;
+
+	SET_OPS();
+	read_json("oct_dir_256.json");
+
+	builder = jwe_builder_new();
+	ck_assert_int_eq(jwe_builder_setkey(builder, JWE_ALG_A256KW,
+					    JWE_ENC_A256GCM, g_item), 0);
+	tok = jwe_builder_generate(builder, (const unsigned char *)PT,
+				   strlen(PT));
+	ck_assert_ptr_nonnull(tok);
+	tok_len = strlen(tok);
+
+	/* The token followed by unrelated bytes, with no nil after it. */
+	buf = malloc(tok_len + 8);
+	ck_assert_ptr_nonnull(buf);
+	memcpy(buf, tok, tok_len);
+	memcpy(buf + tok_len, ".AAAAAAA", 8);
+
+	checker = jwe_checker_new();
+	ck_assert_int_eq(jwe_checker_setkey(checker, JWE_ALG_A256KW,
+					    JWE_ENC_A256GCM, g_item), 0);
+	pt = jwe_checker_decrypt_n(checker, buf, tok_len, &pt_len);
+	ck_assert_ptr_nonnull(pt);
+	ck_assert_int_eq(pt_len, strlen(PT));
+	ck_assert_mem_eq(pt, PT, pt_len);
+	free(pt);
+
+	/* Taking the trailing bytes in makes a sixth part. */
+	pt = jwe_checker_decrypt_n(checker, buf, tok_len + 8, &pt_len);
+	ck_assert_ptr_null(pt);
+
+	pt = jwe_checker_decrypt_n(checker, buf, 0, &pt_len);
+	ck_assert_ptr_null(pt);
+
+	free(buf);
+	free_key();
+}
+END_TEST
+
 START_TEST(tamper_ek)
 {
 	jwe_builder_auto_t *builder = NULL;
@@ -312,6 +359,7 @@ static Suite *libjwt_suite(const char *title)
 	tcase_add_loop_test(tc_core, rt_192_gcm, 0, i);
 	tcase_add_loop_test(tc_core, rt_256_gcm, 0, i);
 	tcase_add_loop_test(tc_core, rt_256_cbc, 0, i);
+	tcase_add_loop_test(tc_core, decrypt_n, 0, i);
 	tcase_add_loop_test(tc_core, tamper_ek, 0, i);
 	tcase_add_loop_test(tc_core, wrong_kek, 0, i);
 	tcase_add_loop_test(tc_core, empty_ek_rejected, 0, i);
@@ -512,6 +512,163 @@ START_TEST(decrypt_bad_components)
 }
 END_TEST
 
+START_TEST(stats_decrypt)
+{
+	jwe_builder_auto_t *builder = NULL;
+	jwe_checker_auto_t *checker = NULL;
+	char_auto *tok = NULL;
+	unsigned char *pt;
+	size_t pt_len = 0;
+	jwt_stats_t st;
+	char *tag;
+
+	SET_OPS();
+	read_json("oct_dir_256.json");
+
+	builder = jwe_builder_new();
+	ck_assert_int_eq(jwe_builder_setkey(builder, JWE_ALG_DIR,
+					    JWE_ENC_A256GCM, g_item), 0);
+	checker = jwe_checker_new();
+	ck_assert_int_eq(jwe_checker_setkey(checker, JWE_ALG_DIR,
+					    JWE_ENC_A256GCM, g_item), 0);
+
+	ck_assert_int_ne(jwe_builder_stats(NULL, &st), 0);
+	ck_assert_int_ne(jwe_checker_stats(checker, NULL), 0);
+
+	tok = jwe_builder_generate(builder, (const unsigned char *)PT,
+				   strlen(PT));
+	ck_assert_ptr_nonnull(tok);
+
+	pt = jwe_checker_decrypt(checker, tok, &pt_len);
+	ck_assert_ptr_nonnull(pt);
+	free(pt);
+
+	/* Corrupt the first character of the tag. */
+	tag = strrchr(tok, '.') + 1;
+	*tag = *tag == 'A' ? 'B' : 'A';
+	pt = jwe_checker_decrypt(checker, tok, &pt_len);
+	ck_assert_ptr_null(pt);
+
+#ifndef LIBJWT_HAVE_STATS
+	ck_assert_int_ne(jwe_builder_stats(builder, &st), 0);
+	ck_assert_int_ne(jwe_checker_stats(checker, &st), 0);
+#else
+	ck_assert_int_eq(jwe_builder_stats(builder, &st), 0);
+	ck_assert_int_eq(st.calls, 1);
+	ck_assert_int_eq(st.failures, 0);
+	ck_assert_int_gt(st.stage[JWT_STAGE_JWE].count, 0);
+	ck_assert_int_eq(st.stage[JWT_STAGE_SIGNATURE].count, 0);
+
+	ck_assert_int_eq(jwe_checker_stats(checker, &st), 0);
+	ck_assert_int_eq(st.calls, 2);
+	ck_assert_int_eq(st.failures, 1);
+	ck_assert_int_eq(st.stage[JWT_STAGE_JWE].count, 2);
+	ck_assert_int_eq(st.stage[JWT_STAGE_JWE].failures, 1);
+	ck_assert_int_gt(st.stage[JWT_STAGE_JSON].count, 0);
+#endif
+
+	free_key();
+}
+END_TEST
+
+/* Each limit turns the token down before the part it bounds is decoded. */
+static void limits_reject(jwe_checker_t *checker, const char *tok,
+			  const jwt_limits_t *lim, const char *msg)
+{
+	size_t pt_len = 0;
+
+	ck_assert_int_eq(jwe_checker_setlimits(checker, lim), 0);
+	ck_assert_ptr_null(jwe_checker_decrypt_all(checker, tok, &pt_len));
+	ck_assert_str_eq(jwe_checker_error_msg(checker), msg);
+	jwe_checker_error_clear(checker);
+}
+
+START_TEST(limits_decrypt)
+{
+	jwe_builder_auto_t *builder = NULL;
+	jwe_checker_auto_t *checker = NULL;
+	char_auto *tok = NULL, *json = NULL;
+	jwt_limits_t lim;
+	unsigned char *pt;
+	size_t pt_len = 0;
+
+	SET_OPS();
+	read_json("oct_dir_256.json");
+
+	builder = jwe_builder_new();
+	ck_assert_int_eq(jwe_builder_setkey(builder, JWE_ALG_DIR,
+					    JWE_ENC_A256GCM, g_item), 0);
+	checker = jwe_checker_new();
+	ck_assert_int_eq(jwe_checker_setkey(checker, JWE_ALG_DIR,
+					    JWE_ENC_A256GCM, g_item), 0);
+
+	ck_assert_int_ne(jwe_checker_setlimits(NULL, NULL), 0);
+
+	tok = jwe_builder_generate(builder, (const unsigned char *)PT,
+				   strlen(PT));
+	ck_assert_ptr_nonnull(tok);
+	ck_assert_int_eq(jwe_builder_set_format(builder,
+						JWE_FORMAT_JSON_FLAT), 0);
+	json = jwe_builder_generate(builder, (const unsigned char *)PT,
+				    strlen(PT));
+	ck_assert_ptr_nonnull(json);
+
+	memset(&lim, 0, sizeof(lim));
+	lim.max_token_len = strlen(tok) - 1;
+	limits_reject(checker, tok, &lim, "Token exceeds an input limit");
+	ck_assert_ptr_null(jwe_checker_decrypt(checker, tok, &pt_len));
+	ck_assert_str_eq(jwe_checker_error_msg(checker),
+			 "Token exceeds an input limit");
+	jwe_checker_error_clear(checker);
+
+	memset(&lim, 0, sizeof(lim));
+	lim.max_header_len = 8;
+	limits_reject(checker, tok, &lim, "Header exceeds an input limit");
+	limits_reject(checker, json, &lim, "Header exceeds an input limit");
+
+	memset(&lim, 0, sizeof(lim));
+	lim.max_payload_len = strlen(PT) - 1;
+	limits_reject(checker, tok, &lim, "Ciphertext exceeds an input limit");
+	limits_reject(checker, json, &lim,
+		      "Ciphertext exceeds an input limit");
+
+	/* {"alg":"dir","enc":"A256GCM"} */
+	memset(&lim, 0, sizeof(lim));
+	lim.max_members = 1;
+	limits_reject(checker, tok, &lim, "Header exceeds an input limit");
+	/* The serialization itself has more members than its header. */
+	lim.max_members = 2;
+	limits_reject(checker, json, &lim, "Token exceeds an input limit");
+
+	memset(&lim, 0, sizeof(lim));
+	lim.max_depth = 1;
+	limits_reject(checker, json, &lim, "Token exceeds an input limit");
+
+	memset(&lim, 0, sizeof(lim));
+	lim.max_string_len = strlen("A256GCM") - 1;
+	limits_reject(checker, tok, &lim, "Header exceeds an input limit");
+
+	/* At the limits, both decrypt. */
+	memset(&lim, 0, sizeof(lim));
+	lim.max_token_len = strlen(json);
+	lim.max_payload_len = strlen(PT);
+	/* The serialization's "header" is nested in it. */
+	lim.max_depth = 2;
+	lim.max_string_len = strlen("A256GCM");
+	ck_assert_int_eq(jwe_checker_setlimits(checker, &lim), 0);
+
+	pt = jwe_checker_decrypt(checker, tok, &pt_len);
+	ck_assert_ptr_nonnull(pt);
+	free(pt);
+	pt = jwe_checker_decrypt_all(checker, json, &pt_len);
+	ck_assert_ptr_nonnull(pt);
+	ck_assert_int_eq(pt_len, strlen(PT));
+	free(pt);
+
+	free_key();
+}
+END_TEST
+
 static Suite *libjwt_suite(const char *title)
 {
 	Suite *s;
@@ -537,6 +694,8 @@ static Suite *libjwt_suite(const char *title)
 	tcase_add_loop_test(tc_core, decrypt_header_cases, 0, i);
 	tcase_add_loop_test(tc_core, decrypt_cek_cases, 0, i);
 	tcase_add_loop_test(tc_core, decrypt_bad_components, 0, i);
+	tcase_add_loop_test(tc_core, stats_decrypt, 0, i);
+	tcase_add_loop_test(tc_core, limits_decrypt, 0, i);
 
 	tcase_set_timeout(tc_core, 30);
 	suite_add_tcase(s, tc_core);
@@ -175,6 +175,166 @@ START_TEST(test_policy_partial_ring)
 }
 END_TEST
 
+/* ---- Signatures signed and verified on worker threads ---- */
+START_TEST(test_threads)
+{
+	jwt_builder_auto_t *builder = NULL;
+	jwt_checker_auto_t *c_one = NULL, *c_all = NULL, *c_any = NULL;
+	jwt_checker_auto_t *c_part = NULL;
+	char_auto *tok = NULL;
+	jwk_set_t *eks, *rks, *ring, *ec_ring;
+	const jwk_item_t *ec, *rsa;
+	unsigned int i;
+
+	SET_OPS();
+
+	eks = load_one("ec_key_prime256v1.json");
+	rks = load_one("rsa_key_2048.json");
+	ec = jwks_item_get(eks, 0);
+	rsa = jwks_item_get(rks, 0);
+	ring = load_ec_rsa_ring();
+	ec_ring = jwks_create(NULL);
+	ck_assert_ptr_nonnull(jwks_load_fromfile(ec_ring,
+		KEYDIR "/ec_key_prime256v1.json"));
+
+	ck_assert_int_ne(jwt_builder_setthreads(NULL, 2), 0);
+	ck_assert_int_ne(jwt_checker_setthreads(NULL, 2), 0);
+
+	/* Four signatures, made on two threads, come out in order. */
+	builder = jwt_builder_new();
+	ck_assert_int_eq(jwt_builder_setthreads(builder, 2), 0);
+	ck_assert_int_eq(jwt_builder_setkey(builder, JWT_ALG_RS256, rsa), 0);
+	ck_assert_ptr_nonnull(jwt_builder_add_signature(builder, JWT_ALG_ES256, ec));
+	ck_assert_ptr_nonnull(jwt_builder_add_signature(builder, JWT_ALG_RS256, rsa));
+	ck_assert_ptr_nonnull(jwt_builder_add_signature(builder, JWT_ALG_ES256, ec));
+	tok = jwt_builder_generate(builder);
+	ck_assert_ptr_nonnull(tok);
+
+	/* ALL on three threads: every signature has to be checked. */
+	c_all = jwt_checker_new();
+	ck_assert_int_eq(jwt_checker_setkeyring(c_all, ring,
+		JWT_VERIFY_POLICY_ALL), 0);
+	ck_assert_int_eq(jwt_checker_setthreads(c_all, 3), 0);
+	ck_assert_int_eq(jwt_checker_verify(c_all, tok), 0);
+	ck_assert_uint_eq(jwt_checker_sig_count(c_all), 4);
+	for (i = 0; i < 4; i++)
+		ck_assert_int_eq(jwt_checker_sig_verified(c_all, i), 1);
+
+	/* ANY on one thread stops at the first signature that verifies. */
+	c_one = jwt_checker_new();
+	ck_assert_int_eq(jwt_checker_setkeyring(c_one, ring,
+		JWT_VERIFY_POLICY_ANY), 0);
+	ck_assert_int_eq(jwt_checker_setthreads(c_one, 1), 0);
+	ck_assert_int_eq(jwt_checker_verify(c_one, tok), 0);
+	ck_assert_int_eq(jwt_checker_sig_verified(c_one, 0), 1);
+	for (i = 1; i < 4; i++)
+		ck_assert_int_eq(jwt_checker_sig_verified(c_one, i), 0);
+
+	/* ANY on more threads than signatures. */
+	c_any = jwt_checker_new();
+	ck_assert_int_eq(jwt_checker_setkeyring(c_any, ring,
+		JWT_VERIFY_POLICY_ANY), 0);
+	ck_assert_int_eq(jwt_checker_setthreads(c_any, 8), 0);
+	ck_assert_int_eq(jwt_checker_verify(c_any, tok), 0);
+
+	/* ALL with no RSA key fails at the first signature, and stops. */
+	c_part = jwt_checker_new();
+	ck_assert_int_eq(jwt_checker_setkeyring(c_part, ec_ring,
+		JWT_VERIFY_POLICY_ALL), 0);
+	ck_assert_int_eq(jwt_checker_setthreads(c_part, 1), 0);
+	ck_assert_int_ne(jwt_checker_verify(c_part, tok), 0);
+	for (i = 0; i < 4; i++)
+		ck_assert_int_eq(jwt_checker_sig_verified(c_part, i), 0);
+
+	/* The same checker, back to one signature at a time, checks them all. */
+	ck_assert_int_eq(jwt_checker_setthreads(c_part, 0), 0);
+	ck_assert_int_ne(jwt_checker_verify(c_part, tok), 0);
+	ck_assert_int_eq(jwt_checker_sig_verified(c_part, 1), 1);
+	ck_assert_int_eq(jwt_checker_sig_verified(c_part, 3), 1);
+
+	jwks_free(eks);
+	jwks_free(rks);
+	jwks_free(ring);
+	jwks_free(ec_ring);
+}
+END_TEST
+
+/* ---- Keyless scans: key order after a hit, and the size/curve filter ---- */
+#define SCAN_KEYS 40
+
+START_TEST(test_scan_order)
+{
+	/* A secp256k1 key without "alg": usable for ES256K only. */
+	static const char k1_json[] = "{\"keys\":[{\"kty\":\"EC\","
+		"\"crv\":\"secp256k1\","
+		"\"x\":\"7xdE1j-vQLoWBnhP7Mn70yNhPDCO6pytCqMJTeJ7_90\","
+		"\"y\":\"795Zo2s891l9E7Jb57g9CEvRVGk_LJ7Hy0ixzGcV8UE\","
+		"\"d\":\"zTih0G_1ZdZupZhb7SgOyqsoe2dudSWNPtM4Vt2OYJk\"}]}";
+	static const unsigned int order[] = { SCAN_KEYS - 1, 5, SCAN_KEYS - 1,
+					      0, 5 };
+	char json[SCAN_KEYS * 80 + 16], *p;
+	jwt_checker_auto_t *checker = NULL;
+	jwk_set_t *ring, *k1;
+	unsigned int i;
+
+	SET_OPS();
+
+	/* More HS256 keys than fit the scan's stack. */
+	p = json + sprintf(json, "{\"keys\":[");
+	for (i = 0; i < SCAN_KEYS; i++)
+		p += sprintf(p, "%s{\"kty\":\"oct\",\"k\":\"%040u%03u\"}",
+			     i ? "," : "", i, i);
+	sprintf(p, "]}");
+	ring = jwks_create(json);
+	ck_assert_ptr_nonnull(ring);
+	ck_assert_uint_eq(jwks_item_count(ring), SCAN_KEYS);
+
+	checker = jwt_checker_new();
+	ck_assert_int_eq(jwt_checker_setkeyring(checker, ring,
+		JWT_VERIFY_POLICY_ANY), 0);
+
+	/* Whichever key was used last, each token finds its own. */
+	for (i = 0; i < ARRAY_SIZE(order); i++) {
+		const jwk_item_t *key = jwks_item_get(ring, order[i]);
+		jwt_builder_auto_t *builder = jwt_builder_new();
+		char_auto *tok = NULL;
+
+		ck_assert_int_eq(jwt_builder_setkey(builder, JWT_ALG_HS256,
+						    key), 0);
+		ck_assert_int_eq(jwt_builder_set_format(builder,
+			JWT_FORMAT_JSON_GENERAL), 0);
+		tok = jwt_builder_generate(builder);
+		ck_assert_ptr_nonnull(tok);
+
+		ck_assert_int_eq(jwt_checker_verify(checker, tok), 0);
+		ck_assert_ptr_eq(jwt_checker_sig_key(checker, 0), key);
+	}
+
+	/* An ES256 signature is never checked against a secp256k1 key. */
+	k1 = jwks_create(k1_json);
+	ck_assert_ptr_nonnull(k1);
+	ck_assert_int_eq(jwt_checker_setkeyring(checker, k1,
+		JWT_VERIFY_POLICY_ANY), 0);
+	for (i = 0; i < 2; i++) {
+		jwt_builder_auto_t *builder = jwt_builder_new();
+		jwt_alg_t alg = i ? JWT_ALG_ES256 : JWT_ALG_ES256K;
+		char_auto *tok = NULL;
+
+		ck_assert_int_eq(jwt_builder_setkey(builder, alg,
+						    jwks_item_get(k1, 0)), 0);
+		ck_assert_int_eq(jwt_builder_set_format(builder,
+			JWT_FORMAT_JSON_GENERAL), 0);
+		tok = jwt_builder_generate(builder);
+		ck_assert_ptr_nonnull(tok);
+		ck_assert_int_eq(jwt_checker_verify(checker, tok) == 0,
+				 alg == JWT_ALG_ES256K);
+	}
+
+	jwks_free(ring);
+	jwks_free(k1);
+}
+END_TEST
+
 /* ---- kid-driven key selection from a multi-key ring ---- */
 START_TEST(test_kid_match)
 {
@@ -217,6 +377,21 @@ START_TEST(test_kid_match)
 	ck_assert_str_eq(jwks_item_kid(jwt_checker_sig_key(checker, 0)), KID_RS256);
 	ck_assert_str_eq(jwks_item_kid(jwt_checker_sig_key(checker, 1)), KID_ES256);
 
+	/* A kid the ring does not hold leaves nothing to verify with. */
+	jwt_builder_free(builder);
+	builder = jwt_builder_new();
+	ck_assert_int_eq(jwt_builder_set_format(builder,
+		JWT_FORMAT_JSON_GENERAL), 0);
+	s_ec = jwt_builder_add_signature(builder, JWT_ALG_ES256, ec);
+	ck_assert_ptr_nonnull(s_ec);
+	ck_assert_int_eq(jwt_signature_add_protected_json(s_ec, "kid",
+		"\"no-such-kid\""), 0);
+	free(tok);
+	tok = jwt_builder_generate(builder);
+	ck_assert_ptr_nonnull(tok);
+	ck_assert_int_ne(jwt_checker_verify(checker, tok), 0);
+	ck_assert_int_eq(jwt_checker_error_code(checker), JWT_ERR_KID_UNKNOWN);
+
 	jwks_free(ring);
 }
 END_TEST
@@ -251,6 +426,7 @@ START_TEST(test_tamper)
 	checker = jwt_checker_new();
 	ck_assert_int_eq(jwt_checker_setkey(checker, JWT_ALG_ES256, ec), 0);
 	ck_assert_int_ne(jwt_checker_verify(checker, tok), 0);
+	ck_assert_int_eq(jwt_checker_error_code(checker), JWT_ERR_BAD_SIG);
 
 	jwks_free(eks);
 }
@@ -405,6 +581,8 @@ static Suite *libjwt_suite(const char *title)
 	tcase_add_loop_test(tc_core, test_flat_roundtrip, 0, i);
 	tcase_add_loop_test(tc_core, test_general_roundtrip, 0, i);
 	tcase_add_loop_test(tc_core, test_policy_partial_ring, 0, i);
+	tcase_add_loop_test(tc_core, test_threads, 0, i);
+	tcase_add_loop_test(tc_core, test_scan_order, 0, i);
 	tcase_add_loop_test(tc_core, test_kid_match, 0, i);
 	tcase_add_loop_test(tc_core, test_tamper, 0, i);
 	tcase_add_loop_test(tc_core, test_malformed, 0, i);
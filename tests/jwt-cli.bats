@@ -327,3 +327,13 @@ JWS_RING="../tests/keys/jwks_jws_pair.json"
 	run ./tools/jwt-verify -k ${EC_KEY} -r ${JWS_RING} "x.y.z"
 	[ "${status}" -ne 0 ]
 }
+
+@test "Benchmark the default algorithms" {
+	result="$(./tools/jwt-bench -n 2)"
+	echo "${result}" | grep -q '^PS256 '
+}
+
+@test "Benchmark rejects an unknown algorithm" {
+	run ./tools/jwt-bench -n 1 XX999
+	[ "${status}" -ne 0 ]
+}
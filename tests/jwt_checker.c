@@ -5,6 +5,7 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include "jwt_tests.h"
 
@@ -386,6 +387,50 @@ START_TEST(verify_hs256)
 }
 END_TEST
 
+START_TEST(verify_hs256_n)
+{
+	jwt_checker_auto_t *checker = NULL;
+	/* The token in place inside a header buffer, not nil-terminated. */
+	const char hdr[] = "Authorization: Bearer "
+		"eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9.e30.CM4dD95Nj"
+		"0vSfMGtDas432AUW1HAo7feCiAbt5Yjuds\r\nHost: example.com\r\n";
+	const char *token = hdr + strlen("Authorization: Bearer ");
+	size_t len = strcspn(token, "\r");
+	int ret;
+
+	SET_OPS();
+
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(checker);
+
+	read_json("oct_key_256.json");
+	ret = jwt_checker_setkey(checker, JWT_ALG_HS256, g_item);
+	ck_assert_int_eq(ret, 0);
+
+	ret = jwt_checker_verify_n(checker, token, len);
+	ck_assert_int_eq(ret, 0);
+
+	/* One octet short cuts the signature. */
+	ret = jwt_checker_verify_n(checker, token, len - 1);
+	ck_assert_int_ne(ret, 0);
+
+	/* Extending into the trailing bytes is not the same token either. */
+	ret = jwt_checker_verify_n(checker, token, len + 2);
+	ck_assert_int_ne(ret, 0);
+
+	ret = jwt_checker_verify_n(checker, token, 0);
+	ck_assert_int_ne(ret, 0);
+
+	ret = jwt_checker_verify_n(checker, NULL, len);
+	ck_assert_int_ne(ret, 0);
+
+	ret = jwt_checker_verify_n(NULL, token, len);
+	ck_assert_int_ne(ret, 0);
+
+	free_key();
+}
+END_TEST
+
 START_TEST(hs256_no_key)
 {
 	jwt_checker_auto_t *checker = NULL;
@@ -1475,6 +1520,8 @@ START_TEST(jti_verify_reject)
 	ck_assert_int_ne(ret, 0);
 	ck_assert_str_eq(jwt_checker_error_msg(checker),
 			"Failed one or more claims");
+	ck_assert_int_eq(jwt_checker_error_code(checker), JWT_ERR_REPLAY);
+	ck_assert_int_eq(jwt_checker_error_claims(checker), JWT_CLAIM_JTI);
 }
 END_TEST
 
@@ -1659,6 +1706,835 @@ START_TEST(jti_pool_roundtrip)
 }
 END_TEST
 
+static const char shared_good[] = "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9.e30."
+	"CM4dD95Nj0vSfMGtDas432AUW1HAo7feCiAbt5Yjuds";
+static const char shared_bad[] = "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9.e30."
+	"CM4dD95Nj0vSfMGtDas432AUW1HAo7feCiAbt5Yjudt";
+
+#define SHARED_THREADS	8
+#define SHARED_ROUNDS	200
+
+static void *shared_worker(void *arg)
+{
+	const jwt_checker_shared_t *shared = arg;
+	jwt_verify_ctx_auto_t *ctx = jwt_verify_ctx_new();
+	long fails = 0;
+	int i;
+
+	if (ctx == NULL)
+		return (void *)-1L;
+
+	for (i = 0; i < SHARED_ROUNDS; i++) {
+		if (jwt_checker_shared_verify(shared, ctx, shared_good,
+					      strlen(shared_good)) ||
+		    jwt_verify_ctx_sig_count(ctx) != 1)
+			fails++;
+		if (!jwt_checker_shared_verify(shared, ctx, shared_bad,
+					       strlen(shared_bad)) ||
+		    !jwt_verify_ctx_error(ctx))
+			fails++;
+	}
+
+	return (void *)fails;
+}
+
+START_TEST(shared_verify)
+{
+	jwt_checker_t *checker = NULL;
+	jwt_checker_shared_t *shared;
+	jwt_verify_ctx_auto_t *ctx = NULL;
+	int ret;
+
+	SET_OPS();
+
+	read_json("oct_key_256.json");
+
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(checker);
+	ret = jwt_checker_setkey(checker, JWT_ALG_HS256, g_item);
+	ck_assert_int_eq(ret, 0);
+
+	ck_assert_ptr_null(jwt_checker_freeze(NULL));
+	shared = jwt_checker_freeze(checker);
+	ck_assert_ptr_nonnull(shared);
+
+	ctx = jwt_verify_ctx_new();
+	ck_assert_ptr_nonnull(ctx);
+
+	ret = jwt_checker_shared_verify(shared, ctx, shared_good,
+					strlen(shared_good));
+	ck_assert_int_eq(ret, 0);
+	ck_assert_int_eq(jwt_verify_ctx_error(ctx), 0);
+	ck_assert_str_eq(jwt_verify_ctx_error_msg(ctx), "");
+	ck_assert_int_eq(jwt_verify_ctx_sig_count(ctx), 1);
+	ck_assert_int_eq(jwt_verify_ctx_sig_verified(ctx, 0), 1);
+	ck_assert_ptr_eq(jwt_verify_ctx_sig_key(ctx, 0), g_item);
+
+	ret = jwt_checker_shared_verify(shared, ctx, shared_bad,
+					strlen(shared_bad));
+	ck_assert_int_ne(ret, 0);
+	ck_assert_int_ne(jwt_verify_ctx_error(ctx), 0);
+	ck_assert_str_eq(jwt_verify_ctx_error_msg(ctx),
+			 "Token failed verification");
+	ck_assert_int_eq(jwt_verify_ctx_sig_count(ctx), 0);
+	ck_assert_ptr_null(jwt_verify_ctx_sig_key(ctx, 0));
+
+	/* A good verify after a failed one starts clean. */
+	ret = jwt_checker_shared_verify(shared, ctx, shared_good,
+					strlen(shared_good));
+	ck_assert_int_eq(ret, 0);
+	ck_assert_str_eq(jwt_verify_ctx_error_msg(ctx), "");
+
+	ret = jwt_checker_shared_verify(NULL, ctx, shared_good,
+					strlen(shared_good));
+	ck_assert_int_ne(ret, 0);
+	ret = jwt_checker_shared_verify(shared, NULL, shared_good,
+					strlen(shared_good));
+	ck_assert_int_ne(ret, 0);
+	ret = jwt_checker_shared_verify(shared, ctx, NULL, 0);
+	ck_assert_int_ne(ret, 0);
+
+	/* The context outlives the last reference. */
+	ck_assert_ptr_eq(jwt_checker_shared_ref(shared), shared);
+	jwt_checker_shared_unref(shared);
+	jwt_checker_shared_unref(shared);
+	jwt_checker_shared_unref(NULL);
+
+	ck_assert_int_ne(jwt_verify_ctx_error(NULL), 0);
+	ck_assert_ptr_null(jwt_verify_ctx_error_msg(NULL));
+	ck_assert_int_eq(jwt_verify_ctx_sig_count(NULL), 0);
+
+	free_key();
+}
+END_TEST
+
+START_TEST(shared_verify_threads)
+{
+	jwt_checker_t *checker = NULL;
+	jwt_checker_shared_t *shared;
+	pthread_t th[SHARED_THREADS];
+	void *fails;
+	int i, ret;
+
+	SET_OPS();
+
+	read_json("oct_key_256.json");
+
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(checker);
+	ret = jwt_checker_setkey(checker, JWT_ALG_HS256, g_item);
+	ck_assert_int_eq(ret, 0);
+
+	/* Every thread hits the one cache. */
+	ret = jwt_checker_cache(checker, 16, 0);
+	ck_assert_int_eq(ret, 0);
+
+	shared = jwt_checker_freeze(checker);
+	ck_assert_ptr_nonnull(shared);
+
+	for (i = 0; i < SHARED_THREADS; i++)
+		ck_assert_int_eq(pthread_create(&th[i], NULL, shared_worker,
+						shared), 0);
+
+	for (i = 0; i < SHARED_THREADS; i++) {
+		ck_assert_int_eq(pthread_join(th[i], &fails), 0);
+		ck_assert_ptr_null(fails);
+	}
+
+	jwt_checker_shared_unref(shared);
+
+	free_key();
+}
+END_TEST
+
+/* Sign {"n": n, "exp": exp, "jti": "cache-id"} with the HS256 key in g_item. */
+static char *cache_token(long n, time_t exp)
+{
+	jwt_builder_auto_t *builder = NULL;
+	jwt_value_t jval;
+
+	builder = jwt_builder_new();
+	ck_assert_ptr_nonnull(builder);
+	ck_assert_int_eq(jwt_builder_setkey(builder, JWT_ALG_HS256, g_item), 0);
+
+	jwt_set_SET_INT(&jval, "n", n);
+	ck_assert_int_eq(jwt_builder_claim_set(builder, &jval), 0);
+	jwt_set_SET_INT(&jval, "exp", exp);
+	ck_assert_int_eq(jwt_builder_claim_set(builder, &jval), 0);
+	jwt_set_SET_STR(&jval, "jti", "cache-id");
+	ck_assert_int_eq(jwt_builder_claim_set(builder, &jval), 0);
+
+	return jwt_builder_generate(builder);
+}
+
+START_TEST(cache_verify)
+{
+	jwt_checker_auto_t *checker = NULL;
+	unsigned long hits, misses;
+	unsigned int entries;
+	int ret;
+
+	SET_OPS();
+
+	read_json("oct_key_256.json");
+
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(checker);
+	ret = jwt_checker_setkey(checker, JWT_ALG_HS256, g_item);
+	ck_assert_int_eq(ret, 0);
+
+	/* No cache yet. */
+	ck_assert_int_ne(jwt_checker_cache_stats(checker, &hits, NULL, NULL), 0);
+	ck_assert_int_ne(jwt_checker_cache(NULL, 8, 0), 0);
+	ck_assert_int_ne(jwt_checker_cache(checker, 8, -1), 0);
+	ck_assert_str_eq(jwt_checker_error_msg(checker), "Invalid cache TTL");
+	jwt_checker_error_clear(checker);
+
+	ret = jwt_checker_cache(checker, 8, 300);
+	ck_assert_int_eq(ret, 0);
+
+	ret = jwt_checker_verify(checker, shared_good);
+	ck_assert_int_eq(ret, 0);
+	ret = jwt_checker_verify(checker, shared_good);
+	ck_assert_int_eq(ret, 0);
+	ck_assert_int_eq(jwt_checker_sig_count(checker), 1);
+	ck_assert_int_eq(jwt_checker_sig_verified(checker, 0), 1);
+	ck_assert_ptr_eq(jwt_checker_sig_key(checker, 0), g_item);
+
+	ret = jwt_checker_cache_stats(checker, &hits, &misses, &entries);
+	ck_assert_int_eq(ret, 0);
+	ck_assert_int_eq(hits, 1);
+	ck_assert_int_eq(misses, 1);
+	ck_assert_int_eq(entries, 1);
+
+	/* A bad signature is never cached, so it fails every time. */
+	ret = jwt_checker_verify(checker, shared_bad);
+	ck_assert_int_ne(ret, 0);
+	jwt_checker_error_clear(checker);
+	ret = jwt_checker_verify(checker, shared_bad);
+	ck_assert_int_ne(ret, 0);
+	ck_assert_str_eq(jwt_checker_error_msg(checker),
+			 "Token failed verification");
+	jwt_checker_error_clear(checker);
+
+	ret = jwt_checker_cache_stats(checker, &hits, &misses, &entries);
+	ck_assert_int_eq(ret, 0);
+	ck_assert_int_eq(hits, 1);
+	ck_assert_int_eq(misses, 3);
+	ck_assert_int_eq(entries, 1);
+
+	/* Replacing the cache drops its entries and counters. */
+	ret = jwt_checker_cache(checker, 8, 0);
+	ck_assert_int_eq(ret, 0);
+	ret = jwt_checker_cache_stats(checker, &hits, &misses, &entries);
+	ck_assert_int_eq(ret, 0);
+	ck_assert_int_eq(hits + misses + entries, 0);
+
+	ret = jwt_checker_cache(checker, 0, 0);
+	ck_assert_int_eq(ret, 0);
+	ck_assert_int_ne(jwt_checker_cache_stats(checker, NULL, NULL, NULL), 0);
+
+	free_key();
+}
+END_TEST
+
+static int cache_jti_calls;
+
+static int __jti_count(const jwt_t *jwt, jwt_config_t *config, const char *jti)
+{
+	(void)jwt;
+	(void)config;
+	ck_assert_str_eq(jti, "cache-id");
+	cache_jti_calls++;
+	return 0;
+}
+
+/* A hit skips only the signature: exp and the jti callback still run. */
+START_TEST(cache_claims_on_hit)
+{
+	jwt_checker_auto_t *checker = NULL;
+	char_auto *token = NULL;
+	unsigned long hits;
+	int ret;
+
+	SET_OPS();
+
+	read_json("oct_key_256.json");
+
+	/* Expired ten seconds ago, accepted only with leeway. */
+	token = cache_token(1, time(NULL) - 10);
+	ck_assert_ptr_nonnull(token);
+
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(checker);
+	ck_assert_int_eq(jwt_checker_setkey(checker, JWT_ALG_HS256, g_item), 0);
+	ck_assert_int_eq(jwt_checker_cache(checker, 8, 0), 0);
+	ck_assert_int_eq(jwt_checker_time_leeway(checker, JWT_CLAIM_EXP, 60), 0);
+	ck_assert_int_eq(jwt_checker_setjti(checker, __jti_count, NULL), 0);
+
+	cache_jti_calls = 0;
+	ck_assert_int_eq(jwt_checker_verify(checker, token), 0);
+	ck_assert_int_eq(jwt_checker_verify(checker, token), 0);
+	ck_assert_int_eq(cache_jti_calls, 2);
+	ck_assert_int_eq(jwt_checker_cache_stats(checker, &hits, NULL, NULL), 0);
+	ck_assert_int_eq(hits, 1);
+
+	/* Same bytes, same key, but now out of leeway. */
+	ck_assert_int_eq(jwt_checker_time_leeway(checker, JWT_CLAIM_EXP, 0), 0);
+	ret = jwt_checker_verify(checker, token);
+	ck_assert_int_ne(ret, 0);
+	ck_assert_str_eq(jwt_checker_error_msg(checker),
+			 "Failed one or more claims");
+	jwt_checker_error_clear(checker);
+
+	/* A replay rejected by the jti callback is rejected on a hit too. */
+	ck_assert_int_eq(jwt_checker_time_leeway(checker, JWT_CLAIM_EXP, 60), 0);
+	ck_assert_int_eq(jwt_checker_setjti(checker, __jti_reject, NULL), 0);
+	ret = jwt_checker_verify(checker, token);
+	ck_assert_int_ne(ret, 0);
+	ck_assert_str_eq(jwt_checker_error_msg(checker),
+			 "Failed one or more claims");
+
+	ck_assert_int_eq(jwt_checker_cache_stats(checker, &hits, NULL, NULL), 0);
+	ck_assert_int_eq(hits, 2);
+
+	free_key();
+}
+END_TEST
+
+START_TEST(cache_evict)
+{
+	jwt_checker_auto_t *checker = NULL;
+	char_auto *a = NULL, *b = NULL, *c = NULL;
+	unsigned long hits, misses;
+	unsigned int entries;
+	time_t exp = time(NULL) + 600;
+
+	SET_OPS();
+
+	read_json("oct_key_256.json");
+
+	a = cache_token(1, exp);
+	b = cache_token(2, exp);
+	c = cache_token(3, exp);
+	ck_assert(a && b && c);
+
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(checker);
+	ck_assert_int_eq(jwt_checker_setkey(checker, JWT_ALG_HS256, g_item), 0);
+	ck_assert_int_eq(jwt_checker_cache(checker, 2, 0), 0);
+
+	/* a drops out when c arrives, then b when a comes back. */
+	ck_assert_int_eq(jwt_checker_verify(checker, a), 0);
+	ck_assert_int_eq(jwt_checker_verify(checker, b), 0);
+	ck_assert_int_eq(jwt_checker_verify(checker, c), 0);
+	ck_assert_int_eq(jwt_checker_verify(checker, a), 0);
+	ck_assert_int_eq(jwt_checker_verify(checker, c), 0);
+	ck_assert_int_eq(jwt_checker_verify(checker, a), 0);
+
+	ck_assert_int_eq(jwt_checker_cache_stats(checker, &hits, &misses,
+						 &entries), 0);
+	ck_assert_int_eq(hits, 2);
+	ck_assert_int_eq(misses, 4);
+	ck_assert_int_eq(entries, 2);
+
+	free_key();
+}
+END_TEST
+
+#define BATCH_N	100
+
+START_TEST(verify_batch)
+{
+	jwt_checker_auto_t *checker = NULL;
+	const char *tokens[BATCH_N];
+	size_t lens[BATCH_N];
+	jwt_verify_result_t results[BATCH_N];
+	char padded[sizeof(shared_good) + 8];
+	unsigned int threads;
+	int i, ret;
+
+	SET_OPS();
+
+	read_json("oct_key_256.json");
+
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(checker);
+	ret = jwt_checker_setkey(checker, JWT_ALG_HS256, g_item);
+	ck_assert_int_eq(ret, 0);
+
+	/* A token in place in a larger buffer, found by length. */
+	memcpy(padded, shared_good, sizeof(shared_good) - 1);
+	memcpy(padded + sizeof(shared_good) - 1, " trailer", 8);
+
+	for (i = 0; i < BATCH_N; i++) {
+		switch (i % 4) {
+		case 0:
+			tokens[i] = shared_good;
+			break;
+		case 1:
+			tokens[i] = shared_bad;
+			break;
+		case 2:
+			tokens[i] = "not.a.token";
+			break;
+		default:
+			tokens[i] = padded;
+			break;
+		}
+		lens[i] = i % 4 == 3 ? sizeof(shared_good) - 1 :
+			strlen(tokens[i]);
+	}
+
+	for (threads = 0; threads <= 4; threads += 4) {
+		memset(results, 0xff, sizeof(results));
+
+		ret = jwt_checker_verify_batch(checker, tokens, lens, BATCH_N,
+					       results, threads);
+		ck_assert_int_ne(ret, 0);
+
+		for (i = 0; i < BATCH_N; i++) {
+			if (i % 4 == 0 || i % 4 == 3) {
+				ck_assert_int_eq(results[i].error, 0);
+				ck_assert_str_eq(results[i].error_msg, "");
+			} else {
+				ck_assert_int_ne(results[i].error, 0);
+				ck_assert_int_ne(results[i].error_msg[0], 0);
+			}
+		}
+		/* A fixed message is shared, not copied. */
+		ck_assert_str_eq(results[1].error_msg,
+				 "Token failed verification");
+		ck_assert_ptr_ne(results[1].error_msg, results[1].error_buf);
+		ck_assert_int_eq(results[0].code, JWT_ERR_NONE);
+		ck_assert_int_eq(results[1].code, JWT_ERR_BAD_SIG);
+		ck_assert_int_eq(results[2].code, JWT_ERR_MALFORMED);
+	}
+
+	/* The checker's own state is untouched by the failures. */
+	ck_assert_int_eq(jwt_checker_error(checker), 0);
+
+	/* All good, nil-terminated. */
+	tokens[0] = shared_good;
+	tokens[1] = shared_good;
+	ret = jwt_checker_verify_batch(checker, tokens, NULL, 2, results, 8);
+	ck_assert_int_eq(ret, 0);
+
+	/* A NULL token fails on its own. */
+	tokens[1] = NULL;
+	ret = jwt_checker_verify_batch(checker, tokens, NULL, 2, results, 1);
+	ck_assert_int_ne(ret, 0);
+	ck_assert_int_eq(results[0].error, 0);
+	ck_assert_str_eq(results[1].error_msg, "Must pass a token");
+	ck_assert_ptr_eq(results[1].error_msg, results[1].error_buf);
+
+	ck_assert_int_eq(jwt_checker_verify_batch(checker, tokens, NULL, 0,
+						  NULL, 0), 0);
+	ck_assert_int_ne(jwt_checker_verify_batch(NULL, tokens, NULL, 2,
+						  results, 0), 0);
+	ret = jwt_checker_verify_batch(checker, NULL, NULL, 2, results, 0);
+	ck_assert_int_ne(ret, 0);
+	ck_assert_str_eq(jwt_checker_error_msg(checker),
+			 "Must pass tokens and results");
+
+	free_key();
+}
+END_TEST
+
+static long arena_allocs;
+
+static void *arena_count_malloc(size_t size)
+{
+	arena_allocs++;
+	return malloc(size);
+}
+
+static void arena_count_free(void *ptr)
+{
+	free(ptr);
+}
+
+/* Verify the same token with another arena checker from inside the callback;
+ * the inner verify must not reset the outer one's arena. */
+static int arena_nested_cb(jwt_t *jwt, jwt_config_t *config)
+{
+	jwt_checker_auto_t *inner = jwt_checker_new();
+	jwt_value_t jval;
+
+	ck_assert_ptr_nonnull(inner);
+	ck_assert_int_eq(jwt_checker_setkey(inner, JWT_ALG_HS256, g_item), 0);
+	ck_assert_int_eq(jwt_checker_setarena(inner, 1024), 0);
+	ck_assert_int_eq(jwt_checker_verify(inner, config->ctx), 0);
+
+	jwt_set_GET_INT(&jval, "n");
+	ck_assert_int_eq(jwt_claim_get(jwt, &jval), JWT_VALUE_ERR_NONE);
+	ck_assert_int_eq(jval.int_val, 7);
+
+	return 0;
+}
+
+START_TEST(arena_verify)
+{
+	jwt_checker_auto_t *checker = NULL;
+	jwt_builder_auto_t *builder = NULL;
+	char_auto *token = NULL, *built = NULL;
+	long heap, arena;
+	int ret;
+
+	SET_OPS();
+
+	read_json("oct_key_256.json");
+
+	token = cache_token(7, time(NULL) + 600);
+	ck_assert_ptr_nonnull(token);
+
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(checker);
+	ck_assert_int_eq(jwt_checker_setkey(checker, JWT_ALG_HS256, g_item), 0);
+	ck_assert_int_ne(jwt_checker_setarena(NULL, 1024), 0);
+
+	/* Count the allocations of one verify, without and with the arena. */
+	ck_assert_int_eq(jwt_set_alloc(arena_count_malloc, arena_count_free), 0);
+	arena_allocs = 0;
+	ret = jwt_checker_verify(checker, token);
+	heap = arena_allocs;
+
+	jwt_checker_setarena(checker, 16384);
+	jwt_checker_verify(checker, token);	/* Makes the thread's arena */
+	arena_allocs = 0;
+	ret |= jwt_checker_verify(checker, token);
+	arena = arena_allocs;
+	jwt_set_alloc(NULL, NULL);
+
+	ck_assert_int_eq(ret, 0);
+	ck_assert_int_lt(arena, heap);
+
+	/* Failures come back as before. */
+	ret = jwt_checker_verify(checker, shared_bad);
+	ck_assert_int_ne(ret, 0);
+	ck_assert_str_eq(jwt_checker_error_msg(checker),
+			 "Token failed verification");
+	jwt_checker_error_clear(checker);
+
+	/* Nested arena verifies on the same thread. */
+	ck_assert_int_eq(jwt_checker_setcb(checker, arena_nested_cb, token), 0);
+	ck_assert_int_eq(jwt_checker_verify(checker, token), 0);
+	ck_assert_int_eq(jwt_checker_setcb(checker, NULL, NULL), 0);
+
+	/* A token built in the arena outlives it. */
+	builder = jwt_builder_new();
+	ck_assert_ptr_nonnull(builder);
+	ck_assert_int_eq(jwt_builder_setkey(builder, JWT_ALG_HS256, g_item), 0);
+	ck_assert_int_eq(jwt_builder_setarena(builder, 4096), 0);
+	built = jwt_builder_generate(builder);
+	ck_assert_ptr_nonnull(built);
+	ck_assert_int_eq(jwt_checker_verify(checker, built), 0);
+
+	/* Released, then made again on demand. */
+	jwt_arena_release();
+	ck_assert_int_eq(jwt_checker_verify(checker, token), 0);
+	jwt_arena_release();
+
+	ck_assert_int_eq(jwt_checker_setarena(checker, 0), 0);
+	ck_assert_int_eq(jwt_checker_verify(checker, token), 0);
+
+	free_key();
+}
+END_TEST
+
+START_TEST(stats_verify)
+{
+	jwt_checker_auto_t *checker = NULL;
+	jwt_builder_auto_t *builder = NULL;
+	char_auto *token = NULL, *expired = NULL, *built = NULL;
+#ifdef LIBJWT_HAVE_STATS
+	jwt_verify_ctx_auto_t *ctx = NULL;
+	jwt_checker_shared_t *shared;
+#endif
+	jwt_stats_t st;
+
+	SET_OPS();
+
+	read_json("oct_key_256.json");
+
+	token = cache_token(1, time(NULL) + 600);
+	ck_assert_ptr_nonnull(token);
+	expired = cache_token(2, time(NULL) - 10);
+	ck_assert_ptr_nonnull(expired);
+
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(checker);
+	ck_assert_int_eq(jwt_checker_setkey(checker, JWT_ALG_HS256, g_item), 0);
+
+	builder = jwt_builder_new();
+	ck_assert_ptr_nonnull(builder);
+	ck_assert_int_eq(jwt_builder_setkey(builder, JWT_ALG_HS256, g_item), 0);
+
+	ck_assert_int_ne(jwt_checker_stats(NULL, &st), 0);
+	ck_assert_int_ne(jwt_checker_stats(checker, NULL), 0);
+	ck_assert_int_ne(jwt_builder_stats(NULL, &st), 0);
+	ck_assert_int_ne(jwt_builder_stats(builder, NULL), 0);
+
+#ifndef LIBJWT_HAVE_STATS
+	/* Compiled out: nothing to read. */
+	ck_assert_int_ne(jwt_checker_stats(checker, &st), 0);
+	ck_assert_int_ne(jwt_builder_stats(builder, &st), 0);
+#else
+	ck_assert_int_eq(jwt_checker_stats(checker, &st), 0);
+	ck_assert_int_eq(st.calls, 0);
+	ck_assert_int_eq(st.failures, 0);
+
+	ck_assert_int_eq(jwt_checker_verify(checker, token), 0);
+	ck_assert_int_ne(jwt_checker_verify(checker, expired), 0);
+	jwt_checker_error_clear(checker);
+	ck_assert_int_ne(jwt_checker_verify(checker, shared_bad), 0);
+	jwt_checker_error_clear(checker);
+	ck_assert_int_ne(jwt_checker_verify(checker, "not-a-token"), 0);
+	jwt_checker_error_clear(checker);
+
+	ck_assert_int_eq(jwt_checker_stats(checker, &st), 0);
+	ck_assert_int_eq(st.calls, 4);
+	ck_assert_int_eq(st.failures, 3);
+
+	/* Each failure is put down to the stage it happened in. */
+	ck_assert_int_eq(st.stage[JWT_STAGE_PARSE].failures, 1);
+	ck_assert_int_eq(st.stage[JWT_STAGE_CLAIMS].failures, 1);
+	ck_assert_int_eq(st.stage[JWT_STAGE_SIGNATURE].failures, 1);
+	/* The expired token is turned down before its signature is checked. */
+	ck_assert_int_eq(st.stage[JWT_STAGE_SIGNATURE].count, 2);
+	ck_assert_int_gt(st.stage[JWT_STAGE_BASE64].count, 0);
+	ck_assert_int_gt(st.stage[JWT_STAGE_JSON].count, 0);
+	ck_assert_int_eq(st.stage[JWT_STAGE_JWE].count, 0);
+
+	built = jwt_builder_generate(builder);
+	ck_assert_ptr_nonnull(built);
+
+	ck_assert_int_eq(jwt_builder_stats(builder, &st), 0);
+	ck_assert_int_eq(st.calls, 1);
+	ck_assert_int_eq(st.failures, 0);
+	ck_assert_int_eq(st.stage[JWT_STAGE_SIGNATURE].count, 1);
+	ck_assert_int_gt(st.stage[JWT_STAGE_BASE64].count, 0);
+	ck_assert_int_gt(st.stage[JWT_STAGE_JSON].count, 0);
+
+	/* Views of a shared checker count into the checker they froze. */
+	shared = jwt_checker_freeze(checker);
+	ck_assert_ptr_nonnull(shared);
+	ctx = jwt_verify_ctx_new();
+	ck_assert_ptr_nonnull(ctx);
+
+	ck_assert_int_eq(jwt_checker_shared_verify(shared, ctx, built,
+						   strlen(built)), 0);
+
+	ck_assert_int_eq(jwt_checker_stats(checker, &st), 0);
+	ck_assert_int_eq(st.calls, 5);
+	ck_assert_int_eq(st.failures, 3);
+
+	checker = NULL;
+	jwt_checker_shared_unref(shared);
+#endif
+
+	free_key();
+}
+END_TEST
+
+START_TEST(error_codes)
+{
+	jwt_checker_auto_t *checker = NULL;
+	jwt_verify_ctx_auto_t *ctx = NULL;
+	jwt_checker_shared_t *shared;
+	char_auto *expired = NULL;
+
+	SET_OPS();
+
+	read_json("oct_key_256.json");
+
+	expired = cache_token(1, time(NULL) - 10);
+	ck_assert_ptr_nonnull(expired);
+
+	ck_assert_int_eq(jwt_checker_error_code(NULL), JWT_ERR_OTHER);
+	ck_assert_int_eq(jwt_checker_error_claims(NULL), 0);
+	ck_assert_int_eq(jwt_verify_ctx_error_code(NULL), JWT_ERR_OTHER);
+	ck_assert_int_eq(jwt_verify_ctx_error_claims(NULL), 0);
+
+	/* No key at all: nothing the token could be checked against. */
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(checker);
+	ck_assert_int_eq(jwt_checker_error_code(checker), JWT_ERR_NONE);
+	ck_assert_int_ne(jwt_checker_verify(checker, shared_good), 0);
+	ck_assert_int_eq(jwt_checker_error_code(checker), JWT_ERR_KID_UNKNOWN);
+	jwt_checker_error_clear(checker);
+
+	ck_assert_int_eq(jwt_checker_setkey(checker, JWT_ALG_HS256, g_item), 0);
+
+	ck_assert_int_ne(jwt_checker_verify(checker, expired), 0);
+	ck_assert_int_eq(jwt_checker_error_code(checker), JWT_ERR_EXPIRED);
+	ck_assert_int_eq(jwt_checker_error_claims(checker), JWT_CLAIM_EXP);
+	ck_assert_str_eq(jwt_checker_error_msg(checker),
+			 "Failed one or more claims");
+
+	/* Clearing drops the reason and the claims with the message. */
+	jwt_checker_error_clear(checker);
+	ck_assert_int_eq(jwt_checker_error_code(checker), JWT_ERR_NONE);
+	ck_assert_int_eq(jwt_checker_error_claims(checker), 0);
+	ck_assert_str_eq(jwt_checker_error_msg(checker), "");
+
+	ck_assert_int_ne(jwt_checker_verify(checker, shared_bad), 0);
+	ck_assert_int_eq(jwt_checker_error_code(checker), JWT_ERR_BAD_SIG);
+	ck_assert_int_eq(jwt_checker_error_claims(checker), 0);
+	ck_assert_str_eq(jwt_checker_error_msg(checker),
+			 "Token failed verification");
+	jwt_checker_error_clear(checker);
+
+	ck_assert_int_ne(jwt_checker_verify(checker, "not-a-token"), 0);
+	ck_assert_int_eq(jwt_checker_error_code(checker), JWT_ERR_MALFORMED);
+	jwt_checker_error_clear(checker);
+
+	/* Unsigned, but the checker has a key. */
+	ck_assert_int_ne(jwt_checker_verify(checker,
+			 "eyJhbGciOiJub25lIn0.e30."), 0);
+	ck_assert_int_eq(jwt_checker_error_code(checker), JWT_ERR_ALG_DENIED);
+	jwt_checker_error_clear(checker);
+
+	ck_assert_int_eq(jwt_checker_claim_set(checker, JWT_CLAIM_ISS,
+					       "issuer"), 0);
+	ck_assert_int_ne(jwt_checker_verify(checker, shared_good), 0);
+	ck_assert_int_eq(jwt_checker_error_code(checker), JWT_ERR_CLAIMS);
+	ck_assert_int_eq(jwt_checker_error_claims(checker), JWT_CLAIM_ISS);
+	jwt_checker_error_clear(checker);
+	ck_assert_int_eq(jwt_checker_claim_del(checker, JWT_CLAIM_ISS), 0);
+
+	/* The same from a context of a shared checker. */
+	shared = jwt_checker_freeze(checker);
+	ck_assert_ptr_nonnull(shared);
+	checker = NULL;
+	ctx = jwt_verify_ctx_new();
+	ck_assert_ptr_nonnull(ctx);
+
+	ck_assert_int_ne(jwt_checker_shared_verify(shared, ctx, expired,
+						   strlen(expired)), 0);
+	ck_assert_int_eq(jwt_verify_ctx_error_code(ctx), JWT_ERR_EXPIRED);
+	ck_assert_int_eq(jwt_verify_ctx_error_claims(ctx), JWT_CLAIM_EXP);
+
+	ck_assert_int_eq(jwt_checker_shared_verify(shared, ctx, shared_good,
+						   strlen(shared_good)), 0);
+	ck_assert_int_eq(jwt_verify_ctx_error_code(ctx), JWT_ERR_NONE);
+	ck_assert_int_eq(jwt_verify_ctx_error_claims(ctx), 0);
+
+	jwt_checker_shared_unref(shared);
+
+	free_key();
+}
+END_TEST
+
+static int __limits_cb(jwt_t *jwt, jwt_config_t *config)
+{
+	(void)jwt;
+	(void)config;
+
+	return 0;
+}
+
+/* Turned down by @lim with @msg, whether or not the claims are built. */
+static void limits_reject(jwt_checker_t *checker, const char *token,
+			  const jwt_limits_t *lim, const char *msg)
+{
+	int cb;
+
+	ck_assert_int_eq(jwt_checker_setlimits(checker, lim), 0);
+
+	for (cb = 0; cb < 2; cb++) {
+		ck_assert_int_eq(jwt_checker_setcb(checker,
+				 cb ? __limits_cb : NULL, NULL), 0);
+		ck_assert_int_ne(jwt_checker_verify(checker, token), 0);
+		ck_assert_int_eq(jwt_checker_error_code(checker),
+				 JWT_ERR_LIMIT);
+		ck_assert_str_eq(jwt_checker_error_msg(checker), msg);
+		jwt_checker_error_clear(checker);
+	}
+
+	ck_assert_int_eq(jwt_checker_setcb(checker, NULL, NULL), 0);
+}
+
+START_TEST(limits_verify)
+{
+	jwt_checker_auto_t *checker = NULL;
+	jwt_builder_auto_t *builder = NULL;
+	char_auto *token = NULL, *json = NULL;
+	jwt_limits_t lim;
+	jwt_value_t jval;
+
+	SET_OPS();
+
+	read_json("oct_key_256.json");
+
+	/* {"alg":"HS256","typ":"JWT"} .
+	 * {"iat":...,"nest":{"a":{"b":1}},"s":"abcdefgh"} */
+	builder = jwt_builder_new();
+	ck_assert_ptr_nonnull(builder);
+	ck_assert_int_eq(jwt_builder_setkey(builder, JWT_ALG_HS256, g_item), 0);
+	jwt_set_SET_JSON(&jval, "nest", "{\"a\":{\"b\":1}}");
+	ck_assert_int_eq(jwt_builder_claim_set(builder, &jval), 0);
+	jwt_set_SET_STR(&jval, "s", "abcdefgh");
+	ck_assert_int_eq(jwt_builder_claim_set(builder, &jval), 0);
+
+	token = jwt_builder_generate(builder);
+	ck_assert_ptr_nonnull(token);
+	ck_assert_int_eq(jwt_builder_set_format(builder,
+						JWT_FORMAT_JSON_FLAT), 0);
+	json = jwt_builder_generate(builder);
+	ck_assert_ptr_nonnull(json);
+
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(checker);
+	ck_assert_int_eq(jwt_checker_setkey(checker, JWT_ALG_HS256, g_item), 0);
+
+	ck_assert_int_ne(jwt_checker_setlimits(NULL, NULL), 0);
+	ck_assert_int_eq(jwt_checker_setlimits(checker, NULL), 0);
+
+	memset(&lim, 0, sizeof(lim));
+	lim.max_token_len = strlen(token) - 1;
+	limits_reject(checker, token, &lim, "Token exceeds an input limit");
+
+	memset(&lim, 0, sizeof(lim));
+	lim.max_header_len = 8;
+	limits_reject(checker, token, &lim, "Header exceeds an input limit");
+	limits_reject(checker, json, &lim, "Header exceeds an input limit");
+
+	memset(&lim, 0, sizeof(lim));
+	lim.max_payload_len = 8;
+	limits_reject(checker, token, &lim, "Payload exceeds an input limit");
+	limits_reject(checker, json, &lim, "Payload exceeds an input limit");
+
+	memset(&lim, 0, sizeof(lim));
+	lim.max_depth = 2;
+	limits_reject(checker, token, &lim, "Payload exceeds an input limit");
+
+	memset(&lim, 0, sizeof(lim));
+	lim.max_members = 4;
+	limits_reject(checker, token, &lim, "Payload exceeds an input limit");
+	/* The serialization's own members are counted first. */
+	lim.max_members = 2;
+	limits_reject(checker, json, &lim, "Token exceeds an input limit");
+
+	memset(&lim, 0, sizeof(lim));
+	lim.max_string_len = 7;
+	limits_reject(checker, token, &lim, "Payload exceeds an input limit");
+	limits_reject(checker, json, &lim, "Payload exceeds an input limit");
+
+	/* At every limit, both verify. */
+	memset(&lim, 0, sizeof(lim));
+	lim.max_token_len = strlen(json);
+	lim.max_depth = 3;
+	lim.max_members = 5;
+	lim.max_string_len = 8;
+	ck_assert_int_eq(jwt_checker_setlimits(checker, &lim), 0);
+	ck_assert_int_eq(jwt_checker_verify(checker, token), 0);
+	ck_assert_int_eq(jwt_checker_verify(checker, json), 0);
+
+	free_key();
+}
+END_TEST
+
 static Suite *libjwt_suite(const char *title)
 {
 	Suite *s;
@@ -1700,6 +2576,7 @@ static Suite *libjwt_suite(const char *title)
 
 	tc_core = tcase_create("HS256 Key Verify");
 	tcase_add_loop_test(tc_core, verify_hs256, 0, i);
+	tcase_add_loop_test(tc_core, verify_hs256_n, 0, i);
 	tcase_add_loop_test(tc_core, verify_hs256_wcb, 0, i);
 	tcase_add_loop_test(tc_core, verify_hs256_stress, 0, i);
 	tcase_add_loop_test(tc_core, verify_hs256_fail, 0, i);
@@ -1745,6 +2622,34 @@ static Suite *libjwt_suite(const char *title)
 	tcase_add_loop_test(tc_core, jti_pool_roundtrip, 0, i);
 	suite_add_tcase(s, tc_core);
 
+	tc_core = tcase_create("Shared");
+	tcase_add_loop_test(tc_core, shared_verify, 0, i);
+	tcase_add_loop_test(tc_core, shared_verify_threads, 0, i);
+	tcase_add_loop_test(tc_core, verify_batch, 0, i);
+	suite_add_tcase(s, tc_core);
+
+	tc_core = tcase_create("Cache");
+	tcase_add_loop_test(tc_core, cache_verify, 0, i);
+	tcase_add_loop_test(tc_core, cache_claims_on_hit, 0, i);
+	tcase_add_loop_test(tc_core, cache_evict, 0, i);
+	suite_add_tcase(s, tc_core);
+
+	tc_core = tcase_create("Arena");
+	tcase_add_loop_test(tc_core, arena_verify, 0, i);
+	suite_add_tcase(s, tc_core);
+
+	tc_core = tcase_create("Stats");
+	tcase_add_loop_test(tc_core, stats_verify, 0, i);
+	suite_add_tcase(s, tc_core);
+
+	tc_core = tcase_create("Error codes");
+	tcase_add_loop_test(tc_core, error_codes, 0, i);
+	suite_add_tcase(s, tc_core);
+
+	tc_core = tcase_create("Limits");
+	tcase_add_loop_test(tc_core, limits_verify, 0, i);
+	suite_add_tcase(s, tc_core);
+
 	return s;
 }
 
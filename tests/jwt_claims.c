@@ -198,6 +198,169 @@ START_TEST(claims_sub)
 }
 END_TEST
 
+/* An unsigned token ("alg":"none") with @json as its claims. */
+static char *__none_token(const char *json)
+{
+	static const char b64[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+		"0123456789-_";
+	const char head[] = "eyJhbGciOiJub25lIn0.";
+	const unsigned char *in = (const unsigned char *)json;
+	size_t len = strlen(json), i;
+	char *out, *p;
+
+	out = malloc(sizeof(head) + (len * 4 + 2) / 3 + 1);
+	ck_assert_ptr_nonnull(out);
+
+	strcpy(out, head);
+	p = out + strlen(head);
+
+	for (i = 0; i + 2 < len; i += 3) {
+		*p++ = b64[in[i] >> 2];
+		*p++ = b64[((in[i] & 3) << 4) | (in[i + 1] >> 4)];
+		*p++ = b64[((in[i + 1] & 0xf) << 2) | (in[i + 2] >> 6)];
+		*p++ = b64[in[i + 2] & 0x3f];
+	}
+	if (len - i == 1) {
+		*p++ = b64[in[i] >> 2];
+		*p++ = b64[(in[i] & 3) << 4];
+	} else if (len - i == 2) {
+		*p++ = b64[in[i] >> 2];
+		*p++ = b64[((in[i] & 3) << 4) | (in[i + 1] >> 4)];
+		*p++ = b64[(in[i + 1] & 0xf) << 2];
+	}
+	*p++ = '.';
+	*p = '\0';
+
+	return out;
+}
+
+/* Verify @json as the claims, expecting success or the error @err. */
+static void __scan_verify(jwt_checker_t *checker, const char *json,
+			  const char *err)
+{
+	char *token = __none_token(json);
+	int ret;
+
+	ret = jwt_checker_verify(checker, token);
+	if (err == NULL) {
+		ck_assert_int_eq(ret, 0);
+	} else {
+		ck_assert_int_ne(ret, 0);
+		ck_assert_str_eq(jwt_checker_error_msg(checker), err);
+		jwt_checker_error_clear(checker);
+	}
+
+	free(token);
+}
+
+/* With no callback, the checker reads the registered claims straight from
+ * the payload instead of building its JSON tree. Escapes, "aud" arrays, type
+ * errors, duplicate names at any depth and malformed JSON must come out as
+ * they do with the tree. */
+START_TEST(claims_scan)
+{
+	jwt_checker_auto_t *checker = NULL;
+	const char *parse = "Error parsing payload";
+	const char *failed = "Failed one or more claims";
+	const char *required[] = { "scope", "exp" };
+	char *big, *p;
+	int i;
+
+	SET_OPS();
+
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(checker);
+	ck_assert_int_eq(jwt_checker_setkey(checker, JWT_ALG_NONE, NULL), 0);
+	ck_assert_int_eq(jwt_checker_claim_set(checker, JWT_CLAIM_ISS,
+					       "foo.example.com"), 0);
+	ck_assert_int_eq(jwt_checker_claim_set(checker, JWT_CLAIM_AUD,
+					       "me"), 0);
+
+	/* Escaped values and names compare by what they decode to. */
+	__scan_verify(checker,
+		"{\"iss\":\"foo\\u002eexample.com\",\"aud\":\"m\\u0065\"}", NULL);
+	__scan_verify(checker,
+		"{\"\\u0069ss\":\"foo.example.com\",\"aud\":\"me\"}", NULL);
+	__scan_verify(checker,
+		"{\"iss\":\"foo.example.com\\u0000\",\"aud\":\"me\"}", parse);
+
+	/* "aud" arrays: only the string elements are audiences. */
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\","
+		"\"aud\":[1,null,{\"me\":1},\"you\",\"m\\u0065\"]}", NULL);
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\","
+		"\"aud\":[\"you\",[\"me\"]]}", failed);
+	__scan_verify(checker,
+		"{\"iss\":\"foo.example.com\",\"aud\":[]}", failed);
+
+	/* A wrong type fails its check; absent is fine for the times only. */
+	__scan_verify(checker,
+		"{\"iss\":[\"foo.example.com\"],\"aud\":\"me\"}", failed);
+	__scan_verify(checker, "{\"aud\":\"me\"}", failed);
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\","
+		"\"aud\":\"me\",\"exp\":1e30}", failed);
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\","
+		"\"aud\":\"me\",\"nbf\":\"0\"}", failed);
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\","
+		"\"aud\":\"me\",\"exp\":1,\"nbf\":0}", failed);
+
+	/* @rfc{8725,2.4} Duplicate names are refused at every level, also
+	 * when only their escapes differ; the same name in two objects is
+	 * not a duplicate. */
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\",\"aud\":\"me\","
+		"\"x\":{\"a\":1,\"b\":2},\"y\":{\"a\":1,\"b\":2},\"a\":0}", NULL);
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\",\"aud\":\"me\","
+		"\"x\":[{\"a\":1,\"b\":{},\"a\":2}]}", parse);
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\",\"aud\":\"me\","
+		"\"\\u0069ss\":\"foo.example.com\"}", parse);
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\",\"aud\":\"me\","
+		"\"x\":{\"a\":1,\"b\":2,\"c\":3,\"d\":4,\"e\":5,\"f\":6,"
+		"\"g\":7,\"h\":8,\"i\":9,\"j\":10}}", NULL);
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\",\"aud\":\"me\","
+		"\"x\":{\"a\":1,\"b\":2,\"c\":3,\"d\":4,\"e\":5,\"f\":6,"
+		"\"g\":7,\"h\":8,\"i\":9,\"c\":10}}", parse);
+
+	/* Malformed JSON, out of range numbers, bad UTF-8 and surrogates. */
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\",\"aud\":\"me\"}x",
+		      parse);
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\",\"aud\":\"me\","
+		"\"exp\":9223372036854775808}", parse);
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\",\"aud\":\"me\","
+		"\"x\":-1e400}", parse);
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\",\"aud\":\"me\","
+		"\"x\":01}", parse);
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\",\"aud\":\"me\","
+		"\"x\":\"\\ud800\"}", parse);
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\",\"aud\":\"me\","
+		"\"x\":\"\xc0\xae\"}", parse);
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\",\"aud\":\"me\","
+		"\"x\":\"\\ud83d\\ude00 \xf0\x9f\x98\x80\"}", NULL);
+
+	/* Required claims are looked for in the same pass. */
+	ck_assert_int_eq(jwt_checker_require(checker, required,
+					     ARRAY_SIZE(required)), 0);
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\",\"aud\":\"me\","
+		"\"scope\":{\"x\":[]},\"exp\":\"soon\"}", failed);
+	__scan_verify(checker, "{\"iss\":\"foo.example.com\",\"aud\":\"me\","
+		"\"x\":{\"exp\":1},\"scope\":null}",
+		"Required claim \"exp\" is missing");
+
+	/* A large permission list, and a duplicate at its very end. */
+	ck_assert_int_eq(jwt_checker_require(checker, NULL, 0), 0);
+	big = malloc(100000);
+	ck_assert_ptr_nonnull(big);
+	p = big + sprintf(big, "{\"iss\":\"foo.example.com\",\"perms\":[");
+	for (i = 0; i < 2000; i++)
+		p += sprintf(p, "%s{\"r\":\"res-%d\",\"a\":[\"read\"]}",
+			     i ? "," : "", i);
+	strcpy(p, "],\"aud\":[\"x\",\"me\"]}");
+	__scan_verify(checker, big, NULL);
+	strcpy(p, "],\"aud\":[\"x\",\"me\"],\"perms\":0}");
+	__scan_verify(checker, big, parse);
+	free(big);
+}
+END_TEST
+
 static Suite *libjwt_suite(const char *title)
 {
 	Suite *s;
@@ -212,6 +375,7 @@ static Suite *libjwt_suite(const char *title)
 	tcase_add_loop_test(tc_core, claims_iss, 0, i);
 	tcase_add_loop_test(tc_core, claims_aud, 0, i);
 	tcase_add_loop_test(tc_core, claims_sub, 0, i);
+	tcase_add_loop_test(tc_core, claims_scan, 0, i);
 	suite_add_tcase(s, tc_core);
 
 	return s;
@@ -8,6 +8,10 @@
 
 #include "jwt_tests.h"
 
+#ifdef HAVE_OPENSSL
+#include <openssl/crypto.h>
+#endif
+
 START_TEST(test_jwt_ops)
 {
 	size_t i;
@@ -35,6 +39,112 @@ START_TEST(test_jwt_ops)
 }
 END_TEST
 
+#ifdef HAVE_OPENSSL
+/* Sign and verify with @key_file, and round-trip a JWE. Returns non-zero if
+ * anything along the way fails. */
+static int libctx_roundtrip(const char *key_file, jwt_alg_t alg)
+{
+	jwt_builder_auto_t *builder = NULL;
+	jwt_checker_auto_t *checker = NULL;
+	char_auto *token = NULL;
+	int ret;
+
+	read_json(key_file);
+	if (jwks_item_error(g_item)) {
+		free_key();
+		return 1;
+	}
+
+	builder = jwt_builder_new();
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(builder);
+	ck_assert_ptr_nonnull(checker);
+
+	ck_assert_int_eq(jwt_builder_setkey(builder, alg, g_item), 0);
+	ck_assert_int_eq(jwt_checker_setkey(checker, alg, g_item), 0);
+
+	token = jwt_builder_generate(builder);
+	ret = token == NULL || jwt_checker_verify(checker, token);
+
+	free_key();
+
+	return ret;
+}
+
+static int libctx_jwe(void)
+{
+	jwe_builder_t *builder;
+	jwe_checker_t *checker;
+	unsigned char *pt = NULL;
+	char *token;
+
+	read_json("oct_key_256_enc.json");
+
+	builder = jwe_builder_new();
+	checker = jwe_checker_new();
+	ck_assert_ptr_nonnull(builder);
+	ck_assert_ptr_nonnull(checker);
+
+	ck_assert_int_eq(jwe_builder_setkey(builder, JWE_ALG_A256KW,
+					    JWE_ENC_A256GCM, g_item), 0);
+	ck_assert_int_eq(jwe_checker_setkey(checker, JWE_ALG_A256KW,
+					    JWE_ENC_A256GCM, g_item), 0);
+
+	token = jwe_builder_generate(builder, (const unsigned char *)"hi", 2);
+	if (token != NULL)
+		pt = jwe_checker_decrypt(checker, token, NULL);
+
+	free(token);
+	jwe_builder_free(builder);
+	jwe_checker_free(checker);
+	free_key();
+
+	if (pt == NULL)
+		return 1;
+
+	ck_assert_str_eq((char *)pt, "hi");
+	free(pt);
+
+	return 0;
+}
+
+START_TEST(openssl_libctx)
+{
+	OSSL_LIB_CTX *libctx;
+
+	ck_assert(!jwt_set_crypto_ops("openssl"));
+
+	libctx = OSSL_LIB_CTX_new();
+	ck_assert_ptr_nonnull(libctx);
+
+	/* Everything still works from a fresh context. */
+	ck_assert_int_eq(jwt_set_crypto_openssl_libctx(libctx,
+						       "provider=default"), 0);
+	ck_assert_int_eq(libctx_roundtrip("oct_key_256.json", JWT_ALG_HS256), 0);
+	ck_assert_int_eq(libctx_roundtrip("rsa_key_2048.json", JWT_ALG_RS256), 0);
+	ck_assert_int_eq(libctx_roundtrip("rsa_pss_key_2048.json",
+					  JWT_ALG_PS256), 0);
+	ck_assert_int_eq(libctx_roundtrip("ec_key_prime256v1.json",
+					  JWT_ALG_ES256), 0);
+	ck_assert_int_eq(libctx_jwe(), 0);
+
+	/* A property query nothing matches: the backend really fetches
+	 * through it, so HMAC and key loading fail. */
+	ck_assert_int_eq(jwt_set_crypto_openssl_libctx(libctx,
+						       "provider=nosuch"), 0);
+	ck_assert_int_ne(libctx_roundtrip("oct_key_256.json", JWT_ALG_HS256), 0);
+	ck_assert_int_ne(libctx_roundtrip("rsa_key_2048.json", JWT_ALG_RS256), 0);
+
+	/* Back to the defaults. */
+	ck_assert_int_eq(jwt_set_crypto_openssl_libctx(NULL, NULL), 0);
+	ck_assert_int_eq(libctx_roundtrip("oct_key_256.json", JWT_ALG_HS256), 0);
+	ck_assert_int_eq(libctx_jwe(), 0);
+
+	OSSL_LIB_CTX_free(libctx);
+}
+END_TEST
+#endif
+
 static Suite *libjwt_suite(const char *title)
 {
 	Suite *s;
@@ -45,6 +155,9 @@ static Suite *libjwt_suite(const char *title)
 	tc_core = tcase_create("jwt_crypto");
 
 	tcase_add_test(tc_core, test_jwt_ops);
+#ifdef HAVE_OPENSSL
+	tcase_add_test(tc_core, openssl_libctx);
+#endif
 
 	tcase_set_timeout(tc_core, 30);
 
@@ -165,6 +165,85 @@ START_TEST(test_jwks_ec_pub_oversized)
 }
 END_TEST
 
+/* Sign and verify many tokens, so R and S with leading zero octets and with
+ * the top bit set (which DER pads) both go through the R || S <-> DER
+ * conversion, then check that all-zero and all-ones signatures of the right
+ * length are refused. */
+static void __ec_sig_roundtrip(const char *key_file, jwt_alg_t alg,
+			       const char *zero, const char *ones)
+{
+	jwt_builder_auto_t *builder = NULL;
+	jwt_checker_auto_t *checker = NULL;
+	char *out, *dot, *bad;
+	size_t head_len;
+	int i;
+
+	read_json(key_file);
+
+	builder = jwt_builder_new();
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(builder);
+	ck_assert_ptr_nonnull(checker);
+	ck_assert_int_eq(jwt_builder_setkey(builder, alg, g_item), 0);
+	ck_assert_int_eq(jwt_checker_setkey(checker, alg, g_item), 0);
+
+	for (i = 0; i < 256; i++) {
+		out = jwt_builder_generate(builder);
+		ck_assert_ptr_nonnull(out);
+		ck_assert_int_eq(jwt_checker_verify(checker, out), 0);
+		if (i < 255)
+			free(out);
+	}
+
+	dot = strrchr(out, '.');
+	ck_assert_ptr_nonnull(dot);
+	head_len = dot - out + 1;
+
+	bad = malloc(head_len + strlen(zero) + 1);
+	ck_assert_ptr_nonnull(bad);
+	memcpy(bad, out, head_len);
+
+	strcpy(bad + head_len, zero);
+	ck_assert_int_ne(jwt_checker_verify(checker, bad), 0);
+
+	strcpy(bad + head_len, ones);
+	ck_assert_int_ne(jwt_checker_verify(checker, bad), 0);
+
+	free(bad);
+	free(out);
+
+	free_key();
+}
+
+START_TEST(test_ec_sig_encoding)
+{
+	char zero[177], ones[177];
+
+	SET_OPS();
+
+	/* ES256: 64 octets, 86 characters, the last holding 2 bits. */
+	memset(zero, 'A', 86);
+	zero[86] = '\0';
+	memset(ones, '_', 85);
+	strcpy(ones + 85, "w");
+	__ec_sig_roundtrip("ec_key_prime256v1.json", JWT_ALG_ES256, zero, ones);
+
+	/* ES384: 96 octets, 128 characters. */
+	memset(zero, 'A', 128);
+	zero[128] = '\0';
+	memset(ones, '_', 128);
+	ones[128] = '\0';
+	__ec_sig_roundtrip("ec_key_secp384r1.json", JWT_ALG_ES384, zero, ones);
+
+	/* ES512: 132 octets, 176 characters. */
+	memset(zero, 'A', 176);
+	zero[176] = '\0';
+	memset(ones, '_', 176);
+	ones[176] = '\0';
+	__ec_sig_roundtrip("ec_key_secp521r1.json", JWT_ALG_ES512, zero, ones);
+}
+END_TEST
+
 static Suite *libjwt_suite(const char *title)
 {
 	Suite *s;
@@ -182,6 +261,7 @@ static Suite *libjwt_suite(const char *title)
 	tcase_add_loop_test(tc_core, test_jwks_ec_pub_bad_points, 0, i);
 	tcase_add_loop_test(tc_core, test_jwks_ec_pub_bad_component_decode, 0, i);
 	tcase_add_loop_test(tc_core, test_jwks_ec_pub_oversized, 0, i);
+	tcase_add_loop_test(tc_core, test_ec_sig_encoding, 0, i);
 
 	tcase_set_timeout(tc_core, 30);
 
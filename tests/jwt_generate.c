@@ -149,6 +149,54 @@ START_TEST(test_generate_append)
 }
 END_TEST
 
+/* A key generated for JWE is marked "use":"enc" and encrypts. */
+START_TEST(test_generate_enc)
+{
+	static const struct {
+		jwk_key_type_t kty;
+		const char *param;
+		jwe_key_alg_t alg;
+	} cases[] = {
+		{ JWK_KEY_TYPE_RSA, "2048",  JWE_ALG_RSA_OAEP_256 },
+		{ JWK_KEY_TYPE_EC,  "P-256", JWE_ALG_ECDH_ES_A128KW },
+	};
+	size_t i;
+
+	SET_OPS();
+
+	for (i = 0; i < ARRAY_SIZE(cases); i++) {
+		jwe_builder_auto_t *b = jwe_builder_new();
+		jwe_checker_auto_t *c = jwe_checker_new();
+		char_auto *tok = NULL;
+		unsigned char *pt;
+		const jwk_item_t *k;
+		jwk_set_t *set;
+
+		set = jwks_create_generate(cases[i].kty, cases[i].param,
+					   JWT_ALG_NONE, JWK_KEY_USE_ENC);
+		ck_assert_ptr_nonnull(set);
+		k = jwks_item_get(set, 0);
+		ck_assert_ptr_nonnull(k);
+		ck_assert_int_eq(jwks_item_error(k), 0);
+		ck_assert_int_eq(jwks_item_use(k), JWK_PUB_KEY_USE_ENC);
+		ck_assert_int_eq(jwks_item_alg(k), JWT_ALG_NONE);
+
+		ck_assert_int_eq(jwe_builder_setkey(b, cases[i].alg,
+			JWE_ENC_A128GCM, k), 0);
+		tok = jwe_builder_generate(b, (const unsigned char *)"hi", 2);
+		ck_assert_ptr_nonnull(tok);
+		ck_assert_int_eq(jwe_checker_setkey(c, cases[i].alg,
+			JWE_ENC_A128GCM, k), 0);
+		pt = jwe_checker_decrypt(c, tok, NULL);
+		ck_assert_ptr_nonnull(pt);
+		ck_assert_str_eq((char *)pt, "hi");
+		free(pt);
+
+		jwks_free(set);
+	}
+}
+END_TEST
+
 static Suite *libjwt_suite(const char *title)
 {
 	Suite *s;
@@ -162,6 +210,7 @@ static Suite *libjwt_suite(const char *title)
 	tcase_add_loop_test(tc_core, test_generate_optional, 0, i);
 	tcase_add_loop_test(tc_core, test_generate_errors, 0, i);
 	tcase_add_loop_test(tc_core, test_generate_append, 0, i);
+	tcase_add_loop_test(tc_core, test_generate_enc, 0, i);
 
 	tcase_set_timeout(tc_core, 120);
 	suite_add_tcase(s, tc_core);
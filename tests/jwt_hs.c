@@ -125,6 +125,109 @@ START_TEST(hs512)
 }
 END_TEST
 
+static int __verify_hs(const jwk_item_t *item, jwt_alg_t alg,
+		       const char *token)
+{
+	jwt_checker_auto_t *checker = NULL;
+	int ret;
+
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(checker);
+
+	ret = jwt_checker_setkey(checker, alg, item);
+	ck_assert_int_eq(ret, 0);
+
+	return jwt_checker_verify(checker, token);
+}
+
+START_TEST(hs_sig_encoding)
+{
+	const char good[] = "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9.e30.CM4dD95Nj"
+		"0vSfMGtDas432AUW1HAo7feCiAbt5Yjuds";
+	char bad[sizeof(good) + 4];
+	size_t len = strlen(good);
+
+	SET_OPS();
+
+	read_json("oct_key_256.json");
+
+	/* Twice: the second verify uses the key state kept from the first. */
+	ck_assert_int_eq(__verify_hs(g_item, JWT_ALG_HS256, good), 0);
+	ck_assert_int_eq(__verify_hs(g_item, JWT_ALG_HS256, good), 0);
+
+	/* 's' and 't' differ only in the unused low bits of the last
+	 * character, so both decode to the same MAC. Only the canonical
+	 * encoding is accepted. */
+	strcpy(bad, good);
+	ck_assert_int_eq(bad[len - 1], 's');
+	bad[len - 1] = 't';
+	ck_assert_int_ne(__verify_hs(g_item, JWT_ALG_HS256, bad), 0);
+
+	/* Truncated */
+	strcpy(bad, good);
+	bad[len - 1] = '\0';
+	ck_assert_int_ne(__verify_hs(g_item, JWT_ALG_HS256, bad), 0);
+
+	/* Extended */
+	strcpy(bad, good);
+	strcat(bad, "AA");
+	ck_assert_int_ne(__verify_hs(g_item, JWT_ALG_HS256, bad), 0);
+
+	/* Not base64url */
+	strcpy(bad, good);
+	bad[len - 5] = '+';
+	ck_assert_int_ne(__verify_hs(g_item, JWT_ALG_HS256, bad), 0);
+
+	/* One bit of the MAC */
+	strcpy(bad, good);
+	bad[len - 43] = 'D';
+	ck_assert_int_ne(__verify_hs(g_item, JWT_ALG_HS256, bad), 0);
+
+	free_key();
+}
+END_TEST
+
+START_TEST(hs_one_key_many_algs)
+{
+	jwt_builder_auto_t *builder = NULL;
+	jwk_set_auto_t *jwk_set = NULL;
+	jwt_alg_t algs[] = { JWT_ALG_HS256, JWT_ALG_HS384, JWT_ALG_HS512 };
+	const jwk_item_t *item;
+	size_t i;
+	int ret;
+
+	SET_OPS();
+
+	/* No "alg", so one key serves all three digests; each keeps its
+	 * own state on the key. */
+	jwk_set = jwks_create("{\"kty\":\"oct\",\"k\":\"vPnfAG10Y09YGh-DQQw"
+		"Q-n1lye8hfaO1PYdh8qr5oOI5gxKaX1GNBgwtSWsFyt7txFpuMs4kf_3wPWIe"
+		"fC2rQg\"}");
+	ck_assert_ptr_nonnull(jwk_set);
+	item = jwks_item_get(jwk_set, 0);
+	ck_assert_ptr_nonnull(item);
+	ck_assert_int_eq(jwks_item_error(item), 0);
+
+	builder = jwt_builder_new();
+	ck_assert_ptr_nonnull(builder);
+
+	for (i = 0; i < ARRAY_SIZE(algs); i++) {
+		char *out;
+
+		ret = jwt_builder_setkey(builder, algs[i], item);
+		ck_assert_int_eq(ret, 0);
+		out = jwt_builder_generate(builder);
+		ck_assert_ptr_nonnull(out);
+
+		ck_assert_int_eq(__verify_hs(item, algs[i], out), 0);
+		ck_assert_int_ne(__verify_hs(item,
+			algs[(i + 1) % ARRAY_SIZE(algs)], out), 0);
+
+		free(out);
+	}
+}
+END_TEST
+
 static Suite *libjwt_suite(const char *title)
 {
 	Suite *s;
@@ -138,6 +241,8 @@ static Suite *libjwt_suite(const char *title)
 	tcase_add_loop_test(tc_core, hs384, 0, i);
 	tcase_add_loop_test(tc_core, hs512, 0, i);
 	tcase_add_loop_test(tc_core, hs_too_small, 0, i);
+	tcase_add_loop_test(tc_core, hs_sig_encoding, 0, i);
+	tcase_add_loop_test(tc_core, hs_one_key_many_algs, 0, i);
 	suite_add_tcase(s, tc_core);
 
 	return s;
@@ -156,6 +156,66 @@ START_TEST(test_jwks_keyring_load)
 }
 END_TEST
 
+/* kid lookups stay right as keys are added and removed, for a keyring big
+ * enough that the index (not the list walk) is what answers. */
+START_TEST(test_jwks_kid_index)
+{
+	const char dup[] = "{\"keys\":["
+		"{\"kty\":\"oct\",\"kid\":\"dup\",\"alg\":\"HS256\","
+		"\"k\":\"AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxwdHh8\"},"
+		"{\"kty\":\"oct\",\"kid\":\"dup\",\"alg\":\"HS384\","
+		"\"k\":\"AAECAwQFBgcICQoLDA0ODxAREhMUFRYXGBkaGxwdHh8\"}]}";
+	jwk_set_auto_t *set = NULL;
+	char kid[300][64];
+	const jwk_item_t *item;
+	int i;
+
+	SET_OPS();
+
+	for (i = 0; i < 300; i++) {
+		set = jwks_generate(set, JWK_KEY_TYPE_OCT, NULL, JWT_ALG_HS256,
+				    JWK_KEY_GEN_KID);
+		ck_assert_ptr_nonnull(set);
+		ck_assert_int_eq(jwks_error(set), 0);
+		item = jwks_item_get(set, i);
+		ck_assert_ptr_nonnull(jwks_item_kid(item));
+		strcpy(kid[i], jwks_item_kid(item));
+	}
+
+	for (i = 0; i < 300; i++)
+		ck_assert_ptr_eq(jwks_find_bykid(set, kid[i]),
+				 jwks_item_get(set, i));
+	ck_assert_ptr_null(jwks_find_bykid(set, "no-such-kid"));
+
+	/* Removing keys drops them, and only them, from the index. */
+	ck_assert(jwks_item_free(set, 0));
+	ck_assert(jwks_item_free(set, 150));
+	ck_assert_ptr_null(jwks_find_bykid(set, kid[0]));
+	ck_assert_ptr_null(jwks_find_bykid(set, kid[151]));
+	ck_assert_ptr_eq(jwks_find_bykid(set, kid[1]), jwks_item_get(set, 0));
+	ck_assert_ptr_eq(jwks_find_bykid(set, kid[299]),
+			 jwks_item_get(set, 297));
+
+	/* The first of a duplicated kid wins, and the next takes over. */
+	set = jwks_load(set, dup);
+	ck_assert_ptr_nonnull(set);
+	item = jwks_find_bykid(set, "dup");
+	ck_assert_ptr_nonnull(item);
+	ck_assert_int_eq(jwks_item_alg(item), JWT_ALG_HS256);
+	ck_assert(jwks_item_free(set, 298));
+	item = jwks_find_bykid(set, "dup");
+	ck_assert_ptr_nonnull(item);
+	ck_assert_int_eq(jwks_item_alg(item), JWT_ALG_HS384);
+
+	ck_assert_int_eq(jwks_item_free_all(set), 299);
+	ck_assert_ptr_null(jwks_find_bykid(set, kid[1]));
+	ck_assert_ptr_null(jwks_find_bykid(set, "dup"));
+
+	set = jwks_load(set, dup);
+	ck_assert_ptr_nonnull(jwks_find_bykid(set, "dup"));
+}
+END_TEST
+
 #ifdef HAVE_LIBCURL
 START_TEST(load_fromurl)
 {
@@ -331,6 +391,7 @@ static Suite *libjwt_suite(const char *title)
 	/* Load a whole keyring */
 	tcase_add_loop_test(tc_core, test_jwks_keyring_load, 0, i);
 	tcase_add_loop_test(tc_core, test_jwks_keyring_all_bad, 0, i);
+	tcase_add_loop_test(tc_core, test_jwks_kid_index, 0, i);
 
 	tcase_add_loop_test(tc_core, load_fromurl, 0, i);
 #ifdef HAVE_LIBCURL
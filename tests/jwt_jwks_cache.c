@@ -7,12 +7,15 @@
 #include "jwt_tests.h"
 
 /* @rfc{7517} Cached remote JWKS source: TTL, Cache-Control/ETag conditional
- * refresh (304), kid-miss refresh + cooldown, and the http(s) SSRF guard
- * (issue #313). Only meaningful with libcurl; a tiny in-process HTTP server
- * serves the JWKS with caching headers and counts requests. */
+ * refresh (304), kid-miss refresh + cooldown, the http(s) SSRF guard
+ * (issue #313), and the background refresher. Only meaningful with libcurl; a
+ * tiny in-process HTTP server serves the JWKS with caching headers and counts
+ * requests. */
 
 #ifdef HAVE_LIBCURL
 #include <pthread.h>
+#include <signal.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -24,6 +27,14 @@ static const char JWKS_BODY[] =
 	"\"x\":\"Y--DdSpCZ5oF3j__h-SdNJIwvB5aI4AXzpRErGUjWrM\","
 	"\"y\":\"_bSTCXlDeU-pZZbOKDUVLANspSIeuKZfTM8rtXFG_RU\"}]}";
 
+/* Two HS256 keys, for a rotation from "a" to "b". */
+static const char JWKS_A[] =
+	"{\"keys\":[{\"kty\":\"oct\",\"kid\":\"a\",\"alg\":\"HS256\","
+	"\"k\":\"YWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWFhYWE\"}]}";
+static const char JWKS_B[] =
+	"{\"keys\":[{\"kty\":\"oct\",\"kid\":\"b\",\"alg\":\"HS256\","
+	"\"k\":\"YmJiYmJiYmJiYmJiYmJiYmJiYmJiYmJiYmJiYmJiYmI\"}]}";
+
 static struct {
 	int listen_fd;
 	int port;
@@ -31,20 +42,34 @@ static struct {
 	int conditional;	/* GETs that carried If-None-Match	*/
 	int max_age;		/* Cache-Control: max-age to advertise	*/
 	int fail;		/* when set, respond 500			*/
+	const char *body;	/* JWKS to serve, JWKS_BODY if NULL	*/
+	const char *etag;	/* Its ETag, "v1" if NULL		*/
+	int delay;		/* ms to wait before responding		*/
+	long long at[8];	/* when the first GETs arrived (ms)	*/
 	pthread_t thread;
 	pthread_mutex_t lock;
-	volatile int stop;
+	int stop;		/* set by server_stop()			*/
 } srv;
 
+static long long mono_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
 static void *server_thread(void *arg)
 {
 	(void)arg;
 
 	for (;;) {
-		char req[4096];
+		char req[4096], inm[64];
 		int fd = accept(srv.listen_fd, NULL, NULL);
+		const char *body, *etag;
 		ssize_t n;
-		int cond;
+		int cond, delay, fail;
 
 		if (fd < 0)
 			break;	/* listen socket closed -> shut down */
@@ -56,19 +81,31 @@ static void *server_thread(void *arg)
 		}
 		req[n] = '\0';
 
-		cond = (strstr(req, "If-None-Match: \"v1\"") != NULL);
-
 		pthread_mutex_lock(&srv.lock);
+		body = srv.body ? srv.body : JWKS_BODY;
+		etag = srv.etag ? srv.etag : "v1";
+		delay = srv.delay;
+		fail = srv.fail;
+		snprintf(inm, sizeof(inm), "If-None-Match: \"%s\"", etag);
+		cond = (strstr(req, inm) != NULL);
+		if (srv.requests < (int)ARRAY_SIZE(srv.at))
+			srv.at[srv.requests] = mono_ms();
 		srv.requests++;
 		if (cond)
 			srv.conditional++;
 		pthread_mutex_unlock(&srv.lock);
 
+		/* A slow origin: the request is counted, the answer late
+		 * (but not past server_stop()). */
+		for (; delay > 0 && !__atomic_load_n(&srv.stop, __ATOMIC_RELAXED);
+		     delay -= 10)
+			usleep(10000);
+
 		/* Consume write()'s result (glibc marks it warn_unused_result, and a
 		 * (void) cast does not suppress that under -Werror). We do NOT assert
 		 * it: a test client may legitimately hang up early, and this runs on a
 		 * worker thread where a failing ck_assert would longjmp across threads. */
-		if (srv.fail) {
+		if (fail) {
 			const char *e = "HTTP/1.1 500 Internal Server Error\r\n"
 					"Content-Length: 0\r\n\r\n";
 			ssize_t w = write(fd, e, strlen(e));
@@ -77,9 +114,9 @@ static void *server_thread(void *arg)
 			char hdr[256];
 			int hlen = snprintf(hdr, sizeof(hdr),
 				"HTTP/1.1 304 Not Modified\r\n"
-				"ETag: \"v1\"\r\n"
+				"ETag: \"%s\"\r\n"
 				"Cache-Control: max-age=%d\r\n"
-				"\r\n", srv.max_age);
+				"\r\n", etag, srv.max_age);
 			ssize_t w = write(fd, hdr, hlen);
 			(void)w;
 		} else {
@@ -87,12 +124,12 @@ static void *server_thread(void *arg)
 			int hlen = snprintf(hdr, sizeof(hdr),
 				"HTTP/1.1 200 OK\r\n"
 				"Content-Type: application/json\r\n"
-				"ETag: \"v1\"\r\n"
+				"ETag: \"%s\"\r\n"
 				"Cache-Control: max-age=%d\r\n"
 				"Content-Length: %zu\r\n"
-				"\r\n", srv.max_age, strlen(JWKS_BODY));
+				"\r\n", etag, srv.max_age, strlen(body));
 			ssize_t wh = write(fd, hdr, hlen);
-			ssize_t wb = write(fd, JWKS_BODY, strlen(JWKS_BODY));
+			ssize_t wb = write(fd, body, strlen(body));
 			(void)wh;
 			(void)wb;
 		}
@@ -132,6 +169,7 @@ static int server_start(void)
 
 static void server_stop(void)
 {
+	__atomic_store_n(&srv.stop, 1, __ATOMIC_RELAXED);
 	shutdown(srv.listen_fd, SHUT_RDWR);
 	close(srv.listen_fd);
 	pthread_join(srv.thread, NULL);
@@ -149,6 +187,18 @@ static int req_count(void)
 	return n;
 }
 
+/* Milliseconds from the @i'th request to the next, counting from 1. */
+static long long req_gap(int i)
+{
+	long long gap;
+
+	pthread_mutex_lock(&srv.lock);
+	gap = srv.at[i] - srv.at[i - 1];
+	pthread_mutex_unlock(&srv.lock);
+
+	return gap;
+}
+
 static void req_reset(void)
 {
 	pthread_mutex_lock(&srv.lock);
@@ -157,6 +207,85 @@ static void req_reset(void)
 	pthread_mutex_unlock(&srv.lock);
 }
 
+static void serve(const char *body, const char *etag, int delay)
+{
+	pthread_mutex_lock(&srv.lock);
+	srv.body = body;
+	srv.etag = etag;
+	srv.delay = delay;
+	pthread_mutex_unlock(&srv.lock);
+}
+
+static void serve_fail(int fail)
+{
+	pthread_mutex_lock(&srv.lock);
+	srv.fail = fail;
+	pthread_mutex_unlock(&srv.lock);
+}
+
+/* Wait up to 10s for the server to have seen @n requests. */
+static void wait_requests(int n)
+{
+	long long end = mono_ms() + 10000;
+
+	while (req_count() < n && mono_ms() < end)
+		usleep(10000);
+
+	ck_assert_int_ge(req_count(), n);
+}
+
+/* A flattened JWS signed by the one key in @jwks, naming its kid. */
+static char *make_token(const char *jwks, const char *kid)
+{
+	jwt_builder_t *builder;
+	jwt_signature_t *sig;
+	jwk_set_t *keys;
+	char *token, val[16];
+
+	keys = jwks_create(jwks);
+	ck_assert_ptr_nonnull(keys);
+
+	builder = jwt_builder_new();
+	ck_assert_ptr_nonnull(builder);
+	ck_assert_int_eq(jwt_builder_set_format(builder,
+						JWT_FORMAT_JSON_FLAT), 0);
+	sig = jwt_builder_add_signature(builder, JWT_ALG_HS256,
+					jwks_item_get(keys, 0));
+	ck_assert_ptr_nonnull(sig);
+	snprintf(val, sizeof(val), "\"%s\"", kid);
+	ck_assert_int_eq(jwt_signature_add_protected_json(sig, "kid", val), 0);
+
+	token = jwt_builder_generate(builder);
+	ck_assert_ptr_nonnull(token);
+
+	jwt_builder_free(builder);
+	jwks_free(keys);
+
+	return token;
+}
+
+/* A callback that uses the set its checker holds for the verify. */
+static int set_cb(jwt_t *jwt, jwt_config_t *config)
+{
+	jwk_set_t *set = config->ctx;
+
+	(void)jwt;
+
+	jwks_refresh_fromurl(set);
+	jwks_load_fromurl_cached(set, "http://127.0.0.1:1/other", NULL);
+
+	return 0;
+}
+
+static int verify(jwt_checker_t *checker, const char *token)
+{
+	int ret = jwt_checker_verify(checker, token);
+
+	jwt_checker_error_clear(checker);
+
+	return ret;
+}
+
 static char *make_url(void)
 {
 	char *url = NULL;
@@ -289,11 +418,182 @@ START_TEST(test_scheme_guard)
 }
 END_TEST
 
+/* The refresher fetches a rotated key set on a kid miss while verifies go
+ * on with the old keys, never waiting on the (slow) origin. */
+START_TEST(test_background_rotate)
+{
+	jwks_url_config_t cfg = { .verify = 0, .ttl = 0, .cooldown = 0 };
+	jwt_checker_t *checker;
+	char *url = make_url(), *tok_a, *tok_b;
+	jwk_set_t *set;
+	long long t;
+
+	srv.max_age = 300;
+	serve(JWKS_A, "a", 0);
+	req_reset();
+
+	tok_a = make_token(JWKS_A, "a");
+	tok_b = make_token(JWKS_B, "b");
+
+	set = jwks_load_fromurl_cached(NULL, url, &cfg);
+	ck_assert_int_eq(req_count(), 1);
+	ck_assert_int_eq(jwks_refresh_start(set), 0);
+	ck_assert_int_eq(jwks_refresh_start(set), 0);
+
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(checker);
+	ck_assert_int_eq(jwt_checker_setkeyring(checker, set,
+						JWT_VERIFY_POLICY_ANY), 0);
+	ck_assert_int_eq(verify(checker, tok_a), 0);
+	ck_assert_int_ne(jwt_checker_verify(checker, tok_b), 0);
+	ck_assert_int_eq(jwt_checker_error_code(checker), JWT_ERR_KID_UNKNOWN);
+	jwt_checker_error_clear(checker);
+
+	/* The keys rotate at an origin that takes 2s to answer. A kid miss
+	 * only wakes the refresher. */
+	serve(JWKS_B, "b", 2000);
+	t = mono_ms();
+	jwks_refresh_fromurl(set);
+	ck_assert_int_lt(mono_ms() - t, 1000);
+	wait_requests(2);
+
+	/* In flight: the old keys are still served, without waiting. */
+	t = mono_ms();
+	ck_assert_int_eq(verify(checker, tok_a), 0);
+	ck_assert_int_lt(mono_ms() - t, 1000);
+
+	/* Then the new ones replace them. */
+	t = mono_ms() + 10000;
+	while (verify(checker, tok_b) && mono_ms() < t)
+		usleep(10000);
+	ck_assert_int_eq(verify(checker, tok_b), 0);
+	ck_assert_int_ne(verify(checker, tok_a), 0);
+	/* Not a URL change while it runs, even from a callback during a
+	 * verify. */
+	ck_assert_int_eq(jwt_checker_setcb(checker, set_cb, set), 0);
+	ck_assert_int_eq(verify(checker, tok_b), 0);
+	jwks_refresh_stop(set);
+	ck_assert_int_ne(jwks_error(set), 0);
+
+	jwt_checker_free(checker);
+	jwks_free(set);
+	serve(NULL, NULL, 0);
+	free(tok_a);
+	free(tok_b);
+	free(url);
+}
+END_TEST
+
+/* Renewal comes ahead of expiry, failures back off, and the keys are kept
+ * all along. */
+START_TEST(test_background_backoff)
+{
+	jwks_url_config_t cfg = { .verify = 0, .ttl = 0, .cooldown = 0 };
+	char *url = make_url();
+	jwk_set_t *set;
+
+	/* Not a URL source. */
+	set = jwks_create(NULL);
+	ck_assert_int_ne(jwks_refresh_start(set), 0);
+	ck_assert_int_ne(jwks_error(set), 0);
+	jwks_free(set);
+
+	srv.max_age = 4;
+	serve_fail(0);
+	req_reset();
+
+	set = jwks_load_fromurl_cached(NULL, url, &cfg);
+	ck_assert_int_eq(req_count(), 1);
+	ck_assert_int_eq(jwks_refresh_start(set), 0);
+
+	/* The origin fails from here on. */
+	serve_fail(1);
+	wait_requests(4);
+	jwks_refresh_stop(set);
+
+	/* Renewed at four fifths of the 4s, so before the keys went stale. */
+	ck_assert_int_ge(req_gap(1), 2000);
+	ck_assert_int_lt(req_gap(1), 4000);
+
+	/* Then retried after 50-100% of 1s, and of 2s. A retry is never
+	 * early, however late a loaded machine runs it. */
+	ck_assert_int_ge(req_gap(2), 500);
+	ck_assert_int_ge(req_gap(3), 1000);
+
+	ck_assert_int_ne(jwks_error(set), 0);
+	ck_assert_int_gt(jwks_item_count(set), 0);
+	serve_fail(0);
+
+	jwks_free(set);
+	free(url);
+}
+END_TEST
+
+/* Keys that are always stale are renewed no more often than the cooldown. */
+START_TEST(test_background_floor)
+{
+	jwks_url_config_t cfg = { .verify = 0, .ttl = 0, .cooldown = 2 };
+	char *url = make_url();
+	jwk_set_t *set;
+
+	srv.max_age = 0;
+	req_reset();
+
+	set = jwks_load_fromurl_cached(NULL, url, &cfg);
+	ck_assert_int_eq(req_count(), 1);
+	ck_assert_int_eq(jwks_refresh_start(set), 0);
+
+	/* Renewed at once, being stale, then not again for 2s where it
+	 * would otherwise have been after 1s. */
+	wait_requests(3);
+	jwks_refresh_stop(set);
+	ck_assert_int_lt(req_gap(1), 2000);
+	ck_assert_int_ge(req_gap(2), 2000);
+	ck_assert_int_gt(jwks_item_count(set), 0);
+
+	jwks_free(set);
+	free(url);
+}
+END_TEST
+
+/* Freeing the set stops its refresher without waiting out a slow fetch. */
+START_TEST(test_background_stop)
+{
+	jwks_url_config_t cfg = { .verify = 0, .ttl = 0, .cooldown = 0 };
+	char *url = make_url();
+	jwk_set_t *set;
+	long long t;
+
+	srv.max_age = 300;
+	req_reset();
+
+	set = jwks_load_fromurl_cached(NULL, url, &cfg);
+	ck_assert_int_eq(jwks_refresh_start(set), 0);
+
+	serve(NULL, NULL, 5000);
+	jwks_refresh_fromurl(set);
+	wait_requests(2);
+
+	t = mono_ms();
+	jwks_free(set);
+	ck_assert_int_lt(mono_ms() - t, 3000);
+
+	serve(NULL, NULL, 0);
+	free(url);
+}
+END_TEST
+
 #else  /* !HAVE_LIBCURL */
 
 START_TEST(test_no_libcurl)
 {
+	jwk_set_t *set;
+
 	ck_assert_ptr_null(jwks_load_fromurl_cached(NULL, "https://x/", NULL));
+
+	set = jwks_create(NULL);
+	ck_assert_int_ne(jwks_refresh_start(set), 0);
+	jwks_free(set);
 }
 END_TEST
 
@@ -313,6 +613,10 @@ static Suite *libjwt_suite(const char *title)
 	tcase_add_test(tc_core, test_cooldown);
 	tcase_add_test(tc_core, test_refresh_keeps_keys_on_error);
 	tcase_add_test(tc_core, test_scheme_guard);
+	tcase_add_test(tc_core, test_background_rotate);
+	tcase_add_test(tc_core, test_background_backoff);
+	tcase_add_test(tc_core, test_background_floor);
+	tcase_add_test(tc_core, test_background_stop);
 #else
 	tcase_add_test(tc_core, test_no_libcurl);
 #endif
@@ -329,6 +633,9 @@ int main(void)
 	SRunner *sr;
 
 #ifdef HAVE_LIBCURL
+	/* A client that gave up on a slow answer closes before it is sent. */
+	signal(SIGPIPE, SIG_IGN);
+
 	if (server_start() != 0) {
 		fprintf(stderr, "could not start the test HTTP server\n");
 		return EXIT_FAILURE;
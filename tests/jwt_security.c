@@ -746,6 +746,114 @@ START_TEST(test_jwt_alg_none_empty)
 }
 END_TEST
 
+/* Standard-base64 characters in a segment are rejected, not translated */
+START_TEST(test_jwt_std_alphabet_segment)
+{
+	jwt_checker_auto_t *checker = NULL;
+	int ret;
+
+	SET_OPS();
+
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(checker);
+
+	/* {"alg":"none"} . {} with a trailing '+' . (empty sig) */
+	ret = jwt_checker_verify(checker,
+		"eyJhbGciOiJub25lIn0.e30+.");
+	ck_assert_int_ne(ret, 0);
+
+	/* Literal '=' padding is not base64url either */
+	ret = jwt_checker_verify(checker,
+		"eyJhbGciOiJub25lIn0=.e30.");
+	ck_assert_int_ne(ret, 0);
+}
+END_TEST
+
+/* A claim set larger than the parser's stack staging buffer */
+START_TEST(test_jwt_large_payload)
+{
+	jwt_builder_auto_t *builder = NULL;
+	jwt_checker_auto_t *checker = NULL;
+	char *big = NULL;
+	char *out = NULL;
+	jwt_value_t jval;
+	int ret;
+
+	SET_OPS();
+
+	big = malloc(8192);
+	ck_assert_ptr_nonnull(big);
+	memset(big, 'x', 8191);
+	big[8191] = '\0';
+
+	builder = jwt_builder_new();
+	ck_assert_ptr_nonnull(builder);
+
+	jwt_set_SET_STR(&jval, "big", big);
+	ck_assert_int_eq(jwt_builder_claim_set(builder, &jval),
+			 JWT_VALUE_ERR_NONE);
+
+	out = jwt_builder_generate(builder);
+	ck_assert_ptr_nonnull(out);
+
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(checker);
+
+	ret = jwt_checker_verify(checker, out);
+	ck_assert_int_eq(ret, 0);
+
+	free(out);
+	free(big);
+}
+END_TEST
+
+/* Every payload length over a few vector blocks round-trips, and a
+ * standard-base64 character deep in a long segment is still rejected */
+START_TEST(test_jwt_payload_lengths)
+{
+	jwt_checker_auto_t *checker = NULL;
+	char big[256];
+	int len, ret;
+
+	SET_OPS();
+
+	checker = jwt_checker_new();
+	ck_assert_ptr_nonnull(checker);
+
+	for (len = 0; len < (int)sizeof(big) - 1; len++) {
+		jwt_builder_auto_t *builder = NULL;
+		jwt_value_t jval;
+		char *out, *pay;
+		size_t pay_len;
+
+		memset(big, 'a' + (len % 26), len);
+		big[len] = '\0';
+
+		builder = jwt_builder_new();
+		ck_assert_ptr_nonnull(builder);
+
+		jwt_set_SET_STR(&jval, "v", big);
+		ck_assert_int_eq(jwt_builder_claim_set(builder, &jval),
+				 JWT_VALUE_ERR_NONE);
+
+		out = jwt_builder_generate(builder);
+		ck_assert_ptr_nonnull(out);
+
+		ret = jwt_checker_verify(checker, out);
+		ck_assert_int_eq(ret, 0);
+
+		pay = strchr(out, '.') + 1;
+		pay_len = strchr(pay, '.') - pay;
+
+		pay[pay_len / 2] = "+/="[len % 3];
+		ret = jwt_checker_verify(checker, out);
+		ck_assert_int_ne(ret, 0);
+
+		free(out);
+	}
+}
+END_TEST
+
 /*
  * === JWKS load_strn boundary tests ===
  */
@@ -1295,8 +1403,17 @@ END_TEST
 /* @rfc{8725,2.4} Duplicate members in the token header or payload must be
  * rejected so a peer that picks a different occurrence cannot disagree with us
  * about a claim/header. The Jansson backend rejects duplicates; json-c cannot
- * (it keeps the last occurrence), a documented limitation, so there the token
- * parses. */
+ * (it keeps the last occurrence), a documented limitation, so there a header
+ * with one parses. The payload is checked by the claims scanner, which
+ * rejects duplicates with either backend. */
+/* Sees the jwt_t, so the claims are decoded into a tree, not scanned. */
+static int dup_members_cb(jwt_t *jwt, jwt_config_t *config)
+{
+	(void)jwt;
+	(void)config;
+	return 0;
+}
+
 START_TEST(test_dup_members_rejected)
 {
 	jwt_checker_auto_t *checker = NULL;
@@ -1314,21 +1431,19 @@ START_TEST(test_dup_members_rejected)
 	ck_assert_ptr_nonnull(checker);
 	ck_assert_int_eq(jwt_checker_setkey(checker, JWT_ALG_NONE, NULL), 0);
 
+	/* Refused with either JSON backend. */
 	ret = jwt_checker_verify(checker, dup_hdr);
-#ifdef HAVE_JSON_C
-	/* json-c keeps the last occurrence; the token still parses/verifies. */
-	ck_assert_int_eq(ret, 0);
-#else
 	ck_assert_int_ne(ret, 0);
-#endif
 	jwt_checker_error_clear(checker);
 
 	ret = jwt_checker_verify(checker, dup_pay);
-#ifdef HAVE_JSON_C
-	ck_assert_int_eq(ret, 0);
-#else
 	ck_assert_int_ne(ret, 0);
-#endif
+	jwt_checker_error_clear(checker);
+
+	/* The same, with the claims decoded into a tree. */
+	ck_assert_int_eq(jwt_checker_setcb(checker, dup_members_cb, NULL), 0);
+	ret = jwt_checker_verify(checker, dup_pay);
+	ck_assert_int_ne(ret, 0);
 }
 END_TEST
 
@@ -1440,6 +1555,9 @@ static Suite *libjwt_suite(const char *title)
 	tcase_add_loop_test(tc_jwt_parse, test_jwt_many_dots, 0, i);
 	tcase_add_loop_test(tc_jwt_parse, test_jwt_invalid_base64_payload, 0, i);
 	tcase_add_loop_test(tc_jwt_parse, test_jwt_alg_none_empty, 0, i);
+	tcase_add_loop_test(tc_jwt_parse, test_jwt_std_alphabet_segment, 0, i);
+	tcase_add_loop_test(tc_jwt_parse, test_jwt_large_payload, 0, i);
+	tcase_add_loop_test(tc_jwt_parse, test_jwt_payload_lengths, 0, i);
 
 	tcase_set_timeout(tc_jwt_parse, 30);
 	suite_add_tcase(s, tc_jwt_parse);
@@ -308,6 +308,63 @@ START_TEST(test_find_bythumbprint)
 }
 END_TEST
 
+/* The thumbprint index follows keys being added and removed after it was
+ * first used. */
+START_TEST(test_find_bythumbprint_update)
+{
+	jwk_set_auto_t *set = NULL;
+	char_auto *tp_ec = NULL, *tp_ed = NULL, *tp_rsa = NULL;
+	const jwk_item_t *ec_item;
+	char *p;
+	int r;
+
+	SET_OPS();
+
+	r = asprintf(&p, KEYDIR "/ec_key_prime256v1.json");
+	ck_assert_int_gt(r, 0);
+	set = jwks_load_fromfile(NULL, p);
+	free(p);
+	ck_assert_ptr_nonnull(set);
+
+	ec_item = jwks_item_get(set, 0);
+	tp_ec = jwks_item_thumbprint(ec_item, JWK_THUMBPRINT_SHA256);
+	ck_assert_ptr_nonnull(tp_ec);
+	ck_assert_ptr_eq(jwks_find_bythumbprint(set, JWK_THUMBPRINT_SHA256,
+						tp_ec), ec_item);
+
+	r = asprintf(&p, KEYDIR "/eddsa_key_ed25519.json");
+	ck_assert_int_gt(r, 0);
+	ck_assert_ptr_nonnull(jwks_load_fromfile(set, p));
+	free(p);
+	r = asprintf(&p, KEYDIR "/rsa_key_2048.json");
+	ck_assert_int_gt(r, 0);
+	ck_assert_ptr_nonnull(jwks_load_fromfile(set, p));
+	free(p);
+	ck_assert(!jwks_error(set));
+
+	tp_ed = jwks_item_thumbprint(jwks_item_get(set, 1), JWK_THUMBPRINT_SHA256);
+	tp_rsa = jwks_item_thumbprint(jwks_item_get(set, 2),
+				      JWK_THUMBPRINT_SHA512);
+	ck_assert_ptr_nonnull(tp_ed);
+	ck_assert_ptr_nonnull(tp_rsa);
+
+	ck_assert_ptr_eq(jwks_find_bythumbprint(set, JWK_THUMBPRINT_SHA256,
+						tp_ed), jwks_item_get(set, 1));
+	ck_assert_ptr_eq(jwks_find_bythumbprint(set, JWK_THUMBPRINT_SHA512,
+						tp_rsa), jwks_item_get(set, 2));
+
+	ck_assert(jwks_item_free(set, 0));
+	ck_assert_ptr_null(jwks_find_bythumbprint(set, JWK_THUMBPRINT_SHA256,
+						  tp_ec));
+	ck_assert_ptr_eq(jwks_find_bythumbprint(set, JWK_THUMBPRINT_SHA256,
+						tp_ed), jwks_item_get(set, 0));
+
+	jwks_item_free_all(set);
+	ck_assert_ptr_null(jwks_find_bythumbprint(set, JWK_THUMBPRINT_SHA256,
+						  tp_ed));
+}
+END_TEST
+
 #ifdef LIBJWT_HAVE_ML_DSA
 /* Known SHA-256 thumbprints for the ML-DSA (AKP) fixtures. The digest is over
  * the public members ("alg","kty","pub") and is backend independent. */
@@ -369,6 +426,7 @@ static Suite *libjwt_suite(const char *title)
 	tcase_add_loop_test(tc_core, test_hash_sizes, 0, i);
 	tcase_add_loop_test(tc_core, test_errors, 0, i);
 	tcase_add_loop_test(tc_core, test_find_bythumbprint, 0, i);
+	tcase_add_loop_test(tc_core, test_find_bythumbprint_update, 0, i);
 #ifdef LIBJWT_HAVE_ML_DSA
 	tcase_add_loop_test(tc_core, test_akp_values, 0, i);
 #endif
@@ -144,6 +144,76 @@ START_TEST(test_allowlist)
 }
 END_TEST
 
+static int cb_accept(jwt_t *jwt, jwt_config_t *config)
+{
+	(void)jwt;
+	(void)config;
+
+	return 0;
+}
+
+/* The header is checked before the payload is decoded: a token with a payload
+ * that is not even base64url fails on its header when the header is what
+ * disqualifies it, and only otherwise on the payload. */
+START_TEST(test_header_first)
+{
+	jwk_set_t *ks;
+	const jwk_item_t *ec;
+	char_auto *tok = NULL;
+	char *bad, *dot1, *dot2;
+	jwt_alg_t no_set[] = { JWT_ALG_RS256, JWT_ALG_RS512 };
+	jwt_checker_auto_t *c1 = NULL, *c2 = NULL, *c3 = NULL, *c4 = NULL;
+
+	SET_OPS();
+	ks = load_ec();
+	ec = jwks_item_get(ks, 0);
+
+	tok = gen(ec, NULL, JWT_FORMAT_COMPACT);
+	ck_assert_ptr_nonnull(tok);
+
+	/* header "." "!!!!" "." signature */
+	bad = malloc(strlen(tok) + 5);
+	ck_assert_ptr_nonnull(bad);
+	dot1 = strchr(tok, '.');
+	dot2 = strchr(dot1 + 1, '.');
+	memcpy(bad, tok, dot1 - tok + 1);
+	strcpy(bad + (dot1 - tok + 1), "!!!!");
+	strcat(bad, dot2);
+
+	/* Rejected by the allowlist. */
+	c1 = jwt_checker_new();
+	ck_assert_int_eq(jwt_checker_setkey(c1, JWT_ALG_ES256, ec), 0);
+	ck_assert_int_eq(jwt_checker_setalgs(c1, no_set, 2), 0);
+	ck_assert_int_ne(jwt_checker_verify(c1, bad), 0);
+	ck_assert_str_eq(jwt_checker_error_msg(c1),
+		"Token rejected by \"typ\" or algorithm policy");
+
+	/* Rejected for want of a key. */
+	c2 = jwt_checker_new();
+	ck_assert_int_ne(jwt_checker_verify(c2, bad), 0);
+	ck_assert_str_eq(jwt_checker_error_msg(c2),
+		"JWT has signature, but no key was given");
+
+	/* Nothing wrong with the header: the payload is decoded and fails. */
+	c3 = jwt_checker_new();
+	ck_assert_int_eq(jwt_checker_setkey(c3, JWT_ALG_ES256, ec), 0);
+	ck_assert_int_ne(jwt_checker_verify(c3, bad), 0);
+	ck_assert_str_eq(jwt_checker_error_msg(c3), "Error parsing payload");
+
+	/* A callback sees the claims, so they are decoded before it runs. */
+	c4 = jwt_checker_new();
+	ck_assert_int_eq(jwt_checker_setcb(c4, cb_accept, NULL), 0);
+	ck_assert_int_ne(jwt_checker_verify(c4, bad), 0);
+	ck_assert_str_eq(jwt_checker_error_msg(c4), "Error parsing payload");
+
+	/* The intact token still verifies on a reused checker. */
+	ck_assert_int_eq(jwt_checker_verify(c3, tok), 0);
+
+	free(bad);
+	jwks_free(ks);
+}
+END_TEST
+
 static Suite *libjwt_suite(const char *title)
 {
 	Suite *s;
@@ -155,6 +225,7 @@ static Suite *libjwt_suite(const char *title)
 
 	tcase_add_loop_test(tc_core, test_typ, 0, i);
 	tcase_add_loop_test(tc_core, test_allowlist, 0, i);
+	tcase_add_loop_test(tc_core, test_header_first, 0, i);
 
 	tcase_set_timeout(tc_core, 30);
 	suite_add_tcase(s, tc_core);
@@ -0,0 +1,1061 @@
+/* Copyright (C) 2026 maClara, LLC <info@maclara-llc.com>
+   This file is part of the JWT C Library
+
+   This Source Code Form is subject to the terms of the Mozilla Public
+   License, v. 2.0. If a copy of the MPL was not distributed with this
+   file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <jwt.h>
+#include <getopt.h>
+#include <string.h>
+#include <time.h>
+#include <libgen.h>
+#include <pthread.h>
+
+#include "jwt-util.h"
+
+#define DEFAULT_ITERATIONS	1000
+#define MAX_THREADS		256
+#define MAX_BACKENDS		8
+#define MAX_CASES		256
+
+/* The JSON library is chosen when LibJWT is built; CMake tells us which. */
+#ifndef JWT_BENCH_JSON
+#define JWT_BENCH_JSON		"unknown"
+#endif
+
+static const char * const all_backends[] = { "openssl", "gnutls", "mbedtls" };
+#define N_ALL_BACKENDS (sizeof(all_backends) / sizeof(all_backends[0]))
+
+/* How to generate a key for each algorithm we can measure. */
+static const struct {
+	jwt_alg_t alg;
+	jwk_key_type_t kty;
+	const char *param;
+} bench_keys[] = {
+	{ JWT_ALG_HS256,  JWK_KEY_TYPE_OCT, "256" },
+	{ JWT_ALG_HS384,  JWK_KEY_TYPE_OCT, "384" },
+	{ JWT_ALG_HS512,  JWK_KEY_TYPE_OCT, "512" },
+	{ JWT_ALG_RS256,  JWK_KEY_TYPE_RSA, "2048" },
+	{ JWT_ALG_RS384,  JWK_KEY_TYPE_RSA, "2048" },
+	{ JWT_ALG_RS512,  JWK_KEY_TYPE_RSA, "2048" },
+	{ JWT_ALG_PS256,  JWK_KEY_TYPE_RSA, "2048" },
+	{ JWT_ALG_PS384,  JWK_KEY_TYPE_RSA, "2048" },
+	{ JWT_ALG_PS512,  JWK_KEY_TYPE_RSA, "2048" },
+	{ JWT_ALG_ES256,  JWK_KEY_TYPE_EC,  "P-256" },
+	{ JWT_ALG_ES256K, JWK_KEY_TYPE_EC,  "secp256k1" },
+	{ JWT_ALG_ES384,  JWK_KEY_TYPE_EC,  "P-384" },
+	{ JWT_ALG_ES512,  JWK_KEY_TYPE_EC,  "P-521" },
+	{ JWT_ALG_EDDSA,  JWK_KEY_TYPE_OKP, "Ed25519" },
+	{ JWT_ALG_ML_DSA_44, JWK_KEY_TYPE_AKP, NULL },
+	{ JWT_ALG_ML_DSA_65, JWK_KEY_TYPE_AKP, NULL },
+	{ JWT_ALG_ML_DSA_87, JWK_KEY_TYPE_AKP, NULL },
+};
+#define N_BENCH_KEYS (sizeof(bench_keys) / sizeof(bench_keys[0]))
+
+static const jwt_alg_t default_algs[] = {
+	JWT_ALG_RS256, JWT_ALG_PS256, JWT_ALG_ES256,
+};
+
+/* One thing to measure: a JWS algorithm, or a JWE "alg" and "enc" pair
+ * (@alg is JWT_ALG_NONE). @named is set when it was asked for by name, so
+ * a backend that cannot do it is an error rather than a skip. */
+struct bench_case {
+	jwt_alg_t alg;
+	jwe_key_alg_t kalg;
+	jwe_enc_t enc;
+	int named;
+};
+
+enum bench_op {
+	BENCH_SIGN,
+	BENCH_VERIFY,
+	BENCH_ENCRYPT,
+	BENCH_DECRYPT,
+	BENCH_REJECT,
+	BENCH_LIMITED,
+};
+
+static const char * const op_names[] = {
+	"sign", "verify", "encrypt", "decrypt", "reject", "limited",
+};
+
+enum bench_format {
+	FORMAT_TEXT,
+	FORMAT_CSV,
+	FORMAT_JSON,
+};
+
+static struct {
+	unsigned long iterations;
+	unsigned int threads;
+	size_t size;
+	unsigned int keyring;
+	size_t reject;
+	enum bench_format format;
+	FILE *out;
+} opts = {
+	.iterations = DEFAULT_ITERATIONS,
+	.threads = 1,
+	.format = FORMAT_TEXT,
+};
+
+_Noreturn static void usage(const char *error, int exit_state)
+{
+	if (error)
+		fprintf(stderr, "ERROR: %s\n\n", error);
+
+	fprintf(stderr, "\
+Usage: %1$s [OPTIONS] [CASE ...]\n\
+\n\
+Measure the time LibJWT takes to sign, verify, encrypt and decrypt tokens\n\
+\n\
+  -h, --help            This help information\n\
+  -l, --list            List the algorithms that can be measured and exit\n\
+  -b, --backend=NAME    Crypto backend to measure, or \"all\" (repeatable;\n\
+                        default: the active one)\n\
+  -n, --iterations=N    Operations per measurement (default %2$d)\n\
+  -t, --threads=N       Run each measurement in N threads at once (default 1)\n\
+  -s, --size=N          Pad each payload to about N octets (default 0)\n\
+  -k, --keyring=N       Verify JWS against a keyring of N keys (default 0)\n\
+  -r, --reject=N        Also turn down a broken token of about N octets,\n\
+                        without and with input limits (default 0: no)\n\
+  -f, --format=FMT      Output as \"text\" (default), \"csv\" or \"json\"\n\
+  -o, --output=FILE     Write the results to FILE instead of stdout\n\
+\n\
+A CASE is a JWS algorithm (e.g. ES256), a JWE \"ALG/ENC\" pair (e.g.\n\
+RSA-OAEP-256/A256GCM), a JWE ALG alone for every ENC, or one of \"jws\",\n\
+\"jwe\" and \"all\". The default is RS256 PS256 ES256.\n\
+\n\
+For each CASE a key is generated with the backend being measured. The\n\
+same key then signs (or encrypts) N tokens and verifies (or decrypts) one\n\
+token N times, after one untimed operation of each kind. Every operation\n\
+is timed: the throughput and the mean, median, 90th and 99th percentile\n\
+latency are printed, in operations per second and microseconds.\n\
+\n\
+With --threads, every thread has its own builder and checker for the same\n\
+key and does all N operations; the throughput counts the operations of all\n\
+threads over the wall time.\n\
+\n\
+With --keyring, JWS tokens are made in the JSON serialization without a\n\
+\"kid\" and verified against N keys of the same kind, the signing key last,\n\
+so the checker has to find the key.\n\
+\n\
+With --reject, a token of about N octets is made like the others, its\n\
+signature (or tag) broken, and checked --iterations times as \"reject\",\n\
+then as \"limited\" with the checker limited to twice the size of a good\n\
+token. Without limits, it is decoded in full before it is turned down.\n\
+\n\
+The JSON library is fixed when LibJWT is built; it is in every record,\n\
+so the output of two builds can be compared.\n",
+		get_progname(), DEFAULT_ITERATIONS);
+
+	exit(exit_state);
+}
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static const char *case_alg_str(const struct bench_case *bc)
+{
+	return bc->alg != JWT_ALG_NONE ? jwt_alg_str(bc->alg) :
+		jwe_alg_str(bc->kalg);
+}
+
+static const char *case_enc_str(const struct bench_case *bc)
+{
+	return bc->alg != JWT_ALG_NONE ? "" : jwe_enc_str(bc->enc);
+}
+
+/* The key to generate for a JWE case: the size "dir" and the AES key
+ * wraps need, an RSA key for RSA-OAEP, P-256 for ECDH-ES, and an
+ * octet password for PBES2. */
+static void jwe_key_spec(jwe_key_alg_t alg, jwe_enc_t enc,
+			 jwk_key_type_t *kty, const char **param)
+{
+	static const char * const enc_bits[JWE_ENC_INVAL] = {
+		[JWE_ENC_A128GCM] = "128",
+		[JWE_ENC_A192GCM] = "192",
+		[JWE_ENC_A256GCM] = "256",
+		[JWE_ENC_A128CBC_HS256] = "256",
+		[JWE_ENC_A192CBC_HS384] = "384",
+		[JWE_ENC_A256CBC_HS512] = "512",
+	};
+
+	*kty = JWK_KEY_TYPE_OCT;
+
+	switch (alg) {
+	case JWE_ALG_DIR:
+		*param = enc_bits[enc];
+		break;
+	case JWE_ALG_A128KW:
+	case JWE_ALG_A128GCMKW:
+		*param = "128";
+		break;
+	case JWE_ALG_A192KW:
+	case JWE_ALG_A192GCMKW:
+		*param = "192";
+		break;
+	case JWE_ALG_RSA_OAEP:
+	case JWE_ALG_RSA_OAEP_256:
+		*kty = JWK_KEY_TYPE_RSA;
+		*param = "2048";
+		break;
+	case JWE_ALG_ECDH_ES:
+	case JWE_ALG_ECDH_ES_A128KW:
+	case JWE_ALG_ECDH_ES_A192KW:
+	case JWE_ALG_ECDH_ES_A256KW:
+		*kty = JWK_KEY_TYPE_EC;
+		*param = "P-256";
+		break;
+	default:
+		*param = "256";
+		break;
+	}
+}
+
+/* Generate the key for @bc, and for --keyring the decoys ahead of it, with
+ * the active backend. Returns the keyring, the key last. */
+static jwk_set_t *bench_keygen(const struct bench_case *bc, unsigned int n)
+{
+	jwk_set_t *jwk_set = NULL;
+	jwk_key_type_t kty = JWK_KEY_TYPE_NONE;
+	const char *param = NULL;
+	unsigned int i;
+	size_t k;
+
+	if (bc->alg != JWT_ALG_NONE) {
+		for (k = 0; k < N_BENCH_KEYS; k++) {
+			if (bench_keys[k].alg == bc->alg) {
+				kty = bench_keys[k].kty;
+				param = bench_keys[k].param;
+			}
+		}
+	} else {
+		jwe_key_spec(bc->kalg, bc->enc, &kty, &param);
+	}
+
+	for (i = 0; i < (n ? n : 1); i++) {
+		jwk_set = jwks_generate(jwk_set, kty, param, bc->alg,
+					bc->alg != JWT_ALG_NONE ? JWK_KEY_NONE :
+					JWK_KEY_USE_ENC);
+		if (jwk_set == NULL)
+			return NULL;
+	}
+
+	return jwk_set;
+}
+
+/* Shared by every thread of a measurement; read only. */
+struct bench_ctx {
+	const struct bench_case *bc;
+	const jwk_item_t *item;
+	const jwk_set_t *ring;		/* --keyring, or NULL		*/
+	enum bench_op op;
+	const char *token;		/* For BENCH_VERIFY/DECRYPT	*/
+	const char *pad;		/* "pad" claim, or NULL		*/
+	const unsigned char *plain;	/* JWE plaintext		*/
+	size_t plain_len;
+	jwt_limits_t limits;		/* For BENCH_LIMITED		*/
+};
+
+/* One thread's builder or checker. */
+struct bench_objs {
+	jwt_builder_t *builder;
+	jwt_checker_t *checker;
+	jwe_builder_t *jwe_builder;
+	jwe_checker_t *jwe_checker;
+};
+
+static void bench_objs_free(struct bench_objs *o)
+{
+	jwt_builder_free(o->builder);
+	jwt_checker_free(o->checker);
+	jwe_builder_free(o->jwe_builder);
+	jwe_checker_free(o->jwe_checker);
+	memset(o, 0, sizeof(*o));
+}
+
+static int bench_setup(const struct bench_ctx *ctx, struct bench_objs *o)
+{
+	const struct bench_case *bc = ctx->bc;
+	enum bench_op op = ctx->op;
+	jwt_value_t jval;
+
+	memset(o, 0, sizeof(*o));
+
+	/* A token to turn down gets the checker a good one would. */
+	if (op == BENCH_REJECT || op == BENCH_LIMITED)
+		op = bc->alg != JWT_ALG_NONE ? BENCH_VERIFY : BENCH_DECRYPT;
+
+	switch (op) {
+	case BENCH_SIGN:
+		o->builder = jwt_builder_new();
+		if (o->builder == NULL ||
+		    jwt_builder_setkey(o->builder, bc->alg, ctx->item))
+			return 1;
+		if (ctx->ring != NULL &&
+		    jwt_builder_set_format(o->builder, JWT_FORMAT_JSON_GENERAL))
+			return 1;
+		if (ctx->pad != NULL) {
+			jwt_set_SET_STR(&jval, "pad", ctx->pad);
+			if (jwt_builder_claim_set(o->builder, &jval))
+				return 1;
+		}
+		return 0;
+
+	case BENCH_VERIFY:
+		o->checker = jwt_checker_new();
+		if (o->checker == NULL)
+			return 1;
+		if (ctx->ring != NULL) {
+			if (jwt_checker_setkeyring(o->checker, ctx->ring,
+						   JWT_VERIFY_POLICY_ANY))
+				return 1;
+		} else if (jwt_checker_setkey(o->checker, bc->alg, ctx->item)) {
+			return 1;
+		}
+		return ctx->op == BENCH_LIMITED &&
+			jwt_checker_setlimits(o->checker, &ctx->limits);
+
+	case BENCH_ENCRYPT:
+		o->jwe_builder = jwe_builder_new();
+		return o->jwe_builder == NULL ||
+			jwe_builder_setkey(o->jwe_builder, bc->kalg, bc->enc,
+					   ctx->item);
+
+	case BENCH_DECRYPT:
+		o->jwe_checker = jwe_checker_new();
+		if (o->jwe_checker == NULL ||
+		    jwe_checker_setkey(o->jwe_checker, bc->kalg, bc->enc,
+				       ctx->item))
+			return 1;
+		return ctx->op == BENCH_LIMITED &&
+			jwe_checker_setlimits(o->jwe_checker, &ctx->limits);
+
+	default:
+		break;
+	}
+
+	return 1;
+}
+
+static const char *bench_error(const struct bench_objs *o)
+{
+	if (o->builder)
+		return jwt_builder_error_msg(o->builder);
+	if (o->checker)
+		return jwt_checker_error_msg(o->checker);
+	if (o->jwe_builder)
+		return jwe_builder_error_msg(o->jwe_builder);
+	if (o->jwe_checker)
+		return jwe_checker_error_msg(o->jwe_checker);
+
+	return "Could not allocate builder/checker";
+}
+
+/* Run one operation. @out, if given, receives what it made. */
+static int bench_op(const struct bench_ctx *ctx, struct bench_objs *o,
+		    char **out)
+{
+	char *res = NULL;
+
+	switch (ctx->op) {
+	case BENCH_SIGN:
+		res = jwt_builder_generate(o->builder);
+		break;
+	case BENCH_VERIFY:
+		return jwt_checker_verify(o->checker, ctx->token);
+	case BENCH_ENCRYPT:
+		res = jwe_builder_generate(o->jwe_builder, ctx->plain,
+					   ctx->plain_len);
+		break;
+	case BENCH_DECRYPT:
+		res = (char *)jwe_checker_decrypt(o->jwe_checker, ctx->token,
+						  NULL);
+		break;
+	case BENCH_REJECT:
+	case BENCH_LIMITED:
+		/* Done when the token is turned down; cleared so the next
+		 * one writes its error again. */
+		if (o->checker != NULL) {
+			if (!jwt_checker_verify(o->checker, ctx->token))
+				return 1;
+			jwt_checker_error_clear(o->checker);
+			return 0;
+		}
+		res = (char *)jwe_checker_decrypt(o->jwe_checker, ctx->token,
+						  NULL);
+		if (res != NULL) {
+			free(res);
+			return 1;
+		}
+		jwe_checker_error_clear(o->jwe_checker);
+		return 0;
+	}
+
+	if (res == NULL)
+		return 1;
+
+	if (out)
+		*out = res;
+	else
+		free(res);
+
+	return 0;
+}
+
+struct bench_arg {
+	const struct bench_ctx *ctx;
+	unsigned long iterations;
+	double *lat;		/* Microseconds per operation		*/
+	int err;
+};
+
+static void *bench_loop(void *data)
+{
+	struct bench_arg *arg = data;
+	struct bench_objs o;
+	unsigned long i;
+	double start;
+
+	arg->err = 1;
+
+	if (bench_setup(arg->ctx, &o)) {
+		fprintf(stderr, "%s: %s\n", case_alg_str(arg->ctx->bc),
+			bench_error(&o));
+		bench_objs_free(&o);
+		return NULL;
+	}
+
+	for (i = 0; i < arg->iterations; i++) {
+		start = now_us();
+		if (bench_op(arg->ctx, &o, NULL)) {
+			fprintf(stderr, "%s: %s\n", case_alg_str(arg->ctx->bc),
+				bench_error(&o));
+			bench_objs_free(&o);
+			return NULL;
+		}
+		arg->lat[i] = now_us() - start;
+	}
+
+	bench_objs_free(&o);
+	arg->err = 0;
+
+	return NULL;
+}
+
+struct bench_result {
+	double ops;		/* Per second, all threads		*/
+	double mean, p50, p90, p99, max;
+};
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* The @pct percentile of the @n sorted @lat (nearest rank). */
+static double percentile(const double *lat, size_t n, double pct)
+{
+	size_t rank = (size_t)(pct / 100.0 * n + 0.5);
+
+	if (rank == 0)
+		rank = 1;
+	if (rank > n)
+		rank = n;
+
+	return lat[rank - 1];
+}
+
+/* Run @ctx on --threads concurrent loops. */
+static int bench_run(const struct bench_ctx *ctx, struct bench_result *res)
+{
+	struct bench_arg args[MAX_THREADS];
+	pthread_t tids[MAX_THREADS];
+	size_t n = opts.iterations * opts.threads, i;
+	double start, elapsed, sum = 0;
+	unsigned int t;
+	double *lat;
+	int err = 0;
+
+	lat = malloc(n * sizeof(*lat));
+	if (lat == NULL) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+
+	for (t = 0; t < opts.threads; t++) {
+		args[t].ctx = ctx;
+		args[t].iterations = opts.iterations;
+		args[t].lat = &lat[t * opts.iterations];
+	}
+
+	start = now_us();
+
+	if (opts.threads == 1) {
+		bench_loop(&args[0]);
+		err = args[0].err;
+	} else {
+		for (t = 0; t < opts.threads; t++) {
+			if (pthread_create(&tids[t], NULL, bench_loop,
+					   &args[t])) {
+				perror("pthread_create");
+				exit(EXIT_FAILURE);
+			}
+		}
+		for (t = 0; t < opts.threads; t++) {
+			pthread_join(tids[t], NULL);
+			err |= args[t].err;
+		}
+	}
+
+	elapsed = now_us() - start;
+
+	if (!err) {
+		qsort(lat, n, sizeof(*lat), cmp_double);
+		for (i = 0; i < n; i++)
+			sum += lat[i];
+
+		res->ops = n / (elapsed / 1e6);
+		res->mean = sum / n;
+		res->p50 = percentile(lat, n, 50);
+		res->p90 = percentile(lat, n, 90);
+		res->p99 = percentile(lat, n, 99);
+		res->max = lat[n - 1];
+	}
+
+	free(lat);
+
+	return err;
+}
+
+static void print_header(void)
+{
+	switch (opts.format) {
+	case FORMAT_TEXT:
+		fprintf(opts.out, "# json=%s threads=%u size=%zu keyring=%u "
+			"reject=%zu iterations=%lu\n", JWT_BENCH_JSON,
+			opts.threads, opts.size, opts.keyring, opts.reject,
+			opts.iterations);
+		fprintf(opts.out, "%-8s %-7s %-28s %12s %10s %10s %10s %10s\n",
+			"BACKEND", "OP", "ALG", "ops/s", "mean us",
+			"p50 us", "p90 us", "p99 us");
+		break;
+	case FORMAT_CSV:
+		fprintf(opts.out, "backend,json,op,alg,enc,size,threads,"
+			"keyring,iterations,ops_per_sec,mean_us,p50_us,"
+			"p90_us,p99_us,max_us\n");
+		break;
+	case FORMAT_JSON:
+		break;
+	}
+}
+
+static void print_result(const char *backend, const struct bench_case *bc,
+			 enum bench_op op, const struct bench_result *r)
+{
+	const char *alg = case_alg_str(bc), *enc = case_enc_str(bc);
+	unsigned int keyring = bc->alg != JWT_ALG_NONE ? opts.keyring : 0;
+	size_t size = op >= BENCH_REJECT ? opts.reject : opts.size;
+	char name[64];
+
+	switch (opts.format) {
+	case FORMAT_TEXT:
+		snprintf(name, sizeof(name), "%s%s%s", alg, *enc ? "/" : "",
+			 enc);
+		fprintf(opts.out,
+			"%-8s %-7s %-28s %12.1f %10.2f %10.2f %10.2f %10.2f\n",
+			backend, op_names[op], name, r->ops, r->mean, r->p50,
+			r->p90, r->p99);
+		break;
+	case FORMAT_CSV:
+		fprintf(opts.out, "%s,%s,%s,%s,%s,%zu,%u,%u,%lu,%.1f,%.3f,"
+			"%.3f,%.3f,%.3f,%.3f\n", backend, JWT_BENCH_JSON,
+			op_names[op], alg, enc, size, opts.threads,
+			keyring, opts.iterations, r->ops, r->mean, r->p50,
+			r->p90, r->p99, r->max);
+		break;
+	case FORMAT_JSON:
+		/* JSON Lines: one object per measurement. */
+		fprintf(opts.out, "{\"backend\":\"%s\",\"json\":\"%s\","
+			"\"op\":\"%s\",\"alg\":\"%s\",\"enc\":\"%s\","
+			"\"size\":%zu,\"threads\":%u,\"keyring\":%u,"
+			"\"iterations\":%lu,\"ops_per_sec\":%.1f,"
+			"\"mean_us\":%.3f,\"p50_us\":%.3f,\"p90_us\":%.3f,"
+			"\"p99_us\":%.3f,\"max_us\":%.3f}\n", backend,
+			JWT_BENCH_JSON, op_names[op], alg, enc, size,
+			opts.threads, keyring, opts.iterations, r->ops,
+			r->mean, r->p50, r->p90, r->p99, r->max);
+		break;
+	}
+
+	fflush(opts.out);
+}
+
+/* As for a key, a backend that cannot do a pairing (e.g. ECDH-ES with a
+ * CEK longer than one Concat KDF round) only fails a case asked for by
+ * name. */
+static int bench_failed(const char *backend, const struct bench_case *bc,
+			struct bench_objs *o)
+{
+	const char *enc = case_enc_str(bc);
+
+	fprintf(stderr, "%s: %s%s%s: %s%s\n", backend, case_alg_str(bc),
+		enc[0] ? "/" : "", enc, bc->named ? "" : "skipped, ",
+		bench_error(o));
+	bench_objs_free(o);
+
+	return bc->named;
+}
+
+/* Limits a service would set for tokens like @token: twice its size. */
+static void bench_limits(const char *token, jwt_limits_t *lim)
+{
+	size_t len = strlen(token) * 2;
+
+	memset(lim, 0, sizeof(*lim));
+	lim->max_token_len = len;
+	lim->max_header_len = len;
+	lim->max_payload_len = len;
+	lim->max_depth = 16;
+	lim->max_members = 1024;
+	lim->max_string_len = len;
+}
+
+/* Measure turning down a --reject octet token that only fails at the very
+ * end, its signature or tag broken: first with no limits, then limited to
+ * what @token, made the same way, needs. */
+static int bench_reject(const char *backend, const struct bench_case *bc,
+			const struct bench_ctx *ctx, const char *token)
+{
+	struct bench_ctx hctx = *ctx;
+	struct bench_result res;
+	struct bench_objs o;
+	char *pad, *hostile = NULL, *p;
+	int err = 1;
+
+	pad = malloc(opts.reject + 1);
+	if (pad == NULL) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	memset(pad, 'x', opts.reject);
+	pad[opts.reject] = '\0';
+	hctx.pad = pad;
+	hctx.plain = (unsigned char *)pad;
+	hctx.plain_len = opts.reject;
+
+	hctx.op = bc->alg != JWT_ALG_NONE ? BENCH_SIGN : BENCH_ENCRYPT;
+	if (bench_setup(&hctx, &o) || bench_op(&hctx, &o, &hostile)) {
+		err = bench_failed(backend, bc, &o);
+		goto out;
+	}
+	bench_objs_free(&o);
+
+	/* Flip the first character of the (first) signature or the tag. */
+	p = strstr(hostile, "\"signature\":\"");
+	p = p ? p + strlen("\"signature\":\"") : strrchr(hostile, '.') + 1;
+	*p = *p == 'A' ? 'B' : 'A';
+
+	hctx.token = hostile;
+	bench_limits(token, &hctx.limits);
+
+	hctx.op = BENCH_REJECT;
+	if (bench_run(&hctx, &res))
+		goto out;
+	print_result(backend, bc, BENCH_REJECT, &res);
+
+	hctx.op = BENCH_LIMITED;
+	if (bench_run(&hctx, &res))
+		goto out;
+	print_result(backend, bc, BENCH_LIMITED, &res);
+
+	err = 0;
+
+out:
+	free(hostile);
+	free(pad);
+
+	return err;
+}
+
+/* Measure both directions of @bc on the active backend. */
+static int bench_case(const char *backend, const struct bench_case *bc)
+{
+	jwk_set_auto_t *jwk_set = NULL;
+	struct bench_ctx ctx = { .bc = bc };
+	struct bench_objs o;
+	struct bench_result res;
+	enum bench_op make, check;
+	char *pad = NULL, *token = NULL;
+	const jwk_item_t *item;
+	unsigned int keyring;
+	size_t n;
+	int err = 1;
+
+	if (bc->alg != JWT_ALG_NONE) {
+		make = BENCH_SIGN;
+		check = BENCH_VERIFY;
+		keyring = opts.keyring;
+	} else {
+		make = BENCH_ENCRYPT;
+		check = BENCH_DECRYPT;
+		keyring = 0;
+	}
+
+	jwk_set = bench_keygen(bc, keyring);
+	n = jwks_item_count(jwk_set);
+	item = n ? jwks_item_get(jwk_set, n - 1) : NULL;
+	if (item == NULL || jwks_item_error(item)) {
+		/* Not every backend has every algorithm; only one asked for
+		 * by name is an error. */
+		fprintf(stderr, "%s: %s: %s key: %s\n", backend,
+			case_alg_str(bc), bc->named ? "could not generate" :
+			"skipped, no", item ? jwks_item_error_msg(item) :
+			jwks_error_msg(jwk_set));
+		return bc->named;
+	}
+
+	ctx.item = item;
+	ctx.ring = keyring ? jwk_set : NULL;
+
+	/* The payload: a "pad" claim, or a JWE plaintext of --size octets. */
+	if (opts.size) {
+		pad = malloc(opts.size + 1);
+		if (pad == NULL) {
+			perror("malloc");
+			exit(EXIT_FAILURE);
+		}
+		memset(pad, 'x', opts.size);
+		pad[opts.size] = '\0';
+		ctx.pad = pad;
+		ctx.plain = (unsigned char *)pad;
+		ctx.plain_len = opts.size;
+	} else {
+		ctx.plain = (const unsigned char *)"{}";
+		ctx.plain_len = 2;
+	}
+
+	/* Untimed: first use sets up anything cached on the key, and makes
+	 * the token to check. */
+	ctx.op = make;
+	if (bench_setup(&ctx, &o) || bench_op(&ctx, &o, &token)) {
+		err = bench_failed(backend, bc, &o);
+		goto out;
+	}
+	bench_objs_free(&o);
+
+	ctx.op = check;
+	ctx.token = token;
+	if (bench_setup(&ctx, &o) || bench_op(&ctx, &o, NULL)) {
+		err = bench_failed(backend, bc, &o);
+		goto out;
+	}
+	bench_objs_free(&o);
+
+	ctx.op = make;
+	if (bench_run(&ctx, &res))
+		goto out;
+	print_result(backend, bc, make, &res);
+
+	ctx.op = check;
+	if (bench_run(&ctx, &res))
+		goto out;
+	print_result(backend, bc, check, &res);
+
+	if (opts.reject && bench_reject(backend, bc, &ctx, token))
+		goto out;
+
+	err = 0;
+
+out:
+	free(token);
+	free(pad);
+
+	return err;
+}
+
+static void list_cases(void)
+{
+	int a, e;
+	size_t i;
+
+	/* ML-DSA has no name in a LibJWT built without it. */
+	printf("JWS algorithms:\n");
+	for (i = 0; i < N_BENCH_KEYS; i++) {
+		if (jwt_alg_str(bench_keys[i].alg) != NULL)
+			printf("    %s\n", jwt_alg_str(bench_keys[i].alg));
+	}
+
+	printf("JWE algorithms:\n");
+	for (a = JWE_ALG_DIR; a < JWE_ALG_INVAL; a++)
+		printf("    %s\n", jwe_alg_str((jwe_key_alg_t)a));
+
+	printf("JWE encryptions:\n");
+	for (e = JWE_ENC_A128GCM; e < JWE_ENC_INVAL; e++)
+		printf("    %s\n", jwe_enc_str((jwe_enc_t)e));
+
+	printf("Backends:\n");
+	for (i = 0; i < N_ALL_BACKENDS; i++) {
+		if (!jwt_set_crypto_ops(all_backends[i]))
+			printf("    %s\n", all_backends[i]);
+	}
+}
+
+static void add_case(struct bench_case *cases, size_t *n, jwt_alg_t alg,
+		     jwe_key_alg_t kalg, jwe_enc_t enc, int named)
+{
+	if (*n == MAX_CASES)
+		usage("Too many cases", EXIT_FAILURE);
+
+	cases[*n].alg = alg;
+	cases[*n].kalg = kalg;
+	cases[*n].enc = enc;
+	cases[*n].named = named;
+	(*n)++;
+}
+
+static void add_jws(struct bench_case *cases, size_t *n, jwt_alg_t alg,
+		    int named)
+{
+	size_t i;
+
+	for (i = 0; i < N_BENCH_KEYS; i++) {
+		if (bench_keys[i].alg == alg) {
+			add_case(cases, n, alg, JWE_ALG_NONE, JWE_ENC_NONE,
+				 named);
+			return;
+		}
+	}
+
+	fprintf(stderr, "%s: not supported by %s\n", jwt_alg_str(alg),
+		get_progname());
+	exit(EXIT_FAILURE);
+}
+
+static void add_jwe(struct bench_case *cases, size_t *n, jwe_key_alg_t kalg,
+		    jwe_enc_t enc, int named)
+{
+	int e;
+
+	if (enc != JWE_ENC_NONE) {
+		add_case(cases, n, JWT_ALG_NONE, kalg, enc, named);
+		return;
+	}
+
+	/* Only the pairings a backend can do are measured. */
+	for (e = JWE_ENC_A128GCM; e < JWE_ENC_INVAL; e++)
+		add_case(cases, n, JWT_ALG_NONE, kalg, (jwe_enc_t)e, 0);
+}
+
+/* Turn one CASE argument into the cases it names. */
+static void parse_case(struct bench_case *cases, size_t *n, const char *arg)
+{
+	const char *slash = strchr(arg, '/');
+	jwe_key_alg_t kalg;
+	jwe_enc_t enc = JWE_ENC_NONE;
+	jwt_alg_t alg;
+	char name[64];
+	size_t i;
+	int a;
+
+	if (!strcmp(arg, "all") || !strcmp(arg, "jws")) {
+		for (i = 0; i < N_BENCH_KEYS; i++) {
+			if (jwt_alg_str(bench_keys[i].alg) != NULL)
+				add_jws(cases, n, bench_keys[i].alg, 0);
+		}
+	}
+	if (!strcmp(arg, "all") || !strcmp(arg, "jwe")) {
+		for (a = JWE_ALG_DIR; a < JWE_ALG_INVAL; a++)
+			add_jwe(cases, n, (jwe_key_alg_t)a, JWE_ENC_NONE, 0);
+	}
+	if (!strcmp(arg, "all") || !strcmp(arg, "jws") || !strcmp(arg, "jwe"))
+		return;
+
+	if (slash == NULL) {
+		alg = jwt_str_alg(arg);
+		if (alg != JWT_ALG_NONE && alg < JWT_ALG_INVAL) {
+			add_jws(cases, n, alg, 1);
+			return;
+		}
+		snprintf(name, sizeof(name), "%s", arg);
+	} else {
+		snprintf(name, sizeof(name), "%.*s", (int)(slash - arg), arg);
+		enc = jwe_str_enc(slash + 1);
+		if (enc == JWE_ENC_NONE || enc >= JWE_ENC_INVAL)
+			goto unknown;
+	}
+
+	kalg = jwe_str_alg(name);
+	if (kalg == JWE_ALG_NONE || kalg >= JWE_ALG_INVAL)
+		goto unknown;
+
+	add_jwe(cases, n, kalg, enc, 1);
+	return;
+
+unknown:
+	fprintf(stderr, "Unknown algorithm [%s]\nUse -l to see a list of "
+		"supported algorithms\n", arg);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_case cases[MAX_CASES];
+	const char *backends[MAX_BACKENDS];
+	size_t n_cases = 0, n_backends = 0, i, c;
+	const char *output = NULL;
+	unsigned long val;
+	int oc, err = 0;
+	char *end;
+
+	char *optstr = "hlb:n:t:s:k:r:f:o:";
+	struct option opttbl[] = {
+		{ "help",	no_argument,		NULL, 'h' },
+		{ "list",	no_argument,		NULL, 'l' },
+		{ "backend",	required_argument,	NULL, 'b' },
+		{ "iterations",	required_argument,	NULL, 'n' },
+		{ "threads",	required_argument,	NULL, 't' },
+		{ "size",	required_argument,	NULL, 's' },
+		{ "keyring",	required_argument,	NULL, 'k' },
+		{ "reject",	required_argument,	NULL, 'r' },
+		{ "format",	required_argument,	NULL, 'f' },
+		{ "output",	required_argument,	NULL, 'o' },
+		{ NULL, 0, 0, 0 },
+	};
+
+	while ((oc = getopt_long(argc, argv, optstr, opttbl, NULL)) != -1) {
+		switch (oc) {
+		case 'h':
+			usage(NULL, EXIT_SUCCESS);
+
+		case 'l':
+			list_cases();
+			exit(EXIT_SUCCESS);
+
+		case 'b':
+			if (!strcmp(optarg, "all")) {
+				for (i = 0; i < N_ALL_BACKENDS; i++) {
+					if (jwt_set_crypto_ops(all_backends[i]))
+						continue;
+					if (n_backends == MAX_BACKENDS)
+						usage("Too many backends",
+						      EXIT_FAILURE);
+					backends[n_backends++] = all_backends[i];
+				}
+				break;
+			}
+			if (jwt_set_crypto_ops(optarg))
+				usage("Unknown or unavailable --backend",
+				      EXIT_FAILURE);
+			if (n_backends == MAX_BACKENDS)
+				usage("Too many backends", EXIT_FAILURE);
+			backends[n_backends++] = optarg;
+			break;
+
+		case 'n':
+			opts.iterations = strtoul(optarg, &end, 10);
+			if (*optarg == '\0' || *end != '\0' ||
+			    opts.iterations == 0)
+				usage("Invalid --iterations", EXIT_FAILURE);
+			break;
+
+		case 't':
+			val = strtoul(optarg, &end, 10);
+			if (*optarg == '\0' || *end != '\0' || val == 0 ||
+			    val > MAX_THREADS)
+				usage("Invalid --threads", EXIT_FAILURE);
+			opts.threads = (unsigned int)val;
+			break;
+
+		case 's':
+			opts.size = strtoul(optarg, &end, 10);
+			if (*optarg == '\0' || *end != '\0')
+				usage("Invalid --size", EXIT_FAILURE);
+			break;
+
+		case 'k':
+			val = strtoul(optarg, &end, 10);
+			if (*optarg == '\0' || *end != '\0' || val > 100000)
+				usage("Invalid --keyring", EXIT_FAILURE);
+			opts.keyring = (unsigned int)val;
+			break;
+
+		case 'r':
+			opts.reject = strtoul(optarg, &end, 10);
+			if (*optarg == '\0' || *end != '\0')
+				usage("Invalid --reject", EXIT_FAILURE);
+			break;
+
+		case 'f':
+			if (!strcmp(optarg, "text"))
+				opts.format = FORMAT_TEXT;
+			else if (!strcmp(optarg, "csv"))
+				opts.format = FORMAT_CSV;
+			else if (!strcmp(optarg, "json"))
+				opts.format = FORMAT_JSON;
+			else
+				usage("Invalid --format", EXIT_FAILURE);
+			break;
+
+		case 'o':
+			output = optarg;
+			break;
+
+		default: /* '?' */
+			usage("Unknown option", EXIT_FAILURE);
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (argc == 0) {
+		for (i = 0; i < sizeof(default_algs) / sizeof(default_algs[0]); i++)
+			add_jws(cases, &n_cases, default_algs[i], 1);
+	}
+	for (oc = 0; oc < argc; oc++)
+		parse_case(cases, &n_cases, argv[oc]);
+
+	if (n_backends == 0)
+		backends[n_backends++] = jwt_get_crypto_ops();
+
+	opts.out = stdout;
+	if (output != NULL) {
+		opts.out = fopen(output, "w");
+		if (opts.out == NULL) {
+			perror(output);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	print_header();
+
+	for (i = 0; i < n_backends; i++) {
+		if (jwt_set_crypto_ops(backends[i])) {
+			fprintf(stderr, "%s: backend not available\n",
+				backends[i]);
+			err++;
+			continue;
+		}
+
+		for (c = 0; c < n_cases; c++)
+			err += bench_case(backends[i], &cases[c]);
+	}
+
+	if (opts.out != stdout)
+		fclose(opts.out);
+
+	exit(err);
+}